@@ -0,0 +1,77 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/platform.h>
+#include <pangolin/image/image.h>
+#include <pangolin/utils/thread_pool.h>
+
+#include <cstdint>
+
+namespace pangolin
+{
+
+// Colours of the top-left 2x2 block of a Bayer mosaic, in reading order.
+enum class BayerTile
+{
+    RGGB,
+    GBRG,
+    GRBG,
+    BGGR
+};
+
+enum class DemosaicMethod
+{
+    // Average of the nearest samples of each missing colour.
+    Bilinear,
+    // Bilinear, corrected by the Laplacian of the colour measured at each
+    // pixel (Malvar, He and Cutler 2004). This is libdc1394's HQLINEAR.
+    HQLinear
+};
+
+// Interpolate a full colour image from the Bayer mosaic in. out must have
+// the same width and height as in and holds interleaved R,G,B samples for
+// each pixel. 16-bit samples are clamped to [0, 2^bit_depth). Pitched images
+// are supported, but out and in must not overlap.
+//
+// Row bands are shared between the threads of pool, when given. Interior
+// pixels use SSE2, AVX2 or NEON kernels where available.
+PANGOLIN_EXPORT
+void Demosaic(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, ThreadPool* pool = nullptr);
+
+PANGOLIN_EXPORT
+void Demosaic(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned int bit_depth = 16, ThreadPool* pool = nullptr);
+
+// As Demosaic() for an image h rows high, computing only rows
+// [y0, y0+out.h) on the calling thread. Row 0 of out is row y0 and row 0 of
+// in is row in_y0, and in must hold the rows within two of those computed.
+PANGOLIN_EXPORT
+void DemosaicRows(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, size_t h, size_t y0, size_t in_y0);
+
+PANGOLIN_EXPORT
+void DemosaicRows(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned int bit_depth, size_t h, size_t y0, size_t in_y0);
+
+}
@@ -37,6 +37,12 @@ namespace pangolin {
 PANGOLIN_EXPORT
 TypedImage LoadImage(std::istream& in, ImageFileType file_type);
 
+/// Decode from in straight into the rows of dst, which must match the stored
+/// image's dimensions and bits per pixel (dst_fmt). Png, Jpg, Zstd, Lz4 and
+/// P12b need no intermediate image; other types are loaded and copied.
+PANGOLIN_EXPORT
+void LoadImage(std::istream& in, ImageFileType file_type, Image<unsigned char> dst, const PixelFormat& dst_fmt);
+
 PANGOLIN_EXPORT
 TypedImage LoadImage(const std::string& filename, ImageFileType file_type);
 
@@ -0,0 +1,64 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/platform.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pangolin
+{
+
+// Conversion between 16-bit samples and rows of little-endian packed 10 or
+// 12-bit samples, as used by the GRAY10 / GRAY12 pixel formats. Sample i
+// occupies bits [b*i, b*(i+1)) of the packed row, so n samples occupy
+// PackedBytes(b,n) bytes, with any unused bits of the final byte zero.
+//
+// These use SSSE3, AVX2 or NEON kernels when the running CPU supports them.
+
+inline size_t PackedBytes(size_t bits, size_t n)
+{
+    return (bits*n + 7) / 8;
+}
+
+// Read PackedBytes(10,n) bytes of in, writing n samples to out.
+PANGOLIN_EXPORT
+void Unpack10bit(uint16_t* out, const uint8_t* in, size_t n);
+
+// Read PackedBytes(12,n) bytes of in, writing n samples to out.
+PANGOLIN_EXPORT
+void Unpack12bit(uint16_t* out, const uint8_t* in, size_t n);
+
+// Write the low 10 bits of n samples of in to PackedBytes(10,n) bytes of out.
+PANGOLIN_EXPORT
+void Pack10bit(uint8_t* out, const uint16_t* in, size_t n);
+
+// Write the low 12 bits of n samples of in to PackedBytes(12,n) bytes of out.
+PANGOLIN_EXPORT
+void Pack12bit(uint8_t* out, const uint16_t* in, size_t n);
+
+}
@@ -26,6 +26,7 @@
 #pragma once
 
 #include <mutex>
+#include <vector>
 
 #include <pangolin/log/packetstream.h>
 #include <pangolin/log/packetstream_source.h>
@@ -48,11 +49,30 @@ struct Packet
         return _stream;
     }
 
+    // Pointer to the next len bytes of packet data inside the memory mapped
+    // file, consuming them. Returns nullptr if the stream isn't mapped or
+    // len exceeds the packet data remaining. Hold Stream().mapping() to use
+    // the pointer beyond the lifetime of the stream. For compressed packets
+    // the pointer is into the decompressed data, valid while this Packet is.
+    const unsigned char* ReadDirect(size_t len);
+
+    // Copy up to len bytes of packet data to target, returning the number
+    // read. Use this rather than Stream().read(), which sees the stored form
+    // of compressed packets.
+    size_t Read(char* target, size_t len);
+
+    // True if the packet was stored compressed. Its data has already been
+    // decompressed and is served by Read() / ReadDirect().
+    bool Compressed() const
+    {
+        return _compressed;
+    }
+
     PacketStreamSourceId src;
     int64_t time;
     size_t size;
     size_t sequence_num;
-    picojson::value meta;
+    PacketMeta meta;
     std::streampos frame_streampos;
 
 private:
@@ -65,6 +85,10 @@ private:
 
     std::streampos data_streampos;
     size_t _data_len;
+
+    bool _compressed;
+    std::vector<unsigned char> _data;
+    size_t _data_read;
 };
 
 }
@@ -0,0 +1,137 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pangolin/platform.h>
+
+namespace pangolin {
+
+// Packets of a source declaring a data compression codec ("lz4" or "zstd")
+// are stored as a method byte followed by:
+//   0: the packet data, stored as is
+//   1: varint data size, compressed data
+//   2: varint position of the TAG_SRC_DICT record, varint data size,
+//      data compressed with that dictionary
+// The writer trains a dictionary from the first packets of each source,
+// which suits streams of small, similar packets such as IMU samples.
+
+// Dictionary read from a TAG_SRC_DICT record.
+class PANGOLIN_EXPORT PacketDictionary
+{
+public:
+    PacketDictionary(std::string data)
+        : _data(std::move(data))
+    {
+    }
+
+    const std::string& Data() const
+    {
+        return _data;
+    }
+
+private:
+    friend class PacketDecompressor;
+    std::string _data;
+
+    // Codec specific form of the dictionary, prepared on first use.
+    std::shared_ptr<void> _prepared;
+};
+
+// Compresses the packets of one source. Not thread safe.
+class PANGOLIN_EXPORT PacketCompressor
+{
+public:
+    // Throws std::invalid_argument if codec isn't supported by this build.
+    PacketCompressor(const std::string& codec);
+    ~PacketCompressor();
+
+    static bool Supported(const std::string& codec);
+
+    // Dictionary the next packets will be compressed with, once trained.
+    // It must be written to the stream before them, at DictionaryPos().
+    const std::string& Dictionary() const
+    {
+        return _dictionary;
+    }
+
+    // Position of the dictionary record in the current file, or 0 if it has
+    // yet to be written.
+    uint64_t DictionaryPos() const
+    {
+        return _dictionary_pos;
+    }
+
+    void SetDictionaryPos(uint64_t pos)
+    {
+        _dictionary_pos = pos;
+    }
+
+    // Append the stored form of the concatenated parts to out.
+    void Compress(const std::pair<const char*,size_t>* parts, size_t num_parts, std::string& out);
+
+private:
+    void AddSample(const std::string& data);
+    void TrainDictionary();
+
+    struct Codec;
+    std::unique_ptr<Codec> _codec;
+
+    std::string _dictionary;
+    uint64_t _dictionary_pos;
+
+    std::string _samples;
+    std::vector<size_t> _sample_sizes;
+    bool _trained;
+
+    std::string _data;
+};
+
+// Decompresses packet data of a source declaring codec.
+class PANGOLIN_EXPORT PacketDecompressor
+{
+public:
+    using DictionaryLookup = std::function<std::shared_ptr<PacketDictionary>(uint64_t pos)>;
+
+    // Throws std::invalid_argument if codec isn't supported by this build.
+    PacketDecompressor(const std::string& codec);
+    ~PacketDecompressor();
+
+    // Decode the stored form of a packet into out. Throws std::runtime_error
+    // if it is corrupt.
+    void Decompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const DictionaryLookup& dictionary);
+
+private:
+    struct Codec;
+    std::unique_ptr<Codec> _codec;
+};
+
+}
@@ -0,0 +1,94 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <pangolin/platform.h>
+#include <pangolin/log/packetstream_source.h>
+
+namespace pangolin {
+
+// Packets found by scanning part of a stream held in memory.
+struct PANGOLIN_EXPORT PacketIndexScan
+{
+    enum Status
+    {
+        // Stopped at the first record starting at or beyond the region.
+        RegionEnd,
+        // Reached the index, footer or end of data: there are no more packets.
+        DataEnd,
+        // Stopped at a record which couldn't be parsed.
+        BadRecord
+    };
+
+    struct Entry
+    {
+        PacketStreamSourceId src;
+        PacketStreamSource::PacketInfo info;
+    };
+
+    PacketIndexScan()
+        : end(0), status(DataEnd)
+    {
+    }
+
+    // Start of every record passed, in order.
+    std::vector<uint64_t> records;
+
+    // Packets, in order.
+    std::vector<Entry> packets;
+
+    // Sources, including any declared by records passed.
+    std::vector<PacketStreamSource> sources;
+
+    // Where scanning stopped.
+    uint64_t end;
+    Status status;
+};
+
+// Follow the records of a stream from begin until one starts at or beyond
+// end. sources are those declared before begin (their indices are ignored).
+//
+// With resync, begin needn't be the start of a record: scanning starts at
+// the first position from which two consecutive records parse, which is
+// how the region of a stream split for parallel scanning is picked up.
+// Such a scan is only known to be in step with the stream once it passes
+// through a record found by scanning the preceding data.
+PANGOLIN_EXPORT
+PacketIndexScan ScanPacketIndex(
+    const char* data, size_t size, uint64_t begin, uint64_t end,
+    const std::vector<PacketStreamSource>& sources, bool resync
+);
+
+// Declare the source described by a TAG_ADD_SOURCE record, either the next
+// one in sources or a repeat declaration of an existing one. Throws
+// std::runtime_error for any other id, which could only come from a corrupt
+// stream.
+PANGOLIN_EXPORT
+void ParsePacketStreamSource(const picojson::value& json, std::vector<PacketStreamSource>& sources);
+
+}
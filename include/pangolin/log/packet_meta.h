@@ -0,0 +1,137 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pangolin/platform.h>
+#include <pangolin/utils/picojson.h>
+
+namespace pangolin {
+
+// Key names of a binary metadata schema (TAG_META_SCHEMA record), in the
+// order their values appear in each TAG_SRC_META record that refers to it.
+using PacketMetaKeys = std::vector<std::string>;
+
+// Frame metadata read from a stream. Metadata written in the binary form is
+// held encoded and only converted to JSON the first time it is accessed, so
+// frames whose metadata is never looked at cost no parsing.
+class PANGOLIN_EXPORT PacketMeta
+{
+public:
+    PacketMeta()
+        : _decoded(true)
+    {
+    }
+
+    PacketMeta(const picojson::value& value)
+        : _value(value), _decoded(true)
+    {
+    }
+
+    PacketMeta(picojson::value&& value)
+        : _decoded(true)
+    {
+        _value.swap(value);
+    }
+
+    PacketMeta(std::shared_ptr<const PacketMetaKeys> keys, std::string encoded)
+        : _decoded(false), _keys(std::move(keys)), _encoded(std::move(encoded))
+    {
+    }
+
+    const picojson::value& value() const
+    {
+        if(!_decoded) Decode();
+        return _value;
+    }
+
+    operator const picojson::value&() const
+    {
+        return value();
+    }
+
+    template<typename T>
+    bool is() const
+    {
+        return value().is<T>();
+    }
+
+    template<typename T>
+    const T& get() const
+    {
+        return value().get<T>();
+    }
+
+    const picojson::value& operator[](const std::string& key) const
+    {
+        return value()[key];
+    }
+
+    bool contains(const std::string& key) const
+    {
+        return value().contains(key);
+    }
+
+    template<typename T>
+    T get_value(const std::string& key, T default_value) const
+    {
+        return value().get_value(key, default_value);
+    }
+
+    std::string serialize(bool prettify = false) const
+    {
+        return value().serialize(prettify);
+    }
+
+    template<typename Iter>
+    void serialize(Iter os, bool prettify = false) const
+    {
+        value().serialize(os, prettify);
+    }
+
+private:
+    void Decode() const;
+
+    mutable picojson::value _value;
+    mutable bool _decoded;
+    std::shared_ptr<const PacketMetaKeys> _keys;
+    std::string _encoded;
+};
+
+// Signature identifying the schema of a metadata object: its keys, in order.
+PANGOLIN_EXPORT
+std::string PacketMetaSignature(const picojson::object& meta);
+
+// Append the binary encoding of a metadata object's values, in key order.
+// Each value is a type byte followed by its data. Nested arrays and objects
+// are encoded inline, with object keys written out in full.
+PANGOLIN_EXPORT
+void AppendPacketMeta(std::string& out, const picojson::object& meta);
+
+}
@@ -0,0 +1,139 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pangolin/platform.h>
+#include <pangolin/log/packetstream_source.h>
+
+namespace pangolin {
+
+// First i in [0,n) with time(i) >= t, or n, for time(i) non-decreasing in i.
+// Probes where t would fall if times were evenly spaced, which for regular
+// sensor streams lands within a few entries. Probes alternate with
+// bisection so that the worst case remains logarithmic.
+template<typename TimeFn>
+size_t InterpolationLowerBound(size_t n, int64_t t, TimeFn time)
+{
+    size_t lo = 0, hi = n;
+    bool bisect = false;
+    while(lo < hi) {
+        const int64_t tlo = time(lo);
+        const int64_t thi = time(hi-1);
+        if(t <= tlo) return lo;
+        if(t > thi) return hi;
+
+        size_t mid;
+        if(bisect) {
+            mid = lo + (hi - lo) / 2;
+        }else{
+            const long double f = static_cast<long double>(t - tlo) / static_cast<long double>(thi - tlo);
+            mid = lo + static_cast<size_t>(f * (hi - 1 - lo));
+        }
+        bisect = !bisect;
+
+        if(time(mid) < t) {
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Reader for the two-level time index of a .pango file (see
+// SourceTimeIndexBinary). Only the first time, position and offset of each
+// block of packets is held in memory. Blocks are read from the file when
+// looked up, with the most recent one cached.
+class PANGOLIN_EXPORT PacketTimeIndex
+{
+public:
+    PacketTimeIndex()
+        : _block_packets(0), _payload_pos(0), _payload_bytes(0), _cached_block(-1)
+    {
+    }
+
+    // Read the TAG_PANGO_TIME_INDEX record at pos in filename. Returns false
+    // if there isn't a valid one.
+    bool Open(const std::string& filename, uint64_t pos);
+
+    void Close();
+
+    bool IsOpen() const
+    {
+        return _file.is_open();
+    }
+
+    size_t NumSources() const
+    {
+        return _sources.size();
+    }
+
+    size_t NumPackets(PacketStreamSourceId src) const
+    {
+        return src < _sources.size() ? _sources[src].num_packets : 0;
+    }
+
+    // Position and time of a packet of src, which must exist.
+    PacketStreamSource::PacketInfo At(PacketStreamSourceId src, size_t packet);
+
+    // First packet of src with capture time >= time_us, or NumPackets(src).
+    size_t LowerBound(PacketStreamSourceId src, int64_t time_us);
+
+    // Bytes held in memory, excluding the file buffer.
+    size_t MemoryBytes() const;
+
+private:
+    struct Source
+    {
+        size_t num_packets;
+        size_t first_block;
+    };
+
+    struct Block
+    {
+        int64_t time;
+        uint64_t pos;
+        uint64_t offset;
+    };
+
+    const std::vector<PacketStreamSource::PacketInfo>& LoadBlock(size_t block);
+
+    std::ifstream _file;
+    size_t _block_packets;
+    uint64_t _payload_pos;
+    uint64_t _payload_bytes;
+    std::vector<Source> _sources;
+    std::vector<Block> _blocks;
+
+    size_t _cached_block;
+    std::vector<PacketStreamSource::PacketInfo> _cached;
+};
+
+}
@@ -26,11 +26,16 @@
 #pragma once
 
 #include <fstream>
+#include <map>
+#include <memory>
 
 #include <pangolin/platform.h>
 
+#include <pangolin/log/packet_compression.h>
+#include <pangolin/log/packet_meta.h>
 #include <pangolin/log/packetstream_tags.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/mapped_file.h>
 
 namespace pangolin
 {
@@ -49,6 +54,12 @@ public:
           _is_pipe(IsPipe(filename))
     {
         cclear();
+        map(filename);
+    }
+
+    ~PacketStream()
+    {
+        close();
     }
 
     bool seekable() const
@@ -61,20 +72,49 @@ public:
         close();
         _is_pipe = IsPipe(filename);
         Base::open(filename.c_str(), std::ios::in | std::ios::binary);
+        map(filename);
     }
 
     void close()
     {
         cclear();
+        _meta_schemas.clear();
+        _dictionaries.clear();
+        if (std::istream::rdbuf() != Base::rdbuf()) {
+            std::istream::rdbuf(Base::rdbuf());
+        }
+        _mapped.reset(nullptr);
         if (Base::is_open()) Base::close();
     }
 
+    // True if reads are served from a memory mapping of the file.
+    bool mapped() const
+    {
+        return _mapped.file() != nullptr;
+    }
+
+    // Mapping backing this stream, or nullptr. Holding it keeps pointers
+    // returned by readDirect() valid after the stream is closed.
+    const std::shared_ptr<MappedFile>& mapping() const
+    {
+        return _mapped.file();
+    }
+
+    // As read(), but returns a pointer into the mapping instead of copying.
+    // Returns nullptr without consuming anything if the stream isn't mapped
+    // or fewer than len bytes remain.
+    const char* readDirect(size_t len);
+
     void seekg(std::streampos target);
 
     void seekg(std::streamoff off, std::ios_base::seekdir way);
 
     std::streampos tellg();
 
+    // Bytes between the read position and the end of file, for bounding
+    // lengths read from the stream before allocating. Unbounded for pipes.
+    size_t remaining();
+
     size_t read(char* target, size_t len);
 
     char get();
@@ -93,11 +133,40 @@ public:
 
     pangoTagType syncToTag();
 
+    // Read the TAG_META_SCHEMA record at the current position.
+    void readMetaSchema();
+
+    // Keys of the schema record written at pos. Schemas not yet passed are
+    // read from the file on first use, e.g. after seeking.
+    std::shared_ptr<const PacketMetaKeys> metaSchema(uint64_t pos);
+
+    // Read the TAG_SRC_DICT record at the current position.
+    void readDictionary();
+
+    // Compression dictionary written at pos, read from the file on first use
+    // as for metaSchema().
+    std::shared_ptr<PacketDictionary> dictionary(uint64_t pos);
+
+    // Shared decompression context for packets of sources declaring codec.
+    PacketDecompressor& decompressor(const std::string& codec);
+
 private:
     using Base = std::ifstream;
 
+    // Regular files are memory mapped where possible so that reads and
+    // seeks don't need system calls.
+    void map(const std::string& filename);
+
     bool _is_pipe;
     pangoTagType _tag;
+    mappedstreambuf _mapped;
+
+    // Binary metadata schemas, by the position they were written at.
+    std::map<uint64_t, std::shared_ptr<const PacketMetaKeys>> _meta_schemas;
+
+    // Compression dictionaries, by the position they were written at.
+    std::map<uint64_t, std::shared_ptr<PacketDictionary>> _dictionaries;
+    std::map<std::string, std::unique_ptr<PacketDecompressor>> _decompressors;
 
     // Amount of frame data left to read. Tracks our position within a data block.
 
@@ -107,5 +176,31 @@ private:
     }
 };
 
+// Bounds-checked varint decoding of in-memory records, as written by
+// appendCompressedUnsignedInt / appendCompressedSignedInt.
+inline bool readCompressedUnsignedInt(const unsigned char*& p, const unsigned char* end, uint64_t& n)
+{
+    n = 0;
+    for(uint32_t shift = 0; p < end && shift < 64; shift += 7) {
+        const unsigned char v = *p++;
+        n |= uint64_t(v & 0x7F) << shift;
+        if(!(v & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool readCompressedSignedInt(const unsigned char*& p, const unsigned char* end, int64_t& n)
+{
+    uint64_t z;
+    if(!readCompressedUnsignedInt(p, end, z)) return false;
+    n = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+    return true;
+}
+
+// Name of file 'segment' of a segmented recording of filename. Segment 0 is
+// filename itself; later segments insert a zero padded number before the
+// extension, e.g. log.pango, log.0001.pango, log.0002.pango, ...
+PANGOLIN_EXPORT
+std::string PacketStreamSegmentFilename(const std::string& filename, size_t segment);
 
 }
@@ -25,11 +25,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <fstream>
 #include <mutex>
 #include <thread>
 
 #include <pangolin/log/packet.h>
+#include <pangolin/log/packet_index_scan.h>
+#include <pangolin/log/packet_time_index.h>
 
 #include <pangolin/log/sync_time.h>
 #include <pangolin/utils/file_utils.h>
@@ -43,11 +46,40 @@ class PANGOLIN_EXPORT PacketStreamReader
 public:
     PacketStreamReader();
 
-    PacketStreamReader(const std::string& filename);
+    PacketStreamReader(const std::string& filename, bool sparse_index = false);
 
     ~PacketStreamReader();
 
-    void Open(const std::string& filename);
+    // Opens filename, along with any further segments of the same recording
+    // (see PacketStreamWriter::SetSegmentLimits). Segments are presented as
+    // one continuous stream with a combined index.
+    //
+    // With sparse_index, the per-packet index isn't loaded: Sources()[i].index
+    // stays empty and packets are looked up through the file's two-level
+    // time index instead (see PacketTimeIndex), using NumPackets / IndexEntry
+    // and Seek. This falls back to the full index for segmented recordings
+    // and files without a time index.
+    //
+    // Files without a valid index have it rebuilt and appended, scanning
+    // the file in parallel chunks where it can be memory mapped.
+    void Open(const std::string& filename, bool sparse_index = false);
+
+    // Rebuild a missing index on a background thread instead of in Open(),
+    // so that playback can start straight away. Packets can be sought once
+    // the rebuild reaches them. Until IndexComplete(), only access the index
+    // through NumPackets(), IndexEntry() and Seek(), not Sources(). Ignored
+    // for segmented recordings and files which can't be memory mapped.
+    // Set before Open().
+    void SetBackgroundIndexing(bool background)
+    {
+        _background_index = background;
+    }
+
+    // False while a background index rebuild is in progress.
+    bool IndexComplete() const
+    {
+        return !_indexing;
+    }
 
     void Close();
 
@@ -74,12 +106,43 @@ public:
     // Jumps to the first packet with time >= time
     size_t Seek(PacketStreamSourceId src, SyncTime::TimePoint time);
 
+    // First packet of src with time >= time, or NumPackets(src) if none.
+    size_t FindFrame(PacketStreamSourceId src, SyncTime::TimePoint time);
+
+    // True if opened with a sparse index which was found.
+    bool SparseIndex() const
+    {
+        return _time_index.IsOpen();
+    }
+
+    size_t NumPackets(PacketStreamSourceId src);
+
+    PacketStreamSource::PacketInfo IndexEntry(PacketStreamSourceId src, size_t framenum);
+
     void FixFileIndex();
 
+    // Files making up this stream, in order
+    const std::vector<std::string>& Segments() const
+    {
+        return _segments;
+    }
+
 private:
     bool GoodToRead();
 
-    bool SetupIndex();
+    void OpenStream(const std::string& filename);
+
+    void OpenSegments(const std::string& filename);
+
+    void OpenSegment(size_t segment);
+
+    bool NextSegment();
+
+    void SeekStream(std::streampos pos);
+
+    bool SetupIndex(bool sparse = false);
+
+    bool SetupTimeIndex(std::streampos indexpos);
 
     void ParseHeader();
 
@@ -87,10 +150,36 @@ private:
 
     bool ParseIndex();
 
-    void RebuildIndex();
+    bool ParseBinaryIndex();
+
+    bool ReadBinaryIndex(std::vector<std::vector<PacketStreamSource::PacketInfo>>& index, size_t max_bytes);
+
+    bool ReadCheckpoint(uint64_t pos, std::streamoff file_end, std::vector<std::vector<PacketStreamSource::PacketInfo>>& index, uint64_t& prev_pos, std::streamoff& end_pos);
+
+    bool RecoverCheckpointIndex(std::streampos& scan_from);
+
+    // Mean size of the records at the start of the data (from begin).
+    std::streamoff EstimatePacketBytes(std::streamoff begin, std::streamoff file_end);
+
+    void SkipCheckpoint();
+
+    void SkipTimeIndex();
+
+    void RebuildIndex(bool background = false);
+
+    // Index the packets of file from position from onwards. In the
+    // background, sources declared after the header are held back in
+    // _scanned_sources rather than added to _sources.
+    void ScanIndex(std::shared_ptr<MappedFile> file, uint64_t from, bool background);
+
+    void StopIndexing();
 
     void AppendIndex();
 
+    // Move the index of sources found by a background scan into _sources,
+    // for those declared there since.
+    void TakeScannedSources();
+
     std::streampos ParseFooter();
 
     void SkipSync();
@@ -108,6 +197,30 @@ private:
 
     bool _is_pipe;
     int _pipe_fd;
+
+    // Segment files and their starting offset within the combined stream.
+    // Packet positions in the index are offsets within the combined stream.
+    std::vector<std::string> _segments;
+    std::vector<std::streamoff> _segment_base;
+    size_t _segment;
+
+    // Packets between index checkpoints, as declared by the header (0 if
+    // the file has none).
+    size_t _checkpoint_packets;
+
+    PacketTimeIndex _time_index;
+
+    bool _background_index;
+    std::thread _index_thread;
+    std::atomic<bool> _indexing;
+    std::atomic<bool> _stop_indexing;
+
+    // Sources a background scan found declared after the header, by id,
+    // with their index. They only join _sources when reading reaches their
+    // declaration, so that the scan never reallocates _sources under
+    // references callers hold into it. Entries below _sources.size() are
+    // unused.
+    std::vector<PacketStreamSource> _scanned_sources;
 };
 
 
@@ -0,0 +1,109 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include <pangolin/log/packetstream_reader.h>
+
+namespace pangolin {
+
+// Plays back sources from any number of indexed PacketStreamReaders in
+// capture time order, as fast as they can be read. Where PlaybackSession
+// keeps sources in step by having each reader's thread wait its turn on a
+// shared SyncTime, the scheduler merges the sources' indices up front and
+// simply hands out whichever packet is next, so a single thread can
+// reprocess a multi-sensor recording at disk speed. Packets with equal
+// times are released in the order their streams were added.
+class PANGOLIN_EXPORT PacketStreamScheduler
+{
+public:
+    struct Stream
+    {
+        std::shared_ptr<PacketStreamReader> reader;
+        PacketStreamSourceId src;
+    };
+
+    // Schedule packets from src of reader, starting from its next packet.
+    // Returns the stream number which NextFrame reports packets under.
+    size_t AddStream(const std::shared_ptr<PacketStreamReader>& reader, PacketStreamSourceId src);
+
+    // Schedule every source of reader.
+    void AddStreams(const std::shared_ptr<PacketStreamReader>& reader);
+
+    const std::vector<Stream>& Streams() const
+    {
+        return _streams;
+    }
+
+    // True if any packets are left.
+    bool Good() const
+    {
+        return !_queue.empty();
+    }
+
+    // Capture time of the next packet, or 0 if none are left.
+    int64_t NextPacketTime() const
+    {
+        return _queue.empty() ? 0 : _queue.top().time_us;
+    }
+
+    // Read the next packet in time order, setting stream to the stream it
+    // belongs to. Throws if no packets are left.
+    Packet NextFrame(size_t& stream);
+
+    Packet NextFrame()
+    {
+        size_t stream;
+        return NextFrame(stream);
+    }
+
+    // Continue from the first packet of each stream at or after time.
+    void Seek(SyncTime::TimePoint time);
+
+private:
+    struct Event
+    {
+        int64_t time_us;
+        size_t stream;
+        size_t frame;
+
+        // Ordering for a min-heap
+        bool operator<(const Event& o) const
+        {
+            return time_us > o.time_us || (time_us == o.time_us && stream > o.stream);
+        }
+    };
+
+    void Schedule(size_t stream, size_t frame);
+
+    std::vector<Stream> _streams;
+    std::priority_queue<Event> _queue;
+};
+
+}
@@ -53,6 +53,10 @@ struct PANGOLIN_EXPORT PacketStreamSource
     std::string     data_definitions;
     int64_t         data_size_bytes;
 
+    // Codec packets are compressed with ("lz4" or "zstd"), or empty if they
+    // are stored as is. See packet_compression.h.
+    std::string     data_compression;
+
     // Index keyed by packet_id
     std::vector<PacketInfo> index;
 
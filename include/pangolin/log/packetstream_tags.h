@@ -18,6 +18,7 @@ const static std::string pss_pkt_alignment_bytes = "alignment_bytes";
 const static std::string pss_pkt_definitions = "definitions";
 const static std::string pss_pkt_size_bytes = "size_bytes";
 const static std::string pss_pkt_format_written = "format_written";
+const static std::string pss_pkt_compression = "compression";
 
 const unsigned int TAG_LENGTH = 3;
 
@@ -26,10 +27,16 @@ const uint32_t TAG_PANGO_HDR    = PANGO_TAG('L', 'I', 'N');
 const uint32_t TAG_PANGO_MAGIC  = PANGO_TAG('P', 'A', 'N');
 const uint32_t TAG_PANGO_SYNC   = PANGO_TAG('S', 'Y', 'N');
 const uint32_t TAG_PANGO_STATS  = PANGO_TAG('S', 'T', 'A');
+const uint32_t TAG_PANGO_INDEX  = PANGO_TAG('I', 'D', 'X');
 const uint32_t TAG_PANGO_FOOTER = PANGO_TAG('F', 'T', 'R');
+const uint32_t TAG_PANGO_CHECKPOINT = PANGO_TAG('C', 'H', 'K');
+const uint32_t TAG_PANGO_TIME_INDEX = PANGO_TAG('T', 'I', 'X');
 const uint32_t TAG_ADD_SOURCE   = PANGO_TAG('S', 'R', 'C');
 const uint32_t TAG_SRC_JSON     = PANGO_TAG('J', 'S', 'N');
 const uint32_t TAG_SRC_PACKET   = PANGO_TAG('P', 'K', 'T');
+const uint32_t TAG_SRC_META     = PANGO_TAG('M', 'E', 'T');
+const uint32_t TAG_META_SCHEMA  = PANGO_TAG('K', 'E', 'Y');
+const uint32_t TAG_SRC_DICT     = PANGO_TAG('D', 'C', 'T');
 const uint32_t TAG_END          = PANGO_TAG('E', 'N', 'D');
 #undef PANGO_TAG
 
@@ -25,7 +25,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
 #include <ostream>
+#include <string>
 
 #include <pangolin/log/packetstream.h>
 #include <pangolin/log/packetstream_source.h>
@@ -39,14 +45,15 @@ class PANGOLIN_EXPORT PacketStreamWriter
 {
 public:
     PacketStreamWriter()
-        : _stream(&_buffer), _indexable(false), _open(false), _bytes_written(0)
+        : _buffer(new threadedfilebuf()), _stream(_buffer.get()), _indexable(false), _open(false), _bytes_written(0), _id(NextId())
     {
         _stream.exceptions(std::ostream::badbit);
     }
 
     PacketStreamWriter(const std::string& filename, size_t buffer_size  = 100*1024*1024)
-        : _buffer(pangolin::PathExpand(filename), buffer_size), _stream(&_buffer),
-          _indexable(!IsPipe(filename)), _open(_stream.good()), _bytes_written(0)
+        : _buffer(new threadedfilebuf(pangolin::PathExpand(filename), buffer_size)), _stream(_buffer.get()),
+          _indexable(!IsPipe(filename)), _open(_stream.good()), _bytes_written(0), _id(NextId()),
+          _filename(pangolin::PathExpand(filename)), _buffer_size(buffer_size)
     {
         _stream.exceptions(std::ostream::badbit);
         WriteHeader();
@@ -59,10 +66,18 @@ public:
     void Open(const std::string& filename, size_t buffer_size = 100 * 1024 * 1024)
     {
         Close();
-        _buffer.open(filename, buffer_size);
+        _buffer->open(filename, buffer_size);
         _open = _stream.good();
         _bytes_written = 0;
         _indexable = !IsPipe(filename);
+        _filename = filename;
+        _buffer_size = buffer_size;
+        _segment_index = 0;
+        _segment_start_time_us = -1;
+        ResetCheckpoints();
+        ClearIndex();
+        ClearMetaSchemas();
+        ResetDictionaries();
         WriteHeader();
     }
 
@@ -73,9 +88,10 @@ public:
             if (_indexable) {
                 WriteEnd();
             }
-            _buffer.close();
+            _buffer->close();
             _open = false;
         }
+        FinishSegments();
     }
 
     // Does not write footer or index.
@@ -83,24 +99,39 @@ public:
     {
         if (_open)
         {
-        _buffer.force_close();
+        _buffer->force_close();
         Close();
         }
     }
 
 
     // Writes to the stream immediately upon add. Return source id # and writes
-    // source id # to argument struct
+    // source id # to argument struct. Packets of sources declaring
+    // data_compression are compressed as they are written, with a dictionary
+    // trained from their first packets (see packet_compression.h). Sources
+    // declaring a codec this build lacks are stored as is, with a warning.
     PacketStreamSourceId AddSource(PacketStreamSource& source);
 
     // If constructor is called inline
     PacketStreamSourceId AddSource(const PacketStreamSource& source);
 
+    // Packets may be written from several threads at once, provided all
+    // sources have been added first. Each packet claims its space in the
+    // write buffer atomically and is copied in without taking a lock, unless
+    // segment limits are set. Index entries are kept per thread and merged
+    // for checkpoints, Sources() and the final index.
     void WriteSourcePacket(
         PacketStreamSourceId src, const char* source,const int64_t receive_time_us,
         size_t sourcelen, const picojson::value& meta = picojson::value()
     );
 
+    // Gather variant: the packet payload is the concatenation of the
+    // (pointer, length) pairs in sources, so callers needn't join them first.
+    void WriteSourcePacket(
+        PacketStreamSourceId src, const std::vector<std::pair<const char*,size_t>>& sources,
+        const int64_t receive_time_us, const picojson::value& meta = picojson::value()
+    );
+
     // For stream read/write synchronization. Note that this is NOT the same as
     // time synchronization on playback of iPacketStreams.
     void WriteSync();
@@ -109,7 +140,9 @@ public:
     // the underlying ostream.
     void WriteEnd();
 
-    const std::vector<PacketStreamSource>& Sources() const {
+    // Sources, indexing every packet written so far.
+    const std::vector<PacketStreamSource>& Sources() {
+        MergeIndex();
         return _sources;
     }
 
@@ -117,18 +150,152 @@ public:
         return _open;
     }
 
+    // Write the index as JSON (TAG_PANGO_STATS) rather than the compact
+    // binary form (TAG_PANGO_INDEX) so that older readers can use it.
+    void SetJsonIndex(bool json_index) {
+        _json_index = json_index;
+    }
+
+    // Write frame metadata as JSON (TAG_SRC_JSON) rather than the binary
+    // form (TAG_SRC_META), so that older readers can use it. The binary form
+    // stores the keys of each distinct metadata object once per source.
+    void SetJsonMeta(bool json_meta) {
+        _json_meta = json_meta;
+    }
+
+    // Roll over to a new file (see PacketStreamSegmentFilename) before any
+    // packet which would start beyond max_bytes into the current file, or
+    // max_duration_us after the first packet in it. Each file is a complete
+    // .pango file with its own index and footer, so a crash only loses the
+    // index of the last segment. Zero disables a limit. Ignored for pipes.
+    void SetSegmentLimits(size_t max_bytes, int64_t max_duration_us) {
+        _segment_max_bytes = max_bytes;
+        _segment_max_us = max_duration_us;
+    }
+
+    size_t SegmentIndex() const {
+        return _segment_index;
+    }
+
+    // Bypass the page cache with O_DIRECT writes, syncing every sync_bytes.
+    // See threadedfilebuf::set_direct_io. Set before Open().
+    void SetDirectIO(bool direct_io, size_t sync_bytes = 0) {
+        _direct_io = direct_io;
+        _sync_bytes = sync_bytes;
+        _buffer->set_direct_io(direct_io, sync_bytes);
+    }
+
+    // Keep up to queue_depth writes in flight with io_uring (0 to disable).
+    // See threadedfilebuf::set_io_uring. Set before Open().
+    void SetIoUring(size_t queue_depth) {
+        _io_uring_depth = queue_depth;
+        _buffer->set_io_uring(queue_depth);
+    }
+
+    // Write an incremental index checkpoint after every num_packets packets
+    // (0 to disable). If the recording is cut short, the reader recovers the
+    // index from the checkpoints and only has to scan the packets after the
+    // last one. Ignored for pipes. Set before Open() so that the header
+    // tells readers to look for checkpoints.
+    void SetCheckpointInterval(size_t num_packets) {
+        _checkpoint_packets = num_packets;
+    }
+
 private:
     void WriteHeader();
     void Write(const PacketStreamSource&);
-    void WriteMeta(PacketStreamSourceId src, const picojson::value& data);
+    void WritePacket(
+        PacketStreamSourceId src, const std::pair<const char*,size_t>* sources, size_t num_sources,
+        const int64_t receive_time_us, const picojson::value& meta
+    );
+    void StorePacket(
+        PacketStreamSourceId src, const std::pair<const char*,size_t>* sources, size_t num_sources,
+        size_t sourcelen, const int64_t receive_time_us, const picojson::value& meta
+    );
+    std::string PacketHeader(
+        PacketStreamSourceId src, const int64_t receive_time_us, size_t sourcelen, size_t storedlen, const picojson::value& meta
+    );
+    void AppendPacket(
+        PacketStreamSourceId src, const std::string& header, const std::pair<const char*,size_t>* sources,
+        size_t num_sources, size_t sourcelen, const int64_t receive_time_us
+    );
+    void StartNewSegment();
+
+    // Open the file for the next segment on another thread, ready for
+    // StartNewSegment(), which then only has to swap buffers.
+    void PrepareNextSegment();
+    std::unique_ptr<threadedfilebuf> OpenBuffer(const std::string& filename) const;
+
+    // Wait for closing segments, and remove any unused prepared segment.
+    void FinishSegments();
+    void PacketWritten();
+    void WriteCheckpoint();
+    void ResetCheckpoints();
+
+    // Index entries recorded by one writing thread.
+    struct ThreadIndex;
+    ThreadIndex& LocalIndex();
 
-    threadedfilebuf _buffer;
+    // Move entries for all packets reserved so far into _sources, in order.
+    void MergeIndex();
+    void ClearIndex();
+
+    // Position of the schema record for meta's keys, writing one if needed.
+    uint64_t MetaSchema(PacketStreamSourceId src, const picojson::object& meta);
+    void ClearMetaSchemas();
+
+    // Compressor of a source declaring data_compression.
+    struct SourceCompression;
+
+    // Write the dictionary record for c if it has a dictionary not yet in
+    // the current file. Called with c's mutex held.
+    void WriteDictionary(PacketStreamSourceId src, SourceCompression& c);
+    void ResetDictionaries();
+
+    static uint64_t NextId() {
+        static std::atomic<uint64_t> next_id(0);
+        return ++next_id;
+    }
+
+    // Replaced with the next file when starting a new segment.
+    std::unique_ptr<threadedfilebuf> _buffer;
     std::ostream _stream;
     bool _indexable, _open;
+    bool _json_index = false;
+    bool _json_meta = false;
 
     std::vector<PacketStreamSource> _sources;
-    size_t _bytes_written;
+    std::atomic<size_t> _bytes_written;
     std::recursive_mutex _lock;
+
+    const uint64_t _id;
+    std::mutex _thread_index_lock;
+    std::vector<std::shared_ptr<ThreadIndex>> _thread_index;
+
+    std::mutex _meta_lock;
+    std::map<std::pair<PacketStreamSourceId,std::string>, uint64_t> _meta_schemas;
+
+    // By source id, null for sources stored as is.
+    std::vector<std::shared_ptr<SourceCompression>> _compression;
+
+    std::string _filename;
+    size_t _buffer_size = 0;
+    size_t _segment_max_bytes = 0;
+    int64_t _segment_max_us = 0;
+    size_t _segment_index = 0;
+    int64_t _segment_start_time_us = -1;
+    int64_t _first_segment_time_us = 0;
+    std::future<std::unique_ptr<threadedfilebuf>> _next_segment;
+    std::future<void> _closing_segment;
+
+    bool _direct_io = false;
+    size_t _sync_bytes = 0;
+    size_t _io_uring_depth = 0;
+
+    size_t _checkpoint_packets = 0;
+    std::atomic<size_t> _packets_since_checkpoint{0};
+    uint64_t _last_checkpoint_pos = 0;
+    std::vector<size_t> _checkpoint_index_start;
 };
 
 inline void writeCompressedUnsignedInt(std::ostream& writer, size_t n)
@@ -151,6 +318,11 @@ inline void writeTag(std::ostream& writer, const pangoTagType tag)
     writer.write(reinterpret_cast<const char*>(&tag), TAG_LENGTH);
 }
 
+inline void appendTag(std::string& out, const pangoTagType tag)
+{
+    out.append(reinterpret_cast<const char*>(&tag), TAG_LENGTH);
+}
+
 inline picojson::value SourceStats(const std::vector<PacketStreamSource>& srcs)
 {
     picojson::value stat;
@@ -170,4 +342,95 @@ inline picojson::value SourceStats(const std::vector<PacketStreamSource>& srcs)
     return stat;
 }
 
+inline void appendCompressedUnsignedInt(std::string& out, uint64_t n)
+{
+    while (n >= 0x80)
+    {
+        out.push_back(static_cast<char>(0x80 | (n & 0x7F)));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+// Signed values are zig-zag encoded so that small negative deltas stay small.
+inline void appendCompressedSignedInt(std::string& out, int64_t n)
+{
+    appendCompressedUnsignedInt(out, (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63));
+}
+
+// Compact binary equivalent of SourceStats, written after TAG_PANGO_INDEX.
+// Layout (all integers varint encoded):
+//   payload_bytes, num_sources,
+//   per source: num_packets, num_packets x delta(pos), num_packets x delta(time)
+// Deltas are taken from the previous packet of the same source (or zero).
+// If first is given, only packets from first[i] onwards are included for
+// source i (as used by the incremental checkpoints).
+inline std::string SourceIndexBinary(const std::vector<PacketStreamSource>& srcs, const std::vector<size_t>& first = {})
+{
+    std::string payload;
+    appendCompressedUnsignedInt(payload, srcs.size());
+    for(size_t i=0; i < srcs.size(); ++i) {
+        const auto& index = srcs[i].index;
+        const auto begin = index.begin() + std::min(i < first.size() ? first[i] : 0, index.size());
+        appendCompressedUnsignedInt(payload, index.end() - begin);
+        int64_t last = 0;
+        for (auto frame = begin; frame != index.end(); ++frame) {
+            const int64_t pos = static_cast<int64_t>(frame->pos);
+            appendCompressedSignedInt(payload, pos - last);
+            last = pos;
+        }
+        last = 0;
+        for (auto frame = begin; frame != index.end(); ++frame) {
+            appendCompressedSignedInt(payload, frame->capture_time - last);
+            last = frame->capture_time;
+        }
+    }
+
+    std::string out;
+    appendCompressedUnsignedInt(out, payload.size());
+    return out + payload;
+}
+
+// Two-level time index, written before TAG_PANGO_INDEX so that readers can
+// look packets up by time without holding the full index in memory (see
+// PacketTimeIndex). Packets of each source are grouped into blocks.
+// Layout:
+//   varint payload_bytes, varint block_packets, varint num_sources,
+//   per source: varint num_packets
+//   per source and block: int64 time and uint64 pos of its first packet,
+//     uint64 offset of its remaining packets from the start of the payload
+//   per source and block: remaining packets as varint delta(pos), delta(time)
+inline std::string SourceTimeIndexBinary(const std::vector<PacketStreamSource>& srcs, size_t block_packets = 4096)
+{
+    std::string head, coarse, fine;
+    appendCompressedUnsignedInt(head, block_packets);
+    appendCompressedUnsignedInt(head, srcs.size());
+    size_t num_blocks = 0;
+    for(const auto& src : srcs) {
+        appendCompressedUnsignedInt(head, src.index.size());
+        num_blocks += (src.index.size() + block_packets - 1) / block_packets;
+    }
+
+    const size_t fine_start = head.size() + num_blocks * (sizeof(int64_t) + 2*sizeof(uint64_t));
+    for(const auto& src : srcs) {
+        const auto& index = src.index;
+        for(size_t b = 0; b < index.size(); b += block_packets) {
+            const int64_t time = index[b].capture_time;
+            const uint64_t pos = static_cast<uint64_t>(index[b].pos);
+            const uint64_t offset = fine_start + fine.size();
+            coarse.append(reinterpret_cast<const char*>(&time), sizeof(int64_t));
+            coarse.append(reinterpret_cast<const char*>(&pos), sizeof(uint64_t));
+            coarse.append(reinterpret_cast<const char*>(&offset), sizeof(uint64_t));
+            for(size_t i = b + 1; i < std::min(b + block_packets, index.size()); ++i) {
+                appendCompressedSignedInt(fine, static_cast<int64_t>(index[i].pos) - static_cast<int64_t>(index[i-1].pos));
+                appendCompressedSignedInt(fine, index[i].capture_time - index[i-1].capture_time);
+            }
+        }
+    }
+
+    std::string out;
+    appendCompressedUnsignedInt(out, head.size() + coarse.size() + fine.size());
+    return out + head + coarse + fine;
+}
+
 }
@@ -0,0 +1,252 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <pangolin/utils/cache_padded.h>
+
+namespace pangolin
+{
+
+// Bounded single-producer / single-consumer ring. push() may only be called
+// from one thread and pop() from one (other) thread. Neither takes a lock;
+// the mutex / condition variable are only touched when a thread has to sleep
+// because the ring is empty or full.
+template<typename T>
+class SpscRing
+{
+public:
+    SpscRing(size_t capacity)
+        : slots(capacity), head(0), tail(0), sleepers(0)
+    {
+        if(capacity == 0) {
+            throw std::invalid_argument("SpscRing: capacity must be non-zero.");
+        }
+    }
+
+    size_t Capacity() const {
+        return slots.size();
+    }
+
+    size_t Size() const {
+        return tail.value.load(std::memory_order_acquire) - head.value.load(std::memory_order_acquire);
+    }
+
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    bool Full() const {
+        return Size() == slots.size();
+    }
+
+    // Producer side. Returns false if the ring is full.
+    bool push(T&& v) {
+        const size_t t = tail.value.load(std::memory_order_relaxed);
+        if(t - head.value.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[t % slots.size()] = std::move(v);
+        tail.value.store(t + 1, std::memory_order_seq_cst);
+        WakeSleepers();
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T& v) {
+        const size_t h = head.value.load(std::memory_order_relaxed);
+        if(tail.value.load(std::memory_order_acquire) == h) {
+            return false;
+        }
+        v = std::move(slots[h % slots.size()]);
+        head.value.store(h + 1, std::memory_order_seq_cst);
+        WakeSleepers();
+        return true;
+    }
+
+    // Block until pred(*this) holds or timeout. Returns pred(*this).
+    template<typename Pred>
+    bool wait_for(std::chrono::microseconds timeout, Pred pred) {
+        if(pred(*this)) return true;
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        sleepers.value.fetch_add(1, std::memory_order_seq_cst);
+        const bool ok = sleep_cv.wait_for(lk, timeout, [&](){ return pred(*this); });
+        sleepers.value.fetch_sub(1, std::memory_order_relaxed);
+        return ok;
+    }
+
+    // Wake any waiting thread so that it can re-evaluate external conditions
+    // (e.g. shutdown flags).
+    void notify_all() {
+        std::lock_guard<std::mutex> lk(sleep_mutex);
+        sleep_cv.notify_all();
+    }
+
+private:
+    void WakeSleepers() {
+        if(sleepers.value.load(std::memory_order_seq_cst) > 0) {
+            notify_all();
+        }
+    }
+
+    std::vector<T> slots;
+    CachePadded<std::atomic<size_t>> head;
+    CachePadded<std::atomic<size_t>> tail;
+    CachePadded<std::atomic<int>> sleepers;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+};
+
+// Lock-free counterpart to FixSizeBuffersQueue for the case of exactly one
+// producer thread (getFreeBuffer / addValidBuffer) and one consumer thread
+// (getNext / getNewest / returnOrAddUsedBuffer / DropNFrames). Buffers cycle
+// between a 'valid' ring (producer -> consumer) and an 'empty' ring
+// (consumer -> producer), so no buffer is ever shared.
+template<typename BufPType>
+class FixSizeBuffersRing
+{
+public:
+    FixSizeBuffersRing(size_t max_buffers)
+        : validBuffers(max_buffers), emptyBuffers(max_buffers)
+    {
+    }
+
+    // Consumer
+    BufPType getNewest() {
+        BufPType bp{};
+        if(!validBuffers.pop(bp)) {
+            // Empty queue.
+            return bp;
+        }
+        // Requeue all but newest buffers.
+        BufPType next{};
+        while(validBuffers.pop(next)) {
+            std::swap(bp, next);
+            emptyBuffers.push(std::move(next));
+        }
+        return bp;
+    }
+
+    // Consumer
+    BufPType getNext() {
+        BufPType bp{};
+        validBuffers.pop(bp);
+        return bp;
+    }
+
+    // Producer. Caller must ensure EmptyBuffers() > 0, e.g. with waitForFreeBuffer.
+    BufPType getFreeBuffer() {
+        BufPType bp{};
+        if(!emptyBuffers.pop(bp)) {
+            throw std::runtime_error("Out of free buffers.");
+        }
+        return bp;
+    }
+
+    // Producer
+    void addValidBuffer(BufPType bp) {
+        if(!validBuffers.push(std::move(bp))) {
+            throw std::runtime_error("Valid buffer ring overflow.");
+        }
+    }
+
+    // Consumer (or any thread before the producer starts)
+    void returnOrAddUsedBuffer(BufPType bp) {
+        if(!emptyBuffers.push(std::move(bp))) {
+            throw std::runtime_error("Empty buffer ring overflow.");
+        }
+    }
+
+    size_t AvailableFrames() const {
+        return validBuffers.Size();
+    }
+
+    size_t EmptyBuffers() const {
+        return emptyBuffers.Size();
+    }
+
+    // Consumer
+    bool DropNFrames(size_t n) {
+        if(validBuffers.Size() < n) {
+            return false;
+        }
+        BufPType bp{};
+        for(size_t i=0; i<n; ++i) {
+            validBuffers.pop(bp);
+            emptyBuffers.push(std::move(bp));
+        }
+        return true;
+    }
+
+    // Consumer: sleep until a valid frame arrives. Returns false if none
+    // arrived before the timeout or Interrupt() was called.
+    bool waitForValidBuffer(std::chrono::microseconds timeout) {
+        return validBuffers.wait_for(timeout, [this](const SpscRing<BufPType>& r){
+            return !r.Empty() || interrupted.load();
+        }) && !validBuffers.Empty();
+    }
+
+    // Producer: sleep until a buffer is returned. Returns false if none
+    // was returned before the timeout or Interrupt() was called.
+    bool waitForFreeBuffer(std::chrono::microseconds timeout) {
+        return waitForFreeBuffers(1, timeout);
+    }
+
+    // Producer: as waitForFreeBuffer, but for at least n free buffers.
+    // Waiting for all buffers allows the producer to drain the queue.
+    bool waitForFreeBuffers(size_t n, std::chrono::microseconds timeout) {
+        return emptyBuffers.wait_for(timeout, [this,n](const SpscRing<BufPType>& r){
+            return r.Size() >= n || interrupted.load();
+        }) && emptyBuffers.Size() >= n;
+    }
+
+    // Release any thread blocked in a wait call. Waits return immediately
+    // until Resume() is called.
+    void Interrupt() {
+        interrupted = true;
+        validBuffers.notify_all();
+        emptyBuffers.notify_all();
+    }
+
+    void Resume() {
+        interrupted = false;
+    }
+
+private:
+    SpscRing<BufPType> validBuffers;
+    SpscRing<BufPType> emptyBuffers;
+    std::atomic<bool> interrupted{false};
+};
+
+}
@@ -0,0 +1,141 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <pangolin/platform.h>
+
+namespace pangolin
+{
+
+// Read-only memory mapping of an entire file. Held by shared_ptr so that
+// pointers into the mapping can outlive the object which opened it.
+class PANGOLIN_EXPORT MappedFile
+{
+public:
+    // Returns nullptr if the file cannot be mapped (e.g. it is empty, a pipe,
+    // or memory mapping is unsupported on this platform).
+    static std::shared_ptr<MappedFile> Open(const std::string& filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const
+    {
+        return data;
+    }
+
+    // Bytes mapped, which is the size of the file when it was mapped.
+    size_t Size() const
+    {
+        return size;
+    }
+
+    // Current size of the file, which differs from Size() if it has since
+    // been appended to or truncated.
+    size_t FileSize() const;
+
+    // Map the same file again at its current size. Returns nullptr on failure.
+    std::shared_ptr<MappedFile> Remap() const;
+
+private:
+    // Maps fd, which the MappedFile takes ownership of.
+    static std::shared_ptr<MappedFile> Map(int fd);
+
+    MappedFile(int fd, const char* data, size_t size)
+        : fd(fd), data(data), size(size)
+    {
+    }
+
+    int fd;
+    const char* data;
+    size_t size;
+};
+
+// Input streambuf reading directly from a MappedFile, which it keeps alive.
+//
+// The file may change while it is read. Reads past the end of the mapping
+// remap the file if it has grown, or continue through the fallback
+// streambuf (opened on the same file) if it can't be remapped. If the file
+// shrinks, reads are limited to its new size, since touching mapped pages
+// beyond the end of a file raises SIGBUS. The size is checked on seeks,
+// large reads and take(), so a file truncated between a check and the read
+// which follows it can still fault.
+class PANGOLIN_EXPORT mappedstreambuf : public std::streambuf
+{
+public:
+    mappedstreambuf();
+
+    // Read from file, or only through fallback if file is null.
+    void reset(std::shared_ptr<MappedFile> file, std::streambuf* fallback = nullptr);
+
+    // Current mapping, or nullptr if there is none or reads have fallen back
+    // to the fallback streambuf.
+    const std::shared_ptr<MappedFile>& file() const
+    {
+        return mapping;
+    }
+
+    // Pointer to the next len bytes, advancing past them, or nullptr if
+    // fewer than len bytes remain in the mapping.
+    const char* take(size_t len);
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize n) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+    // Check the file size against the readable part of the mapping, growing
+    // or shrinking it to match.
+    void Refresh();
+
+    // Serve all further reads through fallback, starting from pos.
+    void UseFallback(off_type pos);
+
+    // File offset of the next character to be read.
+    off_type Position() const
+    {
+        return base + (gptr() - eback());
+    }
+
+    std::shared_ptr<MappedFile> mapping;
+    std::streambuf* fallback;
+    // File offset of eback(): zero while reading from the mapping.
+    off_type base;
+    std::vector<char> buffer;
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ios>
 #include <streambuf>
 #include <vector>
 
@@ -52,4 +53,55 @@ protected:
     }
 };
 
+// Read-only streambuf over an existing block of memory which it does not own.
+// Reads are plain copies and seeks only move the read pointer.
+struct memreadstreambuf : public std::streambuf
+{
+public:
+    memreadstreambuf(const char* data = nullptr, size_t size = 0)
+    {
+        reset(data, size);
+    }
+
+    void reset(const char* data, size_t size)
+    {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+    // Pointer to the next len bytes, advancing past them, or nullptr if
+    // fewer than len bytes remain.
+    const char* take(size_t len)
+    {
+        if(static_cast<size_t>(egptr() - gptr()) < len) {
+            return nullptr;
+        }
+        char* p = gptr();
+        setg(eback(), p + len, egptr());
+        return p;
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        if(!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        const off_type base = (dir == std::ios_base::beg) ? 0 :
+                              (dir == std::ios_base::cur) ? gptr() - eback() :
+                                                            egptr() - eback();
+        const off_type target = base + off;
+        if(target < 0 || target > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + target, egptr());
+        return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
 }
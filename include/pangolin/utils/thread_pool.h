@@ -0,0 +1,187 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace pangolin
+{
+
+// Fixed set of persistent worker threads which execute queued tasks in
+// submission order. Any tasks still queued when the pool is destroyed are
+// run before the workers are joined.
+class ThreadPool
+{
+public:
+    ThreadPool(size_t num_threads)
+        : quit(false)
+    {
+        for(size_t i=0; i < num_threads; ++i) {
+            workers.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        cond.notify_all();
+        for(auto& w : workers) {
+            w.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t NumThreads() const
+    {
+        return workers.size();
+    }
+
+    // Queue f() for execution on a worker. Exceptions thrown by f are
+    // delivered through the returned future.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> Run(F&& f)
+    {
+        using R = typename std::result_of<F()>::type;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task](){ (*task)(); });
+        }
+        cond.notify_one();
+        return result;
+    }
+
+    // Call f(i) for every i in [0,n), sharing the calls between the workers
+    // and the calling thread. Returns once every call has completed and
+    // rethrows the first exception thrown by f. Unlike Run(), no per-call
+    // state is allocated, so this is suitable for per-frame work.
+    template<typename F>
+    void ParallelFor(size_t n, F&& f)
+    {
+        ParallelForState state(n);
+        const size_t num_helpers = std::min(n > 0 ? n-1 : 0, workers.size());
+        if(num_helpers > 0) {
+            state.helpers = num_helpers;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for(size_t h=0; h < num_helpers; ++h) {
+                    tasks.emplace_back([&state, &f](){ state.Work(f); state.HelperFinished(); });
+                }
+            }
+            cond.notify_all();
+        }
+
+        state.Work(f);
+
+        // Helpers reference state on this stack frame, so wait for all to exit.
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.cond.wait(lock, [&state](){ return state.helpers == 0; });
+        if(state.error) {
+            std::rethrow_exception(state.error);
+        }
+    }
+
+private:
+    struct ParallelForState
+    {
+        ParallelForState(size_t n)
+            : n(n), next(0), helpers(0)
+        {
+        }
+
+        template<typename F>
+        void Work(F& f)
+        {
+            for(size_t i = next++; i < n; i = next++) {
+                try {
+                    f(i);
+                }catch(...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!error) error = std::current_exception();
+                }
+            }
+        }
+
+        void HelperFinished()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--helpers == 0) {
+                cond.notify_all();
+            }
+        }
+
+        const size_t n;
+        std::atomic<size_t> next;
+        size_t helpers;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+
+    void WorkerLoop()
+    {
+        while(true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this](){ return quit || !tasks.empty(); });
+                if(tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool quit;
+};
+
+}
@@ -32,6 +32,10 @@
 #include <fstream>
 
 #include <pangolin/platform.h>
+#include <pangolin/utils/cache_padded.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -54,12 +58,56 @@ public:
     void open(const std::string& filename, size_t buffer_size_bytes);
     void close();
     void force_close();
-    
+
+    // Write through O_DIRECT from a page aligned buffer, bypassing the page
+    // cache, instead of O_SYNC. Data is made durable with fdatasync every
+    // sync_bytes (0 for only on close). Takes effect from the next open().
+    // Falls back to cached writes where O_DIRECT isn't supported.
+    void set_direct_io(bool direct_io, size_t sync_bytes = 0);
+
+    // Keep up to queue_depth writes in flight with io_uring rather than
+    // writing one block at a time (0 to disable). Takes effect from the next
+    // open(). Falls back to blocking writes where io_uring is unavailable.
+    void set_io_uring(size_t queue_depth);
+
+    // Space for n bytes claimed by reserve(), at file offset begin.
+    struct reservation {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t cursor;
+    };
+
+    // Claim the next n bytes of the file. Safe to call from several threads
+    // at once; data reaches the file in reservation order. The caller must
+    // put() exactly n bytes and then publish() the reservation.
+    reservation reserve(size_t n);
+
+    // Copy the next bytes of r into the ring, waiting while it is full.
+    void put(reservation& r, const char* data, size_t n);
+
+    // Hand a filled reservation to the writer thread. Waits for any earlier
+    // reservations to be published first.
+    void publish(const reservation& r);
+
+    // Wait until every reservation before file offset pos is published.
+    void wait_published(uint64_t pos);
+
     void operator()();
     
 protected:
     void soft_close();
 
+    void allocate_buffer(std::streamsize size);
+    void free_buffer();
+
+    // Wake threads waiting in put() / publish() / the writer thread.
+    void notify_producers();
+    void notify_writer();
+
+    void write_uring();
+
+    class uring_queue;
+
     //! Override streambuf::xsputn for asynchronous write
     std::streamsize xsputn(const char * s, std::streamsize n) override;
 
@@ -78,20 +126,34 @@ protected:
 #endif
 
     char* mem_buffer;
-    std::streamsize mem_size;
     std::streamsize mem_max_size;
-    std::streamsize mem_start;
-    std::streamsize mem_end;
 
-    std::streampos input_pos;
-    
+    // Byte counts since open. The ring holds [consumed, published) ready for
+    // the writer thread, and [published, reserved) being filled by producers.
+    // Each on its own cache line, as they are written by different threads.
+    CachePadded<std::atomic<uint64_t>> reserved;
+    CachePadded<std::atomic<uint64_t>> published;
+    CachePadded<std::atomic<uint64_t>> consumed;
+
+    // Only taken to sleep / wake
     std::mutex update_mutex;
     std::condition_variable cond_queued;
     std::condition_variable cond_dequeued;
+    std::atomic<int> producers_waiting;
+    std::atomic<int> writer_waiting;
     std::thread write_thread;
 
-    bool should_run;
+    std::atomic<bool> should_run;
+    std::atomic<bool> discard;
     bool is_pipe;
+
+    bool direct_io = false;
+    bool direct_active = false;
+    size_t sync_bytes = 0;
+    size_t bytes_since_sync = 0;
+
+    size_t uring_depth = 0;
+    std::unique_ptr<uring_queue> uring;
 };
 
 }
@@ -29,6 +29,7 @@
 
 #include <pangolin/pangolin.h>
 #include <pangolin/video/video.h>
+#include <pangolin/utils/thread_pool.h>
 
 namespace pangolin
 {
@@ -59,13 +60,16 @@ typedef enum {
 } color_filter_t;
 
 // Video class that debayers its video input using the given method.
+// Bilinear and HQ linear interpolation are built in and share rows between
+// num_threads threads. The remaining interpolation methods require libdc1394.
 class PANGOLIN_EXPORT DebayerVideo :
         public VideoInterface,
         public VideoFilterInterface,
-        public BufferAwareVideoInterface
+        public BufferAwareVideoInterface,
+        public RowFilterInterface
 {
 public:
-    DebayerVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<bayer_method_t> &method, color_filter_t tile);
+    DebayerVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<bayer_method_t> &method, color_filter_t tile, size_t num_threads = 1);
     ~DebayerVideo();
 
     //! Implement VideoInput::Start()
@@ -96,7 +100,17 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement RowFilterInterface methods. libdc1394 methods aren't
+    //! row separable.
+    bool RowSeparable() const;
+    void InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const;
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1);
+
 protected:
+    // Create buffer and pool on the first grab. A debayer run by FusedVideo
+    // is only called through ProcessRows() and never needs them.
+    void Allocate();
+
     void ProcessStreams(unsigned char* out, const unsigned char* in);
 
     std::unique_ptr<VideoInterface> src;
@@ -109,6 +123,10 @@ protected:
     std::vector<bayer_method_t> methods;
     color_filter_t tile;
 
+    // Helpers for the built in demosaic, if more than one thread is used
+    size_t num_threads;
+    std::unique_ptr<ThreadPool> pool;
+
     picojson::value device_properties;
     picojson::value frame_properties;
 };
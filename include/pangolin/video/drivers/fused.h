@@ -0,0 +1,122 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/pangolin.h>
+#include <pangolin/video/video.h>
+#include <pangolin/utils/thread_pool.h>
+
+namespace pangolin
+{
+
+// Video class that runs the chain of row filters at the top of its input
+// (e.g. shift, unpack, mirror and debayer) as one pass over bands of rows,
+// so that intermediate images stay in cache. Bands are shared between
+// num_threads threads. The chain ends at the first filter which isn't row
+// separable, which is grabbed from as usual. band_bytes is the size of a
+// band summed over all stages, which should fit in L2, with at least 32 rows
+// per band. This is experimental: it has not yet been shown to be faster
+// than the unfused chain.
+class PANGOLIN_EXPORT FusedVideo :
+    public VideoInterface,
+    public VideoFilterInterface,
+    public BufferAwareVideoInterface
+{
+public:
+    FusedVideo(std::unique_ptr<VideoInterface>& videoin, size_t num_threads = 1, size_t band_bytes = 256*1024);
+    ~FusedVideo();
+
+    //! Implement VideoInput::Start()
+    void Start();
+
+    //! Implement VideoInput::Stop()
+    void Stop();
+
+    //! Implement VideoInput::SizeBytes()
+    size_t SizeBytes() const;
+
+    //! Implement VideoInput::Streams()
+    const std::vector<StreamInfo>& Streams() const;
+
+    //! Implement VideoInput::GrabNext()
+    bool GrabNext( unsigned char* image, bool wait = true );
+
+    //! Implement VideoInput::GrabNewest()
+    bool GrabNewest( unsigned char* image, bool wait = true );
+
+    //! Implement VideoFilterInterface method
+    std::vector<VideoInterface*>& InputStreams();
+
+    uint32_t AvailableFrames() const;
+
+    bool DropNFrames(uint32_t n);
+
+    //! Number of filters run in each pass
+    size_t NumFusedStages() const;
+
+protected:
+    struct Stage
+    {
+        VideoInterface* video;
+        RowFilterInterface* filter;
+    };
+
+    struct RowSpan
+    {
+        size_t y0;
+        size_t y1;
+    };
+
+    // Rows of stream s computed by each stage for one band of output rows,
+    // and the rows of the source they read
+    struct Band
+    {
+        size_t s;
+        std::vector<RowSpan> rows;
+        RowSpan in;
+    };
+
+    void Process(unsigned char* image, const unsigned char* buffer);
+    void ProcessBand(const Band& band, unsigned char* scratch, unsigned char* image, const unsigned char* buffer);
+
+    std::unique_ptr<VideoInterface> src;
+    std::vector<VideoInterface*> videoin;
+
+    // Filters in order of application, so stages.back() is src.
+    std::vector<Stage> stages;
+    VideoInterface* source;
+
+    std::vector<Band> bands;
+    std::vector<size_t> scratch_offset;
+    size_t scratch_bytes;
+    std::unique_ptr<unsigned char[]> scratch;
+    std::unique_ptr<unsigned char[]> buffer;
+
+    size_t num_lanes;
+    std::unique_ptr<ThreadPool> pool;
+};
+
+}
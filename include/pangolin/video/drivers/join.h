@@ -28,6 +28,7 @@
 #pragma once
 
 #include <pangolin/video/video.h>
+#include <pangolin/utils/thread_pool.h>
 
 namespace pangolin
 {
@@ -56,6 +57,10 @@ public:
 
     bool Sync(int64_t tolerance_us, double transfer_bandwidth_gbps = 0);
 
+    //! Grab from all sources concurrently so that GrabNext blocks for the
+    //! slowest source rather than the sum of all of them.
+    void SetParallelGrab(bool parallel);
+
     bool GrabNext( unsigned char* image, bool wait = true );
 
     bool GrabNewest( unsigned char* image, bool wait = true );
@@ -65,6 +70,8 @@ public:
 protected:
     int64_t GetAdjustedCaptureTime(size_t src_index);
 
+    void GrabAll(unsigned char* image, const std::vector<size_t>& offsets, bool wait, std::vector<bool>& grabbed);
+
     std::vector<std::unique_ptr<VideoInterface>> storage;
     std::vector<VideoInterface*> src;
     std::vector<StreamInfo> streams;
@@ -72,6 +79,9 @@ protected:
 
     int64_t sync_tolerance_us;
     int64_t transfer_bandwidth_bytes_per_us;
+
+    // Workers for src[1..n), src[0] is grabbed on the calling thread.
+    std::unique_ptr<ThreadPool> grab_pool;
 };
 
 
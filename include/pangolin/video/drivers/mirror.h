@@ -29,6 +29,7 @@
 
 #include <pangolin/pangolin.h>
 #include <pangolin/video/video.h>
+#include <pangolin/utils/thread_pool.h>
 
 namespace pangolin
 {
@@ -44,14 +45,17 @@ enum MirrorOptions
     MirrorOptionsRotateCCW,
 };
 
-// Video class that debayers its video input using the given method.
+// Video class that flips, rotates or transposes each stream of its input.
+// Rows are shared between num_threads threads, and the cache tile size of
+// the transposing options is chosen by timing the first frames.
 class PANGOLIN_EXPORT MirrorVideo :
     public VideoInterface,
     public VideoFilterInterface,
-    public BufferAwareVideoInterface
+    public BufferAwareVideoInterface,
+    public RowFilterInterface
 {
 public:
-    MirrorVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<MirrorOptions>& flips);
+    MirrorVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<MirrorOptions>& flips, size_t num_threads = 1);
     ~MirrorVideo();
 
     //! Implement VideoInput::Start()
@@ -79,7 +83,17 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement RowFilterInterface methods. Transposing options aren't
+    //! row separable.
+    bool RowSeparable() const;
+    void InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const;
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1);
+
 protected:
+    // buffer and pool are created by the first grab, so that they aren't
+    // held by a mirror whose rows are computed by FusedVideo.
+    void Allocate();
+
     void Process(unsigned char* image, const unsigned char* buffer);
 
     std::unique_ptr<VideoInterface> videoin;
@@ -88,6 +102,14 @@ protected:
     std::vector<MirrorOptions> flips;
     size_t size_bytes;
     unsigned char* buffer;
+    size_t num_threads;
+
+    // Transpose tile size per stream, and timings (us) while it is chosen
+    std::vector<size_t> tile_trial;
+    std::vector<std::vector<double>> tile_time;
+    std::vector<size_t> tile_size;
+
+    std::unique_ptr<ThreadPool> pool;
 
     picojson::value device_properties;
     picojson::value frame_properties;
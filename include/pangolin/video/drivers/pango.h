@@ -29,17 +29,30 @@
 
 #include <pangolin/log/packetstream_reader.h>
 #include <pangolin/log/playback_session.h>
+#include <pangolin/utils/thread_pool.h>
 #include <pangolin/video/stream_encoder_factory.h>
 #include <pangolin/video/video.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
 namespace pangolin
 {
 
 class PANGOLIN_EXPORT PangoVideo
-    : public VideoInterface, public VideoPropertiesInterface, public VideoPlaybackInterface
+    : public VideoInterface, public VideoPropertiesInterface, public VideoPlaybackInterface,
+      public BufferLeaseVideoInterface
 {
 public:
-    PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session);
+    // With prefetch > 0, up to prefetch frames are read and decoded ahead of
+    // the caller on a background thread. With decode_threads > 1, compressed
+    // frames are decoded concurrently on that many threads, but are still
+    // returned in order.
+    PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session, size_t prefetch = 0, size_t decode_threads = 1);
     ~PangoVideo();
 
     // Implement VideoInterface
@@ -63,9 +76,15 @@ public:
     }
 
     const picojson::value& FrameProperties() const override {
-        return _frame_properties;
+        return _frame_properties.value();
     }
 
+    // Implement BufferLeaseVideoInterface
+
+    // Uncompressed fixed-size frames are leased straight from the memory
+    // mapped log without copying.
+    VideoFrameLease GrabNextLease( bool wait = true ) override;
+
     // Implement VideoPlaybackInterface
 
     size_t GetCurrentFrameId() const override;
@@ -80,8 +99,30 @@ private:
     void HandlePipeClosed();
 
 protected:
+    struct PrefetchFrame
+    {
+        std::shared_ptr<unsigned char> buffer;
+        PacketMeta meta;
+        size_t frame_id;
+        int64_t next_time_us;
+        // Valid if the frame is being decoded on _decode_pool
+        std::future<void> decoded;
+    };
+
     int FindPacketStreamSource();
     void SetupStreams(const PacketStreamSource& src);
+    void ReadPacket(Packet& fi, unsigned char* image);
+    // Pass the next packet of our source to read, then wait until the one
+    // after it is due.
+    void ReadNextPacket(const std::function<void(Packet&)>& read);
+    void DecodeStreams(std::istream& is, unsigned char* image, const std::vector<ImageDecoderIntoFunc>& decoders);
+    std::vector<ImageDecoderIntoFunc> CreateDecoders() const;
+
+    // Take the next prefetched frame and wait until the one after it is due.
+    bool PopPrefetched(PrefetchFrame& frame);
+    void StartPrefetch();
+    void StopPrefetch();
+    void PrefetchLoop();
 
     const std::string _filename;
     std::shared_ptr<PlaybackSession> _playback_session;
@@ -93,11 +134,29 @@ protected:
     size_t _size_bytes;
     bool _fixed_size;
     std::vector<StreamInfo> _streams;
-    std::vector<ImageDecoderFunc> stream_decoder;
+    std::vector<ImageDecoderIntoFunc> stream_decoder;
+    // Encoding of each compressed stream and its decoded format, or empty
+    std::vector<std::pair<std::string, PixelFormat>> stream_encoding;
     picojson::value _device_properties;
-    picojson::value _frame_properties;
+    // Decoded on first access
+    PacketMeta _frame_properties;
     std::string _source_uri;
 
+    const size_t _prefetch;
+    std::thread _prefetch_thread;
+    std::mutex _prefetch_mutex;
+    std::condition_variable _prefetch_cond;
+    std::deque<PrefetchFrame> _prefetch_queue;
+    std::vector<std::shared_ptr<unsigned char>> _prefetch_free;
+    bool _prefetch_quit;
+    bool _prefetch_end;
+    std::unique_ptr<ThreadPool> _decode_pool;
+    // Decoders aren't assumed to be reentrant, so each decode on the pool
+    // takes a set of its own from here.
+    std::mutex _decoders_mutex;
+    std::vector<std::vector<ImageDecoderIntoFunc>> _free_decoders;
+    size_t _current_frame_id;
+
     Registration<size_t> session_seek;
 };
 
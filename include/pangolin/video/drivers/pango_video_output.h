@@ -28,6 +28,8 @@
 #pragma once
 
 #include <pangolin/log/packetstream_writer.h>
+#include <pangolin/utils/memstreambuf.h>
+#include <pangolin/utils/thread_pool.h>
 #include <pangolin/video/video_output.h>
 
 #include <pangolin/video/stream_encoder_factory.h>
@@ -40,7 +42,14 @@ namespace pangolin
 class PANGOLIN_EXPORT PangoVideoOutput : public VideoOutputInterface
 {
 public:
-    PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris);
+    // Recording rolls over to a new segment file every segment_size_bytes or
+    // segment_duration_us of frames when either is non-zero. An index
+    // checkpoint is written every checkpoint_packets frames when non-zero.
+    // direct_io / sync_bytes configure PacketStreamWriter::SetDirectIO and
+    // io_uring_depth PacketStreamWriter::SetIoUring.
+    PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris,
+                     size_t segment_size_bytes = 0, int64_t segment_duration_us = 0, size_t checkpoint_packets = 0,
+                     bool direct_io = false, size_t sync_bytes = 0, size_t io_uring_depth = 0);
     ~PangoVideoOutput();
 
     const std::vector<StreamInfo>& Streams() const override;
@@ -65,6 +74,11 @@ protected:
     bool fixed_size;
     std::map<size_t, std::string> stream_encoder_uris;
     std::vector<ImageEncoderFunc> stream_encoders;
+
+    // Reused between frames for variable-size (encoded) output
+    std::vector<memstreambuf> encoded_stream_data;
+    std::vector<std::pair<const char*,size_t>> encoded_chunks;
+    std::unique_ptr<ThreadPool> encode_pool;
 };
 
 }
@@ -11,7 +11,7 @@
 namespace pangolin
 {
 
-class SharedMemoryVideo : public VideoInterface
+class SharedMemoryVideo : public VideoInterface, public BufferLeaseVideoInterface
 {
 public:
   SharedMemoryVideo(size_t w, size_t h, std::string pix_fmt,
@@ -25,8 +25,12 @@ public:
   void Stop();
   bool GrabNext(unsigned char *image, bool wait);
   bool GrabNewest(unsigned char *image, bool wait);
+  // Holds the shared memory lock until the lease is released.
+  VideoFrameLease GrabNextLease(bool wait);
 
 private:
+  bool WaitForFrame(bool wait);
+
   PixelFormat _fmt;
   size_t _frame_size;
   std::vector<StreamInfo> _streams;
@@ -33,11 +33,17 @@
 namespace pangolin
 {
 
-// Video class that debayers its video input using the given method.
-class PANGOLIN_EXPORT ShiftVideo : public VideoInterface, public VideoFilterInterface
+// Video class that converts 16 bit streams to 8 bit by a right shift and
+// mask. With auto_range, the shift and an offset are instead chosen for each
+// frame to map the non-zero pixels between the given lower and upper
+// percentiles onto [0,255], clamping pixels outside. The percentiles are
+// estimated from a subsampled histogram and smoothed over frames.
+class PANGOLIN_EXPORT ShiftVideo : public VideoInterface, public VideoFilterInterface, public RowFilterInterface
 {
 public:
     ShiftVideo(std::unique_ptr<VideoInterface>& videoin, PixelFormat new_fmt, int shift_right_bits = 0, unsigned int mask = 0xFFFF);
+
+    ShiftVideo(std::unique_ptr<VideoInterface>& videoin, PixelFormat new_fmt, bool auto_range, double percentile = 1.0, double smoothing = 0.8);
     ~ShiftVideo();
 
     //! Implement VideoInput::Start()
@@ -60,7 +66,20 @@ public:
 
     std::vector<VideoInterface*>& InputStreams();
 
+    //! Implement RowFilterInterface methods. Auto range isn't row separable.
+    bool RowSeparable() const;
+    void InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const;
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1);
+
 protected:
+    void Init(const PixelFormat& out_fmt);
+
+    // Input frame buffer, allocated when first grabbed into
+    void Allocate();
+
+    void UpdateRange(size_t s, const Image<unsigned char>& img_in);
+    void Process(unsigned char* image, const unsigned char* buffer);
+
     std::unique_ptr<VideoInterface> src;
     std::vector<VideoInterface*> videoin;
     std::vector<StreamInfo> streams;
@@ -68,6 +87,30 @@ protected:
     unsigned char* buffer;
     int shift_right_bits;
     unsigned int mask;
+
+    bool auto_range;
+    double percentile;
+    double smoothing;
+
+    // Per stream settings and smoothed range for auto_range
+    std::vector<int> stream_shift;
+    std::vector<unsigned int> stream_offset;
+    std::vector<double> range_low;
+    std::vector<double> range_high;
 };
 
+// Convert the w x h 16 bit pixels v of in to 8 bit pixels of out as
+// ((v - offset) >> shift_right_bits) & mask, with v < offset mapping to 0.
+// Results above 255 are clamped if saturate, and truncated to their low
+// byte otherwise.
+PANGOLIN_EXPORT
+void DoShift16to8(
+    Image<unsigned char>& out,
+    const Image<unsigned char>& in,
+    int shift_right_bits,
+    unsigned int mask,
+    unsigned int offset,
+    bool saturate
+);
+
 }
@@ -34,7 +34,7 @@ namespace pangolin
 {
 
 class PANGOLIN_EXPORT SplitVideo
-    : public VideoInterface, public VideoFilterInterface
+    : public VideoInterface, public VideoFilterInterface, public BufferLeaseVideoInterface
 {
 public:
     SplitVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<StreamInfo>& streams);
@@ -53,6 +53,8 @@ public:
     
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    VideoFrameLease GrabNextLease( bool wait = true );
+
     std::vector<VideoInterface*>& InputStreams();
     
 protected:
@@ -30,8 +30,10 @@
 #include <pangolin/pangolin.h>
 #include <pangolin/video/video.h>
 
+#include <atomic>
 #include <memory>
-#include <pangolin/utils/fix_size_buffer_queue.h>
+#include <thread>
+#include <pangolin/utils/fix_size_buffer_ring.h>
 
 namespace pangolin
 {
@@ -39,7 +41,8 @@ namespace pangolin
 
 // Video class that creates a thread that keeps pulling frames and processing from its children.
 class PANGOLIN_EXPORT ThreadVideo :  public VideoInterface, public VideoPropertiesInterface,
-        public BufferAwareVideoInterface, public VideoFilterInterface
+        public BufferAwareVideoInterface, public VideoFilterInterface,
+        public BufferLeaseVideoInterface
 {
 public:
     ThreadVideo(std::unique_ptr<VideoInterface>& videoin, size_t num_buffers);
@@ -63,6 +66,10 @@ public:
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    //! Implement BufferLeaseVideoInterface::GrabNextLease()
+    //! The queue buffer is unavailable to the grab thread until released.
+    VideoFrameLease GrabNextLease( bool wait = true );
+
     const picojson::value& DeviceProperties() const;
 
     const picojson::value& FrameProperties() const;
@@ -78,6 +85,11 @@ public:
 protected:
     struct GrabResult
     {
+        GrabResult()
+            : return_status(false)
+        {
+        }
+
         GrabResult(const size_t buffer_size)
             : return_status(false),
               buffer(new unsigned char[buffer_size])
@@ -87,8 +99,9 @@ protected:
         // No copy constructor.
         GrabResult(const GrabResult& o) = delete;
 
-        // Default move constructor
+        // Default move constructor and assignment
         GrabResult(GrabResult&& o) = default;
+        GrabResult& operator=(GrabResult&& o) = default;
 
         bool return_status;
         std::unique_ptr<unsigned char[]> buffer;
@@ -98,11 +111,15 @@ protected:
     std::unique_ptr<VideoInterface> src;
     std::vector<VideoInterface*> videoin;
 
-    bool quit_grab_thread;
-    FixSizeBuffersQueue<GrabResult> queue;
+    void ReturnBuffer(GrabResult&& grab);
+
+    std::atomic<bool> quit_grab_thread;
+    FixSizeBuffersRing<GrabResult> queue;
+
+    // Leases may be released from any thread, so the consumer side of the
+    // free buffer ring is serialised. The grab thread never takes this lock.
+    std::mutex return_mutex;
 
-    std::condition_variable cv;
-    std::mutex cvMtx;
     std::thread grab_thread;
 
     mutable picojson::value device_properties;
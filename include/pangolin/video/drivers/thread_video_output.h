@@ -0,0 +1,101 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/video/video_output.h>
+#include <pangolin/utils/fix_size_buffer_ring.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace pangolin
+{
+
+// Video output which copies frames into a bounded queue and writes them to
+// its child output from a dedicated writer thread, so that slow encoders or
+// disks do not stall the thread grabbing frames.
+class PANGOLIN_EXPORT ThreadVideoOutput : public VideoOutputInterface
+{
+public:
+    enum FullQueuePolicy {
+        // WriteStreams waits until the writer thread frees a buffer.
+        FullQueueBlock,
+        // WriteStreams discards the frame and counts it as dropped.
+        FullQueueDrop
+    };
+
+    ThreadVideoOutput(std::unique_ptr<VideoOutputInterface>& out, size_t num_buffers, FullQueuePolicy policy);
+    ~ThreadVideoOutput();
+
+    const std::vector<StreamInfo>& Streams() const override;
+    void SetStreams(const std::vector<StreamInfo>& streams, const std::string& uri, const picojson::value& device_properties) override;
+    int WriteStreams(const unsigned char* data, const picojson::value& frame_properties) override;
+    bool IsPipe() const override;
+
+    //! Number of frames waiting to be written
+    size_t QueuedFrames() const;
+
+    //! Number of frames discarded because the queue was full or the write failed
+    size_t DroppedFrames() const;
+
+    //! Block until every queued frame has been handed to the child output
+    void Flush();
+
+    void operator()();
+
+protected:
+    struct WriteJob
+    {
+        WriteJob() {}
+
+        WriteJob(size_t size_bytes)
+            : buffer(new unsigned char[size_bytes])
+        {
+        }
+
+        WriteJob(const WriteJob&) = delete;
+        WriteJob(WriteJob&&) = default;
+        WriteJob& operator=(WriteJob&&) = default;
+
+        std::unique_ptr<unsigned char[]> buffer;
+        picojson::value frame_properties;
+    };
+
+    std::unique_ptr<VideoOutputInterface> out;
+    size_t num_buffers;
+    FullQueuePolicy policy;
+    size_t frame_size_bytes;
+
+    FixSizeBuffersRing<WriteJob> queue;
+    std::atomic<size_t> dropped_frames;
+    std::atomic<bool> quit_write_thread;
+    std::thread write_thread;
+};
+
+}
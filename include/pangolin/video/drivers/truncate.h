@@ -34,7 +34,7 @@ namespace pangolin
 {
 
 class PANGOLIN_EXPORT TruncateVideo
-    : public VideoInterface, public VideoFilterInterface
+    : public VideoInterface, public VideoFilterInterface, public BufferLeaseVideoInterface
 {
 public:
     TruncateVideo(std::unique_ptr<VideoInterface>& videoin, size_t begin, size_t end);
@@ -53,6 +53,8 @@ public:
 
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    VideoFrameLease GrabNextLease( bool wait = true );
+
     std::vector<VideoInterface*>& InputStreams();
 
 protected:
@@ -37,7 +37,8 @@ namespace pangolin
 class PANGOLIN_EXPORT UnpackVideo :
     public VideoInterface,
     public VideoFilterInterface,
-    public BufferAwareVideoInterface
+    public BufferAwareVideoInterface,
+    public RowFilterInterface
 {
 public:
     UnpackVideo(std::unique_ptr<VideoInterface>& videoin, PixelFormat new_fmt);
@@ -68,9 +69,19 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement RowFilterInterface methods
+    bool RowSeparable() const;
+    void InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const;
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1);
+
 protected:
+    // Input frame buffer, allocated when first grabbed into
+    void Allocate();
+
     void Process(unsigned char* image, const unsigned char* buffer);
 
+    void ProcessStream(size_t s, Image<unsigned char>& img_out, const Image<unsigned char>& img_in);
+
     std::unique_ptr<VideoInterface> src;
     std::vector<VideoInterface*> videoin;
     std::vector<StreamInfo> streams;
@@ -47,7 +47,7 @@ struct buffer {
     size_t length;
 };
 
-class PANGOLIN_EXPORT V4lVideo : public VideoInterface, public VideoUvcInterface, public VideoPropertiesInterface
+class PANGOLIN_EXPORT V4lVideo : public VideoInterface, public VideoUvcInterface, public VideoPropertiesInterface, public BufferLeaseVideoInterface
 {
 public:
     V4lVideo(const char* dev_name, io_method io = IO_METHOD_MMAP, unsigned iwidth=0, unsigned iheight=0);
@@ -71,6 +71,10 @@ public:
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    //! Implement BufferLeaseVideoInterface::GrabNextLease()
+    //! For mmap / userptr io the driver buffer is requeued once the lease is released.
+    VideoFrameLease GrabNextLease( bool wait = true );
+
     //! Implement VideoUvcInterface::IoCtrl()
     int IoCtrl(uint8_t unit, uint8_t ctrl, unsigned char* data, int len, UvcRequestCode req_code);
 
@@ -96,7 +100,8 @@ protected:
     void InitPangoDeviceProperties();
 
 
-    int ReadFrame(unsigned char* image);
+    bool GrabFrame(unsigned char* image, VideoFrameLease* lease);
+    int ReadFrame(unsigned char* image, VideoFrameLease* lease);
     void Mainloop();
     
     void init_read(unsigned int buffer_size);
@@ -8,6 +8,9 @@ namespace pangolin {
 
 using ImageEncoderFunc = std::function<void(std::ostream&, const Image<unsigned char>&)>;
 using ImageDecoderFunc = std::function<TypedImage(std::istream&)>;
+// Decodes into the caller's (possibly pitched) image, which must match the
+// dimensions and pixel size of the encoded image.
+using ImageDecoderIntoFunc = std::function<void(std::istream&, Image<unsigned char>)>;
 
 class StreamEncoderFactory
 {
@@ -17,6 +20,8 @@ public:
     ImageEncoderFunc GetEncoder(const std::string& encoder_spec, const PixelFormat& fmt);
 
     ImageDecoderFunc GetDecoder(const std::string& encoder_spec, const PixelFormat& fmt);
+
+    ImageDecoderIntoFunc GetDecoderInto(const std::string& encoder_spec, const PixelFormat& fmt);
 };
 
 }
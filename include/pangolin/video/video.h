@@ -35,7 +35,7 @@
 //
 // scheme = file | files | pango | shmem | dc1394 | uvc | v4l | openni2 |
 //          openni | depthsense | pleora | teli | mjpeg | test |
-//          thread | convert | debayer | split | join | shift | mirror | unpack
+//          thread | convert | debayer | split | join | shift | mirror | unpack | fuse
 //
 // file/files - read one or more streams from image file(s) / video
 //  e.g. "files://~/data/dataset/img_*.jpg"
@@ -44,6 +44,8 @@
 //
 //  e.g. "file:[fmt=GRAY8,size=640x480]///home/user/raw_image.bin"
 //  e.g. "file:[realtime=1]///home/user/video/movie.pango"
+//  e.g. "pango:[prefetch=8]///home/user/video/movie.pango"
+//  e.g. "pango:[decode_threads=8]///home/user/video/compressed.pango"
 //  e.g. "file:[stream=1]///home/user/video/movie.avi"
 //
 // dc1394 - capture video through a firewire camera
@@ -101,6 +103,20 @@
 // debayer - debayer an input video stream
 //  e.g.  "debayer:[tile="BGGR",method="downsample"]//v4l:///dev/video0
 //
+// shift - convert 16 bit greyscale streams to 8 bit by a fixed right shift and mask,
+//         or with shift=auto, by a per frame shift and offset covering the non-zero
+//         pixels between the given lower and upper percentiles (smoothed over frames)
+//           shift=N|auto, mask=N, percentile=P (default: 1), smooth=S (default: 0.8)
+//  e.g. "shift:[shift=4,mask=255]//v4l:///dev/video0"
+//  e.g. "shift:[shift=auto,percentile=0]//openni2:[img1=depth]//"
+//
+// fuse - run the shift / unpack / mirror / debayer filters directly below as one
+//        multithreaded pass over bands of rows, without full size intermediate images.
+//        band_kb is the size of a band summed over all stages, sized to stay in L2.
+//        Experimental: no speed-up over the unfused chain has been demonstrated yet.
+//           threads=N (default: hardware concurrency), band_kb=N (default: 256)
+//  e.g. "fuse://debayer:[tile=RGGB,method=hqlinear]//unpack://pleora:[PixelFormat=BayerRG12p]//"
+//
 // split - split an input video into a one or more streams based on Region of Interest / memory specification
 //           roiN=X+Y+WxH
 //           memN=Offset:WxH:PitchBytes:Format
@@ -114,6 +130,7 @@
 //
 // join - join streams
 //  e.g. "join:[sync_tolerance_us=100, sync_continuously=true]//{pleora:[sn=00000274]//}{pleora:[sn=00000275]//}"
+//  e.g. "join:[parallel=1]//{v4l:///dev/video0}{v4l:///dev/video1}"
 //
 // test - output test video sequence
 //  e.g. "test://"
@@ -182,6 +199,24 @@ T* FindFirstMatchingVideoInterface( VideoInterface& video )
     return 0;
 }
 
+//! Grab the next frame as a lease. Borrows the source buffer when video
+//! implements BufferLeaseVideoInterface, otherwise falls back to copying
+//! into a newly allocated buffer which the lease owns.
+inline
+VideoFrameLease GrabNextLease(VideoInterface* video, bool wait = true)
+{
+    BufferLeaseVideoInterface* li = dynamic_cast<BufferLeaseVideoInterface*>(video);
+    if(li) {
+        return li->GrabNextLease(wait);
+    }
+
+    std::shared_ptr<unsigned char> buffer(new unsigned char[video->SizeBytes()], std::default_delete<unsigned char[]>());
+    if(video->GrabNext(buffer.get(), wait)) {
+        return VideoFrameLease(buffer.get(), buffer);
+    }
+    return VideoFrameLease();
+}
+
 inline
 picojson::value GetVideoFrameProperties(VideoInterface* video)
 {
@@ -112,6 +112,14 @@ struct PANGOLIN_EXPORT VideoInput
     // True iff grabbed live frames are being logged to file
     bool IsRecording() const;
 
+    // Number of frames waiting to be written when recording asynchronously
+    // (output uri thread://...). Always 0 for synchronous recording.
+    size_t RecordQueuedFrames() const;
+
+    // Number of frames an asynchronous recorder has discarded, either
+    // because its queue was full (policy=drop) or because writing failed.
+    size_t RecordDroppedFrames() const;
+
 protected:
     void InitialiseRecorder();
 
@@ -104,6 +104,62 @@ struct PANGOLIN_EXPORT BufferAwareVideoInterface
     virtual bool DropNFrames(uint32_t n) = 0;
 };
 
+//! Read-only view of a captured frame which borrows memory owned by the
+//! video source (driver buffer, queue slot, shared memory, ...) instead of
+//! copying it out. The frame is laid out as described by Streams() of the
+//! interface it was grabbed from. The memory is handed back to the source
+//! once the last copy of the lease is released, so leases should be
+//! short-lived and must not outlive the source itself.
+class PANGOLIN_EXPORT VideoFrameLease
+{
+public:
+    VideoFrameLease()
+        : ptr(nullptr)
+    {
+    }
+
+    VideoFrameLease(const unsigned char* ptr, std::shared_ptr<void> owner)
+        : ptr(ptr), owner(std::move(owner))
+    {
+    }
+
+    const unsigned char* Ptr() const
+    {
+        return ptr;
+    }
+
+    bool IsValid() const
+    {
+        return ptr != nullptr;
+    }
+
+    explicit operator bool() const
+    {
+        return IsValid();
+    }
+
+    //! Give up this reference to the borrowed buffer.
+    void Release()
+    {
+        ptr = nullptr;
+        owner.reset();
+    }
+
+private:
+    const unsigned char* ptr;
+    std::shared_ptr<void> owner;
+};
+
+struct PANGOLIN_EXPORT BufferLeaseVideoInterface
+{
+    virtual ~BufferLeaseVideoInterface() {}
+
+    //! Borrow the next frame from the source without copying it.
+    //! Optionally wait for a frame if one isn't ready
+    //! Returns an invalid lease if no frame was grabbed
+    virtual VideoFrameLease GrabNextLease( bool wait = true ) = 0;
+};
+
 struct PANGOLIN_EXPORT VideoPropertiesInterface
 {
     virtual ~VideoPropertiesInterface() {}
@@ -154,6 +210,26 @@ struct PANGOLIN_EXPORT VideoFilterInterface
     virtual std::vector<VideoInterface*>& InputStreams() = 0;
 };
 
+//! Filter whose output rows each depend on a band of its input rows, so
+//! that it can be run a band of rows at a time as one stage of a FusedVideo.
+//! Output stream s is computed from input stream s. Buffers and threads
+//! used only by GrabNext() / GrabNewest() should be created on first use,
+//! since a fused filter is never grabbed from.
+struct PANGOLIN_EXPORT RowFilterInterface
+{
+    virtual ~RowFilterInterface() {}
+
+    //! Returns true iff ProcessRows() supports the current settings.
+    virtual bool RowSeparable() const = 0;
+
+    //! Rows [in_y0,in_y1) of input stream s read to compute output rows [y0,y1)
+    virtual void InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const = 0;
+
+    //! Compute rows [y0,y1) of output stream s. out holds just those rows,
+    //! and in holds just the input rows given by InputRows().
+    virtual void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1) = 0;
+};
+
 struct PANGOLIN_EXPORT VideoUvcInterface
 {
     virtual ~VideoUvcInterface() {}
@@ -33,7 +33,7 @@
 // VideoOutput URI's take the following form:
 //  scheme:[param1=value1,param2=value2,...]//device
 //
-// scheme = ffmpeg
+// scheme = ffmpeg | pango | thread
 //
 // ffmpeg - encode to compressed file using ffmpeg
 //  fps : fps to embed in encoded file.
@@ -42,6 +42,27 @@
 //
 //  e.g. ffmpeg://output_file.avi
 //  e.g. ffmpeg:[fps=30,bps=1000000,unique_filename]//output_file.avi
+//
+// thread - queue frames and write them to the child output from a separate thread
+//  num_buffers : number of frames which can be queued
+//  policy : block | drop, behaviour when the queue is full
+//
+//  e.g. thread:[num_buffers=60,policy=drop]//pango://video.pango
+//
+// pango - write streams to a .pango log
+//  buffer_size_mb : size of the write buffer
+//  encoder / encoderN : image encoder for all streams / stream N
+//  segment_mb / segment_s : roll over to a new numbered file (video.0001.pango,
+//                           ...) once the current one exceeds this size / duration
+//  checkpoint_packets : write an index checkpoint every N frames so that an
+//                       interrupted recording can be reindexed from its tail
+//  direct_io : write with O_DIRECT, bypassing the page cache (Linux)
+//  sync_mb : fdatasync after every sync_mb of data written
+//  io_uring_depth : number of writes to keep in flight with io_uring (Linux)
+//  unique_filename : append unique suffix if file already exists
+//
+//  e.g. pango:[segment_mb=2048,segment_s=600]//video.pango
+//  e.g. pango:[direct_io=1,sync_mb=256,io_uring_depth=8]//video.pango
 
 #include <pangolin/video/video_output_interface.h>
 #include <pangolin/utils/uri.h>
@@ -0,0 +1,125 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/image/demosaic.h>
+#include <pangolin/utils/cpu_features.h>
+
+#include "demosaic_kernels.h"
+
+#include <stdexcept>
+
+namespace pangolin
+{
+
+namespace
+{
+
+#if defined(PANGO_DEMOSAIC_SSE2)
+typedef Sse2Vec8 BaseVec8;
+typedef Sse2Vec16 BaseVec16;
+#elif defined(PANGO_DEMOSAIC_NEON)
+typedef NeonVec8 BaseVec8;
+typedef NeonVec16 BaseVec16;
+#else
+typedef ScalarVec<uint8_t> BaseVec8;
+typedef ScalarVec<uint16_t> BaseVec16;
+#endif
+
+template<typename T>
+void CheckSizes(const Image<T>& out, const Image<T>& in)
+{
+    if(out.w != in.w || out.h != in.h || out.pitch < 3 * sizeof(T) * out.w) {
+        throw std::runtime_error("Demosaic: Incompatible image sizes");
+    }
+}
+
+template<typename BaseVec, typename T>
+void RowsImpl(Image<T>& out, const Image<T>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0)
+{
+    if( !CpuHasAvx2() || !DemosaicRowsAvx2(out, in, tile, hq, maxval, h, y0, in_y0) ) {
+        DemosaicBand<BaseVec>(out, in, tile, hq, maxval, h, y0, in_y0);
+    }
+}
+
+template<typename BaseVec, typename T>
+void BandImpl(Image<T>& out, const Image<T>& in, BayerTile tile, DemosaicMethod method, int maxval, size_t h, size_t y0, size_t in_y0)
+{
+    // Rows within two of those computed, clamped to the image
+    const size_t need_y0 = y0 > 2 ? y0 - 2 : 0;
+    const size_t need_y1 = std::min(h, y0 + out.h + 2);
+    if( out.w != in.w || out.pitch < 3 * sizeof(T) * out.w || y0 + out.h > h ||
+        in_y0 > need_y0 || in_y0 + in.h < need_y1 ) {
+        throw std::runtime_error("Demosaic: Incompatible image sizes");
+    }
+    RowsImpl<BaseVec>(out, in, tile, method == DemosaicMethod::HQLinear, maxval, h, y0, in_y0);
+}
+
+template<typename BaseVec, typename T>
+void DemosaicImpl(Image<T>& out, const Image<T>& in, BayerTile tile, DemosaicMethod method, int maxval, ThreadPool* pool)
+{
+    CheckSizes(out, in);
+    const bool hq = (method == DemosaicMethod::HQLinear);
+
+    if(pool && in.h > 1) {
+        // Several bands per thread to even out load across busy workers
+        const size_t bands = std::min(in.h, 4 * (pool->NumThreads() + 1));
+        pool->ParallelFor(bands, [&](size_t b) {
+            const size_t y0 = in.h * b / bands;
+            Image<T> out_rows = out.SubImage(0, y0, out.w, in.h * (b+1) / bands - y0);
+            RowsImpl<BaseVec>(out_rows, in, tile, hq, maxval, in.h, y0, 0);
+        });
+    }else{
+        RowsImpl<BaseVec>(out, in, tile, hq, maxval, in.h, 0, 0);
+    }
+}
+
+int MaxValue(unsigned int bit_depth)
+{
+    return (bit_depth > 0 && bit_depth < 16) ? (1 << bit_depth) - 1 : 0xFFFF;
+}
+
+}
+
+void Demosaic(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, ThreadPool* pool)
+{
+    DemosaicImpl<BaseVec8>(out, in, tile, method, 255, pool);
+}
+
+void Demosaic(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned int bit_depth, ThreadPool* pool)
+{
+    DemosaicImpl<BaseVec16>(out, in, tile, method, MaxValue(bit_depth), pool);
+}
+
+void DemosaicRows(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, size_t h, size_t y0, size_t in_y0)
+{
+    BandImpl<BaseVec8>(out, in, tile, method, 255, h, y0, in_y0);
+}
+
+void DemosaicRows(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned int bit_depth, size_t h, size_t y0, size_t in_y0)
+{
+    BandImpl<BaseVec16>(out, in, tile, method, MaxValue(bit_depth), h, y0, in_y0);
+}
+
+}
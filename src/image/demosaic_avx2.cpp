@@ -0,0 +1,56 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Built with AVX2 code generation where the compiler supports it. Only called
+// after CpuHasAvx2() has confirmed the running CPU can execute it.
+
+#include "demosaic_kernels.h"
+
+namespace pangolin
+{
+
+bool DemosaicRowsAvx2(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0)
+{
+#ifdef __AVX2__
+    DemosaicBand<Avx2Vec8>(out, in, tile, hq, maxval, h, y0, in_y0);
+    return true;
+#else
+    (void)out; (void)in; (void)tile; (void)hq; (void)maxval; (void)h; (void)y0; (void)in_y0;
+    return false;
+#endif
+}
+
+bool DemosaicRowsAvx2(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0)
+{
+#ifdef __AVX2__
+    DemosaicBand<Avx2Vec16>(out, in, tile, hq, maxval, h, y0, in_y0);
+    return true;
+#else
+    (void)out; (void)in; (void)tile; (void)hq; (void)maxval; (void)h; (void)y0; (void)in_y0;
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,381 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Demosaic kernels shared by demosaic.cpp and demosaic_avx2.cpp. Everything
+// here has internal linkage, so each translation unit keeps instantiations
+// compiled for its own instruction set.
+
+#pragma once
+
+#include <pangolin/image/demosaic.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define PANGO_DEMOSAIC_SSE2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define PANGO_DEMOSAIC_NEON
+#endif
+
+namespace pangolin
+{
+
+// DemosaicBand() using AVX2 for the interior. Returns false if the library
+// was built without AVX2 support.
+bool DemosaicRowsAvx2(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0);
+bool DemosaicRowsAvx2(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0);
+
+namespace
+{
+
+// Each vector type holds samples widened to signed integers and provides the
+// same operations, so that the interpolation below is written once:
+//   Load / Store convert from and to the sample type, Store clamping to
+//   [0,maxval]; Splat broadcasts a constant; Alternate takes even lanes from
+//   its first argument and odd lanes from its second.
+
+template<typename T>
+struct ScalarVec
+{
+    typedef T Sample;
+    static const int lanes = 1;
+
+    int v;
+
+    static ScalarVec Load(const T* p) { return {*p}; }
+    static ScalarVec Splat(int x) { return {x}; }
+    void Store(T* p, int maxval) const { *p = (T)std::min(std::max(v, 0), maxval); }
+    template<int n> ScalarVec Shl() const { return {v * (1 << n)}; }
+    template<int n> ScalarVec Sar() const { return {v >> n}; }
+    friend ScalarVec operator+(ScalarVec a, ScalarVec b) { return {a.v + b.v}; }
+    friend ScalarVec operator-(ScalarVec a, ScalarVec b) { return {a.v - b.v}; }
+    static ScalarVec Alternate(ScalarVec even, ScalarVec) { return even; }
+};
+
+#ifdef PANGO_DEMOSAIC_SSE2
+// 8 x uint8 samples as int16.
+struct Sse2Vec8
+{
+    typedef uint8_t Sample;
+    static const int lanes = 8;
+
+    __m128i v;
+
+    static Sse2Vec8 Load(const uint8_t* p) { return {_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128())}; }
+    static Sse2Vec8 Splat(int x) { return {_mm_set1_epi16((short)x)}; }
+    void Store(uint8_t* p, int) const { _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(v, v)); }
+    template<int n> Sse2Vec8 Shl() const { return {_mm_slli_epi16(v, n)}; }
+    template<int n> Sse2Vec8 Sar() const { return {_mm_srai_epi16(v, n)}; }
+    friend Sse2Vec8 operator+(Sse2Vec8 a, Sse2Vec8 b) { return {_mm_add_epi16(a.v, b.v)}; }
+    friend Sse2Vec8 operator-(Sse2Vec8 a, Sse2Vec8 b) { return {_mm_sub_epi16(a.v, b.v)}; }
+    static Sse2Vec8 Alternate(Sse2Vec8 even, Sse2Vec8 odd) {
+        const __m128i m = _mm_set1_epi32(0x0000FFFF);
+        return {_mm_or_si128(_mm_and_si128(m, even.v), _mm_andnot_si128(m, odd.v))};
+    }
+};
+
+// 4 x uint16 samples as int32.
+struct Sse2Vec16
+{
+    typedef uint16_t Sample;
+    static const int lanes = 4;
+
+    __m128i v;
+
+    static Sse2Vec16 Load(const uint16_t* p) { return {_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128())}; }
+    static Sse2Vec16 Splat(int x) { return {_mm_set1_epi32(x)}; }
+    void Store(uint16_t* p, int maxval) const {
+        // SSE2 lacks min / max / unsigned pack for 32-bit lanes
+        const __m128i m = _mm_set1_epi32(maxval);
+        __m128i c = _mm_and_si128(v, _mm_cmpgt_epi32(v, _mm_setzero_si128()));
+        const __m128i gt = _mm_cmpgt_epi32(c, m);
+        c = _mm_or_si128(_mm_and_si128(gt, m), _mm_andnot_si128(gt, c));
+        c = _mm_packs_epi32(_mm_sub_epi32(c, _mm_set1_epi32(0x8000)), c);
+        _mm_storel_epi64((__m128i*)p, _mm_add_epi16(c, _mm_set1_epi16((short)0x8000)));
+    }
+    template<int n> Sse2Vec16 Shl() const { return {_mm_slli_epi32(v, n)}; }
+    template<int n> Sse2Vec16 Sar() const { return {_mm_srai_epi32(v, n)}; }
+    friend Sse2Vec16 operator+(Sse2Vec16 a, Sse2Vec16 b) { return {_mm_add_epi32(a.v, b.v)}; }
+    friend Sse2Vec16 operator-(Sse2Vec16 a, Sse2Vec16 b) { return {_mm_sub_epi32(a.v, b.v)}; }
+    static Sse2Vec16 Alternate(Sse2Vec16 even, Sse2Vec16 odd) {
+        const __m128i m = _mm_set_epi32(0, -1, 0, -1);
+        return {_mm_or_si128(_mm_and_si128(m, even.v), _mm_andnot_si128(m, odd.v))};
+    }
+};
+#endif // PANGO_DEMOSAIC_SSE2
+
+#ifdef __AVX2__
+// 16 x uint8 samples as int16.
+struct Avx2Vec8
+{
+    typedef uint8_t Sample;
+    static const int lanes = 16;
+
+    __m256i v;
+
+    static Avx2Vec8 Load(const uint8_t* p) { return {_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p))}; }
+    static Avx2Vec8 Splat(int x) { return {_mm256_set1_epi16((short)x)}; }
+    void Store(uint8_t* p, int) const {
+        _mm_storeu_si128((__m128i*)p, _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+    template<int n> Avx2Vec8 Shl() const { return {_mm256_slli_epi16(v, n)}; }
+    template<int n> Avx2Vec8 Sar() const { return {_mm256_srai_epi16(v, n)}; }
+    friend Avx2Vec8 operator+(Avx2Vec8 a, Avx2Vec8 b) { return {_mm256_add_epi16(a.v, b.v)}; }
+    friend Avx2Vec8 operator-(Avx2Vec8 a, Avx2Vec8 b) { return {_mm256_sub_epi16(a.v, b.v)}; }
+    static Avx2Vec8 Alternate(Avx2Vec8 even, Avx2Vec8 odd) { return {_mm256_blend_epi16(odd.v, even.v, 0x55)}; }
+};
+
+// 8 x uint16 samples as int32.
+struct Avx2Vec16
+{
+    typedef uint16_t Sample;
+    static const int lanes = 8;
+
+    __m256i v;
+
+    static Avx2Vec16 Load(const uint16_t* p) { return {_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))}; }
+    static Avx2Vec16 Splat(int x) { return {_mm256_set1_epi32(x)}; }
+    void Store(uint16_t* p, int maxval) const {
+        const __m256i c = _mm256_min_epi32(_mm256_max_epi32(v, _mm256_setzero_si256()), _mm256_set1_epi32(maxval));
+        _mm_storeu_si128((__m128i*)p, _mm_packus_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1)));
+    }
+    template<int n> Avx2Vec16 Shl() const { return {_mm256_slli_epi32(v, n)}; }
+    template<int n> Avx2Vec16 Sar() const { return {_mm256_srai_epi32(v, n)}; }
+    friend Avx2Vec16 operator+(Avx2Vec16 a, Avx2Vec16 b) { return {_mm256_add_epi32(a.v, b.v)}; }
+    friend Avx2Vec16 operator-(Avx2Vec16 a, Avx2Vec16 b) { return {_mm256_sub_epi32(a.v, b.v)}; }
+    static Avx2Vec16 Alternate(Avx2Vec16 even, Avx2Vec16 odd) { return {_mm256_blend_epi32(odd.v, even.v, 0x55)}; }
+};
+#endif // __AVX2__
+
+#ifdef PANGO_DEMOSAIC_NEON
+// 8 x uint8 samples as int16.
+struct NeonVec8
+{
+    typedef uint8_t Sample;
+    static const int lanes = 8;
+
+    int16x8_t v;
+
+    static NeonVec8 Load(const uint8_t* p) { return {vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)))}; }
+    static NeonVec8 Splat(int x) { return {vdupq_n_s16((int16_t)x)}; }
+    void Store(uint8_t* p, int) const { vst1_u8(p, vqmovun_s16(v)); }
+    template<int n> NeonVec8 Shl() const { return {vshlq_n_s16(v, n)}; }
+    template<int n> NeonVec8 Sar() const { return {vshrq_n_s16(v, n)}; }
+    friend NeonVec8 operator+(NeonVec8 a, NeonVec8 b) { return {vaddq_s16(a.v, b.v)}; }
+    friend NeonVec8 operator-(NeonVec8 a, NeonVec8 b) { return {vsubq_s16(a.v, b.v)}; }
+    static NeonVec8 Alternate(NeonVec8 even, NeonVec8 odd) {
+        return {vbslq_s16(vreinterpretq_u16_u32(vdupq_n_u32(0x0000FFFF)), even.v, odd.v)};
+    }
+};
+
+// 4 x uint16 samples as int32.
+struct NeonVec16
+{
+    typedef uint16_t Sample;
+    static const int lanes = 4;
+
+    int32x4_t v;
+
+    static NeonVec16 Load(const uint16_t* p) { return {vreinterpretq_s32_u32(vmovl_u16(vld1_u16(p)))}; }
+    static NeonVec16 Splat(int x) { return {vdupq_n_s32(x)}; }
+    void Store(uint16_t* p, int maxval) const { vst1_u16(p, vqmovun_s32(vminq_s32(v, vdupq_n_s32(maxval)))); }
+    template<int n> NeonVec16 Shl() const { return {vshlq_n_s32(v, n)}; }
+    template<int n> NeonVec16 Sar() const { return {vshrq_n_s32(v, n)}; }
+    friend NeonVec16 operator+(NeonVec16 a, NeonVec16 b) { return {vaddq_s32(a.v, b.v)}; }
+    friend NeonVec16 operator-(NeonVec16 a, NeonVec16 b) { return {vsubq_s32(a.v, b.v)}; }
+    static NeonVec16 Alternate(NeonVec16 even, NeonVec16 odd) {
+        return {vbslq_s32(vreinterpretq_u32_u64(vdupq_n_u64(0x00000000FFFFFFFFull)), even.v, odd.v)};
+    }
+};
+#endif // PANGO_DEMOSAIC_NEON
+
+template<int n, typename V>
+inline V Round(V v)
+{
+    return (v + V::Splat(1 << (n-1))).template Sar<n>();
+}
+
+// Estimates of a missing colour at the centre of the 5x5 neighbourhood s(dy,dx).
+// Within a row containing colours X and G, Centre() is the measured colour,
+// Cross() is G at an X site, Horiz() is X at a G site, Vert() is the other
+// colour Y at a G site and Diag() is Y at an X site.
+template<bool hq>
+struct Interpolate;
+
+template<>
+struct Interpolate<false>
+{
+    template<typename V, typename S> static V Cross(const S& s) { return Round<2>(s(-1,0) + s(1,0) + s(0,-1) + s(0,1)); }
+    template<typename V, typename S> static V Horiz(const S& s) { return Round<1>(s(0,-1) + s(0,1)); }
+    template<typename V, typename S> static V Vert(const S& s)  { return Round<1>(s(-1,0) + s(1,0)); }
+    template<typename V, typename S> static V Diag(const S& s)  { return Round<2>(s(-1,-1) + s(-1,1) + s(1,-1) + s(1,1)); }
+};
+
+// Malvar, He and Cutler's filters scaled by 16.
+template<>
+struct Interpolate<true>
+{
+    template<typename V, typename S> static V Cross(const S& s) {
+        return Round<4>( s(0,0).template Shl<3>() + (s(-1,0) + s(1,0) + s(0,-1) + s(0,1)).template Shl<2>()
+                         - (s(-2,0) + s(2,0) + s(0,-2) + s(0,2)).template Shl<1>() );
+    }
+    template<typename V, typename S> static V Horiz(const S& s) {
+        const V c = s(0,0);
+        return Round<4>( c.template Shl<3>() + c.template Shl<1>() + (s(0,-1) + s(0,1)).template Shl<3>()
+                         - (s(0,-2) + s(0,2) + s(-1,-1) + s(-1,1) + s(1,-1) + s(1,1)).template Shl<1>()
+                         + s(-2,0) + s(2,0) );
+    }
+    template<typename V, typename S> static V Vert(const S& s) {
+        const V c = s(0,0);
+        return Round<4>( c.template Shl<3>() + c.template Shl<1>() + (s(-1,0) + s(1,0)).template Shl<3>()
+                         - (s(-2,0) + s(2,0) + s(-1,-1) + s(-1,1) + s(1,-1) + s(1,1)).template Shl<1>()
+                         + s(0,-2) + s(0,2) );
+    }
+    template<typename V, typename S> static V Diag(const S& s) {
+        const V c = s(0,0);
+        const V far = s(-2,0) + s(2,0) + s(0,-2) + s(0,2);
+        return Round<4>( c.template Shl<3>() + c.template Shl<2>() + (s(-1,-1) + s(-1,1) + s(1,-1) + s(1,1)).template Shl<2>()
+                         - far.template Shl<1>() - far );
+    }
+};
+
+// Index i reflected into [0,n) about the first and last sample, which keeps
+// the Bayer phase: -1 -> 1, n -> n-2.
+inline int Reflect(int i, int n)
+{
+    if(i < 0) i = -i;
+    if(i >= n) i = 2*(n-1) - i;
+    return std::min(std::max(i, 0), n-1);
+}
+
+// Planar estimates of colours X, G and Y for columns [x0,x1) of the row
+// centred in r[], one pixel at a time with reflected borders.
+template<bool hq, typename T>
+void DemosaicPixels(const T* const r[5], T* cx, T* cg, T* cy, int x0, int x1, int w, bool g_odd, int maxval)
+{
+    typedef ScalarVec<T> V;
+    typedef Interpolate<hq> I;
+    for(int x = x0; x < x1; ++x) {
+        auto s = [&](int dy, int dx) { return V::Load(r[2+dy] + Reflect(x+dx, w)); };
+        if( (x & 1) == (int)g_odd ) {
+            I::template Horiz<V>(s).Store(cx + x, maxval);
+            s(0,0).Store(cg + x, maxval);
+            I::template Vert<V>(s).Store(cy + x, maxval);
+        }else{
+            s(0,0).Store(cx + x, maxval);
+            I::template Cross<V>(s).Store(cg + x, maxval);
+            I::template Diag<V>(s).Store(cy + x, maxval);
+        }
+    }
+}
+
+// As DemosaicPixels, V::lanes pixels at a time. x0 must be even and the
+// 5x5 neighbourhood of [x0,x1) must lie within the row.
+template<bool hq, bool g_odd, typename V>
+void DemosaicVectors(const typename V::Sample* const r[5], typename V::Sample* cx, typename V::Sample* cg, typename V::Sample* cy, int x0, int x1, int maxval)
+{
+    typedef Interpolate<hq> I;
+    for(int x = x0; x + V::lanes <= x1; x += V::lanes) {
+        auto s = [&](int dy, int dx) { return V::Load(r[2+dy] + x + dx); };
+        const V c = s(0,0);
+        if(g_odd) {
+            V::Alternate(c, I::template Horiz<V>(s)).Store(cx + x, maxval);
+            V::Alternate(I::template Cross<V>(s), c).Store(cg + x, maxval);
+            V::Alternate(I::template Diag<V>(s), I::template Vert<V>(s)).Store(cy + x, maxval);
+        }else{
+            V::Alternate(I::template Horiz<V>(s), c).Store(cx + x, maxval);
+            V::Alternate(c, I::template Cross<V>(s)).Store(cg + x, maxval);
+            V::Alternate(I::template Vert<V>(s), I::template Diag<V>(s)).Store(cy + x, maxval);
+        }
+    }
+}
+
+// Rows [y0, y0+out.h) of Demosaic() for an image h rows high, using vector
+// type V for the interior. Row 0 of out is row y0 and row 0 of in is row
+// in_y0, and in must hold the rows within two of those computed.
+template<typename V, typename T = typename V::Sample>
+void DemosaicBand(Image<T>& out, const Image<T>& in, BayerTile tile, bool hq, int maxval, size_t h, size_t y0, size_t in_y0)
+{
+    const int w = (int)in.w;
+
+    // Phase of the first row: whether G is in odd columns, and whether the
+    // other colour is red
+    const bool g_odd0 = (tile == BayerTile::RGGB || tile == BayerTile::BGGR);
+    const bool red0 = (tile == BayerTile::RGGB || tile == BayerTile::GRBG);
+
+    // Vectors cover whole lanes from column 2, leaving room for the border.
+    // A single lane can't alternate colours, so ScalarVec leaves it all to
+    // DemosaicPixels.
+    const int lanes = V::lanes;
+    const int vx1 = (lanes < 2) ? 2 : std::max(2, 2 + ((w - 4) / lanes) * lanes);
+
+    std::vector<T> planes(3*w);
+    T* cx = planes.data();
+    T* cg = cx + w;
+    T* cy = cg + w;
+
+    for(size_t y = y0; y < y0 + out.h; ++y) {
+        const T* r[5];
+        for(int k=0; k < 5; ++k) {
+            r[k] = in.RowPtr(Reflect((int)y + k - 2, (int)h) - in_y0);
+        }
+
+        const bool g_odd = g_odd0 != ((y & 1) != 0);
+        const bool red = red0 != ((y & 1) != 0);
+
+        const int px1 = std::min(2, w);
+        if(hq) {
+            DemosaicPixels<true>(r, cx, cg, cy, 0, px1, w, g_odd, maxval);
+            if(g_odd) DemosaicVectors<true, true, V>(r, cx, cg, cy, 2, vx1, maxval);
+            else      DemosaicVectors<true, false, V>(r, cx, cg, cy, 2, vx1, maxval);
+            DemosaicPixels<true>(r, cx, cg, cy, std::max(px1, vx1), w, w, g_odd, maxval);
+        }else{
+            DemosaicPixels<false>(r, cx, cg, cy, 0, px1, w, g_odd, maxval);
+            if(g_odd) DemosaicVectors<false, true, V>(r, cx, cg, cy, 2, vx1, maxval);
+            else      DemosaicVectors<false, false, V>(r, cx, cg, cy, 2, vx1, maxval);
+            DemosaicPixels<false>(r, cx, cg, cy, std::max(px1, vx1), w, w, g_odd, maxval);
+        }
+
+        const T* cr = red ? cx : cy;
+        const T* cb = red ? cy : cx;
+        T* o = out.RowPtr(y - y0);
+        for(int x = 0; x < w; ++x) {
+            o[3*x+0] = cr[x];
+            o[3*x+1] = cg[x];
+            o[3*x+2] = cb[x];
+        }
+    }
+}
+
+}
+
+}
@@ -26,17 +26,21 @@
  */
 
 #include <pangolin/image/image_io.h>
+#include <pangolin/utils/format_string.h>
 
+#include <cstring>
 #include <fstream>
 
 namespace pangolin {
 
 // PNG
 TypedImage LoadPng(std::istream& in);
+void LoadPng(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt);
 void SavePng(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, bool top_line_first, int zlib_compression_level );
 
 // JPG
 TypedImage LoadJpg(std::istream& in);
+void LoadJpg(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt);
 void SaveJpg(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, float quality);
 
 // PPM
@@ -56,14 +60,17 @@ void SaveExr(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt
 
 // ZSTD (https://github.com/facebook/zstd)
 TypedImage LoadZstd(std::istream& in);
+void LoadZstd(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt);
 void SaveZstd(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level);
 
 // https://github.com/lz4/lz4
 TypedImage LoadLz4(std::istream& in);
+void LoadLz4(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt);
 void SaveLz4(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level);
 
 // packed 12 bit image (obtained from unpacked 16bit)
 TypedImage LoadPacked12bit(std::istream& in);
+void LoadPacked12bit(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt);
 void SavePacked12bit(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level);
 
 TypedImage LoadImage(std::istream& in, ImageFileType file_type)
@@ -90,6 +97,44 @@ TypedImage LoadImage(std::istream& in, ImageFileType file_type)
     }
 }
 
+// Used by the decoders above once they have read the stored image's header:
+// returns dst if a w x h image of format fmt can be decoded into it.
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt)
+{
+    if(dst.w != w || dst.h != h || dst_fmt.bpp != fmt.bpp) {
+        throw std::runtime_error(FormatString(
+            "Stored image (% x %, %) does not match destination (% x %, %)",
+            w, h, fmt.format, dst.w, dst.h, dst_fmt.format
+        ));
+    }
+    return dst;
+}
+
+void LoadImage(std::istream& in, ImageFileType file_type, Image<unsigned char> dst, const PixelFormat& dst_fmt)
+{
+    switch (file_type) {
+    case ImageFileTypePng:
+        return LoadPng(in, dst, dst_fmt);
+    case ImageFileTypeJpg:
+        return LoadJpg(in, dst, dst_fmt);
+    case ImageFileTypeZstd:
+        return LoadZstd(in, dst, dst_fmt);
+    case ImageFileTypeLz4:
+        return LoadLz4(in, dst, dst_fmt);
+    case ImageFileTypeP12b:
+        return LoadPacked12bit(in, dst, dst_fmt);
+    default:
+    {
+        const TypedImage img = LoadImage(in, file_type);
+        ImageDecodeTarget(dst, dst_fmt, img.w, img.h, img.fmt);
+        const size_t row_bytes = dst.w * dst_fmt.bpp / 8;
+        for(size_t y=0; y < dst.h; ++y) {
+            std::memcpy(dst.RowPtr(y), img.RowPtr(y), row_bytes);
+        }
+    }
+    }
+}
+
 TypedImage LoadImage(const std::string& filename, ImageFileType file_type)
 {
     switch (file_type) {
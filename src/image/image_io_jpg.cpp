@@ -19,6 +19,9 @@
 
 namespace pangolin {
 
+// Defined in image_io.cpp
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt);
+
 #ifdef HAVE_JPEG
 
 void error_handler(j_common_ptr cinfo) {
@@ -156,10 +159,11 @@ void pango_jpeg_set_dest_mgr(j_compress_ptr cinfo, std::ostream& os) {
 
 #endif // HAVE_JPEG
 
-TypedImage LoadJpg(std::istream& is) {
 #ifdef HAVE_JPEG
-    TypedImage image;
-
+// target(w,h,fmt) supplies the image to decode into once the header is read.
+template<typename F>
+static void DecodeJpg(std::istream& is, F&& target)
+{
     struct jpeg_decompress_struct cinfo;
     struct jpeg_error_mgr jerr;
 
@@ -169,36 +173,59 @@ TypedImage LoadJpg(std::istream& is) {
     jpeg_create_decompress(&cinfo);
     pango_jpeg_set_source_mgr(&cinfo, is);
 
-    // read info from header.
-    int r = jpeg_read_header(&cinfo, TRUE);
-    if (r != JPEG_HEADER_OK) {
-        throw std::runtime_error("Failed to read JPEG header.");
-    } else if (cinfo.num_components != 3 && cinfo.num_components != 1) {
-        throw std::runtime_error("Unsupported number of color components");
-    } else {
-        jpeg_start_decompress(&cinfo);
-        // resize storage if necessary
-        PixelFormat fmt = PixelFormatFromString(cinfo.output_components == 3 ? "RGB24" : "GRAY8");
-        image.Reinitialise(cinfo.output_width, cinfo.output_height, fmt);
-        JSAMPARRAY imageBuffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE,
-                                                            cinfo.output_width*cinfo.output_components, 1);
-        for (size_t y = 0; y < cinfo.output_height; y++) {
-            jpeg_read_scanlines(&cinfo, imageBuffer, 1);
-            uint8_t* dstRow = (uint8_t*)image.RowPtr(y);
-            memcpy(dstRow, imageBuffer[0], cinfo.output_width*cinfo.output_components);
+    try {
+        // read info from header.
+        int r = jpeg_read_header(&cinfo, TRUE);
+        if (r != JPEG_HEADER_OK) {
+            throw std::runtime_error("Failed to read JPEG header.");
+        } else if (cinfo.num_components != 3 && cinfo.num_components != 1) {
+            throw std::runtime_error("Unsupported number of color components");
+        } else {
+            jpeg_start_decompress(&cinfo);
+            PixelFormat fmt = PixelFormatFromString(cinfo.output_components == 3 ? "RGB24" : "GRAY8");
+            Image<unsigned char> image = target(cinfo.output_width, cinfo.output_height, fmt);
+            // Decompress scanlines directly into the destination rows
+            while (cinfo.output_scanline < cinfo.output_height) {
+                JSAMPROW row = (JSAMPROW)image.RowPtr(cinfo.output_scanline);
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
         }
-        jpeg_finish_decompress(&cinfo);
+    }catch(...) {
+        jpeg_destroy_decompress(&cinfo);
+        throw;
     }
 
     // clean up.
     jpeg_destroy_decompress(&cinfo);
+}
+#endif // HAVE_JPEG
 
+TypedImage LoadJpg(std::istream& is) {
+#ifdef HAVE_JPEG
+    TypedImage image;
+    DecodeJpg(is, [&image](size_t w, size_t h, const PixelFormat& fmt){
+        image.Reinitialise(w, h, fmt);
+        return Image<unsigned char>(image);
+    });
     return image;
 #else
     PANGOLIN_UNUSED(is);
     throw std::runtime_error("Rebuild Pangolin for JPEG support.");
 #endif // HAVE_JPEG
+}
 
+void LoadJpg(std::istream& is, Image<unsigned char> dst, const PixelFormat& dst_fmt) {
+#ifdef HAVE_JPEG
+    DecodeJpg(is, [&](size_t w, size_t h, const PixelFormat& fmt){
+        return ImageDecodeTarget(dst, dst_fmt, w, h, fmt);
+    });
+#else
+    PANGOLIN_UNUSED(is);
+    PANGOLIN_UNUSED(dst);
+    PANGOLIN_UNUSED(dst_fmt);
+    throw std::runtime_error("Rebuild Pangolin for JPEG support.");
+#endif // HAVE_JPEG
 }
 
 TypedImage LoadJpg(const std::string& filename) {
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <fstream>
 #include <memory>
 
@@ -9,6 +10,9 @@
 
 namespace pangolin {
 
+// Defined in image_io.cpp
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt);
+
 #pragma pack(push, 1)
 struct lz4_image_header
 {
@@ -57,25 +61,53 @@ void SaveLz4(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt
 #endif // HAVE_LZ4
 }
 
-TypedImage LoadLz4(std::istream& in)
-{
 #ifdef HAVE_LZ4
+// target(w,h,fmt) supplies the image to decode into once the header is read.
+template<typename F>
+static void DecodeLz4(std::istream& in, F&& target)
+{
     // Read in header, uncompressed
     lz4_image_header header;
     in.read( (char*)&header, sizeof(header));
 
-    TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
-    std::unique_ptr<char[]> input_buffer(new char[header.compressed_size]);
+    const PixelFormat fmt = PixelFormatFromString(header.fmt);
+    Image<unsigned char> img = target(header.w, header.h, fmt);
+    const size_t row_bytes = img.w * fmt.bpp / 8;
+    const size_t size_bytes = row_bytes * img.h;
 
+    std::unique_ptr<char[]> input_buffer(new char[header.compressed_size]);
     in.read(input_buffer.get(), header.compressed_size);
-    const int decompressed_size = LZ4_decompress_safe(input_buffer.get(), (char*)img.ptr, header.compressed_size, img.SizeBytes());
+
+    // Rows are stored contiguously, so we can only decompress in place if
+    // img has no padding between rows.
+    const bool in_place = img.pitch == row_bytes;
+    std::unique_ptr<char[]> unpadded(in_place ? nullptr : new char[size_bytes]);
+    char* output = in_place ? (char*)img.ptr : unpadded.get();
+
+    const int decompressed_size = LZ4_decompress_safe(input_buffer.get(), output, header.compressed_size, size_bytes);
     if (decompressed_size < 0)
         throw std::runtime_error(FormatString("A negative result from LZ4_decompress_safe indicates a failure trying to decompress the data.  See exit code (%) for value returned.", decompressed_size));
-      if (decompressed_size == 0)
+    if (decompressed_size == 0)
         throw std::runtime_error("I'm not sure this function can ever return 0.  Documentation in lz4.h doesn't indicate so.");
-    if (decompressed_size != (int)img.SizeBytes())
-        throw std::runtime_error(FormatString("decompressed size % is not equal to predicted size %", decompressed_size, img.SizeBytes()));
+    if (decompressed_size != (int)size_bytes)
+        throw std::runtime_error(FormatString("decompressed size % is not equal to predicted size %", decompressed_size, size_bytes));
+
+    if(!in_place) {
+        for(size_t y=0; y < img.h; ++y) {
+            std::memcpy(img.RowPtr(y), output + y*row_bytes, row_bytes);
+        }
+    }
+}
+#endif // HAVE_LZ4
 
+TypedImage LoadLz4(std::istream& in)
+{
+#ifdef HAVE_LZ4
+    TypedImage img;
+    DecodeLz4(in, [&img](size_t w, size_t h, const PixelFormat& fmt){
+        img.Reinitialise(w, h, fmt);
+        return Image<unsigned char>(img);
+    });
     return img;
 #else
     PANGOLIN_UNUSED(in);
@@ -83,4 +115,18 @@ TypedImage LoadLz4(std::istream& in)
 #endif // HAVE_LZ4
 }
 
+void LoadLz4(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt)
+{
+#ifdef HAVE_LZ4
+    DecodeLz4(in, [&](size_t w, size_t h, const PixelFormat& fmt){
+        return ImageDecodeTarget(dst, dst_fmt, w, h, fmt);
+    });
+#else
+    PANGOLIN_UNUSED(in);
+    PANGOLIN_UNUSED(dst);
+    PANGOLIN_UNUSED(dst_fmt);
+    throw std::runtime_error("Rebuild Pangolin for LZ4 support.");
+#endif // HAVE_LZ4
+}
+
 }
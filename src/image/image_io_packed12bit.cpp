@@ -2,9 +2,13 @@
 #include <memory>
 
 #include <pangolin/image/typed_image.h>
+#include <pangolin/image/pixel_packing.h>
 
 namespace pangolin {
 
+// Defined in image_io.cpp
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt);
+
 #pragma pack(push, 1)
 struct packed12bit_image_header
 {
@@ -26,16 +30,7 @@ void SavePacked12bit(const Image<uint8_t>& image, const pangolin::PixelFormat& f
   std::unique_ptr<uint8_t[]> output_buffer(new uint8_t[dest_size]);
 
     for(size_t r=0; r<image.h; ++r) {
-        uint8_t* pout = output_buffer.get() + r*dest_pitch;
-        uint16_t* pin = (uint16_t*)(image.ptr + r*image.pitch);
-        const uint16_t* pin_end = (uint16_t*)(image.ptr + (r+1)*image.pitch);
-        while(pin < pin_end) {
-            uint32_t val = (*(pin++) & 0x00000FFF);
-            val |= uint32_t(*(pin++) & 0x00000FFF) << 12;
-            *(pout++) = uint8_t( val & 0x000000FF);
-            *(pout++) = uint8_t((val & 0x0000FF00) >> 8);
-            *(pout++) = uint8_t((val & 0x00FF0000) >> 16);
-        }
+        Pack12bit(output_buffer.get() + r*dest_pitch, (const uint16_t*)(image.ptr + r*image.pitch), image.w);
     }
 
   packed12bit_image_header header;
@@ -48,38 +43,47 @@ void SavePacked12bit(const Image<uint8_t>& image, const pangolin::PixelFormat& f
 
 }
 
-TypedImage LoadPacked12bit(std::istream& in)
+// target(w,h,fmt) supplies the image to decode into once the header is read.
+template<typename F>
+static void DecodePacked12bit(std::istream& in, F&& target)
 {
     // Read in header, uncompressed
     packed12bit_image_header header;
     in.read((char*)&header, sizeof(header));
 
-    TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
+    const PixelFormat fmt = PixelFormatFromString(header.fmt);
+    if (fmt.bpp != 16) {
+        throw std::runtime_error("packed12bit currently only supported with 16bit input image");
+    }
 
-  if (img.fmt.bpp != 16) {
-    throw std::runtime_error("packed12bit currently only supported with 16bit input image");
-  }
+    Image<unsigned char> img = target(header.w, header.h, fmt);
 
-  const size_t input_pitch = (img.w*12)/ 8 + ((img.w*12) % 8 > 0? 1 : 0);
-  const size_t input_size = img.h*input_pitch;
+    const size_t input_pitch = (img.w*12)/ 8 + ((img.w*12) % 8 > 0? 1 : 0);
+    const size_t input_size = img.h*input_pitch;
     std::unique_ptr<uint8_t[]> input_buffer(new uint8_t[input_size]);
 
     in.read((char*)input_buffer.get(), input_size);
 
     for(size_t r=0; r<img.h; ++r) {
-        uint16_t* pout = (uint16_t*)(img.ptr + r*img.pitch);
-        uint8_t* pin = input_buffer.get() + r*input_pitch;
-        const uint8_t* pin_end = input_buffer.get() + (r+1)*input_pitch;
-        while(pin < pin_end) {
-            uint32_t val = *(pin++);
-            val |= uint32_t(*(pin++)) << 8;
-            val |= uint32_t(*(pin++)) << 16;
-            *(pout++) = uint16_t( val & 0x000FFF);
-            *(pout++) = uint16_t((val & 0xFFF000) >> 12);
-        }
+        Unpack12bit((uint16_t*)(img.ptr + r*img.pitch), input_buffer.get() + r*input_pitch, img.w);
     }
+}
 
+TypedImage LoadPacked12bit(std::istream& in)
+{
+    TypedImage img;
+    DecodePacked12bit(in, [&img](size_t w, size_t h, const PixelFormat& fmt){
+        img.Reinitialise(w, h, fmt);
+        return Image<unsigned char>(img);
+    });
     return img;
 }
 
+void LoadPacked12bit(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt)
+{
+    DecodePacked12bit(in, [&](size_t w, size_t h, const PixelFormat& fmt){
+        return ImageDecodeTarget(dst, dst_fmt, w, h, fmt);
+    });
+}
+
 }
@@ -10,6 +10,9 @@
 
 namespace pangolin {
 
+// Defined in image_io.cpp
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt);
+
 #ifdef HAVE_PNG
 
 PixelFormat PngFormat(png_structp png_ptr, png_infop info_ptr )
@@ -71,9 +74,11 @@ void pango_png_stream_write_flush(png_structp pngPtr)
 #endif // HAVE_PNG
 
 
-TypedImage LoadPng(std::istream& source)
-{
 #ifdef HAVE_PNG
+// target(w,h,fmt) supplies the image to decode into once the header is read.
+template<typename F>
+static void DecodePng(std::istream& source, F&& target)
+{
     //so First, we validate our stream with the validate function I just mentioned
     if (!pango_png_validate(source)) {
         throw std::runtime_error("Not valid PNG header");
@@ -115,25 +120,53 @@ TypedImage LoadPng(std::istream& source)
         png_set_palette_to_rgb(png_ptr);
     }
 
-    //read the file
-    png_read_png(png_ptr, info_ptr, PNG_TRANSFORM_SWAP_ENDIAN, NULL);
+    try {
+        // Read the header, then the rows straight into place.
+        png_read_info(png_ptr, info_ptr);
 
-    if( png_get_interlace_type(png_ptr,info_ptr) != PNG_INTERLACE_NONE) {
-        throw std::runtime_error( "Interlace not yet supported" );
-    }
+        if( png_get_interlace_type(png_ptr,info_ptr) != PNG_INTERLACE_NONE) {
+            throw std::runtime_error( "Interlace not yet supported" );
+        }
 
-    const size_t w = png_get_image_width(png_ptr,info_ptr);
-    const size_t h = png_get_image_height(png_ptr,info_ptr);
-    const size_t pitch = png_get_rowbytes(png_ptr, info_ptr);
+        // Switch to little-endian byte order, to match host.
+        if( png_get_bit_depth(png_ptr, info_ptr) == 16) {
+            png_set_swap(png_ptr);
+        }
+        png_read_update_info(png_ptr, info_ptr);
 
-    TypedImage img(w, h, PngFormat(png_ptr, info_ptr), pitch);
+        const size_t w = png_get_image_width(png_ptr,info_ptr);
+        const size_t h = png_get_image_height(png_ptr,info_ptr);
+        const PixelFormat fmt = PngFormat(png_ptr, info_ptr);
 
-    png_bytepp rows = png_get_rows(png_ptr, info_ptr);
-    for( unsigned int r = 0; r < h; r++) {
-        memcpy( img.ptr + pitch*r, rows[r], pitch );
+        if(png_get_rowbytes(png_ptr, info_ptr) != w*fmt.bpp/8) {
+            throw std::runtime_error( "Unexpected PNG row size" );
+        }
+
+        Image<unsigned char> img = target(w, h, fmt);
+
+        std::vector<png_bytep> rows(h);
+        for( unsigned int r = 0; r < h; r++) {
+            rows[r] = img.RowPtr(r);
+        }
+        png_read_image(png_ptr, rows.data());
+        png_read_end(png_ptr, end_info);
+    }catch(...) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        throw;
     }
+
     png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+}
+#endif // HAVE_PNG
 
+TypedImage LoadPng(std::istream& source)
+{
+#ifdef HAVE_PNG
+    TypedImage img;
+    DecodePng(source, [&img](size_t w, size_t h, const PixelFormat& fmt){
+        img.Reinitialise(w, h, fmt);
+        return Image<unsigned char>(img);
+    });
     return img;
 #else
     PANGOLIN_UNUSED(source);
@@ -141,6 +174,20 @@ TypedImage LoadPng(std::istream& source)
 #endif // HAVE_PNG
 }
 
+void LoadPng(std::istream& source, Image<unsigned char> dst, const PixelFormat& dst_fmt)
+{
+#ifdef HAVE_PNG
+    DecodePng(source, [&](size_t w, size_t h, const PixelFormat& fmt){
+        return ImageDecodeTarget(dst, dst_fmt, w, h, fmt);
+    });
+#else
+    PANGOLIN_UNUSED(source);
+    PANGOLIN_UNUSED(dst);
+    PANGOLIN_UNUSED(dst_fmt);
+    throw std::runtime_error("Rebuild Pangolin for PNG support.");
+#endif // HAVE_PNG
+}
+
 TypedImage LoadPng(const std::string& filename)
 {
     std::ifstream f(filename);
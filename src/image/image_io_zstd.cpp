@@ -10,6 +10,9 @@
 
 namespace pangolin {
 
+// Defined in image_io.cpp
+Image<unsigned char> ImageDecodeTarget(Image<unsigned char> dst, const PixelFormat& dst_fmt, size_t w, size_t h, const PixelFormat& fmt);
+
 #pragma pack(push, 1)
 struct zstd_image_header
 {
@@ -76,14 +79,18 @@ void SaveZstd(const Image<unsigned char>& image, const pangolin::PixelFormat& fm
 #endif // HAVE_ZSTD
 }
 
-TypedImage LoadZstd(std::istream& in)
-{
 #ifdef HAVE_ZSTD
+// target(w,h,fmt) supplies the image to decode into once the header is read.
+template<typename F>
+static void DecodeZstd(std::istream& in, F&& target)
+{
     // Read in header, uncompressed
     zstd_image_header header;
     in.read( (char*)&header, sizeof(header));
 
-    TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
+    const PixelFormat fmt = PixelFormatFromString(header.fmt);
+    Image<unsigned char> img = target(header.w, header.h, fmt);
+    const size_t row_bytes = img.w * fmt.bpp / 8;
 
     const size_t input_buffer_size = ZSTD_DStreamInSize();
     std::unique_ptr<char[]> input_buffer(new char[input_buffer_size]);
@@ -95,26 +102,50 @@ TypedImage LoadZstd(std::istream& in)
 
     size_t read_size_hint = ZSTD_initDStream(dstream);
     if (ZSTD_isError(read_size_hint)) {
+        ZSTD_freeDStream(dstream);
         throw std::runtime_error(FormatString("ZSTD_initDStream() error : % \n", ZSTD_getErrorName(read_size_hint)));
     }
 
-    // Image represents our fixed buffer.
-    ZSTD_outBuffer output = { img.ptr, img.SizeBytes(), 0 };
+    // Decompress straight into img if its rows are contiguous. Otherwise go
+    // one destination row at a time, so that img may be pitched.
+    const bool contiguous = img.pitch == row_bytes;
+    size_t y = 0;
+    ZSTD_outBuffer output = { img.ptr, contiguous ? row_bytes * img.h : (img.h ? row_bytes : 0), 0 };
 
     while(read_size_hint)
     {
         const size_t read = in.readsome(input_buffer.get(), read_size_hint);
         ZSTD_inBuffer input = { input_buffer.get(), read, 0 };
         while (input.pos < input.size) {
+            if(!contiguous && output.pos == output.size && y+1 < img.h) {
+                output = { img.RowPtr(++y), row_bytes, 0 };
+            }
+            const size_t in_pos = input.pos;
+            const size_t out_pos = output.pos;
             read_size_hint = ZSTD_decompressStream(dstream, &output , &input);
             if (ZSTD_isError(read_size_hint)) {
+                ZSTD_freeDStream(dstream);
                 throw std::runtime_error(FormatString("ZSTD_decompressStream() error : %", ZSTD_getErrorName(read_size_hint)));
             }
+            if(input.pos == in_pos && output.pos == out_pos) {
+                ZSTD_freeDStream(dstream);
+                throw std::runtime_error("ZSTD stream holds more data than the image.");
+            }
         }
     }
 
     ZSTD_freeDStream(dstream);
+}
+#endif // HAVE_ZSTD
 
+TypedImage LoadZstd(std::istream& in)
+{
+#ifdef HAVE_ZSTD
+    TypedImage img;
+    DecodeZstd(in, [&img](size_t w, size_t h, const PixelFormat& fmt){
+        img.Reinitialise(w, h, fmt);
+        return Image<unsigned char>(img);
+    });
     return img;
 #else
     PANGOLIN_UNUSED(in);
@@ -122,4 +153,18 @@ TypedImage LoadZstd(std::istream& in)
 #endif // HAVE_ZSTD
 }
 
+void LoadZstd(std::istream& in, Image<unsigned char> dst, const PixelFormat& dst_fmt)
+{
+#ifdef HAVE_ZSTD
+    DecodeZstd(in, [&](size_t w, size_t h, const PixelFormat& fmt){
+        return ImageDecodeTarget(dst, dst_fmt, w, h, fmt);
+    });
+#else
+    PANGOLIN_UNUSED(in);
+    PANGOLIN_UNUSED(dst);
+    PANGOLIN_UNUSED(dst_fmt);
+    throw std::runtime_error("Rebuild Pangolin for ZSTD support.");
+#endif // HAVE_ZSTD
+}
+
 }
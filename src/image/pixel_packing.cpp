@@ -0,0 +1,244 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/image/pixel_packing.h>
+#include <pangolin/utils/cpu_features.h>
+
+#include "pixel_packing_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#   include <arm_neon.h>
+#   define PANGO_PACKING_NEON
+#endif
+
+namespace pangolin
+{
+
+namespace
+{
+
+#ifdef PANGO_PACKING_NEON
+// As pixel_packing_ssse3.cpp, with table lookups and per-lane shifts for
+// 10-bit, and de-interleaving loads / stores of byte triples for 12-bit.
+
+size_t Unpack10bitNeon(uint16_t* out, const uint8_t* in, size_t n)
+{
+    static const uint8_t words_[16] = {0,1, 1,2, 2,3, 3,4, 5,6, 6,7, 7,8, 8,9};
+    static const int16_t shifts_[8] = {0,-2,-4,-6, 0,-2,-4,-6};
+    const uint8x16_t words = vld1q_u8(words_);
+    const int16x8_t shifts = vld1q_s16(shifts_);
+    const uint16x8_t mask = vdupq_n_u16(0x03FF);
+
+    const size_t bytes = PackedBytes(10, n);
+    const size_t groups = bytes < 16 ? 0 : std::min(n / 8, (bytes - 16) / 10 + 1);
+    for(size_t g=0; g < groups; ++g) {
+        const uint16x8_t v = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(in + 10*g), words));
+        vst1q_u16(out + 8*g, vandq_u16(vshlq_u16(v, shifts), mask));
+    }
+    return 8*groups;
+}
+
+size_t Unpack12bitNeon(uint16_t* out, const uint8_t* in, size_t n)
+{
+    const size_t groups = n / 16;
+    for(size_t g=0; g < groups; ++g) {
+        const uint8x8x3_t b = vld3_u8(in + 24*g);
+        uint16x8x2_t s;
+        s.val[0] = vorrq_u16(vmovl_u8(b.val[0]), vshlq_n_u16(vmovl_u8(vand_u8(b.val[1], vdup_n_u8(0x0F))), 8));
+        s.val[1] = vorrq_u16(vmovl_u8(vshr_n_u8(b.val[1], 4)), vshlq_n_u16(vmovl_u8(b.val[2]), 4));
+        vst2q_u16(out + 16*g, s);
+    }
+    return 16*groups;
+}
+
+size_t Pack10bitNeon(uint8_t* out, const uint16_t* in, size_t n)
+{
+    static const uint8_t bytes_[16] = {0,1,2,3,4, 8,9,10,11,12, 255,255,255,255,255,255};
+    const uint8x16_t bytes = vld1q_u8(bytes_);
+    const uint16x8_t mask = vdupq_n_u16(0x03FF);
+
+    const size_t groups = n / 8;
+    for(size_t g=0; g < groups; ++g) {
+        const uint32x4_t d = vreinterpretq_u32_u16(vandq_u16(vld1q_u16(in + 8*g), mask));
+        const uint32x4_t p = vorrq_u32(vandq_u32(d, vdupq_n_u32(0xFFFF)), vshlq_n_u32(vshrq_n_u32(d, 16), 10));
+        const uint64x2_t q = vreinterpretq_u64_u32(p);
+        const uint64x2_t r = vorrq_u64(vandq_u64(q, vdupq_n_u64(0xFFFFFFFFull)), vshlq_n_u64(vshrq_n_u64(q, 32), 20));
+        const uint8x16_t b = vqtbl1q_u8(vreinterpretq_u8_u64(r), bytes);
+        uint8_t* o = out + 10*g;
+        vst1_u8(o, vget_low_u8(b));
+        const uint16_t tail = vgetq_lane_u16(vreinterpretq_u16_u8(b), 4);
+        std::memcpy(o + 8, &tail, 2);
+    }
+    return 8*groups;
+}
+
+size_t Pack12bitNeon(uint8_t* out, const uint16_t* in, size_t n)
+{
+    const uint16x8_t mask = vdupq_n_u16(0x0FFF);
+
+    const size_t groups = n / 16;
+    for(size_t g=0; g < groups; ++g) {
+        const uint16x8x2_t s = vld2q_u16(in + 16*g);
+        const uint16x8_t a = vandq_u16(s.val[0], mask);
+        const uint16x8_t b = vandq_u16(s.val[1], mask);
+        uint8x8x3_t o;
+        o.val[0] = vmovn_u16(a);
+        o.val[1] = vmovn_u16(vorrq_u16(vshrq_n_u16(a, 8), vshlq_n_u16(b, 4)));
+        o.val[2] = vmovn_u16(vshrq_n_u16(b, 4));
+        vst3_u8(out + 24*g, o);
+    }
+    return 16*groups;
+}
+#endif // PANGO_PACKING_NEON
+
+size_t None(uint16_t*, const uint8_t*, size_t) { return 0; }
+size_t None(uint8_t*, const uint16_t*, size_t) { return 0; }
+
+// Widest kernels supported by the running CPU
+struct PackingKernels
+{
+    size_t (*unpack10)(uint16_t*, const uint8_t*, size_t);
+    size_t (*unpack12)(uint16_t*, const uint8_t*, size_t);
+    size_t (*pack10)(uint8_t*, const uint16_t*, size_t);
+    size_t (*pack12)(uint8_t*, const uint16_t*, size_t);
+};
+
+PackingKernels SelectKernels()
+{
+    if(CpuHasAvx2()) {
+        return {Unpack10bitAvx2, Unpack12bitAvx2, Pack10bitAvx2, Pack12bitAvx2};
+    }else if(CpuHasSsse3()) {
+        return {Unpack10bitSsse3, Unpack12bitSsse3, Pack10bitSsse3, Pack12bitSsse3};
+    }
+#ifdef PANGO_PACKING_NEON
+    return {Unpack10bitNeon, Unpack12bitNeon, Pack10bitNeon, Pack12bitNeon};
+#else
+    return {None, None, None, None};
+#endif
+}
+
+const PackingKernels& Kernels()
+{
+    static const PackingKernels kernels = SelectKernels();
+    return kernels;
+}
+
+}
+
+void Unpack10bit(uint16_t* out, const uint8_t* in, size_t n)
+{
+    size_t i = Kernels().unpack10(out, in, n);
+    in += PackedBytes(10, i);
+
+    for(; i+4 <= n; i += 4) {
+        uint64_t val = *(in++);
+        val |= uint64_t(*(in++)) << 8;
+        val |= uint64_t(*(in++)) << 16;
+        val |= uint64_t(*(in++)) << 24;
+        val |= uint64_t(*(in++)) << 32;
+        out[i+0] = uint16_t( val & 0x00000003FF);
+        out[i+1] = uint16_t((val & 0x00000FFC00) >> 10);
+        out[i+2] = uint16_t((val & 0x003FF00000) >> 20);
+        out[i+3] = uint16_t((val & 0xFFC0000000) >> 30);
+    }
+
+    // Partial group: sample j starts at bit 2j of byte j
+    for(size_t j=0; i < n; ++i, ++j) {
+        out[i] = uint16_t(((in[j] | uint32_t(in[j+1]) << 8) >> (2*j)) & 0x03FF);
+    }
+}
+
+void Unpack12bit(uint16_t* out, const uint8_t* in, size_t n)
+{
+    size_t i = Kernels().unpack12(out, in, n);
+    in += PackedBytes(12, i);
+
+    for(; i+2 <= n; i += 2) {
+        uint32_t val = *(in++);
+        val |= uint32_t(*(in++)) << 8;
+        val |= uint32_t(*(in++)) << 16;
+        out[i+0] = uint16_t( val & 0x000FFF);
+        out[i+1] = uint16_t((val & 0xFFF000) >> 12);
+    }
+
+    if(i < n) {
+        // Odd count: last sample occupies the final one and a half bytes
+        out[i] = uint16_t((in[0] | uint32_t(in[1]) << 8) & 0x000FFF);
+    }
+}
+
+void Pack10bit(uint8_t* out, const uint16_t* in, size_t n)
+{
+    size_t i = Kernels().pack10(out, in, n);
+    out += PackedBytes(10, i);
+
+    for(; i+4 <= n; i += 4) {
+        uint64_t val = (in[i+0] & 0x00000003FF);
+        val |= uint64_t(in[i+1] & 0x00000003FF) << 10;
+        val |= uint64_t(in[i+2] & 0x00000003FF) << 20;
+        val |= uint64_t(in[i+3] & 0x00000003FF) << 30;
+        *(out++) = uint8_t( val & 0x00000000FF);
+        *(out++) = uint8_t((val & 0x000000FF00) >> 8);
+        *(out++) = uint8_t((val & 0x0000FF0000) >> 16);
+        *(out++) = uint8_t((val & 0x00FF000000) >> 24);
+        *(out++) = uint8_t((val & 0xFF00000000) >> 32);
+    }
+
+    if(i < n) {
+        // Partial group, written only up to its last used byte
+        uint64_t val = 0;
+        for(size_t j=0; i+j < n; ++j) {
+            val |= uint64_t(in[i+j] & 0x03FF) << (10*j);
+        }
+        for(size_t b=0; b < PackedBytes(10, n-i); ++b) {
+            *(out++) = uint8_t(val >> (8*b));
+        }
+    }
+}
+
+void Pack12bit(uint8_t* out, const uint16_t* in, size_t n)
+{
+    size_t i = Kernels().pack12(out, in, n);
+    out += PackedBytes(12, i);
+
+    for(; i+2 <= n; i += 2) {
+        uint32_t val = (in[i+0] & 0x00000FFF);
+        val |= uint32_t(in[i+1] & 0x00000FFF) << 12;
+        *(out++) = uint8_t( val & 0x000000FF);
+        *(out++) = uint8_t((val & 0x0000FF00) >> 8);
+        *(out++) = uint8_t((val & 0x00FF0000) >> 16);
+    }
+
+    if(i < n) {
+        // Odd count: last sample occupies the final one and a half bytes
+        *(out++) = uint8_t(in[i] & 0x00FF);
+        *(out++) = uint8_t((in[i] & 0x0F00) >> 8);
+    }
+}
+
+}
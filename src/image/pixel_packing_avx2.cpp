@@ -0,0 +1,147 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Built with AVX2 code generation where the compiler supports it. Only called
+// after CpuHasAvx2() has confirmed the running CPU can execute it. These
+// follow pixel_packing_ssse3.cpp, with each 128-bit lane handling one of its
+// groups.
+
+#include "pixel_packing_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+
+namespace pangolin
+{
+
+#ifdef __AVX2__
+
+namespace
+{
+
+// Number of whole groups of group_samples samples (group_bytes packed) for
+// which both 16-byte half loads stay within the input.
+inline size_t UnpackGroups(size_t bits, size_t n, size_t group_samples, size_t group_bytes)
+{
+    const size_t bytes = PackedBytes(bits, n);
+    const size_t reach = group_bytes/2 + 16;
+    return bytes < reach ? 0 : std::min(n / group_samples, (bytes - reach) / group_bytes + 1);
+}
+
+// Bytes [p, p+16) in the low lane and [p+offset, p+offset+16) in the high.
+inline __m256i LoadHalves(const uint8_t* p, size_t offset)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + offset)), 1);
+}
+
+}
+
+size_t Unpack10bitAvx2(uint16_t* out, const uint8_t* in, size_t n)
+{
+    const __m256i words = _mm256_setr_epi8(0,1, 1,2, 2,3, 3,4, 5,6, 6,7, 7,8, 8,9, 0,1, 1,2, 2,3, 3,4, 5,6, 6,7, 7,8, 8,9);
+    const __m256i align = _mm256_setr_epi16(64,16,4,1, 64,16,4,1, 64,16,4,1, 64,16,4,1);
+
+    const size_t groups = UnpackGroups(10, n, 16, 20);
+    for(size_t g=0; g < groups; ++g) {
+        const __m256i v = _mm256_shuffle_epi8(LoadHalves(in + 20*g, 10), words);
+        _mm256_storeu_si256((__m256i*)(out + 16*g), _mm256_srli_epi16(_mm256_mullo_epi16(v, align), 6));
+    }
+    return 16*groups;
+}
+
+size_t Unpack12bitAvx2(uint16_t* out, const uint8_t* in, size_t n)
+{
+    const __m256i words = _mm256_setr_epi8(0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11, 0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11);
+    const __m256i even = _mm256_set1_epi32(0x00000FFF);
+    const __m256i odd = _mm256_set1_epi32((int)0xFFFF0000);
+
+    const size_t groups = UnpackGroups(12, n, 16, 24);
+    for(size_t g=0; g < groups; ++g) {
+        const __m256i v = _mm256_shuffle_epi8(LoadHalves(in + 24*g, 12), words);
+        const __m256i s = _mm256_or_si256(_mm256_and_si256(v, even), _mm256_and_si256(_mm256_srli_epi16(v, 4), odd));
+        _mm256_storeu_si256((__m256i*)(out + 16*g), s);
+    }
+    return 16*groups;
+}
+
+size_t Pack10bitAvx2(uint8_t* out, const uint16_t* in, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x03FF);
+    const __m256i pair = _mm256_set1_epi32((1024 << 16) | 1);
+    const __m256i low = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i bytes = _mm256_setr_epi8(0,1,2,3,4, 8,9,10,11,12, -1,-1,-1,-1,-1,-1, 0,1,2,3,4, 8,9,10,11,12, -1,-1,-1,-1,-1,-1);
+
+    const size_t groups = n / 16;
+    for(size_t g=0; g < groups; ++g) {
+        const __m256i p = _mm256_madd_epi16(_mm256_and_si256(_mm256_loadu_si256((const __m256i*)(in + 16*g)), mask), pair);
+        const __m256i q = _mm256_or_si256(_mm256_and_si256(p, low), _mm256_slli_epi64(_mm256_srli_epi64(p, 32), 20));
+        const __m256i b = _mm256_shuffle_epi8(q, bytes);
+        const __m128i b0 = _mm256_castsi256_si128(b);
+        const __m128i b1 = _mm256_extracti128_si256(b, 1);
+        uint8_t* o = out + 20*g;
+        uint16_t tail;
+        _mm_storel_epi64((__m128i*)o, b0);
+        tail = (uint16_t)_mm_extract_epi16(b0, 4);
+        std::memcpy(o + 8, &tail, 2);
+        _mm_storel_epi64((__m128i*)(o + 10), b1);
+        tail = (uint16_t)_mm_extract_epi16(b1, 4);
+        std::memcpy(o + 18, &tail, 2);
+    }
+    return 16*groups;
+}
+
+size_t Pack12bitAvx2(uint8_t* out, const uint16_t* in, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x0FFF);
+    const __m256i pair = _mm256_set1_epi32((4096 << 16) | 1);
+    const __m256i bytes = _mm256_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1, 0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    // Joins the 12 used bytes of each lane
+    const __m256i join = _mm256_setr_epi32(0,1,2, 4,5,6, 7,7);
+
+    const size_t groups = n / 16;
+    for(size_t g=0; g < groups; ++g) {
+        const __m256i p = _mm256_madd_epi16(_mm256_and_si256(_mm256_loadu_si256((const __m256i*)(in + 16*g)), mask), pair);
+        const __m256i b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p, bytes), join);
+        uint8_t* o = out + 24*g;
+        _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(b));
+        _mm_storel_epi64((__m128i*)(o + 16), _mm256_extracti128_si256(b, 1));
+    }
+    return 16*groups;
+}
+
+#else // __AVX2__
+
+size_t Unpack10bitAvx2(uint16_t*, const uint8_t*, size_t) { return 0; }
+size_t Unpack12bitAvx2(uint16_t*, const uint8_t*, size_t) { return 0; }
+size_t Pack10bitAvx2(uint8_t*, const uint16_t*, size_t) { return 0; }
+size_t Pack12bitAvx2(uint8_t*, const uint16_t*, size_t) { return 0; }
+
+#endif // __AVX2__
+
+}
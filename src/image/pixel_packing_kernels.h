@@ -0,0 +1,48 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Instruction set specific kernels behind pixel_packing.h. Each converts a
+// prefix of the n samples and returns how many it converted, leaving the
+// remainder to the portable code in pixel_packing.cpp. They return 0 when
+// the library was built without support for their instruction set.
+
+#pragma once
+
+#include <pangolin/image/pixel_packing.h>
+
+namespace pangolin
+{
+
+size_t Unpack10bitSsse3(uint16_t* out, const uint8_t* in, size_t n);
+size_t Unpack12bitSsse3(uint16_t* out, const uint8_t* in, size_t n);
+size_t Pack10bitSsse3(uint8_t* out, const uint16_t* in, size_t n);
+size_t Pack12bitSsse3(uint8_t* out, const uint16_t* in, size_t n);
+
+size_t Unpack10bitAvx2(uint16_t* out, const uint8_t* in, size_t n);
+size_t Unpack12bitAvx2(uint16_t* out, const uint8_t* in, size_t n);
+size_t Pack10bitAvx2(uint8_t* out, const uint16_t* in, size_t n);
+size_t Pack12bitAvx2(uint8_t* out, const uint16_t* in, size_t n);
+
+}
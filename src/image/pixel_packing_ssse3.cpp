@@ -0,0 +1,139 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Built with SSSE3 code generation where the compiler supports it. Only called
+// after CpuHasSsse3() has confirmed the running CPU can execute it.
+
+#include "pixel_packing_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSSE3__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#   include <tmmintrin.h>
+#   define PANGO_PACKING_SSSE3
+#endif
+
+namespace pangolin
+{
+
+#ifdef PANGO_PACKING_SSSE3
+
+namespace
+{
+
+// Number of whole groups of group_samples samples (group_bytes packed) that
+// can be read with 16-byte loads without passing the end of the input.
+inline size_t UnpackGroups(size_t bits, size_t n, size_t group_samples, size_t group_bytes)
+{
+    const size_t bytes = PackedBytes(bits, n);
+    return bytes < 16 ? 0 : std::min(n / group_samples, (bytes - 16) / group_bytes + 1);
+}
+
+}
+
+size_t Unpack10bitSsse3(uint16_t* out, const uint8_t* in, size_t n)
+{
+    // Two groups of 4 samples in 5 bytes. Sample i of a group is bits
+    // [2i, 2i+10) of the 16-bit word at byte i, extracted by multiplying
+    // it to the top of the word and shifting back down.
+    const __m128i words = _mm_setr_epi8(0,1, 1,2, 2,3, 3,4, 5,6, 6,7, 7,8, 8,9);
+    const __m128i align = _mm_setr_epi16(64,16,4,1, 64,16,4,1);
+
+    const size_t groups = UnpackGroups(10, n, 8, 10);
+    for(size_t g=0; g < groups; ++g) {
+        const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 10*g)), words);
+        _mm_storeu_si128((__m128i*)(out + 8*g), _mm_srli_epi16(_mm_mullo_epi16(v, align), 6));
+    }
+    return 8*groups;
+}
+
+size_t Unpack12bitSsse3(uint16_t* out, const uint8_t* in, size_t n)
+{
+    // Four pairs of samples in 3 bytes. Even samples are the low 12 bits of
+    // the word at byte 0 of the pair, odd samples the high 12 of byte 1's.
+    const __m128i words = _mm_setr_epi8(0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11);
+    const __m128i even = _mm_set1_epi32(0x00000FFF);
+    const __m128i odd = _mm_set1_epi32((int)0xFFFF0000);
+
+    const size_t groups = UnpackGroups(12, n, 8, 12);
+    for(size_t g=0; g < groups; ++g) {
+        const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 12*g)), words);
+        const __m128i s = _mm_or_si128(_mm_and_si128(v, even), _mm_and_si128(_mm_srli_epi16(v, 4), odd));
+        _mm_storeu_si128((__m128i*)(out + 8*g), s);
+    }
+    return 8*groups;
+}
+
+size_t Pack10bitSsse3(uint8_t* out, const uint16_t* in, size_t n)
+{
+    // Combine sample pairs into 20-bit dwords, dword pairs into 40-bit
+    // qwords, then gather the 5 used bytes of each qword.
+    const __m128i mask = _mm_set1_epi16(0x03FF);
+    const __m128i pair = _mm_set1_epi32((1024 << 16) | 1);
+    const __m128i bytes = _mm_setr_epi8(0,1,2,3,4, 8,9,10,11,12, -1,-1,-1,-1,-1,-1);
+
+    const size_t groups = n / 8;
+    for(size_t g=0; g < groups; ++g) {
+        const __m128i p = _mm_madd_epi16(_mm_and_si128(_mm_loadu_si128((const __m128i*)(in + 8*g)), mask), pair);
+        const __m128i q = _mm_or_si128(_mm_and_si128(p, _mm_set_epi32(0, -1, 0, -1)), _mm_slli_epi64(_mm_srli_epi64(p, 32), 20));
+        const __m128i b = _mm_shuffle_epi8(q, bytes);
+        uint8_t* o = out + 10*g;
+        _mm_storel_epi64((__m128i*)o, b);
+        const uint16_t tail = (uint16_t)_mm_extract_epi16(b, 4);
+        std::memcpy(o + 8, &tail, 2);
+    }
+    return 8*groups;
+}
+
+size_t Pack12bitSsse3(uint8_t* out, const uint16_t* in, size_t n)
+{
+    // Combine sample pairs into 24-bit dwords and gather their used bytes.
+    const __m128i mask = _mm_set1_epi16(0x0FFF);
+    const __m128i pair = _mm_set1_epi32((4096 << 16) | 1);
+    const __m128i bytes = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+
+    const size_t groups = n / 8;
+    for(size_t g=0; g < groups; ++g) {
+        const __m128i p = _mm_madd_epi16(_mm_and_si128(_mm_loadu_si128((const __m128i*)(in + 8*g)), mask), pair);
+        const __m128i b = _mm_shuffle_epi8(p, bytes);
+        uint8_t* o = out + 12*g;
+        _mm_storel_epi64((__m128i*)o, b);
+        const uint32_t tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(b, 8));
+        std::memcpy(o + 8, &tail, 4);
+    }
+    return 8*groups;
+}
+
+#else // PANGO_PACKING_SSSE3
+
+size_t Unpack10bitSsse3(uint16_t*, const uint8_t*, size_t) { return 0; }
+size_t Unpack12bitSsse3(uint16_t*, const uint8_t*, size_t) { return 0; }
+size_t Pack10bitSsse3(uint8_t*, const uint16_t*, size_t) { return 0; }
+size_t Pack12bitSsse3(uint8_t*, const uint16_t*, size_t) { return 0; }
+
+#endif // PANGO_PACKING_SSSE3
+
+}
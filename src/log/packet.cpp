@@ -1,10 +1,12 @@
 #include <pangolin/log/packet.h>
 
+#include <algorithm>
+
 namespace pangolin {
 
 
 Packet::Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& lock, std::vector<PacketStreamSource>& srcs)
-    : _stream(s), lock(std::move(lock))
+    : _stream(s), lock(std::move(lock)), _compressed(false), _data_read(0)
 {
     ParsePacketHeader(s, srcs);
 }
@@ -12,9 +14,11 @@ Packet::Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& lock, s
 Packet::Packet(Packet&& o)
     : src(o.src), time(o.time), size(o.size), sequence_num(o.sequence_num),
       meta(std::move(o.meta)), frame_streampos(o.frame_streampos), _stream(o._stream),
-      lock(std::move(o.lock)), data_streampos(o.data_streampos), _data_len(o._data_len)
+      lock(std::move(o.lock)), data_streampos(o.data_streampos), _data_len(o._data_len),
+      _compressed(o._compressed), _data(std::move(o._data)), _data_read(o._data_read)
 {
     o._data_len = 0;
+    o._compressed = false;
 }
 
 Packet::~Packet()
@@ -24,6 +28,9 @@ Packet::~Packet()
 
 size_t Packet::BytesRead() const
 {
+    if(_compressed) {
+        return _data_read;
+    }
     return _stream.tellg() - data_streampos;
 }
 
@@ -36,6 +43,30 @@ int Packet::BytesRemaining() const
     }
 }
 
+const unsigned char* Packet::ReadDirect(size_t len)
+{
+    if(len > static_cast<size_t>(BytesRemaining())) {
+        return nullptr;
+    }
+    if(_compressed) {
+        const unsigned char* p = _data.data() + _data_read;
+        _data_read += len;
+        return p;
+    }
+    return reinterpret_cast<const unsigned char*>(_stream.readDirect(len));
+}
+
+size_t Packet::Read(char* target, size_t len)
+{
+    len = std::min(len, static_cast<size_t>(std::max(BytesRemaining(), 0)));
+    if(_compressed) {
+        std::copy(_data.begin() + _data_read, _data.begin() + _data_read + len, target);
+        _data_read += len;
+        return len;
+    }
+    return _stream.read(target, len);
+}
+
 void Packet::ParsePacketHeader(PacketStream& s, std::vector<PacketStreamSource>& srcs)
 {
     size_t json_src = -1;
@@ -45,7 +76,24 @@ void Packet::ParsePacketHeader(PacketStream& s, std::vector<PacketStreamSource>&
     {
         s.readTag(TAG_SRC_JSON);
         json_src = s.readUINT();
-        picojson::parse(meta, s);
+        picojson::value json;
+        picojson::parse(json, s);
+        meta = PacketMeta(std::move(json));
+    }
+    else if (s.peekTag() == TAG_SRC_META)
+    {
+        // Binary metadata is only decoded if it is accessed.
+        s.readTag(TAG_SRC_META);
+        json_src = s.readUINT();
+        const size_t schema_pos = s.readUINT();
+        const size_t len = s.readUINT();
+        // len is untrusted: don't allocate more than the stream holds.
+        if (!s.good() || len > s.remaining())
+            throw std::runtime_error("Bad frame metadata. Stream may be corrupt.");
+        std::string encoded(len, '\0');
+        if (s.read(&encoded[0], len) != len)
+            throw std::runtime_error("Truncated frame metadata.");
+        meta = PacketMeta(s.metaSchema(schema_pos), std::move(encoded));
     }
 
     s.readTag(TAG_SRC_PACKET);
@@ -57,17 +105,44 @@ void Packet::ParsePacketHeader(PacketStream& s, std::vector<PacketStreamSource>&
     PacketStreamSource& src_packet = srcs[src];
 
     size = src_packet.data_size_bytes;
-    if (!size) {
+    if (!size || !src_packet.data_compression.empty()) {
         size = s.readUINT();
     }
     sequence_num = src_packet.next_packet_id++;
 
+    if (!src_packet.data_compression.empty()) {
+        // Compressed packets are read in full and decompressed up front.
+        std::vector<unsigned char> copy;
+        const unsigned char* stored = reinterpret_cast<const unsigned char*>(s.readDirect(size));
+        if (!stored) {
+            // size is untrusted: don't allocate more than the stream holds.
+            if (size > s.remaining())
+                throw std::runtime_error("Truncated compressed packet.");
+            copy.resize(size);
+            if (!s.good() || s.read(reinterpret_cast<char*>(copy.data()), size) != size)
+                throw std::runtime_error("Truncated compressed packet.");
+            stored = copy.data();
+        }
+        s.decompressor(src_packet.data_compression).Decompress(stored, size, _data, [&s](uint64_t pos){
+            return s.dictionary(pos);
+        });
+        if (src_packet.data_size_bytes && _data.size() != static_cast<size_t>(src_packet.data_size_bytes))
+            throw std::runtime_error("Compressed packet has the wrong size for its source. Stream may be corrupt.");
+        _compressed = true;
+        size = _data.size();
+    }
+
     _data_len = size;
     data_streampos = s.tellg();
 }
 
 void Packet::ReadRemaining()
 {
+    // Compressed packets were consumed from the stream in full.
+    if(_compressed) {
+        return;
+    }
+
     int bytes_left = BytesRemaining();
 
     while(bytes_left > 0 && Stream().good()) {
@@ -0,0 +1,388 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/log/packet_compression.h>
+#include <pangolin/log/packetstream.h>
+#include <pangolin/log/packetstream_writer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#  include <zdict.h>
+#endif
+
+#ifdef HAVE_LZ4
+#  include <lz4.h>
+#endif
+
+namespace pangolin {
+
+namespace {
+
+enum class CodecType { none, zstd, lz4 };
+
+enum StoreMethod : unsigned char {
+    STORE_RAW = 0,
+    STORE_COMPRESSED = 1,
+    STORE_COMPRESSED_DICT = 2
+};
+
+// Dictionaries are trained from up to this many leading packets or bytes
+// of each source.
+const size_t max_sample_packets = 1024;
+const size_t max_sample_bytes = 1 << 20;
+const size_t max_dictionary_bytes = 16 << 10;
+
+// Refuse to allocate for implausible sizes read from a corrupt stream.
+const uint64_t max_packet_bytes = uint64_t(1) << 32;
+
+CodecType ParseCodec(const std::string& codec)
+{
+#ifdef HAVE_ZSTD
+    if(codec == "zstd") return CodecType::zstd;
+#endif
+#ifdef HAVE_LZ4
+    if(codec == "lz4") return CodecType::lz4;
+#endif
+    throw std::invalid_argument("Packet compression codec '" + codec + "' is not supported by this build.");
+}
+
+}
+
+struct PacketCompressor::Codec
+{
+    Codec(CodecType type)
+        : type(type)
+    {
+#ifdef HAVE_ZSTD
+        zctx = nullptr;
+        zdict = nullptr;
+        if(type == CodecType::zstd) {
+            // The packet header holds the data size and dictionary, so leave
+            // them out of the zstd frame: it matters for small packets.
+            zctx = ZSTD_createCCtx();
+#if ZSTD_VERSION_NUMBER >= 10400
+            ZSTD_CCtx_setParameter(zctx, ZSTD_c_compressionLevel, level);
+            ZSTD_CCtx_setParameter(zctx, ZSTD_c_contentSizeFlag, 0);
+            ZSTD_CCtx_setParameter(zctx, ZSTD_c_dictIDFlag, 0);
+#endif
+        }
+#endif
+    }
+
+    ~Codec()
+    {
+#ifdef HAVE_ZSTD
+        ZSTD_freeCDict(zdict);
+        ZSTD_freeCCtx(zctx);
+#endif
+    }
+
+    void Prepare(const std::string& dictionary)
+    {
+        // Unused without any codecs built in.
+        PANGOLIN_UNUSED(dictionary);
+#ifdef HAVE_ZSTD
+        if(type == CodecType::zstd) {
+            zdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+        }
+#endif
+#ifdef HAVE_LZ4
+        if(type == CodecType::lz4) {
+            LZ4_resetStream(&lz4_dict);
+            LZ4_loadDict(&lz4_dict, dictionary.data(), static_cast<int>(dictionary.size()));
+        }
+#endif
+    }
+
+    // Compress src to dst, returning the compressed size or 0 on failure.
+    size_t Compress(const std::string& src, char* dst, size_t capacity, bool with_dictionary)
+    {
+        // Unused without any codecs built in.
+        PANGOLIN_UNUSED(src);
+        PANGOLIN_UNUSED(dst);
+        PANGOLIN_UNUSED(capacity);
+        PANGOLIN_UNUSED(with_dictionary);
+#ifdef HAVE_ZSTD
+        if(type == CodecType::zstd) {
+#if ZSTD_VERSION_NUMBER >= 10400
+            ZSTD_CCtx_refCDict(zctx, with_dictionary ? zdict : nullptr);
+            const size_t r = ZSTD_compress2(zctx, dst, capacity, src.data(), src.size());
+#else
+            // Before zstd 1.4 the frame parameters can't be set through the
+            // stable API, so these frames also carry the size and dict id.
+            const size_t r = with_dictionary
+                ? ZSTD_compress_usingCDict(zctx, dst, capacity, src.data(), src.size(), zdict)
+                : ZSTD_compressCCtx(zctx, dst, capacity, src.data(), src.size(), level);
+#endif
+            return ZSTD_isError(r) ? 0 : r;
+        }
+#endif
+#ifdef HAVE_LZ4
+        if(type == CodecType::lz4) {
+            const int n = static_cast<int>(src.size());
+            const int cap = static_cast<int>(std::min<size_t>(capacity, LZ4_MAX_INPUT_SIZE));
+            int r;
+            if(with_dictionary) {
+                // Each packet is decoded independently, so start every one
+                // from the freshly loaded dictionary state.
+                std::memcpy(&lz4_work, &lz4_dict, sizeof(LZ4_stream_t));
+                r = LZ4_compress_fast_continue(&lz4_work, src.data(), dst, n, cap, 1);
+            }else{
+                r = LZ4_compress_default(src.data(), dst, n, cap);
+            }
+            return r > 0 ? size_t(r) : 0;
+        }
+#endif
+        return 0;
+    }
+
+    size_t Bound(size_t size) const
+    {
+#ifdef HAVE_ZSTD
+        if(type == CodecType::zstd) return ZSTD_compressBound(size);
+#endif
+#ifdef HAVE_LZ4
+        if(type == CodecType::lz4) return LZ4_compressBound(static_cast<int>(size));
+#endif
+        return size;
+    }
+
+    CodecType type;
+
+#ifdef HAVE_ZSTD
+    static const int level = 3;
+    ZSTD_CCtx* zctx;
+    ZSTD_CDict* zdict;
+#endif
+#ifdef HAVE_LZ4
+    LZ4_stream_t lz4_dict;
+    LZ4_stream_t lz4_work;
+#endif
+};
+
+PacketCompressor::PacketCompressor(const std::string& codec)
+    : _codec(new Codec(ParseCodec(codec))), _dictionary_pos(0), _trained(false)
+{
+}
+
+PacketCompressor::~PacketCompressor()
+{
+}
+
+bool PacketCompressor::Supported(const std::string& codec)
+{
+    try {
+        ParseCodec(codec);
+        return true;
+    }catch(const std::invalid_argument&) {
+        return false;
+    }
+}
+
+void PacketCompressor::AddSample(const std::string& data)
+{
+    _samples.append(data);
+    _sample_sizes.push_back(data.size());
+    if(_sample_sizes.size() >= max_sample_packets || _samples.size() >= max_sample_bytes) {
+        TrainDictionary();
+    }
+}
+
+void PacketCompressor::TrainDictionary()
+{
+    _trained = true;
+
+#ifdef HAVE_ZSTD
+    if(_codec->type == CodecType::zstd) {
+        std::string dict(std::min(max_dictionary_bytes, _samples.size() / 4), '\0');
+        if(!dict.empty()) {
+            const size_t r = ZDICT_trainFromBuffer(&dict[0], dict.size(), _samples.data(), _sample_sizes.data(), static_cast<unsigned>(_sample_sizes.size()));
+            // Training fails for too few or too dissimilar samples, in
+            // which case packets are compressed individually.
+            if(!ZDICT_isError(r)) {
+                dict.resize(r);
+                _dictionary.swap(dict);
+            }
+        }
+    }
+#endif
+#ifdef HAVE_LZ4
+    if(_codec->type == CodecType::lz4) {
+        // LZ4 dictionaries are simply preceding data: use the latest samples.
+        const size_t n = std::min<size_t>(64 << 10, _samples.size());
+        _dictionary = _samples.substr(_samples.size() - n);
+    }
+#endif
+
+    if(!_dictionary.empty()) {
+        _codec->Prepare(_dictionary);
+    }
+
+    std::string().swap(_samples);
+    std::vector<size_t>().swap(_sample_sizes);
+}
+
+void PacketCompressor::Compress(const std::pair<const char*,size_t>* parts, size_t num_parts, std::string& out)
+{
+    _data.clear();
+    for(size_t i=0; i < num_parts; ++i) {
+        _data.append(parts[i].first, parts[i].second);
+    }
+
+    // A dictionary trained from this packet only applies to later packets.
+    const bool with_dictionary = !_dictionary.empty() && _dictionary_pos;
+    if(!_trained) AddSample(_data);
+
+    const size_t start = out.size();
+    out.push_back(char(with_dictionary ? STORE_COMPRESSED_DICT : STORE_COMPRESSED));
+    if(with_dictionary) appendCompressedUnsignedInt(out, _dictionary_pos);
+    appendCompressedUnsignedInt(out, _data.size());
+
+    const size_t header = out.size();
+    out.resize(header + _codec->Bound(_data.size()));
+    const size_t n = _codec->Compress(_data, &out[header], out.size() - header, with_dictionary);
+
+    if(n && header + n < start + 1 + _data.size()) {
+        out.resize(header + n);
+    }else{
+        out.resize(start);
+        out.push_back(char(STORE_RAW));
+        out.append(_data);
+    }
+}
+
+struct PacketDecompressor::Codec
+{
+    Codec(CodecType type)
+        : type(type)
+    {
+#ifdef HAVE_ZSTD
+        zctx = nullptr;
+        if(type == CodecType::zstd) zctx = ZSTD_createDCtx();
+#endif
+    }
+
+    ~Codec()
+    {
+#ifdef HAVE_ZSTD
+        ZSTD_freeDCtx(zctx);
+#endif
+    }
+
+    // Decompress exactly capacity bytes into dst, returning false on error.
+    bool Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity, PacketDictionary* dictionary)
+    {
+        // Unused without any codecs built in.
+        PANGOLIN_UNUSED(src);
+        PANGOLIN_UNUSED(size);
+        PANGOLIN_UNUSED(dst);
+        PANGOLIN_UNUSED(capacity);
+        PANGOLIN_UNUSED(dictionary);
+#ifdef HAVE_ZSTD
+        if(type == CodecType::zstd) {
+            size_t r;
+            if(dictionary) {
+                if(!dictionary->_prepared) {
+                    const std::string& d = dictionary->Data();
+                    ZSTD_DDict* ddict = ZSTD_createDDict(d.data(), d.size());
+                    if(!ddict) return false;
+                    dictionary->_prepared = std::shared_ptr<void>(ddict, [](void* p){ ZSTD_freeDDict(static_cast<ZSTD_DDict*>(p)); });
+                }
+                r = ZSTD_decompress_usingDDict(zctx, dst, capacity, src, size, static_cast<const ZSTD_DDict*>(dictionary->_prepared.get()));
+            }else{
+                r = ZSTD_decompressDCtx(zctx, dst, capacity, src, size);
+            }
+            return !ZSTD_isError(r) && r == capacity;
+        }
+#endif
+#ifdef HAVE_LZ4
+        if(type == CodecType::lz4) {
+            if(size > size_t(LZ4_MAX_INPUT_SIZE) || capacity > size_t(LZ4_MAX_INPUT_SIZE)) return false;
+            const char* s = reinterpret_cast<const char*>(src);
+            char* d = reinterpret_cast<char*>(dst);
+            const int r = dictionary
+                ? LZ4_decompress_safe_usingDict(s, d, int(size), int(capacity), dictionary->Data().data(), int(dictionary->Data().size()))
+                : LZ4_decompress_safe(s, d, int(size), int(capacity));
+            return r >= 0 && size_t(r) == capacity;
+        }
+#endif
+        return false;
+    }
+
+    CodecType type;
+#ifdef HAVE_ZSTD
+    ZSTD_DCtx* zctx;
+#endif
+};
+
+PacketDecompressor::PacketDecompressor(const std::string& codec)
+    : _codec(new Codec(ParseCodec(codec)))
+{
+}
+
+PacketDecompressor::~PacketDecompressor()
+{
+}
+
+void PacketDecompressor::Decompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const DictionaryLookup& dictionary)
+{
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+
+    if(p == end) {
+        throw std::runtime_error("Empty compressed packet. Stream may be corrupt.");
+    }
+
+    const unsigned char method = *p++;
+    if(method == STORE_RAW) {
+        out.assign(p, end);
+        return;
+    }
+
+    uint64_t dict_pos = 0;
+    uint64_t data_size = 0;
+    if( method > STORE_COMPRESSED_DICT ||
+        (method == STORE_COMPRESSED_DICT && !readCompressedUnsignedInt(p, end, dict_pos)) ||
+        !readCompressedUnsignedInt(p, end, data_size) || data_size > max_packet_bytes )
+    {
+        throw std::runtime_error("Bad compressed packet header. Stream may be corrupt.");
+    }
+
+    std::shared_ptr<PacketDictionary> dict;
+    if(method == STORE_COMPRESSED_DICT) {
+        dict = dictionary(dict_pos);
+    }
+
+    out.resize(data_size);
+    if(!_codec->Decompress(p, end - p, out.data(), out.size(), dict.get())) {
+        throw std::runtime_error("Failed to decompress packet. Stream may be corrupt.");
+    }
+}
+
+}
@@ -0,0 +1,272 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/log/packet_index_scan.h>
+#include <pangolin/log/packetstream.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace pangolin {
+
+namespace {
+
+enum class Record { Good, End, Bad };
+
+// Cursor over a record in memory. Reads fail rather than pass the end.
+struct RecordReader
+{
+    const unsigned char* p;
+    const unsigned char* end;
+
+    bool Tag(pangoTagType& tag)
+    {
+        tag = 0;
+        return Bytes(&tag, TAG_LENGTH);
+    }
+
+    bool Bytes(void* out, size_t n)
+    {
+        if(size_t(end - p) < n) return false;
+        std::memcpy(out, p, n);
+        p += n;
+        return true;
+    }
+
+    bool Skip(uint64_t n)
+    {
+        if(uint64_t(end - p) < n) return false;
+        p += n;
+        return true;
+    }
+
+    bool UINT(uint64_t& n)
+    {
+        return readCompressedUnsignedInt(p, end, n);
+    }
+
+    // Records which store their own position can be checked against it.
+    bool SelfPos(uint64_t pos)
+    {
+        uint64_t self;
+        return Bytes(&self, sizeof(uint64_t)) && self == pos;
+    }
+
+    bool Json(picojson::value* out)
+    {
+        const char* first = reinterpret_cast<const char*>(p);
+        const char* last = reinterpret_cast<const char*>(end);
+        std::string err;
+        const char* stop;
+        if(out) {
+            stop = picojson::parse(*out, first, last, &err);
+        }else{
+            picojson::null_parse_context ctx;
+            stop = picojson::_parse(ctx, first, last, &err);
+        }
+        p = reinterpret_cast<const unsigned char*>(stop);
+        return err.empty();
+    }
+};
+
+// Parse the record at pos (see PacketStreamWriter for the layouts). Good
+// records set next to the position following them and, for packets, set
+// is_packet and packet. Source declarations are added to sources.
+Record ParseRecord(
+    const unsigned char* data, size_t size, uint64_t pos, std::vector<PacketStreamSource>& sources,
+    uint64_t& next, bool& is_packet, PacketIndexScan::Entry& packet)
+{
+    RecordReader r = {data + pos, data + size};
+    is_packet = false;
+
+    pangoTagType tag;
+    if(!r.Tag(tag)) return Record::End;
+
+    uint64_t src = uint64_t(-1);
+    uint64_t n;
+
+    switch(tag) {
+    case TAG_PANGO_SYNC:
+        break;
+    case TAG_META_SCHEMA:
+        if(!r.SelfPos(pos) || !r.UINT(src) || !r.UINT(n)) return Record::Bad;
+        for(uint64_t k=0; k < n; ++k) {
+            uint64_t len;
+            if(!r.UINT(len) || !r.Skip(len)) return Record::Bad;
+        }
+        break;
+    case TAG_SRC_DICT:
+        if(!r.SelfPos(pos) || !r.UINT(src) || !r.UINT(n) || !r.Skip(n)) return Record::Bad;
+        break;
+    case TAG_PANGO_CHECKPOINT:
+        if(!r.UINT(n) || !r.Skip(n) || !r.Skip(sizeof(uint64_t)) || !r.SelfPos(pos) || !r.Tag(tag) || tag != TAG_PANGO_CHECKPOINT) {
+            return Record::Bad;
+        }
+        break;
+    case TAG_ADD_SOURCE:
+    {
+        picojson::value json;
+        if(!r.Json(&json) || !r.Skip(1)) return Record::Bad;
+        try {
+            ParsePacketStreamSource(json, sources);
+        }catch(const std::exception&) {
+            return Record::Bad;
+        }
+        break;
+    }
+    case TAG_SRC_JSON:
+    case TAG_SRC_META:
+    case TAG_SRC_PACKET:
+    {
+        // Metadata is part of the packet which must follow it.
+        if(tag == TAG_SRC_JSON) {
+            if(!r.UINT(src) || !r.Json(nullptr) || !r.Tag(tag)) return Record::Bad;
+        }else if(tag == TAG_SRC_META) {
+            if(!r.UINT(src) || !r.UINT(n) || !r.UINT(n) || !r.Skip(n) || !r.Tag(tag)) return Record::Bad;
+        }
+        if(tag != TAG_SRC_PACKET) return Record::Bad;
+
+        int64_t time;
+        uint64_t packet_src;
+        if(!r.Bytes(&time, sizeof(int64_t)) || !r.UINT(packet_src) || packet_src >= sources.size()) return Record::Bad;
+        if(src != uint64_t(-1) && src != packet_src) return Record::Bad;
+
+        const PacketStreamSource& s = sources[packet_src];
+        uint64_t len = uint64_t(s.data_size_bytes);
+        if((!len || !s.data_compression.empty()) && !r.UINT(len)) return Record::Bad;
+        // A packet cut short by the end of the data was never completed.
+        if(!r.Skip(len)) return Record::End;
+
+        is_packet = true;
+        packet.src = packet_src;
+        packet.info.pos = static_cast<std::streamoff>(pos);
+        packet.info.capture_time = time;
+        break;
+    }
+    case TAG_PANGO_TIME_INDEX:
+    case TAG_PANGO_STATS:
+    case TAG_PANGO_INDEX:
+    case TAG_PANGO_FOOTER:
+        return Record::End;
+    default:
+        return Record::Bad;
+    }
+
+    next = uint64_t(r.p - data);
+    return Record::Good;
+}
+
+// Tags a resynchronising scan may start on. Those holding their own position
+// or a source id are unlikely to be matched by chance.
+bool IsAnchor(const unsigned char* p)
+{
+    pangoTagType tag = 0;
+    std::memcpy(&tag, p, TAG_LENGTH);
+    return tag == TAG_SRC_PACKET || tag == TAG_SRC_JSON || tag == TAG_SRC_META ||
+           tag == TAG_META_SCHEMA || tag == TAG_SRC_DICT || tag == TAG_PANGO_CHECKPOINT;
+}
+
+}
+
+PacketIndexScan ScanPacketIndex(
+    const char* chars, size_t size, uint64_t begin, uint64_t end,
+    const std::vector<PacketStreamSource>& sources, bool resync)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(chars);
+
+    PacketIndexScan scan;
+    scan.sources.reserve(sources.size());
+    for(const PacketStreamSource& s : sources) {
+        scan.sources.push_back(s);
+        scan.sources.back().index.clear();
+    }
+
+    uint64_t pos = std::min<uint64_t>(begin, size);
+    uint64_t next;
+    bool is_packet;
+    PacketIndexScan::Entry packet;
+
+    if(resync) {
+        // Find a record which parses and is followed by another.
+        std::vector<PacketStreamSource> trial;
+        for(; pos < end && pos + TAG_LENGTH <= size; ++pos) {
+            if(!IsAnchor(data + pos)) continue;
+            trial = scan.sources;
+            uint64_t after;
+            if(ParseRecord(data, size, pos, trial, next, is_packet, packet) == Record::Good &&
+               ParseRecord(data, size, next, trial, after, is_packet, packet) != Record::Bad) {
+                break;
+            }
+        }
+    }
+
+    scan.status = PacketIndexScan::BadRecord;
+    while(true) {
+        if(pos >= end) {
+            scan.status = PacketIndexScan::RegionEnd;
+            break;
+        }
+        const Record r = ParseRecord(data, size, pos, scan.sources, next, is_packet, packet);
+        if(r != Record::Good) {
+            scan.status = r == Record::End ? PacketIndexScan::DataEnd : PacketIndexScan::BadRecord;
+            break;
+        }
+        scan.records.push_back(pos);
+        if(is_packet) {
+            scan.packets.push_back(packet);
+        }
+        pos = next;
+    }
+
+    scan.end = pos;
+    return scan;
+}
+
+void ParsePacketStreamSource(const picojson::value& json, std::vector<PacketStreamSource>& sources)
+{
+    // Ids are assigned in order, so a new source must come next.
+    const int64_t id = json[pss_src_id].get<int64_t>();
+    if(id < 0 || static_cast<uint64_t>(id) > sources.size()) {
+        throw std::runtime_error("Source id out of sequence. Stream may be corrupt.");
+    }
+
+    const size_t src_id = static_cast<size_t>(id);
+    if(sources.size() == src_id) {
+        sources.emplace_back();
+    }
+
+    PacketStreamSource& pss = sources[src_id];
+    pss.id = src_id;
+    pss.driver = json[pss_src_driver].get<std::string>();
+    pss.uri = json[pss_src_uri].get<std::string>();
+    pss.info = json[pss_src_info];
+    pss.version = json[pss_src_version].get<int64_t>();
+    pss.data_alignment_bytes = json[pss_src_packet][pss_pkt_alignment_bytes].get<int64_t>();
+    pss.data_definitions = json[pss_src_packet][pss_pkt_definitions].get<std::string>();
+    pss.data_size_bytes = json[pss_src_packet][pss_pkt_size_bytes].get<int64_t>();
+    pss.data_compression = json[pss_src_packet].get_value<std::string>(pss_pkt_compression, "");
+}
+
+}
@@ -0,0 +1,201 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/log/packet_meta.h>
+#include <pangolin/log/packetstream.h>
+#include <pangolin/log/packetstream_writer.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace pangolin {
+
+namespace {
+
+enum MetaType : unsigned char
+{
+    meta_null = 0,
+    meta_false,
+    meta_true,
+    meta_int,
+    meta_double,
+    meta_string,
+    meta_array,
+    meta_object
+};
+
+// Deeper nesting than this is taken to be corruption.
+const int meta_max_depth = 64;
+
+void AppendMetaValue(std::string& out, const picojson::value& v)
+{
+    if(v.is<picojson::null>()) {
+        out.push_back(meta_null);
+    }else if(v.is<bool>()) {
+        out.push_back(v.get<bool>() ? meta_true : meta_false);
+    }else if(v.is<int64_t>()) {
+        out.push_back(meta_int);
+        appendCompressedSignedInt(out, v.get<int64_t>());
+    }else if(v.is<double>()) {
+        const double d = v.get<double>();
+        out.push_back(meta_double);
+        out.append(reinterpret_cast<const char*>(&d), sizeof(double));
+    }else if(v.is<std::string>()) {
+        const std::string& s = v.get<std::string>();
+        out.push_back(meta_string);
+        appendCompressedUnsignedInt(out, s.size());
+        out += s;
+    }else if(v.is<picojson::array>()) {
+        const picojson::array& a = v.get<picojson::array>();
+        out.push_back(meta_array);
+        appendCompressedUnsignedInt(out, a.size());
+        for(const auto& e : a) {
+            AppendMetaValue(out, e);
+        }
+    }else{
+        const picojson::object& o = v.get<picojson::object>();
+        out.push_back(meta_object);
+        appendCompressedUnsignedInt(out, o.size());
+        for(const auto& kv : o) {
+            appendCompressedUnsignedInt(out, kv.first.size());
+            out += kv.first;
+            AppendMetaValue(out, kv.second);
+        }
+    }
+}
+
+void ReadMetaString(const unsigned char*& p, const unsigned char* end, std::string& s)
+{
+    uint64_t len;
+    if(!readCompressedUnsignedInt(p, end, len) || len > uint64_t(end - p)) {
+        throw std::runtime_error("Bad string in binary frame metadata.");
+    }
+    s.assign(reinterpret_cast<const char*>(p), len);
+    p += len;
+}
+
+// Values are decoded in place, since picojson values can only be copied.
+void ReadMetaValue(const unsigned char*& p, const unsigned char* end, int depth, picojson::value& v)
+{
+    if(p == end || depth > meta_max_depth) {
+        throw std::runtime_error("Truncated binary frame metadata.");
+    }
+
+    switch(*p++) {
+    case meta_null:
+        v = picojson::value();
+        return;
+    case meta_false:
+        v = picojson::value(false);
+        return;
+    case meta_true:
+        v = picojson::value(true);
+        return;
+    case meta_int: {
+        int64_t n;
+        if(!readCompressedSignedInt(p, end, n)) break;
+        v = picojson::value(n);
+        return;
+    }
+    case meta_double: {
+        double d;
+        if(size_t(end - p) < sizeof(double)) break;
+        std::memcpy(&d, p, sizeof(double));
+        p += sizeof(double);
+        v = picojson::value(d);
+        return;
+    }
+    case meta_string:
+        v = picojson::value(picojson::string_type, false);
+        ReadMetaString(p, end, v.get<std::string>());
+        return;
+    case meta_array: {
+        uint64_t n;
+        // Every element takes at least one byte, which bounds the allocation.
+        if(!readCompressedUnsignedInt(p, end, n) || n > uint64_t(end - p)) break;
+        v = picojson::value(picojson::array_type, false);
+        picojson::array& a = v.get<picojson::array>();
+        a.resize(n);
+        for(auto& e : a) {
+            ReadMetaValue(p, end, depth+1, e);
+        }
+        return;
+    }
+    case meta_object: {
+        uint64_t n;
+        if(!readCompressedUnsignedInt(p, end, n) || n > uint64_t(end - p)) break;
+        v = picojson::value(picojson::object_type, false);
+        picojson::object& o = v.get<picojson::object>();
+        std::string key;
+        for(uint64_t i=0; i < n; ++i) {
+            ReadMetaString(p, end, key);
+            ReadMetaValue(p, end, depth+1, o[key]);
+        }
+        return;
+    }
+    default:
+        break;
+    }
+
+    throw std::runtime_error("Bad binary frame metadata.");
+}
+
+}
+
+void PacketMeta::Decode() const
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(_encoded.data());
+    const unsigned char* end = p + _encoded.size();
+
+    picojson::value v(picojson::object_type, false);
+    picojson::object& o = v.get<picojson::object>();
+    for(const std::string& key : *_keys) {
+        ReadMetaValue(p, end, 0, o[key]);
+    }
+    if(p != end) {
+        throw std::runtime_error("Binary frame metadata does not match its schema.");
+    }
+
+    _value.swap(v);
+    _decoded = true;
+}
+std::string PacketMetaSignature(const picojson::object& meta)
+{
+    std::string signature;
+    for(const auto& kv : meta) {
+        signature += kv.first;
+        signature.push_back('\0');
+    }
+    return signature;
+}
+
+void AppendPacketMeta(std::string& out, const picojson::object& meta)
+{
+    for(const auto& kv : meta) {
+        AppendMetaValue(out, kv.second);
+    }
+}
+
+}
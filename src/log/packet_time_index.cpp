@@ -0,0 +1,209 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/log/packet_time_index.h>
+#include <pangolin/log/packetstream.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace pangolin {
+
+namespace {
+
+bool ReadVarint(std::istream& is, uint64_t& n)
+{
+    n = 0;
+    for(uint32_t shift = 0; shift < 64; shift += 7) {
+        const int v = is.get();
+        if(v == std::char_traits<char>::eof()) return false;
+        n |= uint64_t(v & 0x7F) << shift;
+        if(!(v & 0x80)) return true;
+    }
+    return false;
+}
+
+template<typename T>
+bool ReadRaw(std::istream& is, T& v)
+{
+    return bool(is.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+}
+
+bool PacketTimeIndex::Open(const std::string& filename, uint64_t pos)
+{
+    Close();
+
+    _file.open(filename, std::ios::in | std::ios::binary);
+    if(!_file.is_open()) return false;
+
+    _file.seekg(pos);
+    pangoTagType tag = 0;
+    uint64_t block_packets, num_sources;
+    if(!_file.read(reinterpret_cast<char*>(&tag), TAG_LENGTH) || tag != TAG_PANGO_TIME_INDEX ||
+       !ReadVarint(_file, _payload_bytes)) {
+        Close();
+        return false;
+    }
+    _payload_pos = static_cast<uint64_t>(_file.tellg());
+
+    // Every source and block takes at least a byte, which bounds the allocations.
+    if(!ReadVarint(_file, block_packets) || block_packets == 0 ||
+       !ReadVarint(_file, num_sources) || num_sources > _payload_bytes) {
+        Close();
+        return false;
+    }
+
+    _block_packets = block_packets;
+    _sources.resize(num_sources);
+    size_t num_blocks = 0;
+    for(auto& s : _sources) {
+        uint64_t num_packets;
+        if(!ReadVarint(_file, num_packets) || num_packets / block_packets > _payload_bytes) {
+            Close();
+            return false;
+        }
+        s.num_packets = num_packets;
+        s.first_block = num_blocks;
+        num_blocks += (num_packets + block_packets - 1) / block_packets;
+    }
+
+    if(num_blocks > _payload_bytes / sizeof(Block)) {
+        Close();
+        return false;
+    }
+    _blocks.resize(num_blocks);
+    for(auto& b : _blocks) {
+        if(!ReadRaw(_file, b.time) || !ReadRaw(_file, b.pos) || !ReadRaw(_file, b.offset) || b.offset > _payload_bytes) {
+            Close();
+            return false;
+        }
+    }
+
+    // The record ends with its own position.
+    uint64_t self_pos;
+    _file.seekg(_payload_pos + _payload_bytes);
+    if(!ReadRaw(_file, self_pos) || self_pos != pos ||
+       !_file.read(reinterpret_cast<char*>(&tag), TAG_LENGTH) || tag != TAG_PANGO_TIME_INDEX) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void PacketTimeIndex::Close()
+{
+    if(_file.is_open()) _file.close();
+    _file.clear();
+    _block_packets = 0;
+    _payload_pos = 0;
+    _payload_bytes = 0;
+    _sources.clear();
+    _blocks.clear();
+    _cached_block = -1;
+    _cached.clear();
+}
+
+const std::vector<PacketStreamSource::PacketInfo>& PacketTimeIndex::LoadBlock(size_t block)
+{
+    if(block == _cached_block) {
+        return _cached;
+    }
+
+    // Find the source and size of the block
+    size_t src = 0;
+    while(src + 1 < _sources.size() && _sources[src+1].first_block <= block) ++src;
+    const size_t first_packet = (block - _sources[src].first_block) * _block_packets;
+    const size_t num_packets = std::min(_block_packets, _sources[src].num_packets - first_packet);
+
+    const Block& b = _blocks[block];
+    const uint64_t end = block + 1 < _blocks.size() ? _blocks[block+1].offset : _payload_bytes;
+    if(end < b.offset) {
+        throw std::runtime_error("PacketTimeIndex: bad block offset.");
+    }
+
+    std::vector<unsigned char> bytes(end - b.offset);
+    _file.clear();
+    _file.seekg(_payload_pos + b.offset);
+    if(!_file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+        throw std::runtime_error("PacketTimeIndex: unable to read block.");
+    }
+
+    _cached_block = -1;
+    _cached.resize(num_packets);
+    _cached[0] = {static_cast<std::streamoff>(b.pos), b.time};
+    const unsigned char* p = bytes.data();
+    const unsigned char* p_end = p + bytes.size();
+    for(size_t i=1; i < num_packets; ++i) {
+        int64_t dpos, dtime;
+        if(!readCompressedSignedInt(p, p_end, dpos) || !readCompressedSignedInt(p, p_end, dtime)) {
+            throw std::runtime_error("PacketTimeIndex: truncated block.");
+        }
+        _cached[i].pos = _cached[i-1].pos + std::streamoff(dpos);
+        _cached[i].capture_time = _cached[i-1].capture_time + dtime;
+    }
+    _cached_block = block;
+    return _cached;
+}
+
+PacketStreamSource::PacketInfo PacketTimeIndex::At(PacketStreamSourceId src, size_t packet)
+{
+    if(packet >= NumPackets(src)) {
+        throw std::out_of_range("PacketTimeIndex: no such packet.");
+    }
+    return LoadBlock(_sources[src].first_block + packet / _block_packets)[packet % _block_packets];
+}
+
+size_t PacketTimeIndex::LowerBound(PacketStreamSourceId src, int64_t time_us)
+{
+    const size_t n = NumPackets(src);
+    if(n == 0) return 0;
+
+    const Source& s = _sources[src];
+    const size_t num_blocks = (n + _block_packets - 1) / _block_packets;
+
+    // First block starting at or after time_us. Anything earlier is in the
+    // block before it.
+    const size_t b = InterpolationLowerBound(num_blocks, time_us, [&](size_t i){
+        return _blocks[s.first_block + i].time;
+    });
+    if(b == 0) return 0;
+
+    const auto& block = LoadBlock(s.first_block + b - 1);
+    const size_t k = InterpolationLowerBound(block.size(), time_us, [&](size_t i){
+        return block[i].capture_time;
+    });
+    return (b - 1) * _block_packets + k;
+}
+
+size_t PacketTimeIndex::MemoryBytes() const
+{
+    return sizeof(*this) + _sources.capacity() * sizeof(Source) + _blocks.capacity() * sizeof(Block) +
+        _cached.capacity() * sizeof(PacketStreamSource::PacketInfo);
+}
+
+}
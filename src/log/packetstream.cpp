@@ -1,4 +1,6 @@
 #include <pangolin/log/packetstream.h>
+#include <cstdio>
+#include <limits>
 #include <stdexcept>
 
 namespace pangolin {
@@ -26,6 +28,96 @@ int64_t PacketStream::readTimestamp()
     return time_us;
 }
 
+// Schema record:
+//   TAG_META_SCHEMA, uint64 position of this record, varint source id,
+//   varint number of keys, then each key as varint length and characters.
+void PacketStream::readMetaSchema()
+{
+    readTag(TAG_META_SCHEMA);
+    uint64_t pos;
+    read(reinterpret_cast<char*>(&pos), sizeof(uint64_t));
+    readUINT(); // source, for information only
+    const size_t num_keys = readUINT();
+
+    auto keys = std::make_shared<PacketMetaKeys>();
+    bool ok = good();
+    for(size_t i=0; i < num_keys && ok; ++i) {
+        const size_t len = readUINT();
+        // Key lengths are untrusted: don't allocate more than the stream holds.
+        ok = good() && len <= remaining();
+        if(!ok) break;
+        std::string key(len, '\0');
+        ok = read(&key[0], len) == len;
+        if(ok) keys->push_back(std::move(key));
+    }
+    if (!ok || !good())
+        throw std::runtime_error("Bad metadata schema. Stream may be corrupt.");
+
+    _meta_schemas[pos] = std::move(keys);
+}
+
+std::shared_ptr<const PacketMetaKeys> PacketStream::metaSchema(uint64_t pos)
+{
+    auto it = _meta_schemas.find(pos);
+    if (it == _meta_schemas.end() && seekable()) {
+        const std::streampos resume = tellg();
+        seekg(static_cast<std::streampos>(pos));
+        if (peekTag() == TAG_META_SCHEMA)
+            readMetaSchema();
+        clear();
+        seekg(resume);
+        it = _meta_schemas.find(pos);
+    }
+    if (it == _meta_schemas.end())
+        throw std::runtime_error("Frame metadata refers to a missing schema. Stream may be corrupt.");
+    return it->second;
+}
+
+// Dictionary record:
+//   TAG_SRC_DICT, uint64 position of this record, varint source id,
+//   varint dictionary length, then the dictionary.
+void PacketStream::readDictionary()
+{
+    readTag(TAG_SRC_DICT);
+    uint64_t pos;
+    read(reinterpret_cast<char*>(&pos), sizeof(uint64_t));
+    readUINT(); // source, for information only
+    const size_t len = readUINT();
+    // len is untrusted: don't allocate more than the stream holds.
+    if (!good() || len > remaining())
+        throw std::runtime_error("Bad compression dictionary. Stream may be corrupt.");
+
+    std::string data(len, '\0');
+    if (read(&data[0], len) != len)
+        throw std::runtime_error("Truncated compression dictionary.");
+
+    _dictionaries[pos] = std::make_shared<PacketDictionary>(std::move(data));
+}
+
+std::shared_ptr<PacketDictionary> PacketStream::dictionary(uint64_t pos)
+{
+    auto it = _dictionaries.find(pos);
+    if (it == _dictionaries.end() && seekable()) {
+        const std::streampos resume = tellg();
+        seekg(static_cast<std::streampos>(pos));
+        if (peekTag() == TAG_SRC_DICT)
+            readDictionary();
+        clear();
+        seekg(resume);
+        it = _dictionaries.find(pos);
+    }
+    if (it == _dictionaries.end())
+        throw std::runtime_error("Packet refers to a missing compression dictionary. Stream may be corrupt.");
+    return it->second;
+}
+
+PacketDecompressor& PacketStream::decompressor(const std::string& codec)
+{
+    std::unique_ptr<PacketDecompressor>& d = _decompressors[codec];
+    if (!d) d.reset(new PacketDecompressor(codec));
+    return *d;
+}
+
 pangoTagType PacketStream::readTag()
 {
     auto r = peekTag();
@@ -66,6 +158,27 @@ size_t PacketStream::read(char* target, size_t len)
     return gcount();
 }
 
+const char* PacketStream::readDirect(size_t len)
+{
+    if (!mapped() || !good())
+        return nullptr;
+    const char* p = _mapped.take(len);
+    if (p)
+        _tag = 0;
+    return p;
+}
+
+void PacketStream::map(const std::string& filename)
+{
+    if (is_open() && !_is_pipe) {
+        // Reads past the mapping fall back to the file stream.
+        _mapped.reset(MappedFile::Open(filename), Base::rdbuf());
+        if (mapped()) {
+            std::istream::rdbuf(&_mapped);
+        }
+    }
+}
+
 size_t PacketStream::skip(size_t len)
 {
     if (seekable()) {
@@ -86,6 +199,18 @@ std::streampos PacketStream::tellg()
     }
 }
 
+size_t PacketStream::remaining()
+{
+    if (!seekable() || !good()) {
+        return std::numeric_limits<size_t>::max();
+    }
+    const std::streampos pos = Base::tellg();
+    Base::seekg(0, std::ios_base::end);
+    const std::streampos end = Base::tellg();
+    Base::seekg(pos);
+    return end > pos ? static_cast<size_t>(end - pos) : 0;
+}
+
 void PacketStream::seekg(std::streampos target)
 {
     if (seekable()) {
@@ -110,7 +235,13 @@ static bool valid(pangoTagType t)
         case TAG_ADD_SOURCE:
         case TAG_SRC_JSON:
         case TAG_SRC_PACKET:
+        case TAG_SRC_META:
+        case TAG_META_SCHEMA:
+        case TAG_SRC_DICT:
         case TAG_PANGO_STATS:
+        case TAG_PANGO_INDEX:
+        case TAG_PANGO_CHECKPOINT:
+        case TAG_PANGO_TIME_INDEX:
         case TAG_PANGO_FOOTER:
         case TAG_END:
         case TAG_PANGO_HDR:
@@ -143,4 +274,21 @@ pangoTagType PacketStream::syncToTag() //scan through chars one by one until the
 
 }
 
+std::string PacketStreamSegmentFilename(const std::string& filename, size_t segment)
+{
+    if(segment == 0) {
+        return filename;
+    }
+
+    const size_t slash = filename.find_last_of("/\\");
+    size_t dot = filename.find_last_of('.');
+    if(dot == filename.npos || (slash != filename.npos && dot < slash)) {
+        dot = filename.size();
+    }
+
+    char num[32];
+    snprintf(num, sizeof(num), ".%04zu", segment);
+    return filename.substr(0, dot) + num + filename.substr(dot);
+}
+
 }
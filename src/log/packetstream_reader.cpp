@@ -25,6 +25,7 @@
 
 #include <pangolin/log/packetstream_reader.h>
 #include <pangolin/log/packetstream_writer.h>
+#include <pangolin/utils/thread_pool.h>
 
 using std::string;
 using std::istream;
@@ -35,6 +36,9 @@ using std::ios_base;
 using std::streampos;
 using std::streamoff;
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <thread>
 
 #ifndef _WIN_
@@ -45,14 +49,16 @@ namespace pangolin
 {
 
 PacketStreamReader::PacketStreamReader()
-    : _pipe_fd(-1)
+    : _pipe_fd(-1), _segment(0), _checkpoint_packets(0),
+      _background_index(false), _indexing(false), _stop_indexing(false)
 {
 }
 
-PacketStreamReader::PacketStreamReader(const std::string& filename)
-    : _pipe_fd(-1)
+PacketStreamReader::PacketStreamReader(const std::string& filename, bool sparse_index)
+    : _pipe_fd(-1), _segment(0), _checkpoint_packets(0),
+      _background_index(false), _indexing(false), _stop_indexing(false)
 {
-    Open(filename);
+    Open(filename, sparse_index);
 }
 
 PacketStreamReader::~PacketStreamReader()
@@ -60,14 +66,39 @@ PacketStreamReader::~PacketStreamReader()
     Close();
 }
 
-void PacketStreamReader::Open(const std::string& filename)
+void PacketStreamReader::Open(const std::string& filename, bool sparse_index)
 {
+    StopIndexing();
     std::lock_guard<std::recursive_mutex> lg(_mutex);
 
     Close();
 
-    _filename = filename;
     _is_pipe = IsPipe(filename);
+    OpenStream(filename);
+
+    while (_stream.peekTag() == TAG_ADD_SOURCE) {
+        ParseNewSource();
+    }
+
+    // Segments are merged through their full indices.
+    const bool segmented = FileExists(PacketStreamSegmentFilename(filename, 1));
+    if(!SetupIndex(sparse_index && !segmented)) {
+        if(_background_index && !segmented && _stream.mapped()) {
+            // The rebuilt index is appended to the file once complete.
+            RebuildIndex(true);
+        }else{
+            FixFileIndex();
+        }
+    }
+
+    if(_stream.seekable() && !_time_index.IsOpen()) {
+        OpenSegments(filename);
+    }
+}
+
+void PacketStreamReader::OpenStream(const std::string& filename)
+{
+    _filename = filename;
     _stream.open(filename);
 
     if (!_stream.is_open())
@@ -81,23 +112,125 @@ void PacketStreamReader::Open(const std::string& filename)
             throw runtime_error("Bad stream");
     }
 
-
     ParseHeader();
+}
 
+void PacketStreamReader::OpenSegments(const std::string& filename)
+{
+    // Combined index, with positions offset by the start of each segment.
+    std::vector<std::vector<PacketStreamSource::PacketInfo>> index;
+    auto append_index = [&](std::streamoff base) {
+        index.resize(std::max(index.size(), _sources.size()));
+        for(size_t i=0; i < _sources.size(); ++i) {
+            for(PacketStreamSource::PacketInfo info : _sources[i].index) {
+                info.pos += base;
+                index[i].push_back(info);
+            }
+        }
+    };
+    append_index(0);
+
+    std::vector<std::string> segments = {filename};
+    std::vector<std::streamoff> segment_base = {0};
+    const SyncTime::TimePoint recording_start = packet_stream_start;
+    bool reopen = false;
+
+    for(size_t k=1; ; ++k) {
+        const std::string segment = PacketStreamSegmentFilename(filename, k);
+        if(!FileExists(segment)) break;
+
+        // Segments are laid end to end within the combined stream.
+        _stream.clear();
+        _stream.seekg(0, ios_base::end);
+        const std::streamoff base = segment_base.back() + static_cast<std::streamoff>(_stream.tellg());
+
+        reopen = true;
+        try {
+            OpenStream(segment);
+        }catch(const std::exception& e) {
+            pango_print_warn("Ignoring segment '%s': %s\n", segment.c_str(), e.what());
+            break;
+        }
+
+        // Skip anything left over from an earlier recording of the same name.
+        if(packet_stream_start != recording_start) break;
+
+        while (_stream.peekTag() == TAG_ADD_SOURCE) {
+            ParseNewSource();
+        }
+
+        if(!SetupIndex()) {
+            FixFileIndex();
+        }
+
+        segments.push_back(segment);
+        segment_base.push_back(base);
+        append_index(base);
+    }
+
+    _segments = std::move(segments);
+    _segment_base = std::move(segment_base);
+    _segment = 0;
+
+    if(reopen) {
+        for(size_t i=0; i < _sources.size(); ++i) {
+            _sources[i].index = std::move(index[i]);
+            _sources[i].next_packet_id = 0;
+        }
+        OpenSegment(0);
+    }
+}
+
+void PacketStreamReader::OpenSegment(size_t segment)
+{
+    OpenStream(_segments[segment]);
     while (_stream.peekTag() == TAG_ADD_SOURCE) {
         ParseNewSource();
     }
+    _segment = segment;
+}
+
+bool PacketStreamReader::NextSegment()
+{
+    if(_segment + 1 >= _segments.size()) {
+        return false;
+    }
+    OpenSegment(_segment + 1);
+    return true;
+}
+
+void PacketStreamReader::SeekStream(std::streampos pos)
+{
+    if(_segments.size() > 1) {
+        const size_t segment = std::upper_bound(
+            _segment_base.begin(), _segment_base.end(), static_cast<std::streamoff>(pos)
+        ) - _segment_base.begin() - 1;
+        if(segment != _segment) {
+            OpenSegment(segment);
+        }
+        pos -= _segment_base[segment];
+    }
 
-    if(!SetupIndex()) {
-        FixFileIndex();
+    // Reading packets in file order needs no seek, which would discard any
+    // buffered data.
+    if(_stream.good() && _stream.tellg() == pos) {
+        return;
     }
+    _stream.clear();
+    _stream.seekg(pos);
 }
 
 void PacketStreamReader::Close() {
+    StopIndexing();
     std::lock_guard<std::recursive_mutex> lg(_mutex);
 
     _stream.close();
+    _time_index.Close();
     _sources.clear();
+    _scanned_sources.clear();
+    _segments.clear();
+    _segment_base.clear();
+    _segment = 0;
 
 #ifndef _WIN_
     if (_pipe_fd != -1) {
@@ -113,10 +246,15 @@ void PacketStreamReader::ParseHeader()
     picojson::value json_header;
     picojson::parse(json_header, _stream);
 
-    // File timestamp
-    const int64_t start_us = json_header["time_us"].get<int64_t>();
+    // File timestamp. Later segments of a recording refer to the first.
+    const int64_t start_us = json_header.contains("first_segment_time_us") ?
+        json_header["first_segment_time_us"].get<int64_t>() :
+        json_header["time_us"].get<int64_t>();
     packet_stream_start = SyncTime::TimePoint() + std::chrono::microseconds(start_us);
 
+    _checkpoint_packets = json_header.contains("checkpoint_packets") ?
+        static_cast<size_t>(json_header["checkpoint_packets"].get<int64_t>()) : 0;
+
     _stream.get(); // consume newline
 }
 
@@ -127,25 +265,21 @@ void PacketStreamReader::ParseNewSource()
     picojson::parse(json, _stream);
     _stream.get(); // consume newline
 
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    ParsePacketStreamSource(json, _sources);
+    TakeScannedSources();
+}
 
-    const size_t src_id = json[pss_src_id].get<int64_t>();
-
-    if(_sources.size() <= src_id) {
-        _sources.resize(src_id+1);
+void PacketStreamReader::TakeScannedSources()
+{
+    for(size_t i = 0; i < _sources.size() && i < _scanned_sources.size(); ++i) {
+        auto& index = _scanned_sources[i].index;
+        _sources[i].index.insert(_sources[i].index.end(), index.begin(), index.end());
+        index.clear();
     }
-
-    PacketStreamSource& pss = _sources[src_id];
-    pss.id = src_id;
-    pss.driver = json[pss_src_driver].get<string>();
-    pss.uri = json[pss_src_uri].get<string>();
-    pss.info = json[pss_src_info];
-    pss.version = json[pss_src_version].get<int64_t>();
-    pss.data_alignment_bytes = json[pss_src_packet][pss_pkt_alignment_bytes].get<int64_t>();
-    pss.data_definitions = json[pss_src_packet][pss_pkt_definitions].get<string>();
-    pss.data_size_bytes = json[pss_src_packet][pss_pkt_size_bytes].get<int64_t>();
 }
 
-bool PacketStreamReader::SetupIndex()
+bool PacketStreamReader::SetupIndex(bool sparse)
 {
     bool index_good = false;
 
@@ -159,10 +293,20 @@ bool PacketStreamReader::SetupIndex()
         if (_stream.peekTag() == TAG_PANGO_FOOTER)
         {
             //parsing the footer returns the index position
-            _stream.seekg(ParseFooter());
-            if (_stream.peekTag() == TAG_PANGO_STATS) {
-                // Read the pre-build index from the file
-                index_good = ParseIndex();
+            const std::streampos indexpos = ParseFooter();
+            if (sparse && SetupTimeIndex(indexpos)) {
+                index_good = true;
+            }else{
+                _stream.clear();
+                _stream.seekg(indexpos);
+                const pangoTagType index_tag = _stream.peekTag();
+                if (index_tag == TAG_PANGO_INDEX) {
+                    // Read the pre-build binary index from the file
+                    index_good = ParseBinaryIndex();
+                }else if (index_tag == TAG_PANGO_STATS) {
+                    // Older files store the index as JSON
+                    index_good = ParseIndex();
+                }
             }
         }
 
@@ -174,6 +318,27 @@ bool PacketStreamReader::SetupIndex()
     return index_good;
 }
 
+// The time index, if any, ends just ahead of the index with its position.
+bool PacketStreamReader::SetupTimeIndex(std::streampos indexpos)
+{
+    const std::streamoff trailer_bytes = sizeof(uint64_t) + TAG_LENGTH;
+    if(indexpos < trailer_bytes) return false;
+
+    uint64_t pos;
+    _stream.clear();
+    _stream.seekg(indexpos - trailer_bytes);
+    if(_stream.read(reinterpret_cast<char*>(&pos), sizeof(uint64_t)) != sizeof(uint64_t) ||
+       _stream.readTag() != TAG_PANGO_TIME_INDEX) {
+        return false;
+    }
+
+    if(!_time_index.Open(_filename, pos) || _time_index.NumSources() < _sources.size()) {
+        _time_index.Close();
+        return false;
+    }
+    return true;
+}
+
 streampos PacketStreamReader::ParseFooter() //returns position of index.
 {
     _stream.readTag(TAG_PANGO_FOOTER);
@@ -217,6 +382,202 @@ bool PacketStreamReader::ParseIndex()
     return index_good;
 }
 
+bool PacketStreamReader::ParseBinaryIndex()
+{
+    _stream.readTag(TAG_PANGO_INDEX);
+
+    std::vector<std::vector<PacketStreamSource::PacketInfo>> index;
+    // We shouldn't have seen more sources than exist in the index
+    if(!ReadBinaryIndex(index, std::numeric_limits<size_t>::max()) || index.size() < _sources.size()) {
+        return false;
+    }
+
+    _sources.resize(index.size());
+    for(size_t i=0; i < _sources.size(); ++i) {
+        _sources[i].index = std::move(index[i]);
+    }
+
+    return true;
+}
+
+// Reads a SourceIndexBinary record of at most max_bytes from the stream.
+bool PacketStreamReader::ReadBinaryIndex(std::vector<std::vector<PacketStreamSource::PacketInfo>>& index, size_t max_bytes)
+{
+    const size_t payload_bytes = _stream.readUINT();
+    // The size is untrusted: check it against the file before allocating.
+    if(!_stream.good() || payload_bytes > std::min(max_bytes, _stream.remaining())) return false;
+
+    // Read the whole index with one call and decode from memory.
+    std::vector<unsigned char> payload(payload_bytes);
+    if(_stream.read(reinterpret_cast<char*>(payload.data()), payload_bytes) != payload_bytes) {
+        return false;
+    }
+
+    const unsigned char* p = payload.data();
+    const unsigned char* end = p + payload.size();
+
+    uint64_t num_sources;
+    // Every source needs at least three bytes, which bounds the allocation.
+    if(!readCompressedUnsignedInt(p, end, num_sources) || num_sources > size_t(end - p)) {
+        return false;
+    }
+
+    index.clear();
+    index.resize(num_sources);
+    for(auto& src_index : index) {
+        uint64_t num_packets;
+        // Every packet needs at least two bytes, which bounds the allocation.
+        if(!readCompressedUnsignedInt(p, end, num_packets) || num_packets > size_t(end - p) / 2) {
+            return false;
+        }
+        src_index.resize(num_packets);
+        int64_t v = 0;
+        for(auto& info : src_index) {
+            int64_t delta;
+            if(!readCompressedSignedInt(p, end, delta)) return false;
+            v += delta;
+            info.pos = v;
+        }
+        v = 0;
+        for(auto& info : src_index) {
+            int64_t delta;
+            if(!readCompressedSignedInt(p, end, delta)) return false;
+            v += delta;
+            info.capture_time = v;
+        }
+    }
+
+    return true;
+}
+
+// Bytes following the index in a checkpoint record (see PacketStreamWriter::WriteCheckpoint)
+static const size_t checkpoint_trailer_bytes = 2*sizeof(uint64_t) + TAG_LENGTH;
+
+bool PacketStreamReader::ReadCheckpoint(uint64_t pos, std::streamoff file_end, std::vector<std::vector<PacketStreamSource::PacketInfo>>& index, uint64_t& prev_pos, std::streamoff& end_pos)
+{
+    _stream.clear();
+    _stream.seekg(pos);
+    if(_stream.readTag() != TAG_PANGO_CHECKPOINT) return false;
+    if(!ReadBinaryIndex(index, size_t(file_end - pos))) return false;
+
+    uint64_t self_pos = 0;
+    if(_stream.read(reinterpret_cast<char*>(&prev_pos), sizeof(uint64_t)) != sizeof(uint64_t) ||
+       _stream.read(reinterpret_cast<char*>(&self_pos), sizeof(uint64_t)) != sizeof(uint64_t) ||
+       self_pos != pos || prev_pos >= pos || _stream.readTag() != TAG_PANGO_CHECKPOINT) {
+        return false;
+    }
+
+    end_pos = _stream.tellg();
+    return _stream.good();
+}
+
+bool PacketStreamReader::RecoverCheckpointIndex(std::streampos& scan_from)
+{
+    _stream.clear();
+    _stream.seekg(0, ios_base::end);
+    const std::streamoff file_end = _stream.tellg();
+    if(file_end <= 0) return false;
+
+    std::vector<std::vector<std::vector<PacketStreamSource::PacketInfo>>> checkpoints(1);
+    uint64_t prev_pos = 0;
+    bool found = false;
+
+    // Search backwards from the end of file for the trailer of the last
+    // complete checkpoint. Only the data written since it is read.
+    //
+    // The search is byte by byte, so it only goes back a few checkpoint
+    // intervals, sized from the packets at the start of the file. Further
+    // than that, the linear scan the caller falls back on is cheaper.
+    const std::streamoff chunk_bytes = 1 << 20;
+    const std::streamoff search_bytes = std::max(
+        chunk_bytes, 4 * std::streamoff(_checkpoint_packets) * EstimatePacketBytes(scan_from, file_end)
+    );
+    const std::streamoff search_begin = std::max<std::streamoff>(0, file_end - search_bytes);
+
+    std::vector<char> chunk;
+    for(std::streamoff hi = file_end; !found; ) {
+        const std::streamoff lo = std::max<std::streamoff>(search_begin, hi - chunk_bytes);
+        chunk.resize(size_t(hi - lo));
+        _stream.clear();
+        _stream.seekg(lo);
+        if(_stream.read(chunk.data(), chunk.size()) != chunk.size()) return false;
+
+        for(std::streamoff e = hi; !found && e - lo >= std::streamoff(checkpoint_trailer_bytes); --e) {
+            const char* tag = chunk.data() + (e - lo) - TAG_LENGTH;
+            if(memcmp(tag, &TAG_PANGO_CHECKPOINT, TAG_LENGTH)) continue;
+
+            uint64_t pos;
+            memcpy(&pos, tag - sizeof(uint64_t), sizeof(uint64_t));
+            std::streamoff end_pos;
+            if(pos < uint64_t(e) && ReadCheckpoint(pos, file_end, checkpoints[0], prev_pos, end_pos) && end_pos == e) {
+                scan_from = e;
+                found = true;
+            }
+        }
+
+        if(lo == search_begin) break;
+        hi = lo + std::streamoff(checkpoint_trailer_bytes) - 1;
+    }
+
+    if(!found) return false;
+
+    // Follow the chain back to the first checkpoint.
+    while(prev_pos) {
+        checkpoints.emplace_back();
+        std::streamoff end_pos;
+        if(!ReadCheckpoint(prev_pos, file_end, checkpoints.back(), prev_pos, end_pos)) return false;
+    }
+
+    // Sources declared after the header would be missed by scanning the tail.
+    for(const auto& c : checkpoints) {
+        if(c.size() > _sources.size()) return false;
+    }
+
+    for(auto c = checkpoints.rbegin(); c != checkpoints.rend(); ++c) {
+        for(size_t i=0; i < c->size(); ++i) {
+            auto& index = _sources[i].index;
+            index.insert(index.end(), (*c)[i].begin(), (*c)[i].end());
+        }
+    }
+
+    return true;
+}
+
+std::streamoff PacketStreamReader::EstimatePacketBytes(std::streamoff begin, std::streamoff file_end)
+{
+    const std::streamoff sample_end = std::min<std::streamoff>(file_end, begin + (1 << 20));
+    if(begin < 0 || sample_end <= begin) return 0;
+
+    // Record positions are relative to the start of file.
+    std::vector<char> data(static_cast<size_t>(sample_end));
+    _stream.clear();
+    _stream.seekg(0);
+    if(_stream.read(data.data(), data.size()) != data.size()) return 0;
+
+    const PacketIndexScan scan = ScanPacketIndex(
+        data.data(), data.size(), uint64_t(begin), uint64_t(sample_end), _sources, false
+    );
+    if(scan.records.empty()) {
+        // The first record is larger than the sample.
+        return sample_end - begin;
+    }
+    return std::streamoff(scan.end - uint64_t(begin)) / std::streamoff(scan.records.size());
+}
+
+void PacketStreamReader::SkipTimeIndex()
+{
+    _stream.readTag(TAG_PANGO_TIME_INDEX);
+    _stream.skip(_stream.readUINT() + sizeof(uint64_t));
+    _stream.readTag(TAG_PANGO_TIME_INDEX);
+}
+
+void PacketStreamReader::SkipCheckpoint()
+{
+    _stream.readTag(TAG_PANGO_CHECKPOINT);
+    _stream.skip(_stream.readUINT() + 2*sizeof(uint64_t));
+    _stream.readTag(TAG_PANGO_CHECKPOINT);
+}
+
 bool PacketStreamReader::GoodToRead()
 {
     if(!_stream.good()) {
@@ -253,7 +614,7 @@ Packet PacketStreamReader::NextFrame()
 {
     std::unique_lock<std::recursive_mutex> lock(_mutex);
 
-    while (GoodToRead())
+    while (GoodToRead() || NextSegment())
     {
         const pangoTagType t = _stream.peekTag();
 
@@ -265,14 +626,40 @@ Packet PacketStreamReader::NextFrame()
         case TAG_ADD_SOURCE:
             ParseNewSource();
             break;
+        case TAG_META_SCHEMA:
+            _stream.readMetaSchema();
+            break;
+        case TAG_SRC_DICT:
+            _stream.readDictionary();
+            break;
         case TAG_SRC_JSON: //frames are sometimes preceded by metadata, but metadata must ALWAYS be followed by a frame from the same source.
+        case TAG_SRC_META:
         case TAG_SRC_PACKET:
-            return Packet(_stream, std::move(lock), _sources);
+        {
+            Packet packet(_stream, std::move(lock), _sources);
+            packet.frame_streampos += _segment_base.empty() ? 0 : _segment_base[_segment];
+            return packet;
+        }
+        case TAG_PANGO_CHECKPOINT:
+            SkipCheckpoint();
+            break;
+        case TAG_PANGO_TIME_INDEX:
+            SkipTimeIndex();
+            break;
         case TAG_PANGO_STATS:
-            ParseIndex();
+        case TAG_PANGO_INDEX:
+            // Each segment ends with its own index, which is already part of ours.
+            if(_segments.size() > 1) {
+                if(!NextSegment()) throw std::runtime_error("PacketStreamReader: end of stream");
+            }else if(t == TAG_PANGO_STATS) {
+                ParseIndex();
+            }else{
+                ParseBinaryIndex();
+            }
             break;
         case TAG_PANGO_FOOTER: //end of frames
         case TAG_END:
+            if(NextSegment()) break;
             throw std::runtime_error("PacketStreamReader: end of stream");
         case TAG_PANGO_HDR: //shoudln't encounter this
             ParseHeader();
@@ -303,7 +690,7 @@ Packet PacketStreamReader::NextFrame(PacketStreamSourceId src)
     }
 }
 
-void PacketStreamReader::RebuildIndex()
+void PacketStreamReader::RebuildIndex(bool background)
 {
     lock_guard<decltype(_mutex)> lg(_mutex);
 
@@ -319,17 +706,60 @@ void PacketStreamReader::RebuildIndex()
             s.next_packet_id = 0;
         }
 
-        // Read through entire file, updating index
-        try{
-            while (1)
-            {
-                // This will throw if we've run out of frames
-                auto fi = NextFrame();
-                PacketStreamSource& s = _sources[fi.src];
-                PANGO_ENSURE(s.index.size() == fi.sequence_num);
-                s.index.push_back({fi.frame_streampos, fi.time});
+        // Take what we can from checkpoints, leaving only the packets
+        // written after the last one to scan.
+        std::streampos scan_from = pos;
+        if(_checkpoint_packets && RecoverCheckpointIndex(scan_from)) {
+            // Concurrent writers can place packets just before a checkpoint
+            // which it doesn't cover, so rescan from the last packet indexed.
+            PacketStreamSource* last = nullptr;
+            for(PacketStreamSource& s : _sources) {
+                if(!s.index.empty() && (!last || s.index.back().pos > last->index.back().pos)) {
+                    last = &s;
+                }
+            }
+            if(last) {
+                scan_from = last->index.back().pos;
+                last->index.pop_back();
+            }
+            for(PacketStreamSource& s : _sources) {
+                s.next_packet_id = s.index.size();
+            }
+        }else{
+            for(PacketStreamSource& s : _sources) {
+                s.index.clear();
+            }
+            scan_from = pos;
+        }
+
+        std::shared_ptr<MappedFile> file = _stream.mapping();
+        if(file && background) {
+            _indexing = true;
+            _stop_indexing = false;
+            _index_thread = std::thread([this, file, scan_from](){
+                ScanIndex(file, static_cast<uint64_t>(scan_from), true);
+                lock_guard<decltype(_mutex)> lg(_mutex);
+                if(!_stop_indexing) AppendIndex();
+                _indexing = false;
+            });
+        }else if(file) {
+            ScanIndex(file, static_cast<uint64_t>(scan_from), false);
+        }else{
+            _stream.clear();
+            _stream.seekg(scan_from);
+
+            // Read through entire file, updating index
+            try{
+                while (1)
+                {
+                    // This will throw if we've run out of frames
+                    auto fi = NextFrame();
+                    PacketStreamSource& s = _sources[fi.src];
+                    PANGO_ENSURE(s.index.size() == fi.sequence_num);
+                    s.index.push_back({fi.frame_streampos, fi.time});
+                }
+            }catch(...){
             }
-        }catch(...){
         }
 
         // Reset Packet id's
@@ -343,6 +773,122 @@ void PacketStreamReader::RebuildIndex()
     }
 }
 
+// The file is split into chunks which are scanned in parallel, each
+// resynchronising on the first plausible record in it. Chunks are then
+// taken in order, from the record the previous one ended on. A chunk whose
+// scan doesn't pass through that record (it started inside a packet
+// payload which happened to parse, or the data is corrupt) is rescanned
+// from it. Sources declared part way through are handled the same way,
+// since chunks scanned without knowing them stop at their packets.
+void PacketStreamReader::ScanIndex(std::shared_ptr<MappedFile> file, uint64_t from, bool background)
+{
+    const char* data = file->Data();
+    const size_t size = file->Size();
+    if(from >= size) return;
+
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const uint64_t min_chunk_bytes = 8 << 20;
+    const uint64_t chunk_bytes = std::max(min_chunk_bytes, (size - from) / (4 * num_threads) + 1);
+
+    std::vector<uint64_t> bounds;
+    for(uint64_t b = from; b < size; b += chunk_bytes) {
+        bounds.push_back(b);
+    }
+    bounds.push_back(size);
+    const size_t num_chunks = bounds.size() - 1;
+
+    // Sources declared so far, without their index.
+    std::vector<PacketStreamSource> sources;
+    {
+        lock_guard<decltype(_mutex)> lg(_mutex);
+        for(const PacketStreamSource& s : _sources) {
+            sources.push_back(s);
+            sources.back().index.clear();
+        }
+    }
+    const std::vector<PacketStreamSource> initial_sources = sources;
+
+    auto index = [&](PacketStreamSourceId src) -> std::vector<PacketStreamSource::PacketInfo>& {
+        return src < _sources.size() ? _sources[src].index : _scanned_sources[src].index;
+    };
+
+    // Chunks beyond the end of the packets needn't be scanned.
+    std::atomic<bool> finished(false);
+
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<std::future<PacketIndexScan>> scans;
+    if(num_chunks > 1) {
+        pool.reset(new ThreadPool(std::min(num_threads, num_chunks)));
+        for(size_t k=0; k < num_chunks; ++k) {
+            scans.push_back(pool->Run([this, data, size, k, &bounds, &initial_sources, &finished](){
+                if(_stop_indexing || finished) return PacketIndexScan();
+                return ScanPacketIndex(data, size, bounds[k], bounds[k+1], initial_sources, k > 0);
+            }));
+        }
+    }
+
+    uint64_t current = from;
+    for(size_t k=0; k < num_chunks && !finished && !_stop_indexing; ++k) {
+        PacketIndexScan scan = pool ? scans[k].get() : ScanPacketIndex(data, size, from, size, sources, false);
+        lock_guard<decltype(_mutex)> lg(_mutex);
+
+        bool rescanned = false;
+        while(current < bounds[k+1] && !finished) {
+            if(scan.status == PacketIndexScan::DataEnd && scan.end == current) {
+                finished = true;
+            }else if(std::binary_search(scan.records.begin(), scan.records.end(), current)) {
+                // In step with the stream from current onwards.
+                for(size_t i = sources.size(); i < scan.sources.size(); ++i) {
+                    sources.push_back(scan.sources[i]);
+                    if(i < _sources.size()) {
+                        // Reading has already reached its declaration.
+                    }else if(background) {
+                        _scanned_sources.resize(i + 1);
+                        _scanned_sources[i] = scan.sources[i];
+                    }else{
+                        _sources.push_back(scan.sources[i]);
+                    }
+                }
+                for(const PacketIndexScan::Entry& e : scan.packets) {
+                    if(static_cast<uint64_t>(e.info.pos) >= current) {
+                        index(e.src).push_back(e.info);
+                    }
+                }
+                current = scan.end;
+                if(scan.status == PacketIndexScan::DataEnd) {
+                    finished = true;
+                }else if(scan.status == PacketIndexScan::BadRecord) {
+                    scan = ScanPacketIndex(data, size, current, bounds[k+1], sources, false);
+                    rescanned = true;
+                }
+            }else if(!rescanned) {
+                scan = ScanPacketIndex(data, size, current, bounds[k+1], sources, false);
+                rescanned = true;
+            }else{
+                // Nothing parses at current: skip to the next plausible
+                // record, as ReSync() does.
+                pango_print_warn("Skipping unreadable data at %llu in '%s'.\n", (unsigned long long)current, _filename.c_str());
+                scan = ScanPacketIndex(data, size, current + 1, bounds[k+1], sources, true);
+                current = scan.records.empty() ? scan.end : scan.records.front();
+                if(scan.records.empty() && scan.status == PacketIndexScan::DataEnd) {
+                    finished = true;
+                }
+            }
+        }
+    }
+    finished = true;
+}
+
+void PacketStreamReader::StopIndexing()
+{
+    if(_index_thread.joinable()) {
+        _stop_indexing = true;
+        _index_thread.join();
+        _indexing = false;
+        _stop_indexing = false;
+    }
+}
+
 void PacketStreamReader::AppendIndex()
 {
     lock_guard<decltype(_mutex)> lg(_mutex);
@@ -353,8 +899,18 @@ void PacketStreamReader::AppendIndex()
         if(of.is_open()) {
             pango_print_warn("Appending new index to '%s'.\n", _filename.c_str());
             uint64_t indexpos = (uint64_t)of.tellp();
-            writeTag(of, TAG_PANGO_STATS);
-            SourceStats(_sources).serialize(std::ostream_iterator<char>(of), false);
+
+            // Including sources whose declarations reading has yet to reach.
+            std::string index;
+            if(_scanned_sources.size() > _sources.size()) {
+                std::vector<PacketStreamSource> sources = _sources;
+                sources.insert(sources.end(), _scanned_sources.begin() + _sources.size(), _scanned_sources.end());
+                index = SourceIndexBinary(sources);
+            }else{
+                index = SourceIndexBinary(_sources);
+            }
+            writeTag(of, TAG_PANGO_INDEX);
+            of.write(index.data(), index.size());
             writeTag(of, TAG_PANGO_FOOTER);
             of.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
         }
@@ -377,11 +933,11 @@ size_t PacketStreamReader::Seek(PacketStreamSourceId src, size_t framenum)
     PANGO_ASSERT(_stream.seekable());
     PANGO_ASSERT(src < _sources.size());
     PacketStreamSource& source = _sources[src];
-    PANGO_ASSERT(framenum < source.index.size());
+    PANGO_ASSERT(framenum < NumPackets(src));
 
-    if(source.index[framenum].pos > 0) {
-        _stream.clear();
-        _stream.seekg(source.index[framenum].pos);
+    const std::streampos pos = IndexEntry(src, framenum).pos;
+    if(pos > 0) {
+        SeekStream(pos);
         source.next_packet_id = framenum;
     }
     return source.next_packet_id;
@@ -390,28 +946,44 @@ size_t PacketStreamReader::Seek(PacketStreamSourceId src, size_t framenum)
 // Jumps to the first packet with time >= time
 size_t PacketStreamReader::Seek(PacketStreamSourceId src, SyncTime::TimePoint time)
 {
-    PacketStreamSource& source = _sources[src];
+    lock_guard<decltype(_mutex)> lg(_mutex);
 
-    PacketStreamSource::PacketInfo v = {
-        0, std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count()
-    };
+    const size_t frame_num = FindFrame(src, time);
+    if(frame_num < NumPackets(src)) {
+        return Seek(src, frame_num);
+    }else{
+        return _sources[src].next_packet_id;
+    }
+}
 
-    // Find time in indextime
-    auto lb = std::lower_bound(
-        source.index.begin(), source.index.end(), v,
-        [](const PacketStreamSource::PacketInfo& a, const PacketStreamSource::PacketInfo& b){
-            return a.capture_time < b.capture_time;
-        }
-    );
+size_t PacketStreamReader::FindFrame(PacketStreamSourceId src, SyncTime::TimePoint time)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
 
-    if(lb != source.index.end()) {
-        const size_t frame_num = lb - source.index.begin();
-        return Seek(src, frame_num);
+    const int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+
+    if(_time_index.IsOpen()) {
+        return _time_index.LowerBound(src, time_us);
     }else{
-        return source.next_packet_id;
+        const auto& index = _sources[src].index;
+        return InterpolationLowerBound(index.size(), time_us, [&index](size_t i){
+            return index[i].capture_time;
+        });
     }
 }
 
+size_t PacketStreamReader::NumPackets(PacketStreamSourceId src)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    return _time_index.IsOpen() ? _time_index.NumPackets(src) : _sources[src].index.size();
+}
+
+PacketStreamSource::PacketInfo PacketStreamReader::IndexEntry(PacketStreamSourceId src, size_t framenum)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    return _time_index.IsOpen() ? _time_index.At(src, framenum) : _sources[src].index[framenum];
+}
+
 void PacketStreamReader::SkipSync()
 {
     //Assume we have just read PAN, read GO
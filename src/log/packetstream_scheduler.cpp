@@ -0,0 +1,91 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/log/packetstream_scheduler.h>
+
+#include <stdexcept>
+
+namespace pangolin {
+
+size_t PacketStreamScheduler::AddStream(const std::shared_ptr<PacketStreamReader>& reader, PacketStreamSourceId src)
+{
+    if(src >= reader->Sources().size()) {
+        throw std::invalid_argument("PacketStreamScheduler: no such source.");
+    }
+
+    const size_t stream = _streams.size();
+    _streams.push_back({reader, src});
+    Schedule(stream, reader->Sources()[src].next_packet_id);
+    return stream;
+}
+
+void PacketStreamScheduler::AddStreams(const std::shared_ptr<PacketStreamReader>& reader)
+{
+    for(PacketStreamSourceId src=0; src < reader->Sources().size(); ++src) {
+        AddStream(reader, src);
+    }
+}
+
+void PacketStreamScheduler::Schedule(size_t stream, size_t frame)
+{
+    // Sources()[src].index is empty for readers opened with a sparse index.
+    const Stream& s = _streams[stream];
+    if(frame < s.reader->NumPackets(s.src)) {
+        _queue.push({s.reader->IndexEntry(s.src, frame).capture_time, stream, frame});
+    }
+}
+
+Packet PacketStreamScheduler::NextFrame(size_t& stream)
+{
+    if(_queue.empty()) {
+        throw std::runtime_error("PacketStreamScheduler: end of streams");
+    }
+
+    const Event e = _queue.top();
+    _queue.pop();
+    const Stream& s = _streams[e.stream];
+
+    // Consecutive packets of a file are read without seeking.
+    s.reader->Seek(s.src, e.frame);
+    Packet packet = s.reader->NextFrame();
+    if(packet.src != s.src) {
+        throw std::runtime_error("PacketStreamScheduler: index does not match stream.");
+    }
+
+    Schedule(e.stream, e.frame + 1);
+    stream = e.stream;
+    return packet;
+}
+
+void PacketStreamScheduler::Seek(SyncTime::TimePoint time)
+{
+    _queue = std::priority_queue<Event>();
+    for(size_t stream=0; stream < _streams.size(); ++stream) {
+        const Stream& s = _streams[stream];
+        Schedule(stream, s.reader->FindFrame(s.src, time));
+    }
+}
+
+}
@@ -27,6 +27,9 @@
 #include <pangolin/utils/file_utils.h>
 #include <pangolin/utils/timer.h>
 
+#include <cstdio>
+#include <cstring>
+
 using std::ios;
 using std::lock_guard;
 
@@ -46,18 +49,57 @@ static inline const std::string CurrentTimeStr()
     return buffer;
 }
 
+struct PacketStreamWriter::ThreadIndex
+{
+    struct Entry
+    {
+        PacketStreamSourceId src;
+        PacketStreamSource::PacketInfo info;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+};
+
+struct PacketStreamWriter::SourceCompression
+{
+    SourceCompression(const std::string& codec)
+        : compressor(codec)
+    {
+    }
+
+    std::mutex mutex;
+    PacketCompressor compressor;
+};
+
+// Control records are composed up front and written with a single call, so
+// that they occupy one contiguous reservation in the write buffer even when
+// other threads are appending packets.
+
 void PacketStreamWriter::WriteHeader()
 {
     SCOPED_LOCK;
-    _stream.write(PANGO_MAGIC.c_str(), PANGO_MAGIC.size());
     picojson::value pango;
     pango["pangolin_version"] = PANGOLIN_VERSION_STRING;
     pango["time_us"] = Time_us(TimeNow());
+    if(_segment_index == 0) {
+        _first_segment_time_us = pango["time_us"].get<int64_t>();
+    }else{
+        // Identifies the recording this file continues, so that readers
+        // ignore stale segments left over from an earlier recording.
+        pango["segment_index"] = _segment_index;
+        pango["first_segment_time_us"] = _first_segment_time_us;
+    }
     pango["date_created"] = CurrentTimeStr();
     pango["endian"] = "little_endian";
+    if(_checkpoint_packets && _indexable) {
+        pango["checkpoint_packets"] = _checkpoint_packets;
+    }
 
-    writeTag(_stream, TAG_PANGO_HDR);
-    pango.serialize(std::ostream_iterator<char>(_stream), true);
+    std::string header = PANGO_MAGIC;
+    appendTag(header, TAG_PANGO_HDR);
+    header += pango.serialize(true);
+    _stream.write(header.data(), header.size());
 
     for (const auto& source : _sources)
         Write(source);
@@ -75,9 +117,13 @@ void PacketStreamWriter::Write(const PacketStreamSource& source)
     serialize[pss_src_packet][pss_pkt_alignment_bytes] = source.data_alignment_bytes;
     serialize[pss_src_packet][pss_pkt_definitions] = source.data_definitions;
     serialize[pss_src_packet][pss_pkt_size_bytes] = source.data_size_bytes;
+    if (!source.data_compression.empty())
+        serialize[pss_src_packet][pss_pkt_compression] = source.data_compression;
 
-    writeTag(_stream, TAG_ADD_SOURCE);
-    serialize.serialize(std::ostream_iterator<char>(_stream), true);
+    std::string record;
+    appendTag(record, TAG_ADD_SOURCE);
+    record += serialize.serialize(true);
+    _stream.write(record.data(), record.size());
 }
 
 
@@ -95,49 +141,411 @@ PacketStreamSourceId PacketStreamWriter::AddSource(const PacketStreamSource& sou
     _sources.push_back(source);
     _sources.back().id = r;
 
+    _compression.resize(_sources.size());
+    std::string& codec = _sources.back().data_compression;
+    if (!codec.empty()) {
+        if (PacketCompressor::Supported(codec)) {
+            _compression.back() = std::make_shared<SourceCompression>(codec);
+        }else{
+            pango_print_warn("PacketStreamWriter: '%s' compression not available. Storing packets uncompressed.\n", codec.c_str());
+            codec.clear();
+        }
+    }
+
     if (_open) //we might be a pipe, in which case we may not be open
         Write(_sources.back());
 
     return _sources.back().id;
 }
 
-void PacketStreamWriter::WriteMeta(PacketStreamSourceId src, const picojson::value& data)
+void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const char* source, const int64_t receive_time_us, size_t sourcelen, const picojson::value& meta)
 {
-    SCOPED_LOCK;
-    writeTag(_stream, TAG_SRC_JSON);
-    writeCompressedUnsignedInt(_stream, src);
-    data.serialize(std::ostream_iterator<char>(_stream), false);
+    const std::pair<const char*,size_t> part(source, sourcelen);
+    WritePacket(src, &part, 1, receive_time_us, meta);
 }
 
-void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const char* source, const int64_t receive_time_us, size_t sourcelen, const picojson::value& meta)
+void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const std::vector<std::pair<const char*,size_t>>& sources, const int64_t receive_time_us, const picojson::value& meta)
+{
+    WritePacket(src, sources.data(), sources.size(), receive_time_us, meta);
+}
+
+void PacketStreamWriter::WritePacket(PacketStreamSourceId src, const std::pair<const char*,size_t>* sources, size_t num_sources, const int64_t receive_time_us, const picojson::value& meta)
 {
+    if(!_open) {
+        return;
+    }
 
-    SCOPED_LOCK;
-    _sources[src].index.push_back({_stream.tellp(), receive_time_us});
+    size_t sourcelen = 0;
+    for(size_t i=0; i < num_sources; ++i) {
+        sourcelen += sources[i].second;
+    }
+
+    if(_indexable && (_segment_max_bytes || _segment_max_us)) {
+        // Rolling over swaps the underlying file, so segmented writers
+        // append one packet at a time.
+        SCOPED_LOCK;
+        if(_segment_start_time_us < 0) {
+            _segment_start_time_us = receive_time_us;
+            PrepareNextSegment();
+        }else if( (_segment_max_bytes && static_cast<size_t>(_stream.tellp()) >= _segment_max_bytes) ||
+                  (_segment_max_us && receive_time_us - _segment_start_time_us >= _segment_max_us) ) {
+            StartNewSegment();
+            _segment_start_time_us = receive_time_us;
+            PrepareNextSegment();
+        }
+        StorePacket(src, sources, num_sources, sourcelen, receive_time_us, meta);
+    }else{
+        StorePacket(src, sources, num_sources, sourcelen, receive_time_us, meta);
+    }
 
-    if (!meta.is<picojson::null>())
-        WriteMeta(src, meta);
+    _bytes_written += sourcelen;
+    PacketWritten();
+}
+
+void PacketStreamWriter::StorePacket(PacketStreamSourceId src, const std::pair<const char*,size_t>* sources, size_t num_sources, size_t sourcelen, const int64_t receive_time_us, const picojson::value& meta)
+{
+    SourceCompression* c = src < _compression.size() ? _compression[src].get() : nullptr;
+    if(!c) {
+        AppendPacket(src, PacketHeader(src, receive_time_us, sourcelen, sourcelen, meta), sources, num_sources, sourcelen, receive_time_us);
+        return;
+    }
+
+    thread_local std::string stored;
+    stored.clear();
+    {
+        // Packets using the dictionary are reserved after its record.
+        lock_guard<std::mutex> l(c->mutex);
+        WriteDictionary(src, *c);
+        c->compressor.Compress(sources, num_sources, stored);
+    }
+    const std::string header = PacketHeader(src, receive_time_us, sourcelen, stored.size(), meta);
+    const std::pair<const char*,size_t> part(stored.data(), stored.size());
+    AppendPacket(src, header, &part, 1, stored.size(), receive_time_us);
+}
 
-    writeTag(_stream, TAG_SRC_PACKET);
-    writeTimestamp(_stream, receive_time_us);
-    writeCompressedUnsignedInt(_stream, src);
+// Packet header, preceded by any metadata:
+//   TAG_SRC_JSON, varint source id, JSON metadata
+// or
+//   TAG_SRC_META, varint source id, varint position of the schema record
+//   giving the keys, varint length, AppendPacketMeta encoded values
+// then
+//   TAG_SRC_PACKET, int64 time, varint source id, varint stored length unless
+//   the source has a fixed packet size and is stored uncompressed
+std::string PacketStreamWriter::PacketHeader(PacketStreamSourceId src, const int64_t receive_time_us, size_t sourcelen, size_t storedlen, const picojson::value& meta)
+{
+    std::string header;
+    if (meta.is<picojson::object>() && !_json_meta) {
+        const picojson::object& obj = meta.get<picojson::object>();
+        const uint64_t schema_pos = MetaSchema(src, obj);
+        std::string values;
+        AppendPacketMeta(values, obj);
+        appendTag(header, TAG_SRC_META);
+        appendCompressedUnsignedInt(header, src);
+        appendCompressedUnsignedInt(header, schema_pos);
+        appendCompressedUnsignedInt(header, values.size());
+        header += values;
+    }else if (!meta.is<picojson::null>()) {
+        appendTag(header, TAG_SRC_JSON);
+        appendCompressedUnsignedInt(header, src);
+        header += meta.serialize(false);
+    }
+    appendTag(header, TAG_SRC_PACKET);
+    header.append(reinterpret_cast<const char*>(&receive_time_us), sizeof(int64_t));
+    appendCompressedUnsignedInt(header, src);
 
     if (_sources[src].data_size_bytes) {
         if (sourcelen != static_cast<size_t>(_sources[src].data_size_bytes))
             throw std::runtime_error("oPacketStream::writePacket --> Tried to write a fixed-size packet with bad size.");
-    } else {
-        writeCompressedUnsignedInt(_stream, sourcelen);
     }
+    if (!_sources[src].data_size_bytes || !_sources[src].data_compression.empty()) {
+        appendCompressedUnsignedInt(header, storedlen);
+    }
+    return header;
+}
 
-    _stream.write(source, sourcelen);
-    _bytes_written += sourcelen;
+// Schema record:
+//   TAG_META_SCHEMA, uint64 position of this record, varint source id,
+//   varint number of keys, then each key as varint length and characters.
+// Schemas are written just ahead of the first packet using them and
+// referenced by position, so readers that seek past one can go back for it.
+uint64_t PacketStreamWriter::MetaSchema(PacketStreamSourceId src, const picojson::object& meta)
+{
+    std::string signature = PacketMetaSignature(meta);
+
+    lock_guard<std::mutex> l(_meta_lock);
+    auto it = _meta_schemas.find({src, signature});
+    if(it != _meta_schemas.end()) {
+        return it->second;
+    }
+
+    std::string keys;
+    appendCompressedUnsignedInt(keys, src);
+    appendCompressedUnsignedInt(keys, meta.size());
+    for(const auto& kv : meta) {
+        appendCompressedUnsignedInt(keys, kv.first.size());
+        keys += kv.first;
+    }
+
+    threadedfilebuf::reservation r = _buffer->reserve(TAG_LENGTH + sizeof(uint64_t) + keys.size());
+    const uint64_t pos = r.begin;
+    std::string record;
+    appendTag(record, TAG_META_SCHEMA);
+    record.append(reinterpret_cast<const char*>(&pos), sizeof(uint64_t));
+    record += keys;
+    _buffer->put(r, record.data(), record.size());
+    _buffer->publish(r);
+
+    _meta_schemas.emplace(std::make_pair(src, std::move(signature)), pos);
+    return pos;
+}
+
+void PacketStreamWriter::ClearMetaSchemas()
+{
+    lock_guard<std::mutex> l(_meta_lock);
+    _meta_schemas.clear();
+}
+
+// Dictionary record:
+//   TAG_SRC_DICT, uint64 position of this record, varint source id,
+//   varint dictionary length, then the dictionary.
+void PacketStreamWriter::WriteDictionary(PacketStreamSourceId src, SourceCompression& c)
+{
+    const std::string& dict = c.compressor.Dictionary();
+    if(dict.empty() || c.compressor.DictionaryPos()) {
+        return;
+    }
+
+    std::string head;
+    appendCompressedUnsignedInt(head, src);
+    appendCompressedUnsignedInt(head, dict.size());
+
+    threadedfilebuf::reservation r = _buffer->reserve(TAG_LENGTH + sizeof(uint64_t) + head.size() + dict.size());
+    const uint64_t pos = r.begin;
+    std::string record;
+    appendTag(record, TAG_SRC_DICT);
+    record.append(reinterpret_cast<const char*>(&pos), sizeof(uint64_t));
+    record += head;
+    _buffer->put(r, record.data(), record.size());
+    _buffer->put(r, dict.data(), dict.size());
+    _buffer->publish(r);
+
+    c.compressor.SetDictionaryPos(pos);
+}
+
+void PacketStreamWriter::ResetDictionaries()
+{
+    for(auto& c : _compression) {
+        if(c) {
+            lock_guard<std::mutex> l(c->mutex);
+            c->compressor.SetDictionaryPos(0);
+        }
+    }
+}
+
+void PacketStreamWriter::AppendPacket(PacketStreamSourceId src, const std::string& header, const std::pair<const char*,size_t>* sources, size_t num_sources, size_t sourcelen, const int64_t receive_time_us)
+{
+    threadedfilebuf::reservation r = _buffer->reserve(header.size() + sourcelen);
+
+    // Recorded before publishing, so that once everything up to a position
+    // has been published, the entries for it are all present (see MergeIndex).
+    ThreadIndex& local = LocalIndex();
+    {
+        lock_guard<std::mutex> l(local.mutex);
+        local.entries.push_back({src, {static_cast<std::streampos>(r.begin), receive_time_us}});
+    }
+
+    _buffer->put(r, header.data(), header.size());
+    for(size_t i=0; i < num_sources; ++i) {
+        _buffer->put(r, sources[i].first, sources[i].second);
+    }
+    _buffer->publish(r);
+}
+
+PacketStreamWriter::ThreadIndex& PacketStreamWriter::LocalIndex()
+{
+    // Keyed by writer id rather than address, since a writer may be destroyed
+    // and another constructed in its place.
+    thread_local std::vector<std::pair<uint64_t,std::shared_ptr<ThreadIndex>>> local;
+    for(const auto& l : local) {
+        if(l.first == _id) return *l.second;
+    }
+
+    // Forget indices whose writer has since been destroyed.
+    local.erase(std::remove_if(local.begin(), local.end(), [](const std::pair<uint64_t,std::shared_ptr<ThreadIndex>>& l){
+        return l.second.use_count() == 1;
+    }), local.end());
+
+    auto index = std::make_shared<ThreadIndex>();
+    {
+        lock_guard<std::mutex> l(_thread_index_lock);
+        _thread_index.push_back(index);
+    }
+    local.emplace_back(_id, index);
+    return *index;
+}
+
+void PacketStreamWriter::MergeIndex()
+{
+    SCOPED_LOCK;
+
+    // Every packet starting before barrier has its entry recorded once the
+    // buffer is published up to it. Later packets are left for next time.
+    const uint64_t barrier = static_cast<uint64_t>(_stream.tellp());
+    _buffer->wait_published(barrier);
+
+    std::vector<ThreadIndex::Entry> merged;
+    {
+        lock_guard<std::mutex> l(_thread_index_lock);
+        for(auto& index : _thread_index) {
+            lock_guard<std::mutex> li(index->mutex);
+            auto it = std::stable_partition(index->entries.begin(), index->entries.end(), [barrier](const ThreadIndex::Entry& e){
+                return static_cast<uint64_t>(e.info.pos) < barrier;
+            });
+            merged.insert(merged.end(), index->entries.begin(), it);
+            index->entries.erase(index->entries.begin(), it);
+        }
+    }
+
+    std::sort(merged.begin(), merged.end(), [](const ThreadIndex::Entry& a, const ThreadIndex::Entry& b){
+        return a.info.pos < b.info.pos;
+    });
+    for(const auto& e : merged) {
+        _sources[e.src].index.push_back(e.info);
+    }
+}
+
+void PacketStreamWriter::ClearIndex()
+{
+    SCOPED_LOCK;
+    lock_guard<std::mutex> l(_thread_index_lock);
+    for(auto& index : _thread_index) {
+        lock_guard<std::mutex> li(index->mutex);
+        index->entries.clear();
+    }
+    for(auto& s : _sources) {
+        s.index.clear();
+    }
+}
+
+void PacketStreamWriter::StartNewSegment()
+{
+    SCOPED_LOCK;
+    WriteEnd();
+
+    ++_segment_index;
+    std::unique_ptr<threadedfilebuf> next = _next_segment.valid() ?
+        _next_segment.get() : OpenBuffer(PacketStreamSegmentFilename(_filename, _segment_index));
+
+    // The finished file may still have data to flush, so it is closed off
+    // this thread (which is usually grabbing frames).
+    if(_closing_segment.valid()) {
+        _closing_segment.get();
+    }
+    std::swap(_buffer, next);
+    _closing_segment = std::async(std::launch::async, [](std::unique_ptr<threadedfilebuf> done){
+        done->close();
+    }, std::move(next));
+
+    _stream.rdbuf(_buffer.get());
+    _open = _stream.good();
+
+    // Index and schema positions are relative to each file.
+    ClearIndex();
+    ClearMetaSchemas();
+    ResetDictionaries();
+    ResetCheckpoints();
+
+    // Re-declares all sources in the new file.
+    WriteHeader();
+}
+
+void PacketStreamWriter::PrepareNextSegment()
+{
+    if(!_next_segment.valid()) {
+        const std::string filename = PacketStreamSegmentFilename(_filename, _segment_index + 1);
+        _next_segment = std::async(std::launch::async, [this, filename](){
+            return OpenBuffer(filename);
+        });
+    }
+}
+
+std::unique_ptr<threadedfilebuf> PacketStreamWriter::OpenBuffer(const std::string& filename) const
+{
+    std::unique_ptr<threadedfilebuf> buffer(new threadedfilebuf());
+    buffer->set_direct_io(_direct_io, _sync_bytes);
+    buffer->set_io_uring(_io_uring_depth);
+    buffer->open(filename, _buffer_size);
+    return buffer;
+}
+
+void PacketStreamWriter::FinishSegments()
+{
+    if(_closing_segment.valid()) {
+        _closing_segment.get();
+    }
+    if(_next_segment.valid()) {
+        // Not needed after all: remove it so that readers don't find it.
+        std::unique_ptr<threadedfilebuf> unused = _next_segment.get();
+        unused->close();
+        std::remove(PacketStreamSegmentFilename(_filename, _segment_index + 1).c_str());
+    }
+}
+
+void PacketStreamWriter::PacketWritten()
+{
+    if(_checkpoint_packets && _indexable && ++_packets_since_checkpoint % _checkpoint_packets == 0) {
+        WriteCheckpoint();
+    }
+}
+
+// Checkpoint record:
+//   TAG_PANGO_CHECKPOINT, SourceIndexBinary of packets since the previous
+//   checkpoint, uint64 position of the previous checkpoint (0 if none),
+//   uint64 position of this checkpoint, TAG_PANGO_CHECKPOINT
+// The trailing position and tag let readers find the last checkpoint by
+// scanning backwards from the end of a truncated file. With concurrent
+// writers, packets may be reserved between merging the index and reserving
+// the checkpoint, so readers rescan from the last packet indexed.
+void PacketStreamWriter::WriteCheckpoint()
+{
+    SCOPED_LOCK;
+    MergeIndex();
+    const std::string index = SourceIndexBinary(_sources, _checkpoint_index_start);
+
+    threadedfilebuf::reservation r = _buffer->reserve(2*TAG_LENGTH + index.size() + 2*sizeof(uint64_t));
+    const uint64_t pos = r.begin;
+
+    std::string record;
+    appendTag(record, TAG_PANGO_CHECKPOINT);
+    record += index;
+    record.append(reinterpret_cast<const char*>(&_last_checkpoint_pos), sizeof(uint64_t));
+    record.append(reinterpret_cast<const char*>(&pos), sizeof(uint64_t));
+    appendTag(record, TAG_PANGO_CHECKPOINT);
+    _buffer->put(r, record.data(), record.size());
+    _buffer->publish(r);
+
+    _last_checkpoint_pos = pos;
+    _checkpoint_index_start.resize(_sources.size());
+    for(size_t i=0; i < _sources.size(); ++i) {
+        _checkpoint_index_start[i] = _sources[i].index.size();
+    }
+}
+
+void PacketStreamWriter::ResetCheckpoints()
+{
+    SCOPED_LOCK;
+    _packets_since_checkpoint = 0;
+    _last_checkpoint_pos = 0;
+    _checkpoint_index_start.clear();
 }
 
 void PacketStreamWriter::WriteSync()
 {
     SCOPED_LOCK;
+    std::string sync;
     for (unsigned i = 0; i < 10; ++i)
-    writeTag(_stream, TAG_PANGO_SYNC);
+        appendTag(sync, TAG_PANGO_SYNC);
+    _stream.write(sync.data(), sync.size());
 }
 
 void PacketStreamWriter::WriteEnd()
@@ -146,11 +554,40 @@ void PacketStreamWriter::WriteEnd()
     if (!_indexable)
         return;
 
-    auto indexpos = _stream.tellp();
-    writeTag(_stream, TAG_PANGO_STATS);
-    SourceStats(_sources).serialize(std::ostream_iterator<char>(_stream), false);
-    writeTag(_stream, TAG_PANGO_FOOTER);
-    _stream.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
+    MergeIndex();
+
+    // The time index ends with its own position, just ahead of the index,
+    // so readers can find it from the footer. Older readers ignore it.
+    std::string time_index;
+    if(!_json_index) {
+        appendTag(time_index, TAG_PANGO_TIME_INDEX);
+        time_index += SourceTimeIndexBinary(_sources);
+        time_index.append(sizeof(uint64_t), '\0');
+        appendTag(time_index, TAG_PANGO_TIME_INDEX);
+    }
+
+    std::string record;
+    if(_json_index) {
+        appendTag(record, TAG_PANGO_STATS);
+        record += SourceStats(_sources).serialize(false);
+    }else{
+        appendTag(record, TAG_PANGO_INDEX);
+        record += SourceIndexBinary(_sources);
+    }
+    appendTag(record, TAG_PANGO_FOOTER);
+
+    // The footer points back at the index, so its position must be known
+    // before the record is written.
+    threadedfilebuf::reservation r = _buffer->reserve(time_index.size() + record.size() + sizeof(uint64_t));
+    const uint64_t time_index_pos = r.begin;
+    const uint64_t indexpos = r.begin + time_index.size();
+    if(!time_index.empty()) {
+        std::memcpy(&time_index[time_index.size() - TAG_LENGTH - sizeof(uint64_t)], &time_index_pos, sizeof(uint64_t));
+        _buffer->put(r, time_index.data(), time_index.size());
+    }
+    record.append(reinterpret_cast<const char*>(&indexpos), sizeof(uint64_t));
+    _buffer->put(r, record.data(), record.size());
+    _buffer->publish(r);
 }
 
 }
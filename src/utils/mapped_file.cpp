@@ -0,0 +1,291 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/utils/mapped_file.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN_
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif // _WIN_
+
+namespace pangolin
+{
+
+#ifdef _WIN_
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& /*filename*/)
+{
+    return nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+size_t MappedFile::FileSize() const
+{
+    return size;
+}
+
+std::shared_ptr<MappedFile> MappedFile::Remap() const
+{
+    return nullptr;
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& filename)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd == -1) {
+        return nullptr;
+    }
+    return Map(fd);
+}
+
+std::shared_ptr<MappedFile> MappedFile::Map(int fd)
+{
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    if(addr == MAP_FAILED) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The descriptor is kept to follow the size of the file.
+    return std::shared_ptr<MappedFile>(new MappedFile(fd, static_cast<const char*>(addr), st.st_size));
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<char*>(data), size);
+    ::close(fd);
+}
+
+size_t MappedFile::FileSize() const
+{
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        return 0;
+    }
+    return static_cast<size_t>(st.st_size);
+}
+
+std::shared_ptr<MappedFile> MappedFile::Remap() const
+{
+    const int fd2 = dup(fd);
+    if(fd2 == -1) {
+        return nullptr;
+    }
+    return Map(fd2);
+}
+
+#endif // _WIN_
+
+// Reads at least this large check the file size first.
+static const std::streamsize refresh_read_bytes = 4096;
+
+// Size of the read buffer once reads have fallen back to a streambuf.
+static const size_t fallback_buffer_bytes = 64 * 1024;
+
+mappedstreambuf::mappedstreambuf()
+    : fallback(nullptr), base(0)
+{
+    setg(nullptr, nullptr, nullptr);
+}
+
+void mappedstreambuf::reset(std::shared_ptr<MappedFile> file, std::streambuf* fallback_buf)
+{
+    mapping = file;
+    fallback = fallback_buf;
+    base = 0;
+    buffer.clear();
+    if(mapping) {
+        char* begin = const_cast<char*>(mapping->Data());
+        setg(begin, begin, begin + mapping->Size());
+    }else if(fallback) {
+        UseFallback(0);
+    }else{
+        setg(nullptr, nullptr, nullptr);
+    }
+}
+
+void mappedstreambuf::Refresh()
+{
+    if(!mapping) return;
+
+    const off_type pos = Position();
+    const size_t readable = egptr() - eback();
+    const size_t file_size = mapping->FileSize();
+    if(file_size == readable) return;
+
+    if(file_size <= mapping->Size()) {
+        // Truncated, or regrown within the existing mapping.
+        char* begin = const_cast<char*>(mapping->Data());
+        setg(begin, begin + std::min<size_t>(pos, file_size), begin + file_size);
+        return;
+    }
+
+    std::shared_ptr<MappedFile> grown = mapping->Remap();
+    if(grown && grown->Size() >= file_size) {
+        mapping = grown;
+        char* begin = const_cast<char*>(mapping->Data());
+        setg(begin, begin + pos, begin + mapping->Size());
+    }else if(fallback) {
+        UseFallback(pos);
+    }else{
+        char* begin = const_cast<char*>(mapping->Data());
+        setg(begin, begin + pos, begin + mapping->Size());
+    }
+}
+
+void mappedstreambuf::UseFallback(off_type pos)
+{
+    mapping.reset();
+    buffer.resize(fallback_buffer_bytes);
+    base = pos;
+    setg(buffer.data(), buffer.data(), buffer.data());
+}
+
+const char* mappedstreambuf::take(size_t len)
+{
+    if(!mapping) return nullptr;
+    if(static_cast<size_t>(egptr() - gptr()) < len || len >= size_t(refresh_read_bytes)) {
+        Refresh();
+        if(!mapping || static_cast<size_t>(egptr() - gptr()) < len) {
+            return nullptr;
+        }
+    }
+    char* p = gptr();
+    setg(eback(), p + len, egptr());
+    return p;
+}
+
+mappedstreambuf::int_type mappedstreambuf::underflow()
+{
+    if(mapping) {
+        Refresh();
+    }
+
+    if(!mapping && fallback) {
+        const off_type pos = Position();
+        std::streamsize n = 0;
+        if(fallback->pubseekpos(pos, std::ios_base::in) == pos_type(pos)) {
+            n = fallback->sgetn(buffer.data(), buffer.size());
+        }
+        base = pos;
+        setg(buffer.data(), buffer.data(), buffer.data() + std::max<std::streamsize>(n, 0));
+    }
+
+    return gptr() < egptr() ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+}
+
+std::streamsize mappedstreambuf::xsgetn(char_type* s, std::streamsize n)
+{
+    if(mapping && (n >= refresh_read_bytes || egptr() - gptr() < n)) {
+        Refresh();
+    }
+
+    std::streamsize copied = std::min<std::streamsize>(n, egptr() - gptr());
+    if(copied > 0) {
+        std::memcpy(s, gptr(), copied);
+        setg(eback(), gptr() + copied, egptr());
+    }
+
+    if(copied < n && !mapping && fallback && n - copied >= std::streamsize(buffer.size())) {
+        // Large reads go straight to the fallback, without buffering.
+        const off_type pos = Position();
+        std::streamsize read = 0;
+        if(fallback->pubseekpos(pos, std::ios_base::in) == pos_type(pos)) {
+            read = std::max<std::streamsize>(0, fallback->sgetn(s + copied, n - copied));
+        }
+        base = pos + read;
+        setg(buffer.data(), buffer.data(), buffer.data());
+        return copied + read;
+    }
+
+    // Anything else is read a buffer at a time.
+    while(copied < n && underflow() != traits_type::eof()) {
+        const std::streamsize c = std::min<std::streamsize>(n - copied, egptr() - gptr());
+        std::memcpy(s + copied, gptr(), c);
+        setg(eback(), gptr() + c, egptr());
+        copied += c;
+    }
+    return copied;
+}
+
+mappedstreambuf::pos_type mappedstreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if(!(which & std::ios_base::in) || (!mapping && !fallback)) {
+        return pos_type(off_type(-1));
+    }
+
+    // Querying the position (as tellg() does) shouldn't cost a system call.
+    const off_type current = Position();
+    if(dir == std::ios_base::cur && off == 0) {
+        return pos_type(current);
+    }
+    Refresh();
+
+    off_type end;
+    if(mapping) {
+        end = egptr() - eback();
+    }else{
+        end = fallback->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+    }
+
+    const off_type origin = (dir == std::ios_base::beg) ? 0 :
+                            (dir == std::ios_base::cur) ? current : end;
+    const off_type target = origin + off;
+    if(target < 0 || target > end) {
+        return pos_type(off_type(-1));
+    }
+
+    if(target >= base && target <= base + (egptr() - eback())) {
+        setg(eback(), eback() + (target - base), egptr());
+    }else{
+        base = target;
+        setg(buffer.data(), buffer.data(), buffer.data());
+    }
+    return pos_type(target);
+}
+
+mappedstreambuf::pos_type mappedstreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+}
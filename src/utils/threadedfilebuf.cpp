@@ -29,26 +29,172 @@
 #include <pangolin/utils/file_utils.h>
 #include <pangolin/utils/sigstate.h>
 
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <stdexcept>
+#include <vector>
 
 #ifdef USE_POSIX_FILE_IO
 #include <unistd.h>
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_IO_URING
+#include <deque>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
 using namespace std;
 
 namespace pangolin
 {
 
+// Alignment of buffer address, file offset and length for O_DIRECT writes
+static const std::streamsize direct_io_block = 4096;
+
+#ifdef HAVE_IO_URING
+// Largest single write queued with io_uring
+static const std::streamsize uring_chunk_bytes = 1 << 20;
+
+// Minimal io_uring submission / completion queue for positioned writes.
+// Uses the system calls directly so that liburing isn't required.
+class threadedfilebuf::uring_queue
+{
+public:
+    // Returns nullptr if the kernel doesn't support (or permit) io_uring.
+    static std::unique_ptr<uring_queue> Create(unsigned entries)
+    {
+        std::unique_ptr<uring_queue> q(new uring_queue());
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        q->ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if(q->ring_fd < 0) return nullptr;
+
+        q->sq_ring_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        q->cq_ring_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single_mmap) {
+            q->sq_ring_bytes = q->cq_ring_bytes = std::max(q->sq_ring_bytes, q->cq_ring_bytes);
+        }
+
+        q->sq_ring = Map(q->ring_fd, q->sq_ring_bytes, IORING_OFF_SQ_RING);
+        if(!q->sq_ring) return nullptr;
+        if(single_mmap) {
+            q->cq_ring = q->sq_ring;
+        }else{
+            q->cq_ring = Map(q->ring_fd, q->cq_ring_bytes, IORING_OFF_CQ_RING);
+            if(!q->cq_ring) return nullptr;
+        }
+        q->sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+        q->sqes = static_cast<io_uring_sqe*>(Map(q->ring_fd, q->sqes_bytes, IORING_OFF_SQES));
+        if(!q->sqes) return nullptr;
+
+        char* sq = static_cast<char*>(q->sq_ring);
+        char* cq = static_cast<char*>(q->cq_ring);
+        q->sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        q->sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        q->sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        q->cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        q->cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        q->cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        q->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return q;
+    }
+
+    ~uring_queue()
+    {
+        if(sqes) munmap(sqes, sqes_bytes);
+        if(cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_bytes);
+        if(sq_ring) munmap(sq_ring, sq_ring_bytes);
+        if(ring_fd >= 0) ::close(ring_fd);
+    }
+
+    // Queue a write of iov at file offset. iov must stay valid until the
+    // write completes, and no more writes may be outstanding than entries.
+    void write(int fd, const iovec* iov, uint64_t offset, uint64_t user_data)
+    {
+        const unsigned tail = *sq_tail;
+        const unsigned index = tail & sq_mask;
+        io_uring_sqe* sqe = sqes + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(iov);
+        sqe->len = 1;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++to_submit;
+    }
+
+    // Submit queued writes, waiting for at least min_complete completions.
+    void submit(unsigned min_complete)
+    {
+        while(to_submit || min_complete) {
+            const long r = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                                   min_complete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if(r < 0) {
+                if(errno == EINTR) continue;
+                throw std::runtime_error("Unable to submit writes.");
+            }
+            to_submit -= static_cast<unsigned>(r);
+            min_complete = 0;
+        }
+    }
+
+    // Take the next completion, if any.
+    bool pop(uint64_t& user_data, int& res)
+    {
+        const unsigned head = *cq_head;
+        if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes[head & cq_mask];
+        user_data = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    uring_queue() = default;
+
+    static void* Map(int fd, size_t bytes, off_t offset)
+    {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sq_ring_bytes = 0, cq_ring_bytes = 0, sqes_bytes = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned to_submit = 0;
+};
+#else
+class threadedfilebuf::uring_queue {};
+#endif
+
 threadedfilebuf::threadedfilebuf()
-    : mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), should_run(false), is_pipe(false)
+    : mem_buffer(0), mem_max_size(0), reserved(0), published(0), consumed(0),
+      producers_waiting(0), writer_waiting(0), should_run(false), discard(false), is_pipe(false)
 {
 }
 
 threadedfilebuf::threadedfilebuf(const std::string& filename, size_t buffer_size_bytes )
-    : mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), should_run(false), is_pipe(pangolin::IsPipe(filename))
+    : mem_buffer(0), mem_max_size(0), reserved(0), published(0), consumed(0),
+      producers_waiting(0), writer_waiting(0), should_run(false), discard(false), is_pipe(pangolin::IsPipe(filename))
 {
     open(filename, buffer_size_bytes);
 }
@@ -66,7 +212,19 @@ void threadedfilebuf::open(const std::string& filename, size_t buffer_size_bytes
     }
 
 #ifdef USE_POSIX_FILE_IO
-    filenum = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_SYNC, S_IRWXU);
+    direct_active = false;
+    bytes_since_sync = 0;
+    if(direct_io && !is_pipe) {
+        filenum = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_DIRECT, S_IRWXU);
+        if(filenum != -1) {
+            direct_active = true;
+        }else if(errno == EINVAL) {
+            pango_print_warn("O_DIRECT not supported for '%s'. Using cached writes.\n", filename.c_str());
+            filenum = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRWXU);
+        }
+    }else{
+        filenum = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_SYNC, S_IRWXU);
+    }
 #else
     file.open(filename.c_str(), ios::out | ios::binary);
 #endif
@@ -79,12 +237,21 @@ void threadedfilebuf::open(const std::string& filename, size_t buffer_size_bytes
         throw std::runtime_error("Unable to open '" + filename + "' for writing.");
     }
 
+#ifdef HAVE_IO_URING
+    if(uring_depth && !is_pipe) {
+        uring = uring_queue::Create(static_cast<unsigned>(uring_depth));
+        if(!uring) {
+            pango_print_warn("io_uring unavailable. Using blocking writes.\n");
+        }
+    }
+#endif
+
     mem_buffer = 0;
-    mem_size = 0;
-    mem_start = 0;
-    mem_end = 0;
-    mem_max_size = static_cast<std::streamsize>(buffer_size_bytes);
-    mem_buffer = new char[static_cast<size_t>(mem_max_size)];
+    reserved.value = 0;
+    published.value = 0;
+    consumed.value = 0;
+    discard = false;
+    allocate_buffer(static_cast<std::streamsize>(buffer_size_bytes));
 
     should_run = true;
     write_thread = std::thread(std::ref(*this));
@@ -94,20 +261,20 @@ void threadedfilebuf::close()
 {
     should_run = false;
 
-    cond_queued.notify_all();
+    notify_writer();
 
     if(write_thread.joinable())
     {
         write_thread.join();
     }
 
-    if(mem_buffer)
-    {
-        delete [] mem_buffer;
-        mem_buffer = 0;
-    }
+    uring.reset();
+    free_buffer();
 
 #ifdef USE_POSIX_FILE_IO
+    if(filenum != -1 && (direct_io || sync_bytes)) {
+        fdatasync(filenum);
+    }
     ::close(filenum);
     filenum = -1;
 #else
@@ -118,7 +285,9 @@ void threadedfilebuf::close()
 void threadedfilebuf::soft_close()
 {
     // Forces sputn to write no bytes and exit early, results in lost data
-    mem_size = 0;
+    discard = true;
+    notify_producers();
+    notify_writer();
 }
 
 void threadedfilebuf::force_close()
@@ -132,92 +301,155 @@ threadedfilebuf::~threadedfilebuf()
     close();
 }
 
-std::streamsize threadedfilebuf::xsputn(const char* data, std::streamsize num_bytes)
+void threadedfilebuf::set_direct_io(bool direct_io, size_t sync_bytes)
 {
-    if( num_bytes > mem_max_size ) {
-        std::unique_lock<std::mutex> lock(update_mutex);
-        // Wait until queue is empty
-        while( mem_size > 0 ) {
-            cond_dequeued.wait(lock);
-        }
+    this->direct_io = direct_io;
+    this->sync_bytes = sync_bytes;
+}
 
-        // Allocate bigger buffer
-        delete [] mem_buffer;
-        mem_start = 0;
-        mem_end = 0;
-        mem_max_size = num_bytes * 4;
-        mem_buffer = new char[static_cast<size_t>(mem_max_size)];
+void threadedfilebuf::set_io_uring(size_t queue_depth)
+{
+    uring_depth = queue_depth;
+}
+
+void threadedfilebuf::allocate_buffer(std::streamsize size)
+{
+#ifdef USE_POSIX_FILE_IO
+    if(direct_active) {
+        // Whole blocks, so that every wrap point stays aligned
+        size = ((size + direct_io_block - 1) / direct_io_block) * direct_io_block;
+    }
+    void* p = nullptr;
+    if(posix_memalign(&p, static_cast<size_t>(direct_io_block), static_cast<size_t>(size))) {
+        throw std::bad_alloc();
     }
+    mem_buffer = static_cast<char*>(p);
+#else
+    mem_buffer = new char[static_cast<size_t>(size)];
+#endif
+    mem_max_size = size;
+}
 
+void threadedfilebuf::free_buffer()
+{
+    if(mem_buffer)
     {
-        std::unique_lock<std::mutex> lock(update_mutex);
-        
-        // wait until there is space to write into buffer
-        while( mem_size + num_bytes > mem_max_size ) {
-            cond_dequeued.wait(lock);
-        }
-        
-        // add image to end of mem_buffer
-        const std::streamsize array_a_size =
-                (mem_start <= mem_end) ? (mem_max_size - mem_end) : (mem_start - mem_end);
-        
-        if( num_bytes <= array_a_size )
-        {
-            // copy in one
-            memcpy(mem_buffer + mem_end, data, static_cast<size_t>(num_bytes));
-            mem_end += num_bytes;
-            mem_size += num_bytes;
-        }else{
-            const std::streamsize array_b_size = num_bytes - array_a_size;
-            memcpy(mem_buffer + mem_end, data, (size_t)array_a_size);
-            memcpy(mem_buffer, data+array_a_size, (size_t)array_b_size);
-            mem_end = array_b_size;
-            mem_size += num_bytes;
-        }
-        
-        if(mem_end == mem_max_size)
-            mem_end = 0;
+#ifdef USE_POSIX_FILE_IO
+        free(mem_buffer);
+#else
+        delete [] mem_buffer;
+#endif
+        mem_buffer = 0;
     }
-    
-    cond_queued.notify_one();
-    
-    input_pos += num_bytes;
-    return num_bytes;
 }
 
-int threadedfilebuf::overflow(int c)
+// The waiting counts are incremented under update_mutex before the waiter
+// re-checks its condition, so a notifier which sees zero (after changing
+// the condition) can safely skip taking the lock.
+void threadedfilebuf::notify_producers()
 {
-    const std::streamsize num_bytes = 1;
+    if(producers_waiting.load()) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        cond_dequeued.notify_all();
+    }
+}
 
-    {
-        std::unique_lock<std::mutex> lock(update_mutex);
+void threadedfilebuf::notify_writer()
+{
+    if(writer_waiting.load()) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        cond_queued.notify_all();
+    }
+}
 
-        // wait until there is space to write into buffer
-        while( mem_size + num_bytes > mem_max_size ) {
-            cond_dequeued.wait(lock);
+threadedfilebuf::reservation threadedfilebuf::reserve(size_t n)
+{
+    const uint64_t begin = reserved.value.fetch_add(n);
+    return {begin, begin + n, begin};
+}
+
+void threadedfilebuf::put(reservation& r, const char* data, size_t n)
+{
+    const uint64_t size = static_cast<uint64_t>(mem_max_size);
+
+    while(n > 0 && !discard) {
+        const uint64_t c = consumed.value.load(std::memory_order_acquire);
+        if(r.cursor - c >= size) {
+            // Ring full. If all earlier data is published, publish what we
+            // have so far so that packets larger than the ring can drain.
+            const uint64_t p = published.value.load(std::memory_order_acquire);
+            if(p >= r.begin && p < r.cursor) {
+                published.value.store(r.cursor);
+                notify_writer();
+            }
+
+            // Also wake once the earlier reservations publish, so that our
+            // data can be published and drained.
+            std::unique_lock<std::mutex> lock(update_mutex);
+            ++producers_waiting;
+            cond_dequeued.wait(lock, [&](){
+                const uint64_t p = published.value.load();
+                return r.cursor - consumed.value.load() < size || (p >= r.begin && p < r.cursor) || discard;
+            });
+            --producers_waiting;
+            continue;
         }
 
-        // add image to end of mem_buffer
-        mem_buffer[mem_end] = c;
-        mem_end += num_bytes;
-        mem_size += num_bytes;
+        const uint64_t ring_pos = r.cursor % size;
+        const size_t bytes = static_cast<size_t>(std::min<uint64_t>(n, std::min(c + size - r.cursor, size - ring_pos)));
+        memcpy(mem_buffer + ring_pos, data, bytes);
+        r.cursor += bytes;
+        data += bytes;
+        n -= bytes;
+    }
+}
+
+void threadedfilebuf::wait_published(uint64_t pos)
+{
+    // Earlier reservations are normally being filled right now, so spin
+    // briefly before sleeping.
+    for(int i=0; i < 64 && published.value.load(std::memory_order_acquire) < pos; ++i) {
+        std::this_thread::yield();
+    }
 
-        if(mem_end == mem_max_size)
-            mem_end = 0;
+    if(published.value.load(std::memory_order_acquire) < pos) {
+        std::unique_lock<std::mutex> lock(update_mutex);
+        ++producers_waiting;
+        cond_dequeued.wait(lock, [&](){ return published.value.load() >= pos || discard; });
+        --producers_waiting;
     }
+}
 
-    cond_queued.notify_one();
+void threadedfilebuf::publish(const reservation& r)
+{
+    wait_published(r.begin);
+    published.value.store(r.end);
+    notify_writer();
+    // Producers may be waiting for this one to publish
+    notify_producers();
+}
 
-    input_pos += num_bytes;
+std::streamsize threadedfilebuf::xsputn(const char* data, std::streamsize num_bytes)
+{
+    reservation r = reserve(static_cast<size_t>(num_bytes));
+    put(r, data, static_cast<size_t>(num_bytes));
+    publish(r);
     return num_bytes;
 }
 
+int threadedfilebuf::overflow(int c)
+{
+    const char v = static_cast<char>(c);
+    xsputn(&v, 1);
+    return 1;
+}
+
 std::streampos threadedfilebuf::seekoff(
     std::streamoff off, std::ios_base::seekdir way,
     std::ios_base::openmode /*which*/
 ) {
     if(off == 0 && way == ios_base::cur) {
-        return input_pos;
+        return static_cast<std::streamoff>(reserved.value.load());
     }else{
         return -1;
     }
@@ -225,6 +457,14 @@ std::streampos threadedfilebuf::seekoff(
 
 void threadedfilebuf::operator()()
 {
+#ifdef HAVE_IO_URING
+    if(uring) {
+        write_uring();
+        return;
+    }
+#endif
+
+    const uint64_t size = static_cast<uint64_t>(mem_max_size);
     std::streamsize data_to_write = 0;
     
     while(true)
@@ -244,43 +484,165 @@ void threadedfilebuf::operator()()
             }
         }
 
+        const uint64_t c = consumed.value.load(std::memory_order_relaxed);
         {
-            std::unique_lock<std::mutex> lock(update_mutex);
-            
-            while( mem_size == 0 ) {
-                if(!should_run) return;
-                cond_queued.wait(lock);
+            // O_DIRECT writes whole blocks until the stream is closed.
+            auto ready = [&](){
+                return published.value.load() - c >= uint64_t(direct_active ? direct_io_block : 1) || !should_run || discard;
+            };
+            if(!ready()) {
+                std::unique_lock<std::mutex> lock(update_mutex);
+                ++writer_waiting;
+                cond_queued.wait(lock, ready);
+                --writer_waiting;
+            }
+
+            const uint64_t p = published.value.load(std::memory_order_acquire);
+            if(discard || p == c) {
+                if(discard || !should_run) return;
+                continue;
             }
 
-            data_to_write =
-                    (mem_start < mem_end) ?
-                        mem_end - mem_start :
-                        mem_max_size - mem_start;
+            data_to_write = static_cast<std::streamsize>(std::min(p - c, size - c % size));
+
+#ifdef USE_POSIX_FILE_IO
+            if(direct_active) {
+                if(data_to_write >= direct_io_block) {
+                    data_to_write -= data_to_write % direct_io_block;
+                }else{
+                    // Closing with a partial block left: finish with a cached write.
+                    fcntl(filenum, F_SETFL, fcntl(filenum, F_GETFL) & ~O_DIRECT);
+                    direct_active = false;
+                }
+            }
+#endif
         }
 
+        const char* data = mem_buffer + c % size;
 #ifdef USE_POSIX_FILE_IO
-        int bytes_written = ::write(filenum, mem_buffer + mem_start, data_to_write);
+        ssize_t bytes_written = ::write(filenum, data, data_to_write);
         if(bytes_written == -1)
         {
             throw std::runtime_error("Unable to write data.");
         }
+
+        if(sync_bytes) {
+            bytes_since_sync += bytes_written;
+            if(bytes_since_sync >= sync_bytes) {
+                fdatasync(filenum);
+                bytes_since_sync = 0;
+            }
+        }
 #else
         std::streamsize bytes_written =
-                file.sputn(mem_buffer + mem_start, data_to_write );
+                file.sputn(data, data_to_write );
 #endif
 
+        consumed.value.store(c + static_cast<uint64_t>(bytes_written));
+        notify_producers();
+    }
+}
+
+#ifdef HAVE_IO_URING
+// As operator(), but keeping up to uring_depth writes in flight. Queued data
+// is released back to the producer in order as the writes complete.
+void threadedfilebuf::write_uring()
+{
+    struct Write {
+        iovec iov;
+        uint64_t offset;
+        bool done;
+    };
+    std::deque<Write> in_flight;
+    uint64_t front_id = 0;
+    uint64_t in_flight_bytes = 0;
+    const uint64_t size = static_cast<uint64_t>(mem_max_size);
+
+    while(true)
+    {
+        const uint64_t c = consumed.value.load(std::memory_order_relaxed);
+        size_t num_queued = 0;
         {
-            std::unique_lock<std::mutex> lock(update_mutex);
-            
-            mem_size -= bytes_written;
-            mem_start += bytes_written;
-            
-            if(mem_start == mem_max_size)
-                mem_start = 0;
+            if(in_flight.empty()) {
+                auto ready = [&](){
+                    return published.value.load() - c >= uint64_t(direct_active ? direct_io_block : 1) || !should_run || discard;
+                };
+                if(!ready()) {
+                    std::unique_lock<std::mutex> lock(update_mutex);
+                    ++writer_waiting;
+                    cond_queued.wait(lock, ready);
+                    --writer_waiting;
+                }
+
+                const uint64_t p = published.value.load(std::memory_order_acquire);
+                if(discard || (p == c && !should_run)) return;
+
+                if(!should_run && direct_active && p - c < uint64_t(direct_io_block)) {
+                    // Closing with a partial block left: finish with a cached write.
+                    fcntl(filenum, F_SETFL, fcntl(filenum, F_GETFL) & ~O_DIRECT);
+                    direct_active = false;
+                }
+            }
+
+            const uint64_t p = published.value.load(std::memory_order_acquire);
+            while(in_flight.size() < uring_depth) {
+                const uint64_t offset = c + in_flight_bytes;
+                const uint64_t pos = offset % size;
+                uint64_t len = std::min(p - offset, std::min(size - pos, uint64_t(uring_chunk_bytes)));
+                if(direct_active) len -= len % direct_io_block;
+                if(len == 0) break;
+
+                in_flight.push_back({{mem_buffer + pos, static_cast<size_t>(len)}, offset, false});
+                uring->write(filenum, &in_flight.back().iov, offset, front_id + in_flight.size() - 1);
+                in_flight_bytes += len;
+                ++num_queued;
+            }
+        }
+
+        // Only block if there's nothing more we could queue.
+        const bool wait = !in_flight.empty() && (num_queued == 0 || in_flight.size() == uring_depth);
+        uring->submit(wait ? 1 : 0);
+
+        uint64_t id;
+        int res;
+        while(uring->pop(id, res)) {
+            Write& w = in_flight[id - front_id];
+            if(res < 0) {
+                throw std::runtime_error("Unable to write data.");
+            }
+            // Finish any short write synchronously
+            for(size_t written = static_cast<size_t>(res); written < w.iov.iov_len; ) {
+                const ssize_t r = pwrite(filenum, static_cast<char*>(w.iov.iov_base) + written, w.iov.iov_len - written, w.offset + written);
+                if(r <= 0) {
+                    throw std::runtime_error("Unable to write data.");
+                }
+                written += static_cast<size_t>(r);
+            }
+            w.done = true;
+        }
+
+        uint64_t completed = 0;
+        while(!in_flight.empty() && in_flight.front().done) {
+            completed += in_flight.front().iov.iov_len;
+            in_flight.pop_front();
+            ++front_id;
+        }
+
+        if(completed) {
+            if(sync_bytes) {
+                bytes_since_sync += static_cast<size_t>(completed);
+                if(bytes_since_sync >= sync_bytes) {
+                    fdatasync(filenum);
+                    bytes_since_sync = 0;
+                }
+            }
+
+            in_flight_bytes -= completed;
+            consumed.value.store(c + completed);
+            notify_producers();
         }
-        
-        cond_dequeued.notify_all();
     }
 }
+#endif
 
 }
@@ -28,6 +28,7 @@
 #include <pangolin/video/drivers/debayer.h>
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
+#include <pangolin/image/demosaic.h>
 
 #ifdef HAVE_DC1394
 #   include <dc1394/conversions.h>
@@ -60,8 +61,14 @@ pangolin::StreamInfo BayerOutputFormat( const StreamInfo& stream_in, bayer_metho
     return pangolin::StreamInfo( fmt, w, h, w*fmt.bpp / 8, (unsigned char*)0 + start_offset );
 }
 
-DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vector<bayer_method_t>& bayer_method, color_filter_t tile)
-    : src(std::move(src_)), size_bytes(0), methods(bayer_method), tile(tile)
+// Whether method is implemented by pangolin::Demosaic()
+bool BuiltinBayerMethod(bayer_method_t method)
+{
+    return method == BAYER_METHOD_BILINEAR || method == BAYER_METHOD_HQLINEAR;
+}
+
+DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vector<bayer_method_t>& bayer_method, color_filter_t tile, size_t num_threads)
+    : src(std::move(src_)), size_bytes(0), methods(bayer_method), tile(tile), num_threads(num_threads)
 {
     if(!src.get()) {
         throw VideoException("DebayerVideo: VideoInterface in must not be null");
@@ -73,17 +80,15 @@ DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vec
     }
 
     for(size_t s=0; s< src->Streams().size(); ++s) {
-        if( (methods[s] < BAYER_METHOD_NONE) && (!have_dc1394 || src->Streams()[0].IsPitched()) ) {
-            pango_print_warn("debayer: Switching to simple downsampling method because No DC1394 or image is pitched.\n");
-            methods[s] = BAYER_METHOD_DOWNSAMPLE;
+        if( (methods[s] < BAYER_METHOD_NONE) && !BuiltinBayerMethod(methods[s]) && (!have_dc1394 || src->Streams()[s].IsPitched()) ) {
+            pango_print_warn("debayer: Switching to built in hqlinear method because No DC1394 or image is pitched.\n");
+            methods[s] = BAYER_METHOD_HQLINEAR;
         }
 
         const StreamInfo& stin = src->Streams()[s];
         streams.push_back(BayerOutputFormat(stin, methods[s], size_bytes));
         size_bytes += streams.back().SizeBytes();
     }
-
-    buffer = std::unique_ptr<unsigned char[]>(new unsigned char[src->SizeBytes()]);
 }
 
 DebayerVideo::~DebayerVideo()
@@ -225,8 +230,31 @@ void PitchedImageCopy( Image<T>& img_out, const Image<T>& img_in ) {
     }
 }
 
+BayerTile ToBayerTile(color_filter_t tile)
+{
+    switch(tile) {
+      case DC1394_COLOR_FILTER_GBRG: return BayerTile::GBRG;
+      case DC1394_COLOR_FILTER_GRBG: return BayerTile::GRBG;
+      case DC1394_COLOR_FILTER_BGGR: return BayerTile::BGGR;
+      default: return BayerTile::RGGB;
+    }
+}
+
+template<typename T>
+void BuiltinDebayer(Image<T>& img_out, const Image<T>& img_in, bayer_method_t method, color_filter_t tile, unsigned int bit_depth, ThreadPool* pool)
+{
+    const DemosaicMethod dm = (method == BAYER_METHOD_HQLINEAR) ? DemosaicMethod::HQLinear : DemosaicMethod::Bilinear;
+    if(sizeof(T) == 1) {
+        Image<uint8_t> out8 = img_out.template UnsafeReinterpret<uint8_t>();
+        Demosaic(out8, img_in.template UnsafeReinterpret<uint8_t>(), ToBayerTile(tile), dm, pool);
+    }else{
+        Image<uint16_t> out16 = img_out.template UnsafeReinterpret<uint16_t>();
+        Demosaic(out16, img_in.template UnsafeReinterpret<uint16_t>(), ToBayerTile(tile), dm, bit_depth, pool);
+    }
+}
+
 template<typename Tout, typename Tin>
-void ProcessImage(Image<Tout>& img_out, const Image<Tin>& img_in, bayer_method_t method, color_filter_t tile)
+void ProcessImage(Image<Tout>& img_out, const Image<Tin>& img_in, bayer_method_t method, color_filter_t tile, unsigned int bit_depth, ThreadPool* pool)
 {
     if(method == BAYER_METHOD_NONE) {
         PitchedImageCopy(img_out, img_in.template UnsafeReinterpret<Tout>() );
@@ -238,6 +266,8 @@ void ProcessImage(Image<Tout>& img_out, const Image<Tin>& img_in, bayer_method_t
         }
     }else if(method == BAYER_METHOD_DOWNSAMPLE) {
         DownsampleDebayer(img_out, img_in, tile);
+    }else if(BuiltinBayerMethod(method)) {
+        BuiltinDebayer(img_out, img_in, method, tile, bit_depth, pool);
     }else{
 #ifdef HAVE_DC1394
         if(sizeof(Tout) == 1) {
@@ -269,20 +299,31 @@ void DebayerVideo::ProcessStreams(unsigned char* out, const unsigned char *in)
                 std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), num_bytes);
             }
         }else if(stin.PixFormat().bpp == 8) {
-            ProcessImage(img_out, img_in, methods[s], tile);
+            ProcessImage(img_out, img_in, methods[s], tile, 8, pool.get());
         }else if(stin.PixFormat().bpp == 16){
             Image<uint16_t> img_in16  = img_in.UnsafeReinterpret<uint16_t>();
             Image<uint16_t> img_out16 = img_out.UnsafeReinterpret<uint16_t>();
-            ProcessImage(img_out16, img_in16, methods[s], tile);
+            ProcessImage(img_out16, img_in16, methods[s], tile, stin.PixFormat().channel_bit_depth, pool.get());
         }else {
             throw std::runtime_error("debayer: unhandled format combination: " + stin.PixFormat().format );
         }
     }
 }
 
+void DebayerVideo::Allocate()
+{
+    if(!buffer) {
+        buffer = std::unique_ptr<unsigned char[]>(new unsigned char[src->SizeBytes()]);
+        if(num_threads > 1) {
+            pool.reset(new ThreadPool(num_threads-1));
+        }
+    }
+}
+
 //! Implement VideoInput::GrabNext()
 bool DebayerVideo::GrabNext( unsigned char* image, bool wait )
-{    
+{
+    Allocate();
     if(videoin[0]->GrabNext(buffer.get(),wait)) {
         ProcessStreams(image, buffer.get());
         return true;
@@ -294,6 +335,7 @@ bool DebayerVideo::GrabNext( unsigned char* image, bool wait )
 //! Implement VideoInput::GrabNewest()
 bool DebayerVideo::GrabNewest( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin[0]->GrabNewest(buffer.get(),wait)) {
         ProcessStreams(image, buffer.get());
         return true;
@@ -307,6 +349,69 @@ std::vector<VideoInterface*>& DebayerVideo::InputStreams()
     return videoin;
 }
 
+bool DebayerVideo::RowSeparable() const
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        if( methods[s] != BAYER_METHOD_NONE && methods[s] != BAYER_METHOD_DOWNSAMPLE &&
+            methods[s] != BAYER_METHOD_DOWNSAMPLE_MONO && !BuiltinBayerMethod(methods[s]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DebayerVideo::InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const
+{
+    if(methods[s] == BAYER_METHOD_DOWNSAMPLE || methods[s] == BAYER_METHOD_DOWNSAMPLE_MONO) {
+        in_y0 = 2*y0;
+        in_y1 = 2*y1;
+    }else if(BuiltinBayerMethod(methods[s])) {
+        // Interpolation kernels reach two rows either side
+        const size_t h = videoin[0]->Streams()[s].Height();
+        in_y0 = y0 > 2 ? y0 - 2 : 0;
+        in_y1 = std::min(h, y1 + 2);
+    }else{
+        in_y0 = y0;
+        in_y1 = y1;
+    }
+}
+
+void DebayerVideo::ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t y0, size_t y1)
+{
+    const StreamInfo& stin = videoin[0]->Streams()[s];
+    const bayer_method_t method = methods[s];
+
+    if(method == BAYER_METHOD_NONE) {
+        const size_t num_bytes = std::min(in.w, out.w) * stin.PixFormat().bpp / 8;
+        for(size_t y=0; y < out.h; ++y) {
+            std::memcpy(out.RowPtr(y), in.RowPtr(y), num_bytes);
+        }
+    }else if(BuiltinBayerMethod(method)) {
+        // Demosaic reflects at the image border, so it needs to know where
+        // these rows lie in the image
+        size_t in_y0, in_y1;
+        InputRows(s, y0, y1, in_y0, in_y1);
+        const DemosaicMethod dm = (method == BAYER_METHOD_HQLINEAR) ? DemosaicMethod::HQLinear : DemosaicMethod::Bilinear;
+        if(stin.PixFormat().bpp == 8) {
+            DemosaicRows(out, in, ToBayerTile(tile), dm, stin.Height(), y0, in_y0);
+        }else if(stin.PixFormat().bpp == 16) {
+            Image<uint16_t> out16 = out.UnsafeReinterpret<uint16_t>();
+            DemosaicRows(out16, in.UnsafeReinterpret<uint16_t>(), ToBayerTile(tile), dm, stin.PixFormat().channel_bit_depth, stin.Height(), y0, in_y0);
+        }else{
+            throw std::runtime_error("debayer: unhandled format combination: " + stin.PixFormat().format );
+        }
+    }else{
+        if(stin.PixFormat().bpp == 8) {
+            ProcessImage(out, in, method, tile, 8, nullptr);
+        }else if(stin.PixFormat().bpp == 16) {
+            Image<uint16_t> out16 = out.UnsafeReinterpret<uint16_t>();
+            ProcessImage(out16, in.UnsafeReinterpret<uint16_t>(), method, tile, stin.PixFormat().channel_bit_depth, nullptr);
+        }else{
+            throw std::runtime_error("debayer: unhandled format combination: " + stin.PixFormat().format );
+        }
+    }
+}
+
 color_filter_t DebayerVideo::ColorFilterFromString(std::string str)
 {
   if(!str.compare("rggb") || !str.compare("RGGB")) return DC1394_COLOR_FILTER_RGGB;
@@ -345,6 +450,7 @@ PANGOLIN_REGISTER_FACTORY(DebayerVideo)
             const std::string tile_string = uri.Get<std::string>("tile","rggb");
             const std::string method = uri.Get<std::string>("method","none");
             const color_filter_t tile = DebayerVideo::ColorFilterFromString(tile_string);
+            const size_t num_threads = uri.Get<size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
 
             std::vector<bayer_method_t> methods;
             for(size_t s=0; s < subvid->Streams().size(); ++s) {
@@ -352,7 +458,7 @@ PANGOLIN_REGISTER_FACTORY(DebayerVideo)
                 std::string method_s = uri.Get<std::string>(key, method);
                 methods.push_back(DebayerVideo::BayerMethodFromString(method_s));
             }
-            return std::unique_ptr<VideoInterface>( new DebayerVideo(subvid, methods, tile) );
+            return std::unique_ptr<VideoInterface>( new DebayerVideo(subvid, methods, tile, num_threads) );
         }
     };
 
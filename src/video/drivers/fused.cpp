@@ -0,0 +1,260 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/video/drivers/fused.h>
+#include <pangolin/factory/factory_registry.h>
+#include <pangolin/video/iostream_operators.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace pangolin
+{
+
+FusedVideo::FusedVideo(std::unique_ptr<VideoInterface>& src_, size_t num_threads, size_t band_bytes)
+    : src(std::move(src_)), source(nullptr), scratch_bytes(0), num_lanes(std::max<size_t>(num_threads,1))
+{
+    if(!src) {
+        throw VideoException("FusedVideo: VideoInterface in must not be null");
+    }
+    videoin.push_back(src.get());
+
+    // Collect the row filters at the top of the chain, stopping at the first
+    // video which can't be run a band at a time.
+    VideoInterface* v = src.get();
+    while(true) {
+        RowFilterInterface* rf = dynamic_cast<RowFilterInterface*>(v);
+        VideoFilterInterface* vf = dynamic_cast<VideoFilterInterface*>(v);
+        if( !rf || !vf || !rf->RowSeparable() || vf->InputStreams().size() != 1 ||
+            vf->InputStreams()[0]->Streams().size() != v->Streams().size() ) {
+            break;
+        }
+        stages.push_back({v, rf});
+        v = vf->InputStreams()[0];
+    }
+    source = v;
+    std::reverse(stages.begin(), stages.end());
+
+    if(stages.empty()) {
+        pango_print_warn("FusedVideo: No row separable filters found. Frames are passed through.\n");
+        return;
+    }
+
+    // Split each output stream into bands of rows and find the rows each
+    // stage must compute for them.
+    const size_t K = stages.size();
+    std::vector<size_t> stage_bytes(K, 0);
+    for(size_t s=0; s < src->Streams().size(); ++s) {
+        size_t row_bytes = source->Streams()[s].Pitch();
+        for(const Stage& st : stages) {
+            row_bytes += st.video->Streams()[s].Pitch();
+        }
+        const size_t h = src->Streams()[s].Height();
+        const size_t band_rows = std::max<size_t>(32, band_bytes / std::max<size_t>(row_bytes,1));
+
+        for(size_t y=0; y < h; y += band_rows) {
+            Band band;
+            band.s = s;
+            band.rows.resize(K);
+            band.rows[K-1] = {y, std::min(h, y + band_rows)};
+            for(size_t k=K-1; k > 0; --k) {
+                stages[k].filter->InputRows(s, band.rows[k].y0, band.rows[k].y1, band.rows[k-1].y0, band.rows[k-1].y1);
+            }
+            stages[0].filter->InputRows(s, band.rows[0].y0, band.rows[0].y1, band.in.y0, band.in.y1);
+            for(size_t k=0; k+1 < K; ++k) {
+                const size_t bytes = (band.rows[k].y1 - band.rows[k].y0) * stages[k].video->Streams()[s].Pitch();
+                stage_bytes[k] = std::max(stage_bytes[k], bytes);
+            }
+            bands.push_back(band);
+        }
+    }
+
+    // Each lane has its own scratch images for the intermediate stages
+    scratch_offset.resize(K, 0);
+    for(size_t k=0; k+1 < K; ++k) {
+        scratch_offset[k] = scratch_bytes;
+        scratch_bytes += stage_bytes[k];
+    }
+    num_lanes = std::min(num_lanes, bands.size());
+    scratch = std::unique_ptr<unsigned char[]>(new unsigned char[std::max<size_t>(scratch_bytes * num_lanes, 1)]);
+    buffer = std::unique_ptr<unsigned char[]>(new unsigned char[source->SizeBytes()]);
+
+    if(num_lanes > 1) {
+        pool.reset(new ThreadPool(num_lanes-1));
+    }
+}
+
+FusedVideo::~FusedVideo()
+{
+}
+
+//! Implement VideoInput::Start()
+void FusedVideo::Start()
+{
+    videoin[0]->Start();
+}
+
+//! Implement VideoInput::Stop()
+void FusedVideo::Stop()
+{
+    videoin[0]->Stop();
+}
+
+//! Implement VideoInput::SizeBytes()
+size_t FusedVideo::SizeBytes() const
+{
+    return videoin[0]->SizeBytes();
+}
+
+//! Implement VideoInput::Streams()
+const std::vector<StreamInfo>& FusedVideo::Streams() const
+{
+    return videoin[0]->Streams();
+}
+
+size_t FusedVideo::NumFusedStages() const
+{
+    return stages.size();
+}
+
+void FusedVideo::ProcessBand(const Band& band, unsigned char* lane_scratch, unsigned char* image, const unsigned char* buffer_in)
+{
+    const size_t s = band.s;
+    Image<unsigned char> img_in = source->Streams()[s].StreamImage(buffer_in);
+    img_in = img_in.SubImage(0, band.in.y0, img_in.w, band.in.y1 - band.in.y0);
+
+    // Each stage reads just the rows the previous stage wrote.
+    for(size_t k=0; k < stages.size(); ++k) {
+        const StreamInfo& si = stages[k].video->Streams()[s];
+        const RowSpan& rows = band.rows[k];
+        Image<unsigned char> img_out;
+        if(k+1 == stages.size()) {
+            img_out = si.StreamImage(image);
+            img_out = img_out.SubImage(0, rows.y0, img_out.w, rows.y1 - rows.y0);
+        }else{
+            img_out = Image<unsigned char>(lane_scratch + scratch_offset[k], si.Width(), rows.y1 - rows.y0, si.Pitch());
+        }
+        stages[k].filter->ProcessRows(s, img_out, img_in, rows.y0, rows.y1);
+        img_in = img_out;
+    }
+}
+
+void FusedVideo::Process(unsigned char* image, const unsigned char* buffer_in)
+{
+    std::atomic<size_t> next(0);
+    auto lane = [&](size_t l) {
+        unsigned char* lane_scratch = scratch.get() + l * scratch_bytes;
+        for(size_t b = next++; b < bands.size(); b = next++) {
+            ProcessBand(bands[b], lane_scratch, image, buffer_in);
+        }
+    };
+
+    if(pool) {
+        pool->ParallelFor(num_lanes, lane);
+    }else{
+        lane(0);
+    }
+}
+
+//! Implement VideoInput::GrabNext()
+bool FusedVideo::GrabNext( unsigned char* image, bool wait )
+{
+    if(stages.empty()) {
+        return videoin[0]->GrabNext(image, wait);
+    }
+
+    if(source->GrabNext(buffer.get(),wait)) {
+        Process(image, buffer.get());
+        return true;
+    }else{
+        return false;
+    }
+}
+
+//! Implement VideoInput::GrabNewest()
+bool FusedVideo::GrabNewest( unsigned char* image, bool wait )
+{
+    if(stages.empty()) {
+        return videoin[0]->GrabNewest(image, wait);
+    }
+
+    if(source->GrabNewest(buffer.get(),wait)) {
+        Process(image, buffer.get());
+        return true;
+    }else{
+        return false;
+    }
+}
+
+std::vector<VideoInterface*>& FusedVideo::InputStreams()
+{
+    return videoin;
+}
+
+uint32_t FusedVideo::AvailableFrames() const
+{
+    BufferAwareVideoInterface* vpi = dynamic_cast<BufferAwareVideoInterface*>(source);
+    if(!vpi)
+    {
+        pango_print_warn("FusedVideo: child interface is not buffer aware.");
+        return 0;
+    }
+    else
+    {
+        return vpi->AvailableFrames();
+    }
+}
+
+bool FusedVideo::DropNFrames(uint32_t n)
+{
+    BufferAwareVideoInterface* vpi = dynamic_cast<BufferAwareVideoInterface*>(source);
+    if(!vpi)
+    {
+        pango_print_warn("FusedVideo: child interface is not buffer aware.");
+        return false;
+    }
+    else
+    {
+        return vpi->DropNFrames(n);
+    }
+}
+
+PANGOLIN_REGISTER_FACTORY(FusedVideo)
+{
+    struct FusedVideoFactory final : public FactoryInterface<VideoInterface> {
+        std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
+            const size_t num_threads = uri.Get<size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
+            const size_t band_kb = uri.Get<size_t>("band_kb", 256);
+            std::unique_ptr<VideoInterface> subvid = pangolin::OpenVideo(uri.url);
+            return std::unique_ptr<VideoInterface>(
+                new FusedVideo(subvid, num_threads, band_kb * 1024)
+            );
+        }
+    };
+
+    FactoryRegistry<VideoInterface>::I().RegisterFactory(std::make_shared<FusedVideoFactory>(), 10, "fuse");
+}
+
+}
@@ -168,25 +168,76 @@ int64_t JoinVideo::GetAdjustedCaptureTime(size_t src_index)
    }
 }
 
+void JoinVideo::SetParallelGrab(bool parallel)
+{
+    if(parallel && src.size() > 1) {
+        grab_pool.reset(new ThreadPool(src.size()-1));
+    }else{
+        grab_pool.reset();
+    }
+}
+
+void JoinVideo::GrabAll(unsigned char* image, const std::vector<size_t>& offsets, bool wait, std::vector<bool>& grabbed)
+{
+    TSTART()
+    if(grab_pool) {
+        std::vector<std::future<bool>> grabs;
+        for(size_t s=1; s<src.size(); ++s) {
+            grabs.push_back( grab_pool->Run([this, image, &offsets, wait, s](){
+                return src[s]->GrabNext(image+offsets[s], wait);
+            }) );
+        }
+
+        // Every worker must finish with image before we can propagate an error.
+        std::exception_ptr error;
+        try {
+            grabbed[0] = src[0]->GrabNext(image+offsets[0], wait);
+        }catch(...) {
+            error = std::current_exception();
+        }
+        for(size_t s=1; s<src.size(); ++s) {
+            try {
+                grabbed[s] = grabs[s-1].get();
+            }catch(...) {
+                if(!error) error = std::current_exception();
+            }
+        }
+        if(error) {
+            std::rethrow_exception(error);
+        }
+        TGRABANDPRINT("Parallel grab of %ld streams took ", src.size());
+    }else{
+        for(size_t s=0; s<src.size(); ++s) {
+            grabbed[s] = src[s]->GrabNext(image+offsets[s], wait);
+            TGRABANDPRINT("Stream %ld grab took ",s);
+        }
+    }
+}
+
 bool JoinVideo::GrabNext(unsigned char* image, bool wait)
 {
     size_t offset = 0;
     std::vector<size_t> offsets(src.size(), 0);
     std::vector<int64_t> capture_us(src.size(), 0);
+    std::vector<bool> grabbed(src.size(), false);
+
+    for(size_t s=0; s<src.size(); ++s) {
+        offsets[s] = offset;
+        offset += src[s]->SizeBytes();
+    }
 
     TSTART()
     DBGPRINT("Entering GrabNext:")
+    GrabAll(image, offsets, wait, grabbed);
+
     for(size_t s=0; s<src.size(); ++s) {
-        if( src[s]->GrabNext(image+offset,wait) ) {
+        if( grabbed[s] ) {
             if(sync_tolerance_us > 0) {
                 capture_us[s] = GetAdjustedCaptureTime(s);
             }else{
                 capture_us[s] = std::numeric_limits<int64_t>::max();
             }
         }
-        offsets[s] = offset;
-        offset += src[s]->SizeBytes();
-        TGRABANDPRINT("Stream %ld grab took ",s);
     }
 
     // Check if any streams didn't return an image. This means a stream is waiting on data or has finished.
@@ -398,6 +449,9 @@ PANGOLIN_REGISTER_FACTORY(JoinVideo)
             // Bandwidth used to compute exposure end time from reception time for sync logic
             const double transfer_bandwidth_gbps = uri.Get<double>("transfer_bandwidth_gbps", 0.0);
 
+            // Grab from all sources concurrently on persistent worker threads.
+            const bool parallel = uri.Get<bool>("parallel", false);
+
             if(uris.size() == 0) {
                 throw VideoException("No VideoSources found in join URL.", "Specify videos to join with curly braces, e.g. join://{test://}{test://}");
             }
@@ -408,6 +462,7 @@ PANGOLIN_REGISTER_FACTORY(JoinVideo)
             }
 
             JoinVideo* video_raw = new JoinVideo(src);
+            video_raw->SetParallelGrab(parallel);
 
             if(sync_tol_us>0) {
                 if(!video_raw->Sync(sync_tol_us, transfer_bandwidth_gbps)) {
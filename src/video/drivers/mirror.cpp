@@ -28,13 +28,28 @@
 #include <pangolin/video/drivers/mirror.h>
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
+#include <pangolin/utils/timer.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define PANGO_MIRROR_SSE2
+#endif
 
 namespace pangolin
 {
 
+namespace
+{
+
+// Transpose tile sizes tried for each stream, in pixels
+const size_t tile_candidates[] = {16, 32, 64, 128, 256};
+const size_t num_tile_candidates = sizeof(tile_candidates) / sizeof(tile_candidates[0]);
+const size_t tile_trials = 2;
+
+}
 
-MirrorVideo::MirrorVideo(std::unique_ptr<VideoInterface>& src, const std::vector<MirrorOptions>& flips)
-    : videoin(std::move(src)), flips(flips), size_bytes(0),buffer(0)
+MirrorVideo::MirrorVideo(std::unique_ptr<VideoInterface>& src, const std::vector<MirrorOptions>& flips, size_t num_threads)
+    : videoin(std::move(src)), flips(flips), size_bytes(0),buffer(0), num_threads(num_threads)
 {
     if(!videoin) {
         throw VideoException("MirrorVideo: VideoInterface in must not be null");
@@ -65,7 +80,10 @@ MirrorVideo::MirrorVideo(std::unique_ptr<VideoInterface>& src, const std::vector
         };
 
     size_bytes = videoin->SizeBytes();
-    buffer = new unsigned char[size_bytes];
+
+    tile_trial.resize(streams.size(), 0);
+    tile_time.resize(streams.size(), std::vector<double>(num_tile_candidates, 0.0));
+    tile_size.resize(streams.size(), 64);
 }
 
 MirrorVideo::~MirrorVideo()
@@ -97,344 +115,409 @@ const std::vector<StreamInfo>& MirrorVideo::Streams() const
     return streams;
 }
 
-void PitchedImageCopy(
-    Image<unsigned char>& img_out,
-    const Image<unsigned char>& img_in,
-    size_t bytes_per_pixel
-) {
-    if( img_out.w != img_in.w || img_out.h != img_in.h ) {
-        throw std::runtime_error("PitchedImageCopy: Incompatible image sizes");
-    }
+namespace
+{
 
-    for(size_t y=0; y < img_out.h; ++y) {
-        std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), bytes_per_pixel * img_in.w);
-    }
-}
+// Pixel of N bytes, moved as a unit
+template<size_t N>
+struct Pixel
+{
+    unsigned char d[N];
+};
 
-void FlipY(
-    Image<unsigned char>& img_out,
-    const Image<unsigned char>& img_in,
-    size_t bytes_per_pixel
-) {
-    if( img_out.w != img_in.w || img_out.h != img_in.h ) {
-        throw std::runtime_error("FlipY: Incompatible image sizes");
+// Call fn(T()) with T the pixel type of size bytes_per_pixel. Returns false
+// if there is none.
+template<typename F>
+bool DispatchPixelType(size_t bytes_per_pixel, F&& fn)
+{
+    switch(bytes_per_pixel) {
+    case 1: fn(uint8_t()); return true;
+    case 2: fn(uint16_t()); return true;
+    case 3: fn(Pixel<3>()); return true;
+    case 4: fn(uint32_t()); return true;
+    case 6: fn(Pixel<6>()); return true;
+    case 8: fn(uint64_t()); return true;
+    default: return false;
     }
+}
 
-    for(size_t y_out=0; y_out < img_out.h; ++y_out) {
-        const size_t y_in = (img_in.h-1) - y_out;
-        std::memcpy(img_out.RowPtr((int)y_out), img_in.RowPtr((int)y_in), bytes_per_pixel * img_in.w);
+// Call f(y0,y1) over bands of rows [0,h) shared between the threads of pool
+template<typename F>
+void ForEachBand(size_t h, size_t band_rows, ThreadPool* pool, F&& f)
+{
+    const size_t bands = (h + band_rows - 1) / band_rows;
+    if(pool && bands > 1) {
+        pool->ParallelFor(bands, [&](size_t b) {
+            f(b * band_rows, std::min(h, (b+1) * band_rows));
+        });
+    }else{
+        f(0, h);
     }
 }
 
-template <typename T>
-void ChainSwap2(T& a, T& b)
+// Several bands per thread to even out load across busy workers
+size_t BandRows(size_t h, ThreadPool* pool)
 {
-    T t = a;
-    a = b;
-    b = t;
+    const size_t bands = pool ? 4 * (pool->NumThreads() + 1) : 1;
+    return std::max<size_t>(1, (h + bands - 1) / bands);
 }
 
-template <typename T>
-void ChainSwap4(T& a, T& b, T& c, T& d)
+//////////////////////////////////////////////////////////////////////////////
+// Row reversal. Vector kernels return the number of pixels reversed.
+
+template<typename T>
+size_t ReverseRowVec(T*, const T*, size_t)
 {
-    T t = a;
-    a = b;
-    b = c;
-    c = d;
-    d = t;
+    return 0;
 }
 
-template <size_t BPP, size_t TSZ>
-void TiledFlipX(Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+#ifdef PANGO_MIRROR_SSE2
+inline __m128i Reverse(__m128i v, uint64_t)
 {
-    const size_t w = img_in.w;
-    const size_t h = img_in.h;
-
-    typedef struct
-    {
-        unsigned char d[BPP];
-    } T;
-    T d[TSZ][TSZ];
-
-    for(size_t xin = 0; xin < w; xin += TSZ)
-        for(size_t yin = 0; yin < h; yin += TSZ)
-        {
-            const size_t xspan = std::min(TSZ, w - xin);
-            const size_t yspan = std::min(TSZ, h - yin);
-            const size_t xout = w - xin - TSZ;
-            const size_t yout = yin;
-
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
-
-            for(size_t y = 0; y < TSZ; y++)
-                for(size_t x = 0; x < TSZ / 2; x++)
-                    ChainSwap2(d[y][x], d[y][TSZ - 1 - x]);
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2));
+}
 
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(img_out.RowPtr(yout + y) + (xout + TSZ - xspan) * BPP, d[y] + TSZ - xspan, xspan * BPP);
-        }
+inline __m128i Reverse(__m128i v, uint32_t)
+{
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3));
 }
 
-template <size_t BPP, size_t TSZ>
-void TiledRotate180(Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+inline __m128i Reverse(__m128i v, uint16_t)
 {
-    static_assert(!(TSZ & 1), "Tilesize must be even.");
+    v = Reverse(v, uint32_t());
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+}
 
-    const size_t w = img_in.w;
-    const size_t h = img_in.h;
+inline __m128i Reverse(__m128i v, uint8_t)
+{
+    v = Reverse(v, uint16_t());
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
 
-    typedef struct
-    {
-        unsigned char d[BPP];
-    } T;
-    T d[TSZ][TSZ];
+template<typename T>
+size_t ReverseRowSse2(T* out, const T* in, size_t w)
+{
+    const size_t n = sizeof(__m128i) / sizeof(T);
+    size_t x = 0;
+    for(; x + n <= w; x += n) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+        _mm_storeu_si128((__m128i*)(out + w - x - n), Reverse(v, T()));
+    }
+    return x;
+}
 
-    for(size_t xin = 0; xin < w; xin += TSZ)
-        for(size_t yin = 0; yin < h; yin += TSZ)
-        {
-            const size_t xspan = std::min(TSZ, w - xin);
-            const size_t yspan = std::min(TSZ, h - yin);
-            const size_t xout = w - xin - TSZ;
-            const size_t yout = h - yin - TSZ;
+inline size_t ReverseRowVec(uint8_t* out, const uint8_t* in, size_t w)   { return ReverseRowSse2(out, in, w); }
+inline size_t ReverseRowVec(uint16_t* out, const uint16_t* in, size_t w) { return ReverseRowSse2(out, in, w); }
+inline size_t ReverseRowVec(uint32_t* out, const uint32_t* in, size_t w) { return ReverseRowSse2(out, in, w); }
+inline size_t ReverseRowVec(uint64_t* out, const uint64_t* in, size_t w) { return ReverseRowSse2(out, in, w); }
+#endif // PANGO_MIRROR_SSE2
 
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
+template<typename T>
+void ReverseRow(T* out, const T* in, size_t w)
+{
+    for(size_t x = ReverseRowVec(out, in, w); x < w; ++x) {
+        out[w - 1 - x] = in[x];
+    }
+}
 
-            for(size_t y = 0; y < TSZ / 2; y++)
-                for(size_t x = 0; x < TSZ; x++)
-                    ChainSwap2(d[y][x], d[TSZ - 1 - y][TSZ - 1 - x]);
+//////////////////////////////////////////////////////////////////////////////
+// Transpose. Rows are addressed with signed strides so that reading in
+// bottom up gives RotateCW, and writing out bottom up gives RotateCCW.
 
-            for(size_t y = TSZ - yspan; y < TSZ; y++)
-                memcpy(img_out.RowPtr(yout + y) + (xout + TSZ - xspan) * BPP, d[y] + TSZ - xspan, xspan * BPP);
-        }
-}
+// Unsigned integer of at least N bytes
+template<size_t N> struct Carrier { typedef typename Carrier<N+1>::type type; };
+template<> struct Carrier<1> { typedef uint8_t type; };
+template<> struct Carrier<2> { typedef uint16_t type; };
+template<> struct Carrier<4> { typedef uint32_t type; };
+template<> struct Carrier<8> { typedef uint64_t type; };
 
-template <size_t BPP, size_t TSZ>
-void TiledTranspose(Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+template<typename T>
+struct TransposeBlock
 {
-    const size_t w = img_in.w;
-    const size_t h = img_in.h;
+    static const size_t size = 8;
 
-    typedef struct
+    static void Run(unsigned char* out, ptrdiff_t out_stride, const unsigned char* in, ptrdiff_t in_stride, size_t bw, size_t bh)
     {
-        unsigned char d[BPP];
-    } T;
-    T d[TSZ][TSZ];
+        for(size_t x = 0; x < bw; ++x) {
+            T* o = (T*)(out + (ptrdiff_t)x * out_stride);
+            for(size_t y = 0; y < bh; ++y) {
+                o[y] = ((const T*)(in + (ptrdiff_t)y * in_stride))[x];
+            }
+        }
+    }
 
-    for(size_t xin = 0; xin < w; xin += TSZ)
-        for(size_t yin = 0; yin < h; yin += TSZ)
-        {
-            const size_t xspan = std::min(TSZ, w - xin);
-            const size_t yspan = std::min(TSZ, h - yin);
-            const size_t dmin = std::min(xspan, yspan);
-            const size_t dmax = std::max(xspan, yspan);
-            const size_t xout = yin;
-            const size_t yout = xin;
-
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
-
-            for(size_t x = 0; x < dmin; x++)
-                for(size_t y = x + 1; y < dmax; y++)
-                    ChainSwap2(d[x][y], d[y][x]);
-
-            for(size_t y = 0; y < xspan; y++)
-                memcpy(img_out.RowPtr(yout + y) + xout * BPP, d[y], yspan * BPP);
+    // Whole rows are copied through a local block, which is transposed in
+    // cache. Pixels move as a power of two sized word which overlaps the next
+    // pixel, so rows are padded and written in increasing order.
+    static void Run(unsigned char* out, ptrdiff_t out_stride, const unsigned char* in, ptrdiff_t in_stride)
+    {
+        typedef typename Carrier<sizeof(T)>::type W;
+        const size_t row_bytes = size * sizeof(T);
+        unsigned char a[size][row_bytes + sizeof(W)];
+        unsigned char b[size][row_bytes + sizeof(W)];
+        for(size_t y = 0; y < size; ++y) {
+            std::memcpy(a[y], in + (ptrdiff_t)y * in_stride, row_bytes);
         }
-}
+        for(size_t x = 0; x < size; ++x) {
+            for(size_t y = 0; y < size; ++y) {
+                W v;
+                std::memcpy(&v, a[y] + x * sizeof(T), sizeof(W));
+                std::memcpy(b[x] + y * sizeof(T), &v, sizeof(W));
+            }
+        }
+        for(size_t x = 0; x < size; ++x) {
+            std::memcpy(out + (ptrdiff_t)x * out_stride, b[x], row_bytes);
+        }
+    }
+};
 
-template <size_t BPP, size_t TSZ>
-void TiledRotateCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+#ifdef PANGO_MIRROR_SSE2
+template<>
+struct TransposeBlock<uint8_t> : TransposeBlock<Pixel<1>>
 {
-    static_assert(!(TSZ & 1), "Tilesize must be even.");
+    using TransposeBlock<Pixel<1>>::Run;
 
-    const size_t w = img_in.w;
-    const size_t h = img_in.h;
-
-    typedef struct
+    static void Run(unsigned char* out, ptrdiff_t os, const unsigned char* in, ptrdiff_t is)
     {
-        unsigned char d[BPP];
-    } T;
-    T d[TSZ][TSZ];
+        __m128i r[8];
+        for(int i=0; i < 8; ++i) r[i] = _mm_loadl_epi64((const __m128i*)(in + i*is));
+        const __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+        const __m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+        const __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+        const __m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+        const __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+        const __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+        const __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+        const __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+        // Each holds two output rows
+        const __m128i c[4] = {
+            _mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2),
+            _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3)
+        };
+        for(int i=0; i < 4; ++i) {
+            _mm_storel_epi64((__m128i*)(out + (2*i)*os), c[i]);
+            _mm_storel_epi64((__m128i*)(out + (2*i+1)*os), _mm_srli_si128(c[i], 8));
+        }
+    }
+};
 
-    for(size_t xin = 0; xin < w; xin += TSZ)
-        for(size_t yin = 0; yin < h; yin += TSZ)
-        {
-            const size_t xspan = std::min(TSZ, w - xin);
-            const size_t yspan = std::min(TSZ, h - yin);
-            const size_t xout = h - yin - TSZ;
-            const size_t yout = xin;
+template<>
+struct TransposeBlock<uint16_t> : TransposeBlock<Pixel<2>>
+{
+    using TransposeBlock<Pixel<2>>::Run;
 
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
+    static void Run(unsigned char* out, ptrdiff_t os, const unsigned char* in, ptrdiff_t is)
+    {
+        __m128i r[8];
+        for(int i=0; i < 8; ++i) r[i] = _mm_loadu_si128((const __m128i*)(in + i*is));
+        const __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+        const __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+        const __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+        const __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+        const __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+        const __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+        const __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+        const __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+        const __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+        const __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+        const __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+        const __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+        const __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+        const __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+        const __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+        const __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+        const __m128i c[8] = {
+            _mm_unpacklo_epi64(b0, b4), _mm_unpackhi_epi64(b0, b4),
+            _mm_unpacklo_epi64(b1, b5), _mm_unpackhi_epi64(b1, b5),
+            _mm_unpacklo_epi64(b2, b6), _mm_unpackhi_epi64(b2, b6),
+            _mm_unpacklo_epi64(b3, b7), _mm_unpackhi_epi64(b3, b7)
+        };
+        for(int i=0; i < 8; ++i) _mm_storeu_si128((__m128i*)(out + i*os), c[i]);
+    }
+};
 
-            for(size_t y = 0; y < TSZ / 2; y++)
-                for(size_t x = 0; x < TSZ / 2; x++)
-                    ChainSwap4(d[TSZ - 1 - x][y], d[TSZ - 1 - y][TSZ - 1 - x], d[x][TSZ - 1 - y], d[y][x]);
+template<>
+struct TransposeBlock<uint32_t> : TransposeBlock<Pixel<4>>
+{
+    using TransposeBlock<Pixel<4>>::Run;
+    static const size_t size = 4;
 
-            for(size_t y = 0; y < xspan; y++)
-                memcpy(img_out.RowPtr(yout + y) + (xout + TSZ - yspan) * BPP, d[y] + TSZ - yspan, yspan * BPP);
-        }
-}
+    static void Run(unsigned char* out, ptrdiff_t os, const unsigned char* in, ptrdiff_t is)
+    {
+        const __m128i r0 = _mm_loadu_si128((const __m128i*)(in));
+        const __m128i r1 = _mm_loadu_si128((const __m128i*)(in + is));
+        const __m128i r2 = _mm_loadu_si128((const __m128i*)(in + 2*is));
+        const __m128i r3 = _mm_loadu_si128((const __m128i*)(in + 3*is));
+        const __m128i a0 = _mm_unpacklo_epi32(r0, r1);
+        const __m128i a1 = _mm_unpackhi_epi32(r0, r1);
+        const __m128i a2 = _mm_unpacklo_epi32(r2, r3);
+        const __m128i a3 = _mm_unpackhi_epi32(r2, r3);
+        _mm_storeu_si128((__m128i*)(out),        _mm_unpacklo_epi64(a0, a2));
+        _mm_storeu_si128((__m128i*)(out + os),   _mm_unpackhi_epi64(a0, a2));
+        _mm_storeu_si128((__m128i*)(out + 2*os), _mm_unpacklo_epi64(a1, a3));
+        _mm_storeu_si128((__m128i*)(out + 3*os), _mm_unpackhi_epi64(a1, a3));
+    }
+};
 
-template <size_t BPP, size_t TSZ>
-void TiledRotateCCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+template<>
+struct TransposeBlock<uint64_t> : TransposeBlock<Pixel<8>>
 {
-    static_assert(!(TSZ & 1), "Tilesize must be even.");
-
-    const size_t w = img_in.w;
-    const size_t h = img_in.h;
+    using TransposeBlock<Pixel<8>>::Run;
+    static const size_t size = 2;
 
-    typedef struct
+    static void Run(unsigned char* out, ptrdiff_t os, const unsigned char* in, ptrdiff_t is)
     {
-        unsigned char d[BPP];
-    } T;
-    T d[TSZ][TSZ];
+        const __m128i r0 = _mm_loadu_si128((const __m128i*)(in));
+        const __m128i r1 = _mm_loadu_si128((const __m128i*)(in + is));
+        _mm_storeu_si128((__m128i*)(out),      _mm_unpacklo_epi64(r0, r1));
+        _mm_storeu_si128((__m128i*)(out + os), _mm_unpackhi_epi64(r0, r1));
+    }
+};
+#endif // PANGO_MIRROR_SSE2
 
-    for(size_t xin = 0; xin < w; xin += TSZ)
-        for(size_t yin = 0; yin < h; yin += TSZ)
-        {
-            const size_t xspan = std::min(TSZ, w - xin);
-            const size_t yspan = std::min(TSZ, h - yin);
-            const size_t xout = yin;
-            const size_t yout = w - xin - TSZ;
+// Transpose rows [y0,y1) of the w x h image in into columns of out, a tile x
+// tile block at a time so that the lines of both stay in cache.
+template<typename T>
+void TransposeRows(unsigned char* out, ptrdiff_t out_stride, const unsigned char* in, ptrdiff_t in_stride, size_t w, size_t tile, size_t y0, size_t y1)
+{
+    typedef TransposeBlock<T> Block;
+    const size_t B = Block::size;
+
+    for(size_t ty = y0; ty < y1; ty += tile) {
+        const size_t ty1 = std::min(y1, ty + tile);
+        for(size_t tx = 0; tx < w; tx += tile) {
+            const size_t tx1 = std::min(w, tx + tile);
+            // Along output rows innermost, so that their lines fill in order
+            for(size_t x = tx; x < tx1; x += B) {
+                const size_t bw = std::min(B, tx1 - x);
+                for(size_t y = ty; y < ty1; y += B) {
+                    const size_t bh = std::min(B, ty1 - y);
+                    unsigned char* o = out + (ptrdiff_t)x * out_stride + y * sizeof(T);
+                    const unsigned char* i = in + (ptrdiff_t)y * in_stride + x * sizeof(T);
+                    if(bw == B && bh == B) {
+                        Block::Run(o, out_stride, i, in_stride);
+                    }else{
+                        Block::Run(o, out_stride, i, in_stride, bw, bh);
+                    }
+                }
+            }
+        }
+    }
+}
 
-            for(size_t y = 0; y < yspan; y++)
-                memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
+enum TransposeVariant
+{
+    TransposeVariantTranspose,
+    TransposeVariantRotateCW,
+    TransposeVariantRotateCCW
+};
 
-            for(size_t y = 0; y < TSZ / 2; y++)
-                for(size_t x = 0; x < TSZ / 2; x++)
-                    ChainSwap4(d[y][x], d[x][TSZ - 1 - y], d[TSZ - 1 - y][TSZ - 1 - x], d[TSZ - 1 - x][y]);
+void TransposeImage(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, TransposeVariant variant, size_t tile, ThreadPool* pool)
+{
+    if( img_out.w != img_in.h || img_out.h != img_in.w ) {
+        throw std::runtime_error("Transpose: Incompatible image sizes");
+    }
 
-            for(size_t y = TSZ - xspan; y < TSZ; y++)
-                memcpy(img_out.RowPtr(yout + y) + xout * BPP, d[y], yspan * BPP);
-        }
-}
+    const unsigned char* in = img_in.ptr;
+    ptrdiff_t in_stride = (ptrdiff_t)img_in.pitch;
+    unsigned char* out = img_out.ptr;
+    ptrdiff_t out_stride = (ptrdiff_t)img_out.pitch;
+
+    if(variant == TransposeVariantRotateCW) {
+        in = img_in.RowPtr(img_in.h - 1);
+        in_stride = -in_stride;
+    }else if(variant == TransposeVariantRotateCCW) {
+        out = img_out.RowPtr(img_out.h - 1);
+        out_stride = -out_stride;
+    }
 
-void FlipX(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel)
-{
-    if(bytes_per_pixel == 1)
-        TiledFlipX<1, 160>(img_out, img_in);
-    else if(bytes_per_pixel == 2)
-        TiledFlipX<2, 120>(img_out, img_in);
-    else if(bytes_per_pixel == 3)
-        TiledFlipX<3, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 4)
-        TiledFlipX<4, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 6)
-        TiledFlipX<6, 64>(img_out, img_in);
-    else {
-        for(size_t y = 0; y < img_out.h; ++y) {
-            for(size_t x = 0; x < img_out.w; ++x) {
-                memcpy(img_out.RowPtr((int)y) + (img_out.w - 1 - x) * bytes_per_pixel,
-                       img_in.RowPtr((int)y) + x * bytes_per_pixel,
-                       bytes_per_pixel);
+    // Bands are whole tiles, so threads share no output cache lines except at tile edges
+    const size_t band_rows = ((BandRows(img_in.h, pool) + tile - 1) / tile) * tile;
+
+    const bool typed = DispatchPixelType(bytes_per_pixel, [&](auto pix) {
+        typedef decltype(pix) T;
+        ForEachBand(img_in.h, band_rows, pool, [&](size_t y0, size_t y1) {
+            TransposeRows<T>(out, out_stride, in, in_stride, img_in.w, tile, y0, y1);
+        });
+    });
+
+    if(!typed) {
+        for(size_t y = 0; y < img_in.h; ++y) {
+            const unsigned char* row_in = in + (ptrdiff_t)y * in_stride;
+            for(size_t x = 0; x < img_in.w; ++x) {
+                memcpy(out + (ptrdiff_t)x * out_stride + y * bytes_per_pixel, row_in + x * bytes_per_pixel, bytes_per_pixel);
             }
         }
     }
 }
 
-void FlipXY(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel)
-{
-    if(bytes_per_pixel == 1)
-        TiledRotate180<1, 160>(img_out, img_in);
-    else if(bytes_per_pixel == 2)
-        TiledRotate180<2, 120>(img_out, img_in);
-    else if(bytes_per_pixel == 3)
-        TiledRotate180<3, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 4)
-        TiledRotate180<4, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 6)
-        TiledRotate180<6, 64>(img_out, img_in);
-    else {
-        for(size_t y_out = 0; y_out < img_out.h; ++y_out) {
-            for(size_t x = 0; x < img_out.w; ++x) {
-                const size_t y_in = (img_in.h - 1) - y_out;
-                memcpy(img_out.RowPtr((int)y_out) + (img_out.w - 1 - x) * bytes_per_pixel,
-                       img_in.RowPtr((int)y_in) + x * bytes_per_pixel,
-                       bytes_per_pixel);
+// Copy rows of img_in to img_out, reversing their order if flip_y and
+// reversing the pixels within each if flip_x.
+void FlipImage(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, bool flip_x, bool flip_y, ThreadPool* pool)
+{
+    if( img_out.w != img_in.w || img_out.h != img_in.h ) {
+        throw std::runtime_error("Flip: Incompatible image sizes");
+    }
+
+    const size_t h = img_in.h;
+    ForEachBand(h, BandRows(h, pool), pool, [&](size_t y0, size_t y1) {
+        for(size_t y = y0; y < y1; ++y) {
+            unsigned char* row_out = img_out.RowPtr(flip_y ? h - 1 - y : y);
+            const unsigned char* row_in = img_in.RowPtr(y);
+            if(!flip_x) {
+                std::memcpy(row_out, row_in, bytes_per_pixel * img_in.w);
+            }else if(!DispatchPixelType(bytes_per_pixel, [&](auto pix) {
+                typedef decltype(pix) T;
+                ReverseRow((T*)row_out, (const T*)row_in, img_in.w);
+            })) {
+                for(size_t x = 0; x < img_in.w; ++x) {
+                    memcpy(row_out + (img_in.w - 1 - x) * bytes_per_pixel, row_in + x * bytes_per_pixel, bytes_per_pixel);
+                }
             }
         }
-    }
+    });
 }
 
-void RotateCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel)
-{
-    if(bytes_per_pixel == 1)
-        TiledRotateCW<1, 160>(img_out, img_in);
-    else if(bytes_per_pixel == 2)
-        TiledRotateCW<2, 120>(img_out, img_in);
-    else if(bytes_per_pixel == 3)
-        TiledRotateCW<3, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 4)
-        TiledRotateCW<4, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 6)
-        TiledRotateCW<6, 64>(img_out, img_in);
-    else {
-        for(size_t yout = 0; yout < img_out.h; ++yout)
-            for(size_t xout = 0; xout < img_out.w; ++xout) {
-                size_t xin = yout;
-                size_t yin = img_out.w - 1 - xout;
-                memcpy(img_out.RowPtr((int)yout) + xout * bytes_per_pixel,
-                       img_in.RowPtr((int)yin) + xin * bytes_per_pixel,
-                       bytes_per_pixel);
-            }
-    }
 }
 
-void Transpose(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel)
-{
-    if(bytes_per_pixel == 1)
-        TiledTranspose<1, 160>(img_out, img_in);
-    else if(bytes_per_pixel == 2)
-        TiledTranspose<2, 120>(img_out, img_in);
-    else if(bytes_per_pixel == 3)
-        TiledTranspose<3, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 4)
-        TiledTranspose<4, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 6)
-        TiledTranspose<6, 64>(img_out, img_in);
-    else {
-        for(size_t yout = 0; yout < img_out.h; ++yout)
-            for(size_t xout = 0; xout < img_out.w; ++xout) {
-                size_t xin = yout;
-                size_t yin = xout;
-                memcpy(img_out.RowPtr((int)yout) + xout * bytes_per_pixel,
-                       img_in.RowPtr((int)yin) + xin * bytes_per_pixel,
-                       bytes_per_pixel);
-            }
-    }
+void PitchedImageCopy(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, ThreadPool* pool)
+{
+    FlipImage(img_out, img_in, bytes_per_pixel, false, false, pool);
 }
 
-void RotateCCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel)
-{
-    if(bytes_per_pixel == 1)
-        TiledRotateCCW<1, 160>(img_out, img_in);
-    else if(bytes_per_pixel == 2)
-        TiledRotateCCW<2, 120>(img_out, img_in);
-    else if(bytes_per_pixel == 3)
-        TiledRotateCCW<3, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 4)
-        TiledRotateCCW<4, 80>(img_out, img_in);
-    else if(bytes_per_pixel == 6)
-        TiledRotateCCW<6, 64>(img_out, img_in);
-    else {
-        for(size_t yout = 0; yout < img_out.h; ++yout)
-            for(size_t xout = 0; xout < img_out.w; ++xout) {
-                size_t xin = img_out.h - 1 - yout;
-                size_t yin = xout;
-                memcpy(img_out.RowPtr((int)yout) + xout * bytes_per_pixel,
-                       img_in.RowPtr((int)yin) + xin * bytes_per_pixel,
-                       bytes_per_pixel);
-            }
-    }
+void FlipX(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, ThreadPool* pool)
+{
+    FlipImage(img_out, img_in, bytes_per_pixel, true, false, pool);
 }
 
+void FlipY(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, ThreadPool* pool)
+{
+    FlipImage(img_out, img_in, bytes_per_pixel, false, true, pool);
+}
 
-void MirrorVideo::Process(unsigned char* buffer_out, const unsigned char* buffer_in)
+void FlipXY(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, ThreadPool* pool)
+{
+    FlipImage(img_out, img_in, bytes_per_pixel, true, true, pool);
+}
+
+void Transpose(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, size_t tile, ThreadPool* pool)
 {
+    TransposeImage(img_out, img_in, bytes_per_pixel, TransposeVariantTranspose, tile, pool);
+}
 
+void RotateCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, size_t tile, ThreadPool* pool)
+{
+    TransposeImage(img_out, img_in, bytes_per_pixel, TransposeVariantRotateCW, tile, pool);
+}
+
+void RotateCCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in, size_t bytes_per_pixel, size_t tile, ThreadPool* pool)
+{
+    TransposeImage(img_out, img_in, bytes_per_pixel, TransposeVariantRotateCCW, tile, pool);
+}
+
+void MirrorVideo::Process(unsigned char* buffer_out, const unsigned char* buffer_in)
+{
     for(size_t s=0; s<streams.size(); ++s) {
         Image<unsigned char> img_out = Streams()[s].StreamImage(buffer_out);
         const Image<unsigned char> img_in  = videoin->Streams()[s].StreamImage(buffer_in);
@@ -442,36 +525,66 @@ void MirrorVideo::Process(unsigned char* buffer_out, const unsigned char* buffer
 
         switch (flips[s]) {
         case MirrorOptionsFlipX:
-            FlipX(img_out, img_in, bytes_per_pixel);
+            FlipX(img_out, img_in, bytes_per_pixel, pool.get());
             break;
         case MirrorOptionsFlipY:
-            FlipY(img_out, img_in, bytes_per_pixel);
+            FlipY(img_out, img_in, bytes_per_pixel, pool.get());
             break;
         case MirrorOptionsFlipXY:
-            FlipXY(img_out, img_in, bytes_per_pixel);
+            FlipXY(img_out, img_in, bytes_per_pixel, pool.get());
             break;
         case MirrorOptionsRotateCW:
-            RotateCW(img_out, img_in, bytes_per_pixel);
-            break;
         case MirrorOptionsRotateCCW:
-            RotateCCW(img_out, img_in, bytes_per_pixel);
-            break;
         case MirrorOptionsTranspose:
-            Transpose(img_out, img_in, bytes_per_pixel);
+        {
+            // Time each candidate tile size on the first frames, then keep the fastest
+            const size_t trial = tile_trial[s];
+            const bool tuning = trial < num_tile_candidates * tile_trials;
+            const size_t tile = tuning ? tile_candidates[trial % num_tile_candidates] : tile_size[s];
+            const basetime start = TimeNow();
+
+            if(flips[s] == MirrorOptionsRotateCW) {
+                RotateCW(img_out, img_in, bytes_per_pixel, tile, pool.get());
+            }else if(flips[s] == MirrorOptionsRotateCCW) {
+                RotateCCW(img_out, img_in, bytes_per_pixel, tile, pool.get());
+            }else{
+                Transpose(img_out, img_in, bytes_per_pixel, tile, pool.get());
+            }
+
+            if(tuning) {
+                const double dt = double(TimeDiff_us(start, TimeNow()));
+                double& best = tile_time[s][trial % num_tile_candidates];
+                best = (trial < num_tile_candidates) ? dt : std::min(best, dt);
+                if(++tile_trial[s] == num_tile_candidates * tile_trials) {
+                    const size_t c = std::min_element(tile_time[s].begin(), tile_time[s].end()) - tile_time[s].begin();
+                    tile_size[s] = tile_candidates[c];
+                }
+            }
             break;
+        }
         case MirrorOptionsNone:
-            PitchedImageCopy(img_out, img_in, bytes_per_pixel);
+            PitchedImageCopy(img_out, img_in, bytes_per_pixel, pool.get());
             break;
         default:
             pango_print_warn("MirrorVideo::Process(): Invalid enum %i.\n", flips[s]);
         }
     }
+}
 
+void MirrorVideo::Allocate()
+{
+    if(!buffer) {
+        buffer = new unsigned char[size_bytes];
+        if(num_threads > 1) {
+            pool.reset(new ThreadPool(num_threads-1));
+        }
+    }
 }
 
 //! Implement VideoInput::GrabNext()
 bool MirrorVideo::GrabNext( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin->GrabNext(buffer,wait)) {
         Process(image, buffer);
         return true;
@@ -483,6 +596,7 @@ bool MirrorVideo::GrabNext( unsigned char* image, bool wait )
 //! Implement VideoInput::GrabNewest()
 bool MirrorVideo::GrabNewest( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin->GrabNewest(buffer,wait)) {
         Process(image, buffer);
         return true;
@@ -496,6 +610,51 @@ std::vector<VideoInterface*>& MirrorVideo::InputStreams()
     return inputs;
 }
 
+bool MirrorVideo::RowSeparable() const
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        if(flips[s] != MirrorOptionsNone && flips[s] != MirrorOptionsFlipX &&
+           flips[s] != MirrorOptionsFlipY && flips[s] != MirrorOptionsFlipXY) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MirrorVideo::InputRows(size_t s, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const
+{
+    if(flips[s] == MirrorOptionsFlipY || flips[s] == MirrorOptionsFlipXY) {
+        const size_t h = streams[s].Height();
+        in_y0 = h - y1;
+        in_y1 = h - y0;
+    }else{
+        in_y0 = y0;
+        in_y1 = y1;
+    }
+}
+
+void MirrorVideo::ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t, size_t)
+{
+    const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+
+    switch (flips[s]) {
+    case MirrorOptionsFlipX:
+        FlipX(out, in, bytes_per_pixel, nullptr);
+        break;
+    case MirrorOptionsFlipY:
+        FlipY(out, in, bytes_per_pixel, nullptr);
+        break;
+    case MirrorOptionsFlipXY:
+        FlipXY(out, in, bytes_per_pixel, nullptr);
+        break;
+    case MirrorOptionsNone:
+        PitchedImageCopy(out, in, bytes_per_pixel, nullptr);
+        break;
+    default:
+        throw VideoException("MirrorVideo::ProcessRows(): Option is not row separable.");
+    }
+}
+
 unsigned int MirrorVideo::AvailableFrames() const
 {
     BufferAwareVideoInterface* vpi = dynamic_cast<BufferAwareVideoInterface*>(videoin.get());
@@ -563,6 +722,8 @@ PANGOLIN_REGISTER_FACTORY(MirrorVideo)
             if(uri.scheme == "rotateCW") default_opt = MirrorOptionsRotateCW;
             if(uri.scheme == "rotateCCW") default_opt = MirrorOptionsRotateCCW;
 
+            const size_t num_threads = uri.Get<size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
+
             std::vector<MirrorOptions> flips;
 
             for(size_t i=0; i < subvid->Streams().size(); ++i){
@@ -572,7 +733,7 @@ PANGOLIN_REGISTER_FACTORY(MirrorVideo)
                 flips.push_back(uri.Get<MirrorOptions>(key, default_opt) );
             }
 
-            return std::unique_ptr<VideoInterface> (new MirrorVideo(subvid, flips));
+            return std::unique_ptr<VideoInterface> (new MirrorVideo(subvid, flips, num_threads));
         }
     };
 
@@ -28,6 +28,7 @@
 #include <pangolin/video/drivers/pack.h>
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
+#include <pangolin/image/pixel_packing.h>
 
 #ifdef DEBUGUNPACK
   #include <pangolin/utils/timer.h>
@@ -115,45 +116,13 @@ void ConvertTo8bit(
     }
 }
 
-template<typename T>
-void ConvertTo10bit(
-    Image<unsigned char>& out,
-    const Image<unsigned char>& in
-) {
-    for(size_t r=0; r<out.h; ++r) {
-        uint8_t* pout = out.ptr + r*out.pitch;
-        T* pin = (T*)(in.ptr + r*in.pitch);
-        const T* pin_end = (T*)(in.ptr + (r+1)*in.pitch);
-        while(pin != pin_end) {
-            uint64_t val = (*(pin++) & 0x00000003FF);
-            val |= uint64_t(*(pin++) & 0x00000003FF) << 10;
-            val |= uint64_t(*(pin++) & 0x00000003FF) << 20;
-            val |= uint64_t(*(pin++) & 0x00000003FF) << 30;
-            *(pout++) = uint8_t( val & 0x00000000FF);
-            *(pout++) = uint8_t((val & 0x000000FF00) >> 8);
-            *(pout++) = uint8_t((val & 0x0000FF0000) >> 16);
-            *(pout++) = uint8_t((val & 0x00FF000000) >> 24);
-            *(pout++) = uint8_t((val & 0xFF00000000) >> 32);
-        }
-    }
-}
-
-template<typename T>
-void ConvertTo12bit(
+void ConvertToPacked(
     Image<unsigned char>& out,
-    const Image<unsigned char>& in
+    const Image<unsigned char>& in,
+    void (*pack)(uint8_t*, const uint16_t*, size_t)
 ) {
     for(size_t r=0; r<out.h; ++r) {
-        uint8_t* pout = out.ptr + r*out.pitch;
-        T* pin = (T*)(in.ptr + r*in.pitch);
-        const T* pin_end = (T*)(in.ptr + (r+1)*in.pitch);
-        while(pin != pin_end) {
-            uint32_t val = (*(pin++) & 0x00000FFF);
-            val |= uint32_t(*(pin++) & 0x00000FFF) << 12;
-            *(pout++) = uint8_t( val & 0x000000FF);
-            *(pout++) = uint8_t((val & 0x0000FF00) >> 8);
-            *(pout++) = uint8_t((val & 0x00FF0000) >> 16);
-        }
+        pack(out.ptr + r*out.pitch, (const uint16_t*)(in.ptr + r*in.pitch), in.w);
     }
 }
 
@@ -170,9 +139,9 @@ void PackVideo::Process(unsigned char* image, const unsigned char* buffer)
             if(bits_out == 8) {
                 ConvertTo8bit<uint16_t>(img_out, img_in);
             }else if( bits_out == 10) {
-                ConvertTo10bit<uint16_t>(img_out, img_in);
+                ConvertToPacked(img_out, img_in, Pack10bit);
             }else if( bits_out == 12){
-                ConvertTo12bit<uint16_t>(img_out, img_in);
+                ConvertToPacked(img_out, img_in, Pack12bit);
             }else{
                 throw pangolin::VideoException("Unsupported bitdepths.");
             }
@@ -29,10 +29,12 @@
 #include <pangolin/log/playback_session.h>
 #include <pangolin/utils/file_extension.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/memstreambuf.h>
 #include <pangolin/utils/signal_slot.h>
 #include <pangolin/video/drivers/pango.h>
 #include <pangolin/video/iostream_operators.h>
 
+#include <algorithm>
 #include <functional>
 
 namespace pangolin
@@ -40,33 +42,53 @@ namespace pangolin
 
 const std::string pango_video_type = "raw_video";
 
-PangoVideo::PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session)
+PangoVideo::PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session, size_t prefetch, size_t decode_threads)
     : _filename(filename),
       _playback_session(playback_session),
       _reader(_playback_session->Open(filename)),
       _event_promise(_playback_session->Time()),
       _src_id(FindPacketStreamSource()),
-      _source(nullptr)
+      _source(nullptr),
+      _prefetch(prefetch),
+      _prefetch_quit(false),
+      _prefetch_end(false),
+      _current_frame_id(static_cast<size_t>(-1))
 {
     PANGO_ENSURE(_src_id != -1, "No appropriate video streams found in log.");
 
     _source = &_reader->Sources()[_src_id];
     SetupStreams(*_source);
 
+    const bool compressed = std::any_of(stream_decoder.begin(), stream_decoder.end(),
+        [](const ImageDecoderIntoFunc& f){ return bool(f); }
+    );
+    if(_prefetch && decode_threads > 1 && compressed) {
+        _decode_pool.reset(new ThreadPool(decode_threads));
+        for(size_t i=0; i < decode_threads; ++i) {
+            _free_decoders.push_back(CreateDecoders());
+        }
+    }
+
     // Make sure we time-seek with other playback devices
     session_seek = _playback_session->Time().OnSeek.Connect(
         [&](SyncTime::TimePoint t){
             _event_promise.Cancel();
+            // Frames read ahead are from before the seek.
+            StopPrefetch();
             _reader->Seek(_src_id, t);
+            _current_frame_id = _source->next_packet_id - 1;
             _event_promise.WaitAndRenew(_source->NextPacketTime());
+            StartPrefetch();
         }
     );
 
     _event_promise.WaitAndRenew(_source->NextPacketTime());
+    StartPrefetch();
 }
 
 PangoVideo::~PangoVideo()
 {
+    StopPrefetch();
 }
 
 size_t PangoVideo::SizeBytes() const
@@ -89,37 +111,66 @@ void PangoVideo::Stop()
 
 }
 
-bool PangoVideo::GrabNext(unsigned char* image, bool /*wait*/)
+void PangoVideo::ReadPacket(Packet& fi, unsigned char* image)
 {
-    try
-    {
-        Packet fi = _reader->NextFrame(_src_id);
-        _frame_properties = fi.meta;
+    if(_fixed_size) {
+        if(const unsigned char* src = fi.ReadDirect(_size_bytes)) {
+            std::memcpy(image, src, _size_bytes);
+        }else{
+            fi.Read(reinterpret_cast<char*>(image), _size_bytes);
+        }
+    }else if(fi.Compressed()) {
+        memreadstreambuf sb(reinterpret_cast<const char*>(fi.ReadDirect(fi.size)), fi.size);
+        std::istream is(&sb);
+        DecodeStreams(is, image, stream_decoder);
+    }else{
+        DecodeStreams(fi.Stream(), image, stream_decoder);
+    }
+}
 
-        if(_fixed_size) {
-            fi.Stream().read(reinterpret_cast<char*>(image), _size_bytes);
+void PangoVideo::DecodeStreams(std::istream& is, unsigned char* image, const std::vector<ImageDecoderIntoFunc>& decoders)
+{
+    for(size_t s=0; s < _streams.size(); ++s) {
+        StreamInfo& si = _streams[s];
+        pangolin::Image<unsigned char> dst = si.StreamImage(image);
+
+        if(decoders[s]) {
+            decoders[s](is, dst);
         }else{
-            for(size_t s=0; s < _streams.size(); ++s) {
-                StreamInfo& si = _streams[s];
-                pangolin::Image<unsigned char> dst = si.StreamImage(image);
+            for(size_t row =0; row < dst.h; ++row) {
+                is.read((char*)dst.RowPtr(row), si.RowBytes());
+            }
+        }
+    }
+}
 
-                if(stream_decoder[s]) {
-                    pangolin::TypedImage img = stream_decoder[s](fi.Stream());
-                    PANGO_ENSURE(img.IsValid());
+void PangoVideo::ReadNextPacket(const std::function<void(Packet&)>& read)
+{
+    Packet fi = _reader->NextFrame(_src_id);
+    _frame_properties = fi.meta;
+    read(fi);
+    _event_promise.WaitAndRenew(_source->NextPacketTime());
+}
 
-                    // TODO: We can avoid this copy by decoding directly into img
-                    for(size_t row =0; row < dst.h; ++row) {
-                        std::memcpy(dst.RowPtr(row), img.RowPtr(row), si.RowBytes());
-                    }
-                }else{
-                    for(size_t row =0; row < dst.h; ++row) {
-                        fi.Stream().read((char*)dst.RowPtr(row), si.RowBytes());
-                    }
-                }
+bool PangoVideo::GrabNext(unsigned char* image, bool /*wait*/)
+{
+    try
+    {
+        if(_prefetch) {
+            PrefetchFrame frame;
+            if(!PopPrefetched(frame)) {
+                _frame_properties = picojson::value();
+                return false;
             }
+            std::memcpy(image, frame.buffer.get(), _size_bytes);
+            std::lock_guard<std::mutex> l(_prefetch_mutex);
+            _prefetch_free.push_back(std::move(frame.buffer));
+            return true;
         }
 
-        _event_promise.WaitAndRenew(_source->NextPacketTime());
+        ReadNextPacket([&](Packet& fi){
+            ReadPacket(fi, image);
+        });
         return true;
     }
     catch(...)
@@ -134,8 +185,57 @@ bool PangoVideo::GrabNewest( unsigned char* image, bool wait )
     return GrabNext(image, wait);
 }
 
+VideoFrameLease PangoVideo::GrabNextLease(bool wait)
+{
+    if(!_prefetch && !_fixed_size) {
+        // Frames are assembled from each stream, so need a buffer of their own.
+        std::shared_ptr<unsigned char> buffer(new unsigned char[_size_bytes], std::default_delete<unsigned char[]>());
+        if(GrabNext(buffer.get(), wait)) {
+            return VideoFrameLease(buffer.get(), buffer);
+        }
+        return VideoFrameLease();
+    }
+
+    try
+    {
+        if(_prefetch) {
+            // Hand over the prefetched buffer rather than copying it.
+            PrefetchFrame frame;
+            if(PopPrefetched(frame)) {
+                return VideoFrameLease(frame.buffer.get(), frame.buffer);
+            }
+        }else{
+            VideoFrameLease lease;
+            ReadNextPacket([&](Packet& fi){
+                // The lease keeps the mapping alive, even if the reader is closed.
+                // Decompressed data only lives as long as the packet, so is copied.
+                std::shared_ptr<void> owner = fi.Stream().mapping();
+                const unsigned char* ptr = fi.Compressed() ? nullptr : fi.ReadDirect(_size_bytes);
+
+                if(!ptr) {
+                    std::shared_ptr<unsigned char> buffer(new unsigned char[_size_bytes], std::default_delete<unsigned char[]>());
+                    fi.Read(reinterpret_cast<char*>(buffer.get()), _size_bytes);
+                    ptr = buffer.get();
+                    owner = buffer;
+                }
+                lease = VideoFrameLease(ptr, owner);
+            });
+            return lease;
+        }
+    }
+    catch(...)
+    {
+    }
+
+    _frame_properties = picojson::value();
+    return VideoFrameLease();
+}
+
 size_t PangoVideo::GetCurrentFrameId() const
 {
+    if(_prefetch) {
+        return _current_frame_id;
+    }
     return (int)(_reader->Sources()[_src_id].next_packet_id) - 1;
 }
 
@@ -161,6 +261,157 @@ std::string PangoVideo::GetSourceUri()
     return _source_uri;
 }
 
+bool PangoVideo::PopPrefetched(PrefetchFrame& frame)
+{
+    std::unique_lock<std::mutex> l(_prefetch_mutex);
+    _prefetch_cond.wait(l, [this](){ return !_prefetch_queue.empty() || _prefetch_end; });
+    if(_prefetch_queue.empty()) {
+        return false;
+    }
+    frame = std::move(_prefetch_queue.front());
+    _prefetch_queue.pop_front();
+    _prefetch_cond.notify_all();
+    l.unlock();
+
+    _frame_properties = std::move(frame.meta);
+    _current_frame_id = frame.frame_id;
+    if(frame.decoded.valid()) {
+        try {
+            // Rethrows any decode error
+            frame.decoded.get();
+        }catch(...) {
+            // The buffer can still be used for later frames.
+            std::lock_guard<std::mutex> l(_prefetch_mutex);
+            _prefetch_free.push_back(std::move(frame.buffer));
+            throw;
+        }
+    }
+    _event_promise.WaitAndRenew(frame.next_time_us);
+    return true;
+}
+
+void PangoVideo::StartPrefetch()
+{
+    if(_prefetch && !_prefetch_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> l(_prefetch_mutex);
+            _prefetch_quit = false;
+            _prefetch_end = false;
+        }
+        _prefetch_thread = std::thread(&PangoVideo::PrefetchLoop, this);
+    }
+}
+
+void PangoVideo::StopPrefetch()
+{
+    if(_prefetch_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> l(_prefetch_mutex);
+            _prefetch_quit = true;
+        }
+        _prefetch_cond.notify_all();
+        _prefetch_thread.join();
+    }
+
+    // Recycle anything not yet consumed, once any decode has finished with it
+    std::lock_guard<std::mutex> l(_prefetch_mutex);
+    for(auto& frame : _prefetch_queue) {
+        if(frame.decoded.valid()) {
+            frame.decoded.wait();
+        }
+        _prefetch_free.push_back(std::move(frame.buffer));
+    }
+    _prefetch_queue.clear();
+}
+
+void PangoVideo::PrefetchLoop()
+{
+    while(true) {
+        PrefetchFrame frame;
+        {
+            std::unique_lock<std::mutex> l(_prefetch_mutex);
+            _prefetch_cond.wait(l, [this](){ return _prefetch_quit || _prefetch_queue.size() < _prefetch; });
+            if(_prefetch_quit) {
+                return;
+            }
+            if(!_prefetch_free.empty()) {
+                frame.buffer = std::move(_prefetch_free.back());
+                _prefetch_free.pop_back();
+            }
+        }
+
+        if(!frame.buffer) {
+            frame.buffer.reset(new unsigned char[_size_bytes], std::default_delete<unsigned char[]>());
+        }
+
+        try
+        {
+            Packet fi = _reader->NextFrame(_src_id);
+            frame.meta = fi.meta;
+            frame.frame_id = fi.sequence_num;
+            frame.next_time_us = _source->NextPacketTime();
+
+            if(_decode_pool) {
+                // Take the encoded packet (straight from the mapping where
+                // possible) and leave decoding to the pool.
+                std::shared_ptr<void> owner = fi.Stream().mapping();
+                const char* data = fi.Compressed() ? nullptr : reinterpret_cast<const char*>(fi.ReadDirect(fi.size));
+                if(!data) {
+                    auto bytes = std::make_shared<std::vector<char>>(fi.size);
+                    fi.Read(bytes->data(), bytes->size());
+                    data = bytes->data();
+                    owner = bytes;
+                }
+                const size_t size = fi.size;
+                std::shared_ptr<unsigned char> buffer = frame.buffer;
+                frame.decoded = _decode_pool->Run([this, data, size, owner, buffer](){
+                    std::vector<ImageDecoderIntoFunc> decoders;
+                    {
+                        std::lock_guard<std::mutex> l(_decoders_mutex);
+                        if(!_free_decoders.empty()) {
+                            decoders = std::move(_free_decoders.back());
+                            _free_decoders.pop_back();
+                        }
+                    }
+                    if(decoders.empty()) {
+                        decoders = CreateDecoders();
+                    }
+
+                    std::exception_ptr error;
+                    try {
+                        memreadstreambuf sb(data, size);
+                        std::istream is(&sb);
+                        DecodeStreams(is, buffer.get(), decoders);
+                    }catch(...) {
+                        error = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> l(_decoders_mutex);
+                        _free_decoders.push_back(std::move(decoders));
+                    }
+                    if(error) std::rethrow_exception(error);
+                });
+            }else{
+                ReadPacket(fi, frame.buffer.get());
+            }
+        }
+        catch(...)
+        {
+            // End of stream (or a bad packet, which also ends synchronous playback)
+            std::lock_guard<std::mutex> l(_prefetch_mutex);
+            _prefetch_free.push_back(std::move(frame.buffer));
+            _prefetch_end = true;
+            _prefetch_cond.notify_all();
+            return;
+        }
+
+        std::lock_guard<std::mutex> l(_prefetch_mutex);
+        _prefetch_queue.push_back(std::move(frame));
+        _prefetch_cond.notify_all();
+    }
+}
+
 int PangoVideo::FindPacketStreamSource()
 {
     for(const auto& src : _reader->Sources())
@@ -196,9 +447,9 @@ void PangoVideo::SetupStreams(const PacketStreamSource& src)
             const std::string compressed_encoding = encoding;
             encoding = json_stream["decoded"].get<std::string>();
             const PixelFormat decoded_fmt = PixelFormatFromString(encoding);
-            stream_decoder.push_back(StreamEncoderFactory::I().GetDecoder(compressed_encoding, decoded_fmt));
+            stream_encoding.emplace_back(compressed_encoding, decoded_fmt);
         }else{
-            stream_decoder.push_back(nullptr);
+            stream_encoding.emplace_back();
         }
 
         PixelFormat fmt = PixelFormatFromString(encoding);
@@ -220,6 +471,21 @@ void PangoVideo::SetupStreams(const PacketStreamSource& src)
 
         _streams.push_back(si);
     }
+
+    stream_decoder = CreateDecoders();
+}
+
+std::vector<ImageDecoderIntoFunc> PangoVideo::CreateDecoders() const
+{
+    std::vector<ImageDecoderIntoFunc> decoders;
+    for(const auto& enc : stream_encoding) {
+        if(enc.first.empty()) {
+            decoders.push_back(nullptr);
+        }else{
+            decoders.push_back(StreamEncoderFactory::I().GetDecoderInto(enc.first, enc.second));
+        }
+    }
+    return decoders;
 }
 
 PANGOLIN_REGISTER_FACTORY(PangoVideo)
@@ -229,7 +495,9 @@ PANGOLIN_REGISTER_FACTORY(PangoVideo)
             const std::string path = PathExpand(uri.url);
 
             if( !uri.scheme.compare("pango") || FileType(uri.url) == ImageFileTypePango ) {
-                return std::unique_ptr<VideoInterface>(new PangoVideo(path.c_str(), PlaybackSession::ChooseFromParams(uri)));
+                const size_t decode_threads = uri.Get<size_t>("decode_threads", 1);
+                const size_t prefetch = uri.Get<size_t>("prefetch", decode_threads > 1 ? 2*decode_threads : 0);
+                return std::unique_ptr<VideoInterface>(new PangoVideo(path.c_str(), PlaybackSession::ChooseFromParams(uri), prefetch, decode_threads));
             }
             return std::unique_ptr<VideoInterface>();
         }
@@ -27,7 +27,6 @@
 
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/utils/file_utils.h>
-#include <pangolin/utils/memstreambuf.h>
 #include <pangolin/utils/picojson.h>
 #include <pangolin/utils/sigstate.h>
 #include <pangolin/utils/timer.h>
@@ -35,7 +34,6 @@
 #include <pangolin/video/iostream_operators.h>
 #include <pangolin/video/video_interface.h>
 #include <set>
-#include <future>
 
 #ifndef _WIN_
 #  include <unistd.h>
@@ -51,7 +49,9 @@ void SigPipeHandler(int sig)
     SigState::I().sig_callbacks.at(sig).value = true;
 }
 
-PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris)
+PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris,
+                                   size_t segment_size_bytes, int64_t segment_duration_us, size_t checkpoint_packets,
+                                   bool direct_io, size_t sync_bytes, size_t io_uring_depth)
     : filename(filename),
       packetstream_buffer_size_bytes(buffer_size_bytes),
       packetstreamsrcid(-1),
@@ -60,6 +60,11 @@ PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_si
       fixed_size(true),
       stream_encoder_uris(stream_encoder_uris)
 {
+    packetstream.SetSegmentLimits(segment_size_bytes, segment_duration_us);
+    packetstream.SetCheckpointInterval(checkpoint_packets);
+    packetstream.SetDirectIO(direct_io, sync_bytes);
+    packetstream.SetIoUring(io_uring_depth);
+
     if(!is_pipe)
     {
         packetstream.Open(filename, packetstream_buffer_size_bytes);
@@ -144,6 +149,20 @@ void PangoVideoOutput::SetStreams(const std::vector<StreamInfo>& st, const std::
         pss.data_definitions = "struct Frame{ uint8 stream_data[" + pangolin::Convert<std::string, size_t>::Do(total_frame_size) + "];};";
 
         packetstreamsrcid = (int)packetstream.AddSource(pss);
+
+        if(!fixed_size) {
+            // Per-stream output buffers keep their capacity from frame to frame.
+            encoded_stream_data.clear();
+            for(size_t i=0; i < streams.size(); ++i) {
+                encoded_stream_data.emplace_back(streams[i].SizeBytes());
+            }
+            encoded_chunks.resize(streams.size());
+
+            // Stream 0 is encoded on the calling thread.
+            if(streams.size() > 1) {
+                encode_pool.reset(new ThreadPool(streams.size()-1));
+            }
+        }
     } else {
         throw std::runtime_error("Unable to add new streams");
     }
@@ -202,18 +221,8 @@ int PangoVideoOutput::WriteStreams(const unsigned char* data, const picojson::va
 #endif
 
     if(!fixed_size) {
-        // TODO: Make this more efficient (without so many allocs and memcpy's)
-
-        std::vector<memstreambuf> encoded_stream_data;
-
-        // Create buffers for compressed data: the first will be reused for all the data later
-        encoded_stream_data.emplace_back(total_frame_size);
-        for(size_t i=1; i < streams.size(); ++i) {
-            encoded_stream_data.emplace_back(streams[i].SizeBytes());
-        }
-
         // lambda encodes frame data i to encoded_stream_data[i]
-        auto encode_stream = [&](int i){
+        auto encode_stream = [&](size_t i){
             encoded_stream_data[i].clear();
             std::ostream encode_stream(&encoded_stream_data[i]);
 
@@ -232,29 +241,19 @@ int PangoVideoOutput::WriteStreams(const unsigned char* data, const picojson::va
                     }
                 }
             }
-            return true;
-        };
 
-        // Compress each stream (>0 in another thread)
-        std::vector<std::future<bool>> encode_finished;
-        for(size_t i=1; i < streams.size(); ++i) {
-            encode_finished.emplace_back(std::async(std::launch::async, [&,i](){
-                return encode_stream(i);
-            }));
-        }
-        // Encode stream 0 in this thread
-        encode_stream(0);
-
-        // Reuse our first compression stream for the rest of the data too.
-        std::vector<uint8_t>& encoded = encoded_stream_data[0].buffer;
+            encoded_chunks[i] = std::make_pair(reinterpret_cast<const char*>(encoded_stream_data[i].data()), encoded_stream_data[i].size());
+        };
 
-        // Wait on all threads to finish and copy into data packet
-        for(size_t i=1; i < streams.size(); ++i) {
-            encode_finished[i-1].get();
-            encoded.insert(encoded.end(), encoded_stream_data[i].buffer.begin(), encoded_stream_data[i].buffer.end());
+        // Compress each stream on the persistent encoder threads
+        if(encode_pool) {
+            encode_pool->ParallelFor(streams.size(), encode_stream);
+        }else{
+            encode_stream(0);
         }
 
-        packetstream.WriteSourcePacket(packetstreamsrcid, reinterpret_cast<const char*>(encoded.data()), host_reception_time_us, encoded.size(), frame_properties);
+        // Write the encoded streams back to back as a single packet
+        packetstream.WriteSourcePacket(packetstreamsrcid, encoded_chunks, host_reception_time_us, frame_properties);
     }else{
         packetstream.WriteSourcePacket(packetstreamsrcid, reinterpret_cast<const char*>(data), host_reception_time_us, total_frame_size, frame_properties);
     }
@@ -268,6 +267,12 @@ PANGOLIN_REGISTER_FACTORY(PangoVideoOutput)
         std::unique_ptr<VideoOutputInterface> Open(const Uri& uri) override {
             const size_t mb = 1024*1024;
             const size_t buffer_size_bytes = uri.Get("buffer_size_mb", 100) * mb;
+            const size_t segment_size_bytes = uri.Get<size_t>("segment_mb", 0) * mb;
+            const int64_t segment_duration_us = static_cast<int64_t>(uri.Get<double>("segment_s", 0.0) * 1e6);
+            const size_t checkpoint_packets = uri.Get<size_t>("checkpoint_packets", 0);
+            const bool direct_io = uri.Get<bool>("direct_io", false);
+            const size_t sync_bytes = uri.Get<size_t>("sync_mb", 0) * mb;
+            const size_t io_uring_depth = uri.Get<size_t>("io_uring_depth", 0);
             std::string filename = uri.url;
 
             if(uri.Contains("unique_filename")) {
@@ -290,7 +295,7 @@ PANGOLIN_REGISTER_FACTORY(PangoVideoOutput)
             }
 
             return std::unique_ptr<VideoOutputInterface>(
-                new PangoVideoOutput(filename, buffer_size_bytes, stream_encoder_uris)
+                new PangoVideoOutput(filename, buffer_size_bytes, stream_encoder_uris, segment_size_bytes, segment_duration_us, checkpoint_packets, direct_io, sync_bytes, io_uring_depth)
             );
         }
     };
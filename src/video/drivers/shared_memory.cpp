@@ -42,7 +42,7 @@ const std::vector<StreamInfo>& SharedMemoryVideo::Streams() const
     return _streams;
 }
 
-bool SharedMemoryVideo::GrabNext(unsigned char* image, bool wait)
+bool SharedMemoryVideo::WaitForFrame(bool wait)
 {
     // If a condition variable exists, try waiting on it.
     if(_buffer_full) {
@@ -55,6 +55,14 @@ bool SharedMemoryVideo::GrabNext(unsigned char* image, bool wait)
             return false;
         }
     }
+    return true;
+}
+
+bool SharedMemoryVideo::GrabNext(unsigned char* image, bool wait)
+{
+    if(!WaitForFrame(wait)) {
+        return false;
+    }
 
     // Read the buffer.
     _shared_memory->lock();
@@ -69,6 +77,21 @@ bool SharedMemoryVideo::GrabNewest(unsigned char* image, bool wait)
     return GrabNext(image,wait);
 }
 
+VideoFrameLease SharedMemoryVideo::GrabNextLease(bool wait)
+{
+    if(!WaitForFrame(wait)) {
+        return VideoFrameLease();
+    }
+
+    // The writer is kept out of the buffer for as long as the lease is held.
+    std::shared_ptr<SharedMemoryBufferInterface> shmem = _shared_memory;
+    shmem->lock();
+    std::shared_ptr<void> unlock(shmem->ptr(), [shmem](void*) {
+        shmem->unlock();
+    });
+    return VideoFrameLease(shmem->ptr(), unlock);
+}
+
 PANGOLIN_REGISTER_FACTORY(SharedMemoryVideo)
 {
     struct SharedMemoryVideoFactory final : public FactoryInterface<VideoInterface> {
@@ -29,11 +29,137 @@
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define PANGO_SHIFT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define PANGO_SHIFT_NEON
+#endif
+
 namespace pangolin
 {
 
+namespace
+{
+
+// Mapping of a 16 bit pixel v to 8 bits: ((v - offset) >> shift) & mask,
+// with v < offset mapping to 0. The result is clamped to 255 if saturate,
+// and truncated to its low byte otherwise.
+struct ShiftParams
+{
+    unsigned int offset;
+    int shift;
+    unsigned int mask;
+    bool saturate;
+};
+
+inline uint8_t ShiftPixel(uint16_t v, const ShiftParams& p)
+{
+    const unsigned int x = ((v > p.offset ? v - p.offset : 0) >> p.shift) & p.mask;
+    return (uint8_t)(p.saturate ? std::min(x, 255u) : x);
+}
+
+// Vector kernels return the number of pixels written
+#if defined(PANGO_SHIFT_SSE2)
+size_t ShiftRowVec(uint8_t* out, const uint16_t* in, size_t w, const ShiftParams& p)
+{
+    const __m128i offset = _mm_set1_epi16((short)std::min(p.offset, 0xFFFFu));
+    const __m128i shift = _mm_cvtsi32_si128(p.shift);
+    const __m128i mask = _mm_set1_epi16((short)(p.mask & 0xFFFF));
+    const __m128i max8 = _mm_set1_epi16(255);
+
+    size_t x = 0;
+    for(; x + 16 <= w; x += 16) {
+        __m128i v[2] = {
+            _mm_loadu_si128((const __m128i*)(in + x)),
+            _mm_loadu_si128((const __m128i*)(in + x + 8))
+        };
+        for(int i=0; i < 2; ++i) {
+            v[i] = _mm_and_si128(_mm_srl_epi16(_mm_subs_epu16(v[i], offset), shift), mask);
+            // min(v,255) = v - max(v-255,0) without SSE4.1's unsigned min
+            v[i] = p.saturate ? _mm_sub_epi16(v[i], _mm_subs_epu16(v[i], max8)) : _mm_and_si128(v[i], max8);
+        }
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(v[0], v[1]));
+    }
+    return x;
+}
+#elif defined(PANGO_SHIFT_NEON)
+size_t ShiftRowVec(uint8_t* out, const uint16_t* in, size_t w, const ShiftParams& p)
+{
+    const uint16x8_t offset = vdupq_n_u16((uint16_t)std::min(p.offset, 0xFFFFu));
+    const int16x8_t shift = vdupq_n_s16((int16_t)-p.shift);
+    const uint16x8_t mask = vdupq_n_u16((uint16_t)(p.mask & 0xFFFF));
+    const uint16x8_t max8 = vdupq_n_u16(255);
+
+    size_t x = 0;
+    for(; x + 16 <= w; x += 16) {
+        uint16x8_t v[2] = { vld1q_u16(in + x), vld1q_u16(in + x + 8) };
+        for(int i=0; i < 2; ++i) {
+            v[i] = vandq_u16(vshlq_u16(vqsubq_u16(v[i], offset), shift), mask);
+            v[i] = p.saturate ? vminq_u16(v[i], max8) : vandq_u16(v[i], max8);
+        }
+        vst1q_u8(out + x, vcombine_u8(vmovn_u16(v[0]), vmovn_u16(v[1])));
+    }
+    return x;
+}
+#else
+size_t ShiftRowVec(uint8_t*, const uint16_t*, size_t, const ShiftParams&)
+{
+    return 0;
+}
+#endif
+
+// Lower and upper percentile of the non-zero pixels of a 16 bit image,
+// from a histogram of every 4th pixel of every 4th row. Returns false if
+// no pixels are sampled.
+bool SampleRange(const Image<unsigned char>& in, double percentile, unsigned int& low, unsigned int& high)
+{
+    const int bin_bits = 4;
+    const size_t step = 4;
+    std::vector<uint32_t> hist(0x10000 >> bin_bits, 0);
+
+    size_t n = 0;
+    for(size_t y = 0; y < in.h; y += step) {
+        const uint16_t* row = (const uint16_t*)in.RowPtr(y);
+        for(size_t x = 0; x < in.w; x += step) {
+            if(row[x]) {
+                ++hist[row[x] >> bin_bits];
+                ++n;
+            }
+        }
+    }
+    if(n == 0) {
+        return false;
+    }
+
+    const size_t tail = (size_t)(n * std::min(std::max(percentile, 0.0), 50.0) / 100.0);
+    size_t lo = 0, hi = hist.size() - 1;
+    for(size_t sum = 0; lo < hi && (sum += hist[lo]) <= tail; ++lo) {}
+    for(size_t sum = 0; hi > lo && (sum += hist[hi]) <= tail; --hi) {}
+
+    low = (unsigned int)(lo << bin_bits);
+    high = (unsigned int)(((hi + 1) << bin_bits) - 1);
+    return true;
+}
+
+}
+
 ShiftVideo::ShiftVideo(std::unique_ptr<VideoInterface> &src_, PixelFormat out_fmt, int shift_right_bits, unsigned int mask)
-    : src(std::move(src_)), size_bytes(0), buffer(0), shift_right_bits(shift_right_bits), mask(mask)
+    : src(std::move(src_)), size_bytes(0), buffer(0), shift_right_bits(shift_right_bits), mask(mask),
+      auto_range(false), percentile(0.0), smoothing(0.0)
+{
+    Init(out_fmt);
+}
+
+ShiftVideo::ShiftVideo(std::unique_ptr<VideoInterface> &src_, PixelFormat out_fmt, bool auto_range, double percentile, double smoothing)
+    : src(std::move(src_)), size_bytes(0), buffer(0), shift_right_bits(0), mask(0xFFFF),
+      auto_range(auto_range), percentile(percentile), smoothing(smoothing)
+{
+    Init(out_fmt);
+}
+
+void ShiftVideo::Init(const PixelFormat& out_fmt)
 {
     if(!src) {
         throw VideoException("ShiftVideo: VideoInterface in must not be null");
@@ -58,7 +184,10 @@ ShiftVideo::ShiftVideo(std::unique_ptr<VideoInterface> &src_, PixelFormat out_fm
         size_bytes += w*h*out_fmt.bpp / 8;
     }
 
-    buffer = new unsigned char[src->SizeBytes()];
+    stream_shift.resize(streams.size(), shift_right_bits);
+    stream_offset.resize(streams.size(), 0);
+    range_low.resize(streams.size(), -1.0);
+    range_high.resize(streams.size(), -1.0);
 }
 
 ShiftVideo::~ShiftVideo()
@@ -94,25 +223,71 @@ void DoShift16to8(
     Image<unsigned char>& out,
     const Image<unsigned char>& in,
     int shift_right_bits,
-    unsigned int mask
+    unsigned int mask,
+    unsigned int offset,
+    bool saturate
 ) {
+    const ShiftParams p = {offset, shift_right_bits, mask, saturate};
     for(size_t y=0; y<out.h; ++y) {
-        for(size_t x=0; x<out.w; ++x) {
-            const unsigned short vin = ((unsigned short*)(in.ptr + y * in.pitch))[x];
-            out.ptr[y*out.pitch+x] = (vin >> shift_right_bits) & mask;
+        uint8_t* row_out = out.RowPtr(y);
+        const uint16_t* row_in = (const uint16_t*)in.RowPtr(y);
+        for(size_t x = ShiftRowVec(row_out, row_in, out.w, p); x < out.w; ++x) {
+            row_out[x] = ShiftPixel(row_in[x], p);
+        }
+    }
+}
+
+void ShiftVideo::UpdateRange(size_t s, const Image<unsigned char>& img_in)
+{
+    unsigned int low, high;
+    if(!SampleRange(img_in, percentile, low, high)) {
+        return;
+    }
+
+    if(range_low[s] < 0.0) {
+        range_low[s] = low;
+        range_high[s] = high;
+    }else{
+        range_low[s] = smoothing * range_low[s] + (1.0 - smoothing) * low;
+        range_high[s] = smoothing * range_high[s] + (1.0 - smoothing) * high;
+    }
+
+    // Smallest shift which fits the range in 8 bits
+    const unsigned int offset = (unsigned int)(range_low[s] + 0.5);
+    const unsigned int range = (unsigned int)std::max(range_high[s] + 0.5 - offset, 0.0);
+    int shift = 0;
+    while(shift < 16 && (range >> shift) > 255) {
+        ++shift;
+    }
+    stream_offset[s] = offset;
+    stream_shift[s] = shift;
+}
+
+void ShiftVideo::Process(unsigned char* image, const unsigned char* buffer_in)
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        Image<unsigned char> img_in  = videoin[0]->Streams()[s].StreamImage(buffer_in);
+        Image<unsigned char> img_out = Streams()[s].StreamImage(image);
+        if(auto_range) {
+            UpdateRange(s, img_in);
         }
+        DoShift16to8(img_out, img_in, stream_shift[s], mask, stream_offset[s], auto_range);
+    }
+}
+
+void ShiftVideo::Allocate()
+{
+    if(!buffer) {
+        buffer = new unsigned char[src->SizeBytes()];
     }
 }
 
 //! Implement VideoInput::GrabNext()
 bool ShiftVideo::GrabNext( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin[0]->GrabNext(buffer,wait)) {
-        for(size_t s=0; s<streams.size(); ++s) {
-            Image<unsigned char> img_in  = videoin[0]->Streams()[s].StreamImage(buffer);
-            Image<unsigned char> img_out = Streams()[s].StreamImage(image);
-            DoShift16to8(img_out, img_in, shift_right_bits, mask);
-        }
+        Process(image, buffer);
         return true;
     }else{
         return false;
@@ -122,12 +297,9 @@ bool ShiftVideo::GrabNext( unsigned char* image, bool wait )
 //! Implement VideoInput::GrabNewest()
 bool ShiftVideo::GrabNewest( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin[0]->GrabNewest(buffer,wait)) {
-        for(size_t s=0; s<streams.size(); ++s) {
-            Image<unsigned char> img_in  = videoin[0]->Streams()[s].StreamImage(buffer);
-            Image<unsigned char> img_out = Streams()[s].StreamImage(image);
-            DoShift16to8(img_out, img_in, shift_right_bits, mask);
-        }
+        Process(image, buffer);
         return true;
     }else{
         return false;
@@ -139,14 +311,38 @@ std::vector<VideoInterface*>& ShiftVideo::InputStreams()
     return videoin;
 }
 
+bool ShiftVideo::RowSeparable() const
+{
+    return !auto_range;
+}
+
+void ShiftVideo::InputRows(size_t, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const
+{
+    in_y0 = y0;
+    in_y1 = y1;
+}
+
+void ShiftVideo::ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t, size_t)
+{
+    DoShift16to8(out, in, stream_shift[s], mask, stream_offset[s], false);
+}
+
 PANGOLIN_REGISTER_FACTORY(ShiftVideo)
 {
     struct ShiftVideoFactory final : public FactoryInterface<VideoInterface> {
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
+            std::unique_ptr<VideoInterface> subvid = pangolin::OpenVideo(uri.url);
+
+            if(uri.Get<std::string>("shift", "0") == "auto") {
+                const double percentile = uri.Get<double>("percentile", 1.0);
+                const double smoothing = uri.Get<double>("smooth", 0.8);
+                return std::unique_ptr<VideoInterface>(
+                    new ShiftVideo(subvid, PixelFormatFromString("GRAY8"), true, percentile, smoothing)
+                );
+            }
+
             const int shift_right = uri.Get<int>("shift", 0);
             const int mask = uri.Get<int>("mask",  0xffff);
-
-            std::unique_ptr<VideoInterface> subvid = pangolin::OpenVideo(uri.url);
             return std::unique_ptr<VideoInterface>(
                 new ShiftVideo(subvid, PixelFormatFromString("GRAY8"), shift_right, mask)
             );
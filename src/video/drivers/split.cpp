@@ -80,6 +80,12 @@ bool SplitVideo::GrabNewest( unsigned char* image, bool wait )
     return videoin[0]->GrabNewest(image, wait);
 }
 
+VideoFrameLease SplitVideo::GrabNextLease( bool wait )
+{
+    // Split streams are views into the input buffer, so the lease passes straight through.
+    return pangolin::GrabNextLease(videoin[0], wait);
+}
+
 std::vector<VideoInterface*>& SplitVideo::InputStreams()
 {
     return videoin;
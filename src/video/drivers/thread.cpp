@@ -47,7 +47,7 @@ const uint64_t grab_fail_thread_sleep_us = 1000;
 const uint64_t capture_timout_ms = 5000;
 
 ThreadVideo::ThreadVideo(std::unique_ptr<VideoInterface> &src_, size_t num_buffers)
-    : src(std::move(src_)), quit_grab_thread(true)
+    : src(std::move(src_)), quit_grab_thread(true), queue(num_buffers)
 {
     if(!src) {
         throw VideoException("ThreadVideo: VideoInterface in must not be null");
@@ -77,6 +77,7 @@ void ThreadVideo::Start()
     if(quit_grab_thread) {
         videoin[0]->Start();
         quit_grab_thread = false;
+        queue.Resume();
         grab_thread = std::thread(std::ref(*this));
     }
 }
@@ -85,6 +86,7 @@ void ThreadVideo::Start()
 void ThreadVideo::Stop()
 {
     quit_grab_thread = true;
+    queue.Interrupt();
     if(grab_thread.joinable()) {
         grab_thread.join();
     }
@@ -121,9 +123,16 @@ uint32_t ThreadVideo::AvailableFrames() const
 
 bool ThreadVideo::DropNFrames(uint32_t n)
 {
+    std::lock_guard<std::mutex> lock(return_mutex);
     return queue.DropNFrames(n);
 }
 
+void ThreadVideo::ReturnBuffer(GrabResult&& grab)
+{
+    std::lock_guard<std::mutex> lock(return_mutex);
+    queue.returnOrAddUsedBuffer(std::move(grab));
+}
+
 //! Implement VideoInput::GrabNext()
 bool ThreadVideo::GrabNext( unsigned char* image, bool wait )
 {
@@ -140,9 +149,8 @@ bool ThreadVideo::GrabNext( unsigned char* image, bool wait )
     }else{
         if(queue.AvailableFrames() == 0 && wait) {
             // Must return a frame so block on notification from grab thread.
-            std::unique_lock<std::mutex> lk(cvMtx);
             DBGPRINT("GrabNext no available frames wait for notification.");
-            if(cv.wait_for(lk, std::chrono::milliseconds(capture_timout_ms)) == std::cv_status::timeout)
+            if(!queue.waitForValidBuffer(std::chrono::milliseconds(capture_timout_ms)))
             {
                 pango_print_warn("ThreadVideo: GrabNext blocking read for frames reached timeout.");
                 return false;
@@ -158,10 +166,11 @@ bool ThreadVideo::GrabNext( unsigned char* image, bool wait )
         }else{
             DBGPRINT("GrabNext returned false")
         }
-        queue.returnOrAddUsedBuffer(std::move(grab));
+        const bool success = grab.return_status;
+        ReturnBuffer(std::move(grab));
 
         TGRABANDPRINT("GrabNext took")
-        return grab.return_status;
+        return success;
     }
 }
 
@@ -176,9 +185,8 @@ bool ThreadVideo::GrabNewest( unsigned char* image, bool wait )
     }else{
         if(queue.AvailableFrames() == 0 && wait) {
             // Must return a frame so block on notification from grab thread.
-            std::unique_lock<std::mutex> lk(cvMtx);
             DBGPRINT("GrabNewest no available frames wait for notification.");
-            if(cv.wait_for(lk, std::chrono::milliseconds(capture_timout_ms)) == std::cv_status::timeout)
+            if(!queue.waitForValidBuffer(std::chrono::milliseconds(capture_timout_ms)))
             {
                 pango_print_warn("ThreadVideo: GrabNext blocking read for frames reached timeout.");
                 return false;
@@ -187,57 +195,91 @@ bool ThreadVideo::GrabNewest( unsigned char* image, bool wait )
 
         // At least one valid frame in queue, return it.
         DBGPRINT("GrabNewest at least one frame available.");
-        GrabResult grab = queue.getNewest();
+        GrabResult grab;
+        {
+            std::lock_guard<std::mutex> lock(return_mutex);
+            grab = queue.getNewest();
+        }
         const bool success = grab.return_status;
         if(success) {
             std::memcpy(image, grab.buffer.get(), videoin[0]->SizeBytes());
             frame_properties = grab.frame_properties;
         }
-        queue.returnOrAddUsedBuffer(std::move(grab));
+        ReturnBuffer(std::move(grab));
         TGRABANDPRINT("GrabNewest memcpy of available frame took")
 
         return success;
     }
 }
 
+//! Implement BufferLeaseVideoInterface::GrabNextLease()
+VideoFrameLease ThreadVideo::GrabNextLease( bool wait )
+{
+    if(queue.AvailableFrames() == 0) {
+        if(!wait) {
+            return VideoFrameLease();
+        }
+        if(!queue.waitForValidBuffer(std::chrono::milliseconds(capture_timout_ms))) {
+            pango_print_warn("ThreadVideo: GrabNextLease blocking read for frames reached timeout.");
+            return VideoFrameLease();
+        }
+    }
+
+    GrabResult grab = queue.getNext();
+    if(!grab.return_status) {
+        ReturnBuffer(std::move(grab));
+        return VideoFrameLease();
+    }
+
+    frame_properties = grab.frame_properties;
+
+    // The queue buffer is handed back to the grab thread when the last copy of the lease goes.
+    std::shared_ptr<GrabResult> owner(
+        new GrabResult(std::move(grab)),
+        [this](GrabResult* g) {
+            ReturnBuffer(std::move(*g));
+            delete g;
+        }
+    );
+    return VideoFrameLease(owner->buffer.get(), owner);
+}
+
 void ThreadVideo::operator()()
 {
     DBGPRINT("Grab thread Started.")
     // Spinning thread attempting to read from videoin[0] as fast as possible
     // relying on the videoin[0] blocking grab.
     while(!quit_grab_thread) {
-        // Get a buffer from the queue;
-
-        if(queue.EmptyBuffers() > 0) {
-            GrabResult grab = queue.getFreeBuffer();
-
-            // Blocking grab (i.e. GrabNext with wait = true).
-            try{
-                grab.return_status = videoin[0]->GrabNext(grab.buffer.get(), true);
-            }catch(const VideoException& e) {
-                // User doesn't have the opportunity to catch exceptions here.
-                pango_print_warn("ThreadVideo caught VideoException (%s)\n",  e.what());
-                grab.return_status = false;
-            }catch(const std::exception& e){
-                // User doesn't have the opportunity to catch exceptions here.
-                pango_print_warn("ThreadVideo caught exception (%s)\n", e.what());
-                grab.return_status = false;
-            }
-
-            if(grab.return_status){
-                grab.frame_properties = GetVideoFrameProperties(videoin[0]);
-            }else{
-                std::this_thread::sleep_for(std::chrono::microseconds(grab_fail_thread_sleep_us) );
-            }
-            queue.addValidBuffer(std::move(grab));
+        // Get a buffer from the queue, sleeping only if the consumer
+        // is holding on to all of them.
+        if(!queue.waitForFreeBuffer(std::chrono::milliseconds(capture_timout_ms))) {
+            continue;
+        }
+        GrabResult grab = queue.getFreeBuffer();
+
+        // Blocking grab (i.e. GrabNext with wait = true).
+        try{
+            grab.return_status = videoin[0]->GrabNext(grab.buffer.get(), true);
+        }catch(const VideoException& e) {
+            // User doesn't have the opportunity to catch exceptions here.
+            pango_print_warn("ThreadVideo caught VideoException (%s)\n",  e.what());
+            grab.return_status = false;
+        }catch(const std::exception& e){
+            // User doesn't have the opportunity to catch exceptions here.
+            pango_print_warn("ThreadVideo caught exception (%s)\n", e.what());
+            grab.return_status = false;
+        }
 
-            DBGPRINT("Grab thread got frame. valid:%d free:%d",queue.AvailableFrames(),queue.EmptyBuffers())
-            // Let listening threads know we got a frame in case they are waiting.
-            cv.notify_all();
+        if(grab.return_status){
+            grab.frame_properties = GetVideoFrameProperties(videoin[0]);
         }else{
             std::this_thread::sleep_for(std::chrono::microseconds(grab_fail_thread_sleep_us) );
         }
-        std::this_thread::yield();
+
+        // Publishing wakes the consumer if it is waiting on an empty queue.
+        queue.addValidBuffer(std::move(grab));
+
+        DBGPRINT("Grab thread got frame. valid:%d free:%d",queue.AvailableFrames(),queue.EmptyBuffers())
     }
     DBGPRINT("Grab thread Stopped.")
 
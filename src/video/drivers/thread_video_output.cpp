@@ -0,0 +1,185 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Copyright (c) 2014 Steven Lovegrove
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/factory/factory_registry.h>
+#include <pangolin/video/drivers/thread_video_output.h>
+#include <pangolin/video/iostream_operators.h>
+#include <pangolin/video/video.h>
+
+#include <cstring>
+
+namespace pangolin
+{
+
+const uint64_t write_poll_timeout_ms = 100;
+
+ThreadVideoOutput::ThreadVideoOutput(std::unique_ptr<VideoOutputInterface>& out_, size_t num_buffers, FullQueuePolicy policy)
+    : out(std::move(out_)), num_buffers(num_buffers), policy(policy), frame_size_bytes(0),
+      queue(num_buffers), dropped_frames(0), quit_write_thread(false)
+{
+    if(!out) {
+        throw VideoException("ThreadVideoOutput: VideoOutputInterface must not be null");
+    }
+    if(num_buffers == 0) {
+        throw VideoException("ThreadVideoOutput: num_buffers must be at least 1");
+    }
+    write_thread = std::thread(std::ref(*this));
+}
+
+ThreadVideoOutput::~ThreadVideoOutput()
+{
+    // Make sure everything already accepted reaches the child output.
+    Flush();
+    quit_write_thread = true;
+    queue.Interrupt();
+    if(write_thread.joinable()) {
+        write_thread.join();
+    }
+}
+
+const std::vector<StreamInfo>& ThreadVideoOutput::Streams() const
+{
+    return out->Streams();
+}
+
+void ThreadVideoOutput::SetStreams(const std::vector<StreamInfo>& streams, const std::string& uri, const picojson::value& device_properties)
+{
+    // The writer thread may still be using the child with the old layout.
+    Flush();
+    out->SetStreams(streams, uri, device_properties);
+
+    size_t size_bytes = 0;
+    for(const StreamInfo& si : streams) {
+        size_bytes = std::max(size_bytes, (size_t)si.Offset() + si.SizeBytes());
+    }
+
+    if(size_bytes != frame_size_bytes) {
+        // All buffers are free after Flush() and the writer thread is idle,
+        // so they can be reallocated from here.
+        while(queue.EmptyBuffers() > 0) {
+            queue.getFreeBuffer();
+        }
+        frame_size_bytes = size_bytes;
+        for(size_t i=0; i < num_buffers; ++i) {
+            queue.returnOrAddUsedBuffer(WriteJob(frame_size_bytes));
+        }
+    }
+}
+
+int ThreadVideoOutput::WriteStreams(const unsigned char* data, const picojson::value& frame_properties)
+{
+    if(frame_size_bytes == 0) {
+        throw VideoException("ThreadVideoOutput: SetStreams must be called before WriteStreams");
+    }
+
+    if(queue.EmptyBuffers() == 0) {
+        if(policy == FullQueueDrop) {
+            ++dropped_frames;
+            return -1;
+        }
+        while(!queue.waitForFreeBuffer(std::chrono::milliseconds(write_poll_timeout_ms))) {
+            if(quit_write_thread) return -1;
+        }
+    }
+
+    WriteJob job = queue.getFreeBuffer();
+    std::memcpy(job.buffer.get(), data, frame_size_bytes);
+    job.frame_properties = frame_properties;
+    queue.addValidBuffer(std::move(job));
+    return 0;
+}
+
+bool ThreadVideoOutput::IsPipe() const
+{
+    return out->IsPipe();
+}
+
+size_t ThreadVideoOutput::QueuedFrames() const
+{
+    return queue.AvailableFrames();
+}
+
+size_t ThreadVideoOutput::DroppedFrames() const
+{
+    return dropped_frames;
+}
+
+void ThreadVideoOutput::Flush()
+{
+    if(frame_size_bytes == 0) return;
+    while(!queue.waitForFreeBuffers(num_buffers, std::chrono::milliseconds(write_poll_timeout_ms))) {
+        if(!write_thread.joinable()) return;
+    }
+}
+
+void ThreadVideoOutput::operator()()
+{
+    // Drain the queue as fast as the child output allows.
+    while(!quit_write_thread) {
+        if(!queue.waitForValidBuffer(std::chrono::milliseconds(write_poll_timeout_ms))) {
+            continue;
+        }
+
+        WriteJob job = queue.getNext();
+        try{
+            out->WriteStreams(job.buffer.get(), job.frame_properties);
+        }catch(const std::exception& e){
+            // User doesn't have the opportunity to catch exceptions here.
+            pango_print_warn("ThreadVideoOutput caught exception (%s)\n", e.what());
+            ++dropped_frames;
+        }
+        queue.returnOrAddUsedBuffer(std::move(job));
+    }
+}
+
+PANGOLIN_REGISTER_FACTORY(ThreadVideoOutput)
+{
+    struct ThreadVideoOutputFactory final : public FactoryInterface<VideoOutputInterface> {
+        std::unique_ptr<VideoOutputInterface> Open(const Uri& uri) override {
+            std::unique_ptr<VideoOutputInterface> subout = pangolin::OpenVideoOutput(uri.url);
+            const size_t num_buffers = uri.Get<size_t>("num_buffers", 30);
+            const std::string policy = uri.Get<std::string>("policy", "block");
+
+            ThreadVideoOutput::FullQueuePolicy full_policy;
+            if(policy == "block") {
+                full_policy = ThreadVideoOutput::FullQueueBlock;
+            }else if(policy == "drop") {
+                full_policy = ThreadVideoOutput::FullQueueDrop;
+            }else{
+                throw VideoException("ThreadVideoOutput: unknown policy '" + policy + "', expected block or drop");
+            }
+
+            return std::unique_ptr<VideoOutputInterface>(
+                new ThreadVideoOutput(subout, num_buffers, full_policy)
+            );
+        }
+    };
+
+    FactoryRegistry<VideoOutputInterface>::I().RegisterFactory(std::make_shared<ThreadVideoOutputFactory>(), 10, "thread");
+}
+
+}
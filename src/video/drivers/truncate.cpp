@@ -83,6 +83,17 @@ bool TruncateVideo::GrabNewest( unsigned char* image, bool wait )
     return videoin[0]->GrabNewest(image, wait);
 }
 
+VideoFrameLease TruncateVideo::GrabNextLease( bool wait )
+{
+    if(next_frame_to_grab < end) {
+        VideoFrameLease lease = pangolin::GrabNextLease(videoin[0], wait);
+        if(lease && (next_frame_to_grab++) >= begin) {
+            return lease;
+        }
+    }
+    return VideoFrameLease();
+}
+
 std::vector<VideoInterface*>& TruncateVideo::InputStreams()
 {
     return videoin;
@@ -28,6 +28,7 @@
 #include <pangolin/video/drivers/unpack.h>
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
+#include <pangolin/image/pixel_packing.h>
 
 #ifdef DEBUGUNPACK
   #include <pangolin/utils/timer.h>
@@ -66,8 +67,6 @@ UnpackVideo::UnpackVideo(std::unique_ptr<VideoInterface> &src_, PixelFormat out_
         streams.push_back(pangolin::StreamInfo( out_fmt, w, h, pitch, (unsigned char*)0 + size_bytes ));
         size_bytes += h*pitch;
     }
-
-    buffer = new unsigned char[src->SizeBytes()];
 }
 
 UnpackVideo::~UnpackVideo()
@@ -114,45 +113,53 @@ void ConvertFrom8bit(
     }
 }
 
+// Unpack each row straight into out, or through a row of 16-bit samples
+// for other output types.
 template<typename T>
-void ConvertFrom10bit(
+void ConvertFromPacked(
     Image<unsigned char>& out,
-    const Image<unsigned char>& in
+    const Image<unsigned char>& in,
+    void (*unpack)(uint16_t*, const uint8_t*, size_t)
 ) {
+    const bool direct = std::is_same<T, uint16_t>::value;
+    std::vector<uint16_t> row(direct ? 0 : out.w);
     for(size_t r=0; r<out.h; ++r) {
         T* pout = (T*)(out.ptr + r*out.pitch);
-        uint8_t* pin = in.ptr + r*in.pitch;
-        const uint8_t* pin_end = in.ptr + (r+1)*in.pitch;
-        while(pin != pin_end) {
-            uint64_t val = *(pin++);
-            val |= uint64_t(*(pin++)) << 8;
-            val |= uint64_t(*(pin++)) << 16;
-            val |= uint64_t(*(pin++)) << 24;
-            val |= uint64_t(*(pin++)) << 32;
-            *(pout++) = T( val & 0x00000003FF);
-            *(pout++) = T((val & 0x00000FFC00) >> 10);
-            *(pout++) = T((val & 0x003FF00000) >> 20);
-            *(pout++) = T((val & 0xFFC0000000) >> 30);
+        const uint8_t* pin = in.ptr + r*in.pitch;
+        if(direct) {
+            unpack((uint16_t*)pout, pin, out.w);
+        }else{
+            unpack(row.data(), pin, out.w);
+            std::copy(row.begin(), row.end(), pout);
         }
     }
 }
 
-template<typename T>
-void ConvertFrom12bit(
-    Image<unsigned char>& out,
-    const Image<unsigned char>& in
-) {
-    for(size_t r=0; r<out.h; ++r) {
-        T* pout = (T*)(out.ptr + r*out.pitch);
-        uint8_t* pin = in.ptr + r*in.pitch;
-        const uint8_t* pin_end = in.ptr + (r+1)*in.pitch;
-        while(pin != pin_end) {
-            uint32_t val = *(pin++);
-            val |= uint32_t(*(pin++)) << 8;
-            val |= uint32_t(*(pin++)) << 16;
-            *(pout++) = T( val & 0x000FFF);
-            *(pout++) = T((val & 0xFFF000) >> 12);
+void UnpackVideo::ProcessStream(size_t s, Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+{
+    const int bits_in  = videoin[0]->Streams()[s].PixFormat().bpp;
+
+    if(Streams()[s].PixFormat().format == "GRAY32F") {
+        if( bits_in == 8) {
+            ConvertFrom8bit<float>(img_out, img_in);
+        }else if( bits_in == 10) {
+            ConvertFromPacked<float>(img_out, img_in, Unpack10bit);
+        }else if( bits_in == 12){
+            ConvertFromPacked<float>(img_out, img_in, Unpack12bit);
+        }else{
+            throw pangolin::VideoException("Unsupported bitdepths.");
         }
+    }else if(Streams()[s].PixFormat().format == "GRAY16LE") {
+        if( bits_in == 8) {
+            ConvertFrom8bit<uint16_t>(img_out, img_in);
+        }else if( bits_in == 10) {
+            ConvertFromPacked<uint16_t>(img_out, img_in, Unpack10bit);
+        }else if( bits_in == 12){
+            ConvertFromPacked<uint16_t>(img_out, img_in, Unpack12bit);
+        }else{
+            throw pangolin::VideoException("Unsupported bitdepths.");
+        }
+    }else{
     }
 }
 
@@ -162,38 +169,38 @@ void UnpackVideo::Process(unsigned char* image, const unsigned char* buffer)
     for(size_t s=0; s<streams.size(); ++s) {
         const Image<unsigned char> img_in  = videoin[0]->Streams()[s].StreamImage(buffer);
         Image<unsigned char> img_out = Streams()[s].StreamImage(image);
+        ProcessStream(s, img_out, img_in);
+    }
+    TGRABANDPRINT("Unpacking took ")
+}
 
-        const int bits_in  = videoin[0]->Streams()[s].PixFormat().bpp;
+bool UnpackVideo::RowSeparable() const
+{
+    return true;
+}
 
-        if(Streams()[s].PixFormat().format == "GRAY32F") {
-            if( bits_in == 8) {
-                ConvertFrom8bit<float>(img_out, img_in);
-            }else if( bits_in == 10) {
-                ConvertFrom10bit<float>(img_out, img_in);
-            }else if( bits_in == 12){
-                ConvertFrom12bit<float>(img_out, img_in);
-            }else{
-                throw pangolin::VideoException("Unsupported bitdepths.");
-            }
-        }else if(Streams()[s].PixFormat().format == "GRAY16LE") {
-            if( bits_in == 8) {
-                ConvertFrom8bit<uint16_t>(img_out, img_in);
-            }else if( bits_in == 10) {
-                ConvertFrom10bit<uint16_t>(img_out, img_in);
-            }else if( bits_in == 12){
-                ConvertFrom12bit<uint16_t>(img_out, img_in);
-            }else{
-                throw pangolin::VideoException("Unsupported bitdepths.");
-            }
-        }else{
-        }
+void UnpackVideo::InputRows(size_t, size_t y0, size_t y1, size_t& in_y0, size_t& in_y1) const
+{
+    in_y0 = y0;
+    in_y1 = y1;
+}
+
+void UnpackVideo::ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in, size_t, size_t)
+{
+    ProcessStream(s, out, in);
+}
+
+void UnpackVideo::Allocate()
+{
+    if(!buffer) {
+        buffer = new unsigned char[src->SizeBytes()];
     }
-    TGRABANDPRINT("Unpacking took ")
 }
 
 //! Implement VideoInput::GrabNext()
 bool UnpackVideo::GrabNext( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin[0]->GrabNext(buffer,wait)) {
         Process(image,buffer);
         return true;
@@ -205,6 +212,7 @@ bool UnpackVideo::GrabNext( unsigned char* image, bool wait )
 //! Implement VideoInput::GrabNewest()
 bool UnpackVideo::GrabNewest( unsigned char* image, bool wait )
 {
+    Allocate();
     if(videoin[0]->GrabNewest(buffer,wait)) {
         Process(image,buffer);
         return true;
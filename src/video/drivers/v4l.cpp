@@ -65,6 +65,18 @@ static int xioctl(int fd, int request, void* arg)
     return r;
 }
 
+// Hand out a dequeued driver buffer, requeueing it when the lease is released.
+static VideoFrameLease LeaseDriverBuffer(int fd, const v4l2_buffer& buf, unsigned char* ptr)
+{
+    std::shared_ptr<void> requeue(ptr, [fd, buf](void*) {
+        v4l2_buffer qbuf = buf;
+        if (-1 == xioctl (fd, VIDIOC_QBUF, &qbuf)) {
+            pango_print_warn("V4lVideo: unable to requeue leased buffer (%s)\n", strerror(errno));
+        }
+    });
+    return VideoFrameLease(ptr, requeue);
+}
+
 inline std::string V4lToString(int32_t v)
 {
     //	v = ((__u32)(a) | ((__u32)(b) << 8) | ((__u32)(c) << 16) | ((__u32)(d) << 24))
@@ -115,6 +127,18 @@ size_t V4lVideo::SizeBytes() const
 }
 
 bool V4lVideo::GrabNext( unsigned char* image, bool /*wait*/ )
+{
+    return GrabFrame(image, nullptr);
+}
+
+VideoFrameLease V4lVideo::GrabNextLease( bool /*wait*/ )
+{
+    VideoFrameLease lease;
+    GrabFrame(nullptr, &lease);
+    return lease;
+}
+
+bool V4lVideo::GrabFrame(unsigned char* image, VideoFrameLease* lease)
 {
     for (;;) {
         fd_set fds;
@@ -144,7 +168,7 @@ bool V4lVideo::GrabNext( unsigned char* image, bool /*wait*/ )
             return false;
         }
 
-        if (ReadFrame(image))
+        if (ReadFrame(image, lease))
             break;
 
         /* EAGAIN - continue select loop. */
@@ -159,7 +183,7 @@ bool V4lVideo::GrabNewest( unsigned char* image, bool wait )
     return GrabNext(image,wait);
 }
 
-int V4lVideo::ReadFrame(unsigned char* image)
+int V4lVideo::ReadFrame(unsigned char* image, VideoFrameLease* lease)
 {
     struct v4l2_buffer buf;
     unsigned int i;
@@ -184,7 +208,14 @@ int V4lVideo::ReadFrame(unsigned char* image)
         frame_properties[PANGO_HOST_RECEPTION_TIME_US] = picojson::value(pangolin::Time_us(pangolin::TimeNow()));
 
         //            process_image(buffers[0].start);
-        memcpy(image,buffers[0].start,buffers[0].length);
+        if(lease) {
+            // buffers[0] is reused by the next read, so the lease needs its own copy.
+            std::shared_ptr<unsigned char> copy(new unsigned char[buffers[0].length], std::default_delete<unsigned char[]>());
+            memcpy(copy.get(),buffers[0].start,buffers[0].length);
+            *lease = VideoFrameLease(copy.get(), copy);
+        }else{
+            memcpy(image,buffers[0].start,buffers[0].length);
+        }
 
         break;
 
@@ -214,6 +245,10 @@ int V4lVideo::ReadFrame(unsigned char* image)
         assert (buf.index < n_buffers);
 
         //            process_image (buffers[buf.index].start);
+        if(lease) {
+            *lease = LeaseDriverBuffer(fd, buf, (unsigned char*)buffers[buf.index].start);
+            break;
+        }
         memcpy(image,buffers[buf.index].start,buffers[buf.index].length);
 
 
@@ -253,6 +288,10 @@ int V4lVideo::ReadFrame(unsigned char* image)
         assert (i < n_buffers);
 
         //            process_image ((void *) buf.m.userptr);
+        if(lease) {
+            *lease = LeaseDriverBuffer(fd, buf, (unsigned char*)buf.m.userptr);
+            break;
+        }
         memcpy(image,(void *)buf.m.userptr,buf.length);
 
 
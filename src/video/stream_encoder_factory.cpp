@@ -59,4 +59,14 @@ ImageDecoderFunc StreamEncoderFactory::GetDecoder(const std::string& encoder_spe
     };
 }
 
+ImageDecoderIntoFunc StreamEncoderFactory::GetDecoderInto(const std::string& encoder_spec, const PixelFormat& fmt)
+{
+    const EncoderDetails encdet = EncoderDetailsFromString(encoder_spec);
+    PANGO_ENSURE(encdet.file_type != ImageFileTypeUnknown);
+
+    return [fmt,encdet](std::istream& is, Image<unsigned char> dst){
+        LoadImage(is,encdet.file_type,dst,fmt);
+    };
+}
+
 }
@@ -27,6 +27,7 @@
 
 #include <pangolin/video/video_input.h>
 #include <pangolin/video/video_output.h>
+#include <pangolin/video/drivers/thread_video_output.h>
 
 namespace pangolin
 {
@@ -216,5 +217,17 @@ bool VideoInput::IsRecording() const
     return video_recorder != 0;
 }
 
+size_t VideoInput::RecordQueuedFrames() const
+{
+    ThreadVideoOutput* async = dynamic_cast<ThreadVideoOutput*>(video_recorder.get());
+    return async ? async->QueuedFrames() : 0;
+}
+
+size_t VideoInput::RecordDroppedFrames() const
+{
+    ThreadVideoOutput* async = dynamic_cast<ThreadVideoOutput*>(video_recorder.get());
+    return async ? async->DroppedFrames() : 0;
+}
+
 }
 
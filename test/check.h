@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Assertion shared by the tests. It throws, so that the test exits with the
+// failed condition and its line, and is checked in release builds too.
+#define CHECK(cond) do { \
+    if(!(cond)) throw std::runtime_error(std::string("Check failed: ") + #cond + " (line " + std::to_string(__LINE__) + ")"); \
+} while(0)
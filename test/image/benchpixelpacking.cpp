@@ -0,0 +1,77 @@
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pangolin/image/pixel_packing.h>
+#include <pangolin/utils/cpu_features.h>
+#include <pangolin/utils/timer.h>
+
+using namespace std;
+using namespace pangolin;
+
+// Throughput of the 10 and 12-bit pack and unpack kernels, in GB/s of 16-bit
+// samples, for a row which stays in cache and for a whole 4K frame. Compare
+// kernels by running with PANGOLIN_CPU_FEATURES set to "avx2,ssse3", "ssse3"
+// or "" (portable code).
+
+struct Buffers
+{
+    Buffers(size_t n)
+        : n(n), samples(n), packed(PackedBytes(12, n))
+    {
+        for(size_t i = 0; i < n; ++i) samples[i] = uint16_t(i * 2654435761u >> 20);
+        for(size_t i = 0; i < packed.size(); ++i) packed[i] = uint8_t(i * 2654435761u >> 13);
+    }
+
+    size_t n;
+    vector<uint16_t> samples;
+    vector<uint8_t> packed;
+};
+
+double Measure(const std::function<void()>& op, size_t sample_bytes, double min_seconds)
+{
+    // Warm up, then repeat for at least min_seconds.
+    op();
+    size_t iterations = 0;
+    const basetime start = TimeNow();
+    double elapsed = 0.0;
+    do {
+        op();
+        ++iterations;
+        elapsed = TimeDiff_us(start, TimeNow()) / 1e6;
+    } while(elapsed < min_seconds);
+    return double(sample_bytes) * iterations / elapsed / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    const double min_seconds = argc > 1 ? std::stod(argv[1]) : 0.5;
+
+    cout << "ssse3: " << CpuHasSsse3() << ", avx2: " << CpuHasAvx2() << endl;
+    cout << setw(12) << left << "GB/s" << right << setw(10) << "row" << setw(10) << "frame" << endl;
+
+    // A 30 KB row, and a 3840x2160 frame.
+    Buffers row(15360);
+    Buffers frame(3840 * 2160);
+
+    const struct {
+        const char* name;
+        std::function<void(Buffers&)> op;
+    } ops[] = {
+        {"unpack10", [](Buffers& b){ Unpack10bit(b.samples.data(), b.packed.data(), b.n); }},
+        {"unpack12", [](Buffers& b){ Unpack12bit(b.samples.data(), b.packed.data(), b.n); }},
+        {"pack10",   [](Buffers& b){ Pack10bit(b.packed.data(), b.samples.data(), b.n); }},
+        {"pack12",   [](Buffers& b){ Pack12bit(b.packed.data(), b.samples.data(), b.n); }},
+    };
+
+    for(const auto& op : ops) {
+        cout << setw(12) << left << op.name << right << fixed << setprecision(1);
+        for(Buffers* b : {&row, &frame}) {
+            cout << setw(10) << Measure([&](){ op.op(*b); }, b->n * sizeof(uint16_t), min_seconds);
+        }
+        cout << endl;
+    }
+    return 0;
+}
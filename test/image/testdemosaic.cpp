@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include <pangolin/image/demosaic.h>
+#include <pangolin/image/managed_image.h>
+#include <pangolin/utils/thread_pool.h>
+
+#include "../check.h"
+
+using namespace std;
+using namespace pangolin;
+
+const BayerTile tiles[] = {BayerTile::RGGB, BayerTile::GBRG, BayerTile::GRBG, BayerTile::BGGR};
+const char* tile_names[] = {"RGGB", "GBRG", "GRBG", "BGGR"};
+
+// Odd, tiny and SIMD-width straddling sizes.
+const size_t sizes[][2] = {
+    {1,1}, {2,2}, {1,7}, {7,1}, {3,5}, {5,3}, {16,4}, {37,9}, {70,11}, {129,6}
+};
+
+// Reflect about the first / last sample without repeating it, as used for
+// the two-pixel border.
+int Reflect(int i, int n)
+{
+    if(i < 0) i = -i;
+    if(i >= n) i = 2*(n-1) - i;
+    return std::max(0, std::min(i, n-1));
+}
+
+// Straightforward per-pixel demosaic, written from the Malvar, He and Cutler
+// 5x5 filters (scaled by 16) and the bilinear averages.
+template<typename T>
+class Reference
+{
+public:
+    Reference(const Image<T>& in, size_t tile, bool hq, int maxval)
+        : in(in), tile(tile_names[tile]), hq(hq), maxval(maxval)
+    {
+    }
+
+    // Colour ('R','G','B') of the sample at (x,y)
+    char At(size_t x, size_t y) const
+    {
+        return tile[2*(y&1) + (x&1)];
+    }
+
+    int S(int x, int y, int dx, int dy) const
+    {
+        return in(Reflect(x+dx, (int)in.w), Reflect(y+dy, (int)in.h));
+    }
+
+    int Value(size_t x, size_t y, char c) const
+    {
+        const int X = (int)x, Y = (int)y;
+        const char own = At(x, y);
+        if(own == c) return S(X,Y,0,0);
+
+        enum { Cross, Horiz, Vert, Diag } kind;
+        if(own != 'G') {
+            kind = (c == 'G') ? Cross : Diag;
+        }else{
+            // Colour of the horizontal neighbours
+            kind = (At(x+1, y) == c) ? Horiz : Vert;
+        }
+
+        const int c0 = S(X,Y,0,0);
+        const int n4 = S(X,Y,-1,0) + S(X,Y,1,0) + S(X,Y,0,-1) + S(X,Y,0,1);
+        const int h2 = S(X,Y,-1,0) + S(X,Y,1,0);
+        const int v2 = S(X,Y,0,-1) + S(X,Y,0,1);
+        const int d4 = S(X,Y,-1,-1) + S(X,Y,1,-1) + S(X,Y,-1,1) + S(X,Y,1,1);
+        const int hf = S(X,Y,-2,0) + S(X,Y,2,0);
+        const int vf = S(X,Y,0,-2) + S(X,Y,0,2);
+
+        double v;
+        if(hq) {
+            int sum = 0;
+            switch(kind) {
+            case Cross: sum = 8*c0 + 4*n4 - 2*(hf+vf); break;
+            case Horiz: sum = 10*c0 + 8*h2 - 2*(hf+d4) + vf; break;
+            case Vert:  sum = 10*c0 + 8*v2 - 2*(vf+d4) + hf; break;
+            case Diag:  sum = 12*c0 + 4*d4 - 3*(hf+vf); break;
+            }
+            v = std::floor(sum / 16.0 + 0.5);
+        }else{
+            switch(kind) {
+            case Cross: v = n4 / 4.0; break;
+            case Horiz: v = h2 / 2.0; break;
+            case Vert:  v = v2 / 2.0; break;
+            case Diag:  v = d4 / 4.0; break;
+            default: v = 0;
+            }
+            v = std::floor(v + 0.5);
+        }
+        return (int)std::max(0.0, std::min(v, (double)maxval));
+    }
+
+private:
+    const Image<T>& in;
+    const char* tile;
+    bool hq;
+    int maxval;
+};
+
+template<typename T>
+void Fill(Image<T>& img, unsigned bits, unsigned seed)
+{
+    uint32_t s = seed * 2654435761u + 1;
+    for(size_t y = 0; y < img.h; ++y) {
+        for(size_t x = 0; x < img.w; ++x) {
+            s = s * 1664525u + 1013904223u;
+            // Mostly extremes, to exercise clamping of the HQ correction
+            const uint32_t r = s >> 8;
+            const uint32_t max = (1u << bits) - 1;
+            img(x,y) = T( (r & 3) == 0 ? 0 : (r & 3) == 1 ? max : (r >> 2) & max );
+        }
+    }
+}
+
+template<typename T>
+void Run(Image<T>& out, const Image<T>& in, BayerTile tile, DemosaicMethod method, unsigned bits, ThreadPool* pool);
+
+template<>
+void Run(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, unsigned, ThreadPool* pool)
+{
+    Demosaic(out, in, tile, method, pool);
+}
+
+template<>
+void Run(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned bits, ThreadPool* pool)
+{
+    Demosaic(out, in, tile, method, bits, pool);
+}
+
+template<typename T>
+void Rows(Image<T>& out, const Image<T>& in, BayerTile tile, DemosaicMethod method, unsigned bits, size_t h, size_t y0, size_t in_y0);
+
+template<>
+void Rows(Image<uint8_t>& out, const Image<uint8_t>& in, BayerTile tile, DemosaicMethod method, unsigned, size_t h, size_t y0, size_t in_y0)
+{
+    DemosaicRows(out, in, tile, method, h, y0, in_y0);
+}
+
+template<>
+void Rows(Image<uint16_t>& out, const Image<uint16_t>& in, BayerTile tile, DemosaicMethod method, unsigned bits, size_t h, size_t y0, size_t in_y0)
+{
+    DemosaicRows(out, in, tile, method, bits, h, y0, in_y0);
+}
+
+template<typename T>
+void CheckAgainstReference(const Image<T>& out, const Image<T>& in, size_t t, bool hq, unsigned bits, const string& what)
+{
+    const int maxval = (bits < 16) ? (1 << bits) - 1 : 0xFFFF;
+    Reference<T> ref(in, t, hq, maxval);
+    for(size_t y = 0; y < in.h; ++y) {
+        const T* row = out.RowPtr(y);
+        for(size_t x = 0; x < in.w; ++x) {
+            for(int c = 0; c < 3; ++c) {
+                const int expected = ref.Value(x, y, "RGB"[c]);
+                if(row[3*x+c] != expected) {
+                    throw runtime_error(what + ": " + tile_names[t] + (hq ? " hq" : " bilinear") +
+                        " " + to_string(in.w) + "x" + to_string(in.h) + " at (" + to_string(x) + "," + to_string(y) +
+                        ") channel " + to_string(c) + ": " + to_string(row[3*x+c]) + " != " + to_string(expected));
+                }
+            }
+        }
+    }
+}
+
+// Every tile, method and size against the reference, both with tight and
+// padded pitches, single threaded, with a pool and in row bands.
+template<typename T>
+void test_demosaic(unsigned bits, ThreadPool& pool)
+{
+    for(const auto& sz : sizes) {
+        const size_t w = sz[0], h = sz[1];
+        for(size_t pad = 0; pad <= 2; pad += 2) {
+            ManagedImage<T> in(w, h, (w + pad) * sizeof(T));
+            ManagedImage<T> out(w, h, (3*w + pad) * sizeof(T));
+            Fill<T>(in, bits, unsigned(w * 131 + h * 7 + pad));
+
+            for(size_t t = 0; t < 4; ++t) {
+                for(int m = 0; m < 2; ++m) {
+                    const DemosaicMethod method = m ? DemosaicMethod::HQLinear : DemosaicMethod::Bilinear;
+
+                    out.Fill(T(0x5a));
+                    Run<T>(out, in, tiles[t], method, bits, nullptr);
+                    CheckAgainstReference<T>(out, in, t, m, bits, "serial");
+
+                    out.Fill(T(0x5a));
+                    Run<T>(out, in, tiles[t], method, bits, &pool);
+                    CheckAgainstReference<T>(out, in, t, m, bits, "pool");
+
+                    // Uneven bands, each given a copy of just the input rows
+                    // it reads
+                    out.Fill(T(0x5a));
+                    for(size_t y0 = 0; y0 < h; y0 += 3) {
+                        const size_t y1 = std::min(h, y0 + 3);
+                        const size_t in_y0 = y0 > 2 ? y0 - 2 : 0;
+                        const size_t in_y1 = std::min(h, y1 + 2);
+                        ManagedImage<T> band(w, in_y1 - in_y0);
+                        for(size_t y = in_y0; y < in_y1; ++y) {
+                            std::copy(in.RowPtr(y), in.RowPtr(y) + w, band.RowPtr(y - in_y0));
+                        }
+                        Image<T> out_rows = out.SubImage(0, y0, w, y1 - y0);
+                        Rows<T>(out_rows, band, tiles[t], method, bits, h, y0, in_y0);
+                    }
+                    CheckAgainstReference<T>(out, in, t, m, bits, "rows");
+                }
+            }
+        }
+    }
+}
+
+void test_bad_sizes()
+{
+    ManagedImage<uint8_t> in(8, 8);
+    ManagedImage<uint8_t> small(8, 8, 8 * 3 - 1);
+    ManagedImage<uint8_t> other(8, 7, 8 * 3);
+    for(Image<uint8_t>* out : {(Image<uint8_t>*)&small, (Image<uint8_t>*)&other}) {
+        bool threw = false;
+        try {
+            Demosaic(*out, in, BayerTile::RGGB, DemosaicMethod::Bilinear);
+        }catch(const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    // A band of in missing rows read for the rows of out
+    ManagedImage<uint8_t> out(8, 4, 8 * 3);
+    for(size_t in_y0 : {size_t(0), size_t(1)}) {
+        Image<uint8_t> band = in.SubImage(0, in_y0, 8, 5);
+        bool threw = false;
+        try {
+            DemosaicRows(out, band, BayerTile::RGGB, DemosaicMethod::Bilinear, 8, 2, in_y0);
+        }catch(const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+int main(int, char**)
+{
+    ThreadPool pool(3);
+    test_demosaic<uint8_t>(8, pool);
+    test_demosaic<uint16_t>(12, pool);
+    test_demosaic<uint16_t>(16, pool);
+    test_bad_sizes();
+    cout << "All demosaic tests passed." << endl;
+    return 0;
+}
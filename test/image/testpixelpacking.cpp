@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pangolin/image/pixel_packing.h>
+#include <pangolin/utils/cpu_features.h>
+
+#include "../check.h"
+
+using namespace std;
+using namespace pangolin;
+
+// Compares whichever kernels the CPU (and PANGOLIN_CPU_FEATURES) selects
+// against a bit at a time reference, for every length up to a few vectors and
+// at every alignment. ctest also runs this with the SIMD kernels disabled.
+
+const size_t max_samples = 300;
+const size_t guard = 64;
+const uint8_t guard_byte = 0xa5;
+
+// Sample i occupies bits [bits*i, bits*(i+1)) of the packed row.
+void ReferencePack(vector<uint8_t>& out, const uint16_t* in, size_t n, size_t bits)
+{
+    out.assign(PackedBytes(bits, n), 0);
+    for(size_t i = 0; i < n; ++i) {
+        for(size_t b = 0; b < bits; ++b) {
+            const size_t bit = bits*i + b;
+            if(in[i] & (1u << b)) out[bit / 8] |= uint8_t(1u << (bit % 8));
+        }
+    }
+}
+
+void ReferenceUnpack(vector<uint16_t>& out, const uint8_t* in, size_t n, size_t bits)
+{
+    out.assign(n, 0);
+    for(size_t i = 0; i < n; ++i) {
+        for(size_t b = 0; b < bits; ++b) {
+            const size_t bit = bits*i + b;
+            if(in[bit / 8] & (1u << (bit % 8))) out[i] |= uint16_t(1u << b);
+        }
+    }
+}
+
+uint32_t Random(uint32_t& s)
+{
+    s = s * 1664525u + 1013904223u;
+    return s >> 8;
+}
+
+void test_pack(size_t bits)
+{
+    uint32_t seed = uint32_t(bits);
+    vector<uint16_t> in(max_samples + 8);
+    vector<uint8_t> out(PackedBytes(bits, max_samples) + guard + 8);
+    vector<uint8_t> expected;
+
+    for(size_t n = 0; n <= max_samples; ++n) {
+        for(size_t offset = 0; offset < 4; ++offset) {
+            // Unused high bits set in some samples, which must be ignored.
+            for(auto& v : in) v = uint16_t(Random(seed));
+            uint16_t* src = in.data() + offset;
+            uint8_t* dst = out.data() + offset;
+            std::fill(out.begin(), out.end(), guard_byte);
+
+            if(bits == 10) Pack10bit(dst, src, n);
+            else           Pack12bit(dst, src, n);
+
+            ReferencePack(expected, src, n, bits);
+            for(size_t i = 0; i < expected.size(); ++i) {
+                if(dst[i] != expected[i]) {
+                    throw runtime_error("Pack" + to_string(bits) + "bit n=" + to_string(n) + " offset=" + to_string(offset) +
+                                        ": byte " + to_string(i) + " is " + to_string(dst[i]) + ", expected " + to_string(expected[i]));
+                }
+            }
+            for(size_t i = expected.size(); i < expected.size() + guard; ++i) {
+                CHECK(dst[i] == guard_byte);
+            }
+            for(size_t i = 0; i < offset; ++i) {
+                CHECK(out[i] == guard_byte);
+            }
+        }
+    }
+}
+
+void test_unpack(size_t bits)
+{
+    uint32_t seed = uint32_t(bits) * 31;
+    vector<uint8_t> in(PackedBytes(bits, max_samples) + 8);
+    vector<uint16_t> out(max_samples + guard + 8);
+    vector<uint16_t> expected;
+    const uint16_t guard_word = 0xa5a5;
+
+    for(size_t n = 0; n <= max_samples; ++n) {
+        for(size_t offset = 0; offset < 4; ++offset) {
+            for(auto& v : in) v = uint8_t(Random(seed));
+            const uint8_t* src = in.data() + offset;
+            uint16_t* dst = out.data() + offset;
+            std::fill(out.begin(), out.end(), guard_word);
+
+            if(bits == 10) Unpack10bit(dst, src, n);
+            else           Unpack12bit(dst, src, n);
+
+            ReferenceUnpack(expected, src, n, bits);
+            for(size_t i = 0; i < n; ++i) {
+                if(dst[i] != expected[i]) {
+                    throw runtime_error("Unpack" + to_string(bits) + "bit n=" + to_string(n) + " offset=" + to_string(offset) +
+                                        ": sample " + to_string(i) + " is " + to_string(dst[i]) + ", expected " + to_string(expected[i]));
+                }
+            }
+            for(size_t i = n; i < n + guard; ++i) {
+                CHECK(dst[i] == guard_word);
+            }
+            for(size_t i = 0; i < offset; ++i) {
+                CHECK(out[i] == guard_word);
+            }
+        }
+    }
+}
+
+int main(int, char**)
+{
+    cout << "ssse3: " << CpuHasSsse3() << ", avx2: " << CpuHasAvx2() << endl;
+    for(size_t bits : {10, 12}) {
+        test_pack(bits);
+        test_unpack(bits);
+    }
+    cout << "All pixel packing tests passed." << endl;
+    return 0;
+}
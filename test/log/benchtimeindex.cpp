@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+
+#include <pangolin/log/packetstream_reader.h>
+#include <pangolin/log/packetstream_writer.h>
+#include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/timer.h>
+
+using namespace std;
+using namespace pangolin;
+
+// Writes a log of num_packets small packets (unless it already exists),
+// then compares opening it with the full and the sparse (time) index, and
+// seeking to random times, reading the packet found.
+
+const int64_t period_us = 1000;
+
+void WriteLog(const string& filename, size_t num_packets)
+{
+    PacketStreamWriter writer(filename);
+    PacketStreamSource source;
+    source.driver = "bench";
+    writer.AddSource(source);
+
+    char data[16] = {};
+    for(size_t n = 0; n < num_packets; ++n) {
+        // Regular, with some jitter.
+        const int64_t t = int64_t(n) * period_us + int64_t(n * 7919 % 300);
+        writer.WriteSourcePacket(0, data, t, sizeof(data));
+    }
+}
+
+void Run(const string& filename, bool sparse, size_t num_seeks)
+{
+    const basetime open_start = TimeNow();
+    PacketStreamReader reader(filename, sparse);
+    const double open_ms = TimeDiff_us(open_start, TimeNow()) / 1e3;
+
+    const size_t num_packets = reader.NumPackets(0);
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> time(0, int64_t(num_packets) * period_us);
+
+    size_t errors = 0;
+    const basetime seek_start = TimeNow();
+    for(size_t i = 0; i < num_seeks; ++i) {
+        const int64_t t = time(rng);
+        const size_t frame = reader.Seek(0, SyncTime::TimePoint() + chrono::microseconds(t));
+        if(frame >= num_packets) continue;
+        Packet packet = reader.NextFrame(0);
+        if(packet.time < t || (frame > 0 && reader.IndexEntry(0, frame - 1).capture_time >= t)) ++errors;
+    }
+    const double seek_us = double(TimeDiff_us(seek_start, TimeNow())) / num_seeks;
+
+    if(errors) cerr << errors << " seeks found the wrong packet!" << endl;
+    cout << fixed << setprecision(1) << setw(12) << left << (sparse ? "sparse" : "full")
+         << right << "open: " << setw(8) << open_ms << " ms"
+         << "  seek: " << setw(6) << seek_us << " us" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    const string filename = argc > 1 ? argv[1] : "bench_time_index.pango";
+    const size_t num_packets = argc > 2 ? std::stoul(argv[2]) : 10000000;
+    const size_t num_seeks = argc > 3 ? std::stoul(argv[3]) : 20000;
+
+    if(!FileExists(filename)) {
+        cout << "writing " << num_packets << " packets to " << filename << endl;
+        WriteLog(filename, num_packets);
+    }
+
+    // Sparse first, so that the full index isn't helped by a warm page cache.
+    Run(filename, true, num_seeks);
+    Run(filename, false, num_seeks);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <pangolin/log/packetstream_writer.h>
+#include <pangolin/utils/timer.h>
+
+using namespace std;
+using namespace pangolin;
+
+// Writes total_mb of variable size packets to a .pango file through each
+// PacketStreamWriter write mode (see SetDirectIO and SetIoUring) and
+// reports the throughput, including the final flush on Close().
+
+struct Mode
+{
+    string name;
+    bool direct_io;
+    size_t sync_bytes;
+    size_t io_uring_depth;
+};
+
+double Run(const string& filename, const Mode& mode, size_t total_bytes, size_t packet_bytes)
+{
+    // Sizes vary so that packets don't fall on block boundaries.
+    vector<char> data(packet_bytes + packet_bytes / 2);
+    for(size_t i = 0; i < data.size(); ++i) data[i] = char(i * 31);
+
+    PacketStreamWriter writer;
+    writer.SetDirectIO(mode.direct_io, mode.sync_bytes);
+    writer.SetIoUring(mode.io_uring_depth);
+
+    const basetime start = TimeNow();
+    writer.Open(filename, 64*1024*1024);
+    PacketStreamSource source;
+    source.driver = "bench";
+    writer.AddSource(source);
+
+    size_t written = 0;
+    for(size_t n = 0; written < total_bytes; ++n) {
+        const size_t size = packet_bytes / 2 + (n * 7919) % packet_bytes;
+        writer.WriteSourcePacket(0, data.data(), int64_t(n), size);
+        written += size;
+    }
+    writer.Close();
+    const double secs = TimeDiff_us(start, TimeNow()) / 1e6;
+
+    remove(filename.c_str());
+    return written / secs;
+}
+
+int main(int argc, char** argv)
+{
+    const string filename = argc > 1 ? argv[1] : "bench_write.pango";
+    const size_t total_mb = argc > 2 ? std::stoul(argv[2]) : 256;
+    const size_t packet_kb = argc > 3 ? std::stoul(argv[3]) : 1024;
+
+    const vector<Mode> modes = {
+        {"cached",               false, 0,            0},
+        {"direct_io",            true,  0,            0},
+        {"direct_io, sync 64MB", true,  64*1024*1024, 0},
+        {"io_uring 4",           false, 0,            4},
+        {"io_uring 16",          false, 0,            16},
+        {"io_uring 16, direct",  true,  0,            16},
+    };
+
+    cout << "file: " << filename << "  total: " << total_mb << " MB  packets: ~" << packet_kb << " KB" << endl;
+    for(const Mode& mode : modes) {
+        const double rate = Run(filename, mode, total_mb*1024*1024, packet_kb*1024);
+        cout << fixed << setprecision(1) << setw(24) << left << mode.name
+             << right << setw(8) << rate / (1024*1024) << " MB/s" << endl;
+    }
+    return 0;
+}
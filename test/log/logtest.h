@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pangolin/log/packetstream_reader.h>
+#include <pangolin/log/packetstream_writer.h>
+
+#include "../check.h"
+
+// Helpers shared by the .pango round-trip tests.
+
+namespace logtest
+{
+
+// Deterministic payload for packet num of source src. Sizes vary so that
+// packets don't fall on regular boundaries.
+inline std::string Payload(size_t src, size_t num)
+{
+    std::string data = "source " + std::to_string(src) + " packet " + std::to_string(num) + " ";
+    const size_t len = data.size() + (num * 37 + src * 101) % 300;
+    for(size_t i = data.size(); i < len; ++i) {
+        data.push_back(char('a' + (i + num) % 26));
+    }
+    return data;
+}
+
+inline int64_t Time_us(size_t src, size_t num)
+{
+    return 1000000 + int64_t(num) * 10000 + int64_t(src) * 17;
+}
+
+inline pangolin::PacketStreamSourceId AddSource(pangolin::PacketStreamWriter& writer, const std::string& name, const std::string& codec = "")
+{
+    pangolin::PacketStreamSource source;
+    source.driver = name;
+    source.uri = name + "://";
+    source.data_compression = codec;
+    return writer.AddSource(source);
+}
+
+// Write num_packets packets for each of num_sources sources, interleaved.
+inline void WritePackets(pangolin::PacketStreamWriter& writer, size_t num_sources, size_t num_packets, size_t first = 0)
+{
+    for(size_t n = first; n < first + num_packets; ++n) {
+        for(size_t s = 0; s < num_sources; ++s) {
+            const std::string data = Payload(s, n);
+            writer.WriteSourcePacket(s, data.data(), Time_us(s, n), data.size());
+        }
+    }
+}
+
+inline void CheckPacket(pangolin::Packet& packet, size_t src, size_t num)
+{
+    const std::string expected = Payload(src, num);
+    CHECK(packet.src == src);
+    CHECK(packet.sequence_num == num);
+    CHECK(packet.time == Time_us(src, num));
+    CHECK(packet.size == expected.size());
+    std::string data(packet.size, '\0');
+    CHECK(packet.Read(&data[0], data.size()) == data.size());
+    CHECK(data == expected);
+}
+
+// Index entries as seen through NumPackets / IndexEntry, which works for
+// sparse and full indices alike.
+inline void CheckIndex(pangolin::PacketStreamReader& reader, const std::vector<pangolin::PacketStreamSource>& expected)
+{
+    for(size_t s = 0; s < expected.size(); ++s) {
+        CHECK(reader.NumPackets(s) == expected[s].index.size());
+        for(size_t n = 0; n < expected[s].index.size(); ++n) {
+            const pangolin::PacketStreamSource::PacketInfo info = reader.IndexEntry(s, n);
+            CHECK(info.pos == expected[s].index[n].pos);
+            CHECK(info.capture_time == expected[s].index[n].capture_time);
+        }
+    }
+}
+
+// Read every packet in file order, then some by seeking.
+inline void CheckPackets(pangolin::PacketStreamReader& reader, size_t num_sources, size_t num_packets)
+{
+    for(size_t n = 0; n < num_packets; ++n) {
+        for(size_t s = 0; s < num_sources; ++s) {
+            pangolin::Packet packet = reader.NextFrame();
+            CheckPacket(packet, s, n);
+        }
+    }
+
+    for(size_t i = 0; i < num_packets; i += 7) {
+        const size_t n = num_packets - 1 - i;
+        for(size_t s = 0; s < num_sources; ++s) {
+            CHECK(reader.Seek(s, n) == n);
+            pangolin::Packet packet = reader.NextFrame(s);
+            CheckPacket(packet, s, n);
+        }
+    }
+}
+
+inline std::vector<char> ReadFile(const std::string& filename)
+{
+    std::ifstream f(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+inline void WriteFile(const std::string& filename, const std::vector<char>& data)
+{
+    std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+    f.write(data.data(), data.size());
+}
+
+// Position just past the varint at data[p].
+inline size_t SkipVarint(const std::vector<char>& data, size_t p)
+{
+    while(data[p] & 0x80) ++p;
+    return p + 1;
+}
+
+// Replace the varint at data[p] with value, moving the rest of the file along
+// and fixing up the footer so that the index is still found. Only positions
+// after p are off.
+inline void ReplaceVarint(std::vector<char>& data, size_t p, uint64_t value)
+{
+    const size_t old_len = SkipVarint(data, p) - p;
+    std::string replacement;
+    pangolin::appendCompressedUnsignedInt(replacement, value);
+    data.erase(data.begin() + p, data.begin() + p + old_len);
+    data.insert(data.begin() + p, replacement.begin(), replacement.end());
+
+    uint64_t index_pos;
+    std::memcpy(&index_pos, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+    index_pos += replacement.size() - old_len;
+    std::memcpy(data.data() + data.size() - sizeof(uint64_t), &index_pos, sizeof(uint64_t));
+}
+
+// Position of the first record with the given tag which starts with its own
+// position as a uint64, as schema and dictionary records do.
+inline size_t FindRecord(const std::vector<char>& data, uint32_t tag)
+{
+    for(size_t p = 0; p + pangolin::TAG_LENGTH + sizeof(uint64_t) <= data.size(); ++p) {
+        uint64_t pos;
+        std::memcpy(&pos, data.data() + p + pangolin::TAG_LENGTH, sizeof(uint64_t));
+        if(std::memcmp(data.data() + p, &tag, pangolin::TAG_LENGTH) == 0 && pos == p) {
+            return p;
+        }
+    }
+    throw std::runtime_error("Record not found");
+}
+
+// True if f throws a runtime_error whose message contains what.
+template<typename F>
+bool ThrowsRuntimeError(F&& f, const std::string& what)
+{
+    try {
+        f();
+    }catch(const std::runtime_error& e) {
+        return std::string(e.what()).find(what) != std::string::npos;
+    }
+    return false;
+}
+
+}
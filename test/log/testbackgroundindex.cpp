@@ -0,0 +1,146 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 3;
+const size_t num_packets = 2000;
+
+// Source num_sources is only declared half way through the file. The index
+// and footer are cut off, so that readers have to rebuild the index.
+vector<PacketStreamSource> WriteLog(const string& filename)
+{
+    PacketStreamWriter writer;
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    WritePackets(writer, num_sources, num_packets / 2);
+    AddSource(writer, "late");
+    for(size_t n = num_packets / 2; n < num_packets; ++n) {
+        for(size_t s = 0; s <= num_sources; ++s) {
+            const size_t num = s < num_sources ? n : n - num_packets / 2;
+            const string data = Payload(s, num);
+            writer.WriteSourcePacket(s, data.data(), Time_us(s, num), data.size());
+        }
+    }
+    vector<PacketStreamSource> sources = writer.Sources();
+    writer.Close();
+
+    vector<char> data = ReadFile(filename);
+    uint64_t index_pos;
+    memcpy(&index_pos, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+    data.resize(index_pos);
+    WriteFile(filename, data);
+    return sources;
+}
+
+void WaitForIndex(PacketStreamReader& reader)
+{
+    while(!reader.IndexComplete()) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+// Packets of every source, in file order.
+void CheckAllPackets(PacketStreamReader& reader)
+{
+    for(size_t n = 0; n < num_packets; ++n) {
+        const size_t sources = n < num_packets / 2 ? num_sources : num_sources + 1;
+        for(size_t s = 0; s < sources; ++s) {
+            Packet packet = reader.NextFrame();
+            const size_t num = s < num_sources ? n : n - num_packets / 2;
+            CheckPacket(packet, s, num);
+        }
+    }
+}
+
+void test_background()
+{
+    const string filename = "test_background_index.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+
+    PacketStreamReader reader;
+    reader.SetBackgroundIndexing(true);
+    reader.Open(filename);
+
+    // As PangoVideo does, hold on to a source while indexing runs.
+    const PacketStreamSource* first = &reader.Sources()[0];
+    WaitForIndex(reader);
+
+    // The late source isn't added behind the caller's back...
+    CHECK(&reader.Sources()[0] == first);
+    CHECK(reader.Sources().size() == num_sources);
+    vector<PacketStreamSource> early(written.begin(), written.begin() + num_sources);
+    CheckIndex(reader, early);
+
+    // ...but joins, with its index, once reading reaches its declaration.
+    CheckAllPackets(reader);
+    CHECK(reader.Sources().size() == num_sources + 1);
+    CheckIndex(reader, written);
+    reader.Close();
+
+    // The appended index covers every source.
+    PacketStreamReader reopened(filename);
+    CHECK(reopened.Sources().size() == num_sources + 1);
+    CheckIndex(reopened, written);
+    CheckAllPackets(reopened);
+}
+
+void test_foreground()
+{
+    // Without background indexing, every source is known after Open().
+    const string filename = "test_foreground_index.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+
+    PacketStreamReader reader(filename);
+    CHECK(reader.Sources().size() == num_sources + 1);
+    CheckIndex(reader, written);
+    CheckAllPackets(reader);
+}
+
+void test_bad_source_id()
+{
+    // A late declaration with an id beyond the next is rejected, not
+    // allocated for.
+    const string filename = "test_background_index_bad_id.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+
+    vector<char> data = ReadFile(filename);
+    const string late = "\"driver\": \"late\"";
+    const auto it = search(data.begin(), data.end(), late.begin(), late.end());
+    CHECK(it != data.end());
+    const string id = "\"id\": " + to_string(num_sources);
+    auto id_pos = search(data.begin(), data.end(), id.begin(), id.end());
+    while(id_pos != data.end() && id_pos < it - 200) {
+        id_pos = search(id_pos + 1, data.end(), id.begin(), id.end());
+    }
+    CHECK(id_pos != data.end());
+    *(id_pos + id.size() - 1) = '9';
+    WriteFile(filename, data);
+
+    for(bool background : {false, true}) {
+        PacketStreamReader reader;
+        reader.SetBackgroundIndexing(background);
+        reader.Open(filename);
+        WaitForIndex(reader);
+        CHECK(reader.Sources().size() == num_sources);
+        vector<PacketStreamSource> early(written.begin(), written.begin() + num_sources);
+        CheckIndex(reader, early);
+    }
+}
+
+int main(int, char**)
+{
+    test_background();
+    test_foreground();
+    test_bad_source_id();
+    cout << "All background index tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <cstring>
+#include <iostream>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 3;
+const size_t num_packets = 300;
+
+vector<PacketStreamSource> WriteLog(const string& filename)
+{
+    PacketStreamWriter writer;
+    writer.SetCheckpointInterval(16);
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    WritePackets(writer, num_sources, num_packets);
+    vector<PacketStreamSource> sources = writer.Sources();
+    writer.Close();
+    return sources;
+}
+
+// Cut the file at pos, as if the recording had stopped there.
+void Truncate(const string& filename, uint64_t pos)
+{
+    vector<char> data = ReadFile(filename);
+    CHECK(pos <= data.size());
+    data.resize(pos);
+    WriteFile(filename, data);
+}
+
+uint64_t IndexPos(const string& filename)
+{
+    const vector<char> data = ReadFile(filename);
+    uint64_t index_pos;
+    memcpy(&index_pos, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+    return index_pos;
+}
+
+void test_lost_index()
+{
+    const string filename = "test_checkpoints.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+    Truncate(filename, IndexPos(filename));
+
+    PacketStreamReader reader(filename);
+    CheckIndex(reader, written);
+    CheckPackets(reader, num_sources, num_packets);
+    reader.Close();
+
+    // The recovered index was appended, so it is used next time.
+    PacketStreamReader reopened(filename);
+    CheckIndex(reopened, written);
+}
+
+void test_partial_packet()
+{
+    const string filename = "test_checkpoints_partial.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+
+    // Stop part way through a packet. Only the packets before it survive.
+    const uint64_t cut = written[1].index[150].pos;
+    Truncate(filename, cut + 5);
+
+    vector<PacketStreamSource> expected = written;
+    for(PacketStreamSource& s : expected) {
+        while(!s.index.empty() && uint64_t(s.index.back().pos) >= cut) {
+            s.index.pop_back();
+        }
+    }
+
+    PacketStreamReader reader(filename);
+    CheckIndex(reader, expected);
+    for(size_t s = 0; s < num_sources; ++s) {
+        const size_t last = expected[s].index.size() - 1;
+        CHECK(reader.Seek(s, last) == last);
+        Packet packet = reader.NextFrame(s);
+        CheckPacket(packet, s, last);
+    }
+}
+
+void test_distant_checkpoint()
+{
+    // Small packets at the start, then large ones after the last
+    // checkpoint: too far back to search for, so the index is rebuilt by a
+    // linear scan instead.
+    const string filename = "test_checkpoints_distant.pango";
+    const size_t num_small = 64;
+    const size_t num_large = 7;
+    const string large(300*1024, 'x');
+
+    PacketStreamWriter writer;
+    writer.SetCheckpointInterval(8);
+    writer.Open(filename);
+    AddSource(writer, "src");
+    WritePackets(writer, 1, num_small);
+    for(size_t n = 0; n < num_large; ++n) {
+        writer.WriteSourcePacket(0, large.data(), Time_us(0, num_small + n), large.size());
+    }
+    const vector<PacketStreamSource> written = writer.Sources();
+    writer.Close();
+    Truncate(filename, IndexPos(filename));
+
+    PacketStreamReader reader(filename);
+    CheckIndex(reader, written);
+    for(size_t n = 0; n < num_small; ++n) {
+        Packet packet = reader.NextFrame();
+        CheckPacket(packet, 0, n);
+    }
+    for(size_t n = 0; n < num_large; ++n) {
+        Packet packet = reader.NextFrame();
+        CHECK(packet.sequence_num == num_small + n);
+        CHECK(packet.size == large.size());
+    }
+}
+
+int main(int, char**)
+{
+    test_lost_index();
+    test_partial_packet();
+    test_distant_checkpoint();
+    cout << "All checkpoint tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <cstring>
+#include <iostream>
+
+#include <pangolin/log/packet_compression.h>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 2;
+// Enough packets that each source trains its dictionary part way through.
+const size_t num_packets = 2000;
+
+// Sources 0 and 1 declare codec, source 2 is stored as is. Returns the
+// sources as written.
+vector<PacketStreamSource> WriteLog(const string& filename, const string& codec)
+{
+    PacketStreamWriter writer;
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s), codec);
+    }
+    AddSource(writer, "raw");
+    WritePackets(writer, num_sources, num_packets);
+
+    // One large and one incompressible packet.
+    const string large(1024*1024, 'z');
+    writer.WriteSourcePacket(0, large.data(), Time_us(0, num_packets), large.size());
+    string noise(4096, '\0');
+    for(size_t i = 0; i < noise.size(); ++i) noise[i] = char((i * 2654435761u) >> 13);
+    writer.WriteSourcePacket(1, noise.data(), Time_us(1, num_packets), noise.size());
+    writer.WriteSourcePacket(2, noise.data(), Time_us(2, 0), noise.size());
+
+    vector<PacketStreamSource> sources = writer.Sources();
+    writer.Close();
+    return sources;
+}
+
+void test_round_trip(const string& codec)
+{
+    const string filename = "test_compression_" + codec + ".pango";
+    const vector<PacketStreamSource> written = WriteLog(filename, codec);
+
+    const bool supported = PacketCompressor::Supported(codec);
+    for(size_t s = 0; s < num_sources; ++s) {
+        // Without the codec, the writer warns and stores packets as is.
+        CHECK(written[s].data_compression == (supported ? codec : string()));
+    }
+
+    PacketStreamReader reader(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        CHECK(reader.Sources()[s].data_compression == written[s].data_compression);
+        CHECK(reader.NumPackets(s) == num_packets + 1);
+    }
+    CheckPackets(reader, num_sources, num_packets);
+
+    // Later packets are decoded against a dictionary found by seeking.
+    CHECK(reader.Seek(1, num_packets - 1) == num_packets - 1);
+    {
+        Packet packet = reader.NextFrame(1);
+        CheckPacket(packet, 1, num_packets - 1);
+    }
+
+    // Each packet must be read before the next is taken from the stream.
+    CHECK(reader.Seek(0, num_packets) == num_packets);
+    {
+        Packet large = reader.NextFrame(0);
+        CHECK(large.size == 1024*1024);
+        string data(large.size, '\0');
+        CHECK(large.Read(&data[0], data.size()) == data.size());
+        CHECK(data == string(1024*1024, 'z'));
+    }
+
+    CHECK(reader.Seek(1, num_packets) == num_packets);
+    string noise[2];
+    for(size_t s = 1; s < 3; ++s) {
+        Packet packet = reader.NextFrame(s);
+        CHECK(packet.size == 4096);
+        noise[s-1].resize(packet.size);
+        CHECK(packet.Read(&noise[s-1][0], packet.size) == packet.size);
+    }
+    CHECK(noise[0] == noise[1]);
+    reader.Close();
+
+    if(supported) {
+        // Similar small packets compress well against the trained dictionary.
+        FindRecord(ReadFile(filename), TAG_SRC_DICT);
+        const vector<PacketStreamSource> raw = WriteLog("test_compression_raw.pango", "");
+        CHECK(ReadFile(filename).size() < ReadFile("test_compression_raw.pango").size() / 2);
+    }
+}
+
+// A compressed packet or dictionary claiming more bytes than the file holds
+// is rejected before anything is allocated for it.
+void test_corrupt_size(const string& codec)
+{
+    if(!PacketCompressor::Supported(codec)) return;
+
+    const string filename = "test_compression_corrupt.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename, codec);
+    const vector<char> original = ReadFile(filename);
+
+    // The stored size varint follows the tag, timestamp and source id.
+    vector<char> data = original;
+    const size_t pos = size_t(written[0].index[10].pos);
+    CHECK(memcmp(data.data() + pos, &TAG_SRC_PACKET, TAG_LENGTH) == 0);
+    string header;
+    header.append(reinterpret_cast<const char*>(&TAG_SRC_PACKET), TAG_LENGTH);
+    const int64_t time = written[0].index[10].capture_time;
+    header.append(reinterpret_cast<const char*>(&time), sizeof(time));
+    appendCompressedUnsignedInt(header, 0);
+    CHECK(memcmp(data.data() + pos, header.data(), header.size()) == 0);
+    ReplaceVarint(data, pos + header.size(), uint64_t(1) << 60);
+    WriteFile(filename, data);
+    {
+        PacketStreamReader reader(filename);
+        CHECK(reader.Seek(0, 10) == 10);
+        CHECK(ThrowsRuntimeError([&]{ reader.NextFrame(0); }, "Truncated compressed packet"));
+    }
+
+    // The dictionary length follows the tag, record position and source id.
+    data = original;
+    const size_t dict = FindRecord(data, TAG_SRC_DICT);
+    ReplaceVarint(data, SkipVarint(data, dict + TAG_LENGTH + sizeof(uint64_t)), uint64_t(1) << 60);
+    WriteFile(filename, data);
+    {
+        PacketStreamReader reader(filename);
+        CHECK(ThrowsRuntimeError([&]{
+            for(size_t i = 0; i <= num_packets; ++i) reader.NextFrame(0);
+        }, "Bad compression dictionary"));
+    }
+}
+
+int main(int, char**)
+{
+    for(const string codec : {"zstd", "lz4"}) {
+        if(!PacketCompressor::Supported(codec)) {
+            cout << codec << " not available: checking uncompressed fallback only." << endl;
+        }
+        test_round_trip(codec);
+        test_corrupt_size(codec);
+    }
+    cout << "All compression tests passed." << endl;
+    return 0;
+}
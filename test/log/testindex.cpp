@@ -0,0 +1,88 @@
+#include <cstring>
+#include <iostream>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 3;
+const size_t num_packets = 200;
+
+vector<PacketStreamSource> WriteLog(const string& filename, bool json_index)
+{
+    PacketStreamWriter writer;
+    writer.SetJsonIndex(json_index);
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    WritePackets(writer, num_sources, num_packets);
+    vector<PacketStreamSource> sources = writer.Sources();
+    writer.Close();
+    return sources;
+}
+
+void test_round_trip(bool json_index)
+{
+    const string filename = "test_index.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename, json_index);
+    const vector<char> original = ReadFile(filename);
+
+    PacketStreamReader reader(filename);
+    CHECK(reader.Sources().size() == num_sources);
+    CheckIndex(reader, written);
+    CheckPackets(reader, num_sources, num_packets);
+    reader.Close();
+
+    // A good index is used as is, not rebuilt and appended.
+    CHECK(ReadFile(filename) == original);
+}
+
+// Overwrite the varint payload size at the start of the binary index.
+void CorruptIndexSize(const string& filename, uint64_t payload_bytes)
+{
+    vector<char> data = ReadFile(filename);
+    uint64_t index_pos;
+    memcpy(&index_pos, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+    CHECK(memcmp(data.data() + index_pos, &TAG_PANGO_INDEX, TAG_LENGTH) == 0);
+
+    string varint;
+    appendCompressedUnsignedInt(varint, payload_bytes);
+    copy(varint.begin(), varint.end(), data.begin() + index_pos + TAG_LENGTH);
+    WriteFile(filename, data);
+}
+
+void test_corrupt_size()
+{
+    const string filename = "test_index_corrupt.pango";
+    const uint64_t bad_sizes[] = {
+        uint64_t(1) << 62,   // would fail to allocate
+        uint64_t(1) << 30,   // would allocate, but is beyond the end of file
+    };
+
+    for(uint64_t bad_size : bad_sizes) {
+        const vector<PacketStreamSource> written = WriteLog(filename, false);
+        CorruptIndexSize(filename, bad_size);
+
+        // The index is rejected and rebuilt by scanning the packets.
+        PacketStreamReader reader(filename);
+        CheckIndex(reader, written);
+        CheckPackets(reader, num_sources, num_packets);
+        reader.Close();
+
+        // The rebuilt index was appended, so it is used next time.
+        PacketStreamReader reopened(filename);
+        CheckIndex(reopened, written);
+    }
+}
+
+int main(int, char**)
+{
+    test_round_trip(false);
+    test_round_trip(true);
+    test_corrupt_size();
+    cout << "All index tests passed." << endl;
+    return 0;
+}
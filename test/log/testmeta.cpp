@@ -0,0 +1,148 @@
+#include <cstring>
+#include <iostream>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 2;
+const size_t num_packets = 200;
+
+// Metadata for packet num of source src. Two alternating key sets per
+// source, so that several schemas are in use, with every value type.
+picojson::value Meta(size_t src, size_t num)
+{
+    picojson::object meta;
+    meta["num"] = picojson::value(int64_t(num));
+    meta["src"] = picojson::value("source " + to_string(src));
+    if(num % 2) {
+        meta["exposure"] = picojson::value(0.25 * double(num) + 0.125);
+        meta["large"] = picojson::value(int64_t(-1) - (int64_t(1) << 40) * int64_t(num));
+        meta["ok"] = picojson::value(num % 3 == 0);
+        meta["none"] = picojson::value();
+    }else{
+        picojson::array values;
+        values.push_back(picojson::value(int64_t(num)));
+        values.push_back(picojson::value("item"));
+        picojson::object nested;
+        nested["x"] = picojson::value(double(num) / 3.0);
+        nested["list"] = picojson::value(values);
+        meta["nested"] = picojson::value(nested);
+        meta["empty"] = picojson::value(picojson::object());
+    }
+    return picojson::value(meta);
+}
+
+void WriteLog(const string& filename, bool json_meta)
+{
+    PacketStreamWriter writer;
+    writer.SetJsonMeta(json_meta);
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    for(size_t n = 0; n < num_packets; ++n) {
+        for(size_t s = 0; s < num_sources; ++s) {
+            const string data = Payload(s, n);
+            writer.WriteSourcePacket(s, data.data(), Time_us(s, n), data.size(), Meta(s, n));
+        }
+    }
+
+    // Metadata which isn't an object is written as JSON.
+    picojson::array list;
+    list.push_back(picojson::value(1.5));
+    list.push_back(picojson::value("last"));
+    const string data = Payload(0, num_packets);
+    writer.WriteSourcePacket(0, data.data(), Time_us(0, num_packets), data.size(), picojson::value(list));
+    writer.Close();
+}
+
+void CheckMeta(Packet& packet, const picojson::value& expected)
+{
+    CHECK(packet.meta.serialize() == expected.serialize());
+}
+
+void test_round_trip(bool json_meta)
+{
+    const string filename = "test_meta.pango";
+    WriteLog(filename, json_meta);
+
+    PacketStreamReader reader(filename);
+    for(size_t n = 0; n < num_packets; ++n) {
+        for(size_t s = 0; s < num_sources; ++s) {
+            Packet packet = reader.NextFrame();
+            CheckMeta(packet, Meta(s, n));
+            CheckPacket(packet, s, n);
+        }
+    }
+    {
+        Packet packet = reader.NextFrame();
+        CHECK(packet.meta.value().is<picojson::array>());
+        CHECK(packet.meta.value().get<picojson::array>().size() == 2);
+        CheckPacket(packet, 0, num_packets);
+    }
+
+    // Seeking past the schema records, backwards and forwards.
+    for(size_t i = 0; i < num_packets; i += 13) {
+        const size_t n = (i * 7) % num_packets;
+        for(size_t s = 0; s < num_sources; ++s) {
+            CHECK(reader.Seek(s, n) == n);
+            Packet packet = reader.NextFrame(s);
+            CHECK(packet.meta.contains("num"));
+            CHECK(packet.meta["num"].get<double>() == double(n));
+            CheckMeta(packet, Meta(s, n));
+            CheckPacket(packet, s, n);
+        }
+    }
+}
+
+// Metadata and schema key lengths claiming more bytes than the file holds
+// are rejected before anything is allocated for them.
+void test_corrupt_lengths()
+{
+    const string filename = "test_meta_corrupt.pango";
+    WriteLog(filename, false);
+    vector<PacketStreamSource> sources;
+    {
+        PacketStreamReader reader(filename);
+        sources = reader.Sources();
+    }
+    const vector<char> original = ReadFile(filename);
+
+    // Frame metadata: tag, source, schema position, then the length.
+    {
+        vector<char> data = original;
+        const size_t pos = size_t(sources[0].index[10].pos);
+        CHECK(memcmp(data.data() + pos, &TAG_SRC_META, TAG_LENGTH) == 0);
+        ReplaceVarint(data, SkipVarint(data, SkipVarint(data, pos + TAG_LENGTH)), uint64_t(1) << 60);
+        WriteFile(filename, data);
+
+        PacketStreamReader reader(filename);
+        CHECK(reader.Seek(0, 10) == 10);
+        CHECK(ThrowsRuntimeError([&](){ reader.NextFrame(0); }, "Stream may be corrupt"));
+    }
+
+    // Schema: tag, position, source, number of keys, then the first key length.
+    {
+        vector<char> data = original;
+        const size_t pos = FindRecord(data, TAG_META_SCHEMA);
+        ReplaceVarint(data, SkipVarint(data, SkipVarint(data, pos + TAG_LENGTH + sizeof(uint64_t))), uint64_t(1) << 60);
+        WriteFile(filename, data);
+
+        PacketStreamReader reader(filename);
+        CHECK(ThrowsRuntimeError([&](){
+            for(size_t n = 0; n < num_packets; ++n) reader.NextFrame();
+        }, "Bad metadata schema"));
+    }
+}
+
+int main(int, char**)
+{
+    test_round_trip(false);
+    test_round_trip(true);
+    test_corrupt_lengths();
+    cout << "All metadata tests passed." << endl;
+    return 0;
+}
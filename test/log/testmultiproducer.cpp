@@ -0,0 +1,107 @@
+#include <iostream>
+#include <thread>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 4;
+const size_t num_packets = 400;
+const size_t buffer_size = 256*1024;
+
+// Every 50th packet is larger than the write buffer.
+string ProducerPayload(size_t src, size_t num)
+{
+    string data = Payload(src, num);
+    if(num % 50 == 0) {
+        data.append(300*1024, char('A' + src));
+    }
+    return data;
+}
+
+void WriteLog(const string& filename, bool direct_io, size_t io_uring_depth)
+{
+    PacketStreamWriter writer;
+    writer.SetDirectIO(direct_io);
+    writer.SetIoUring(io_uring_depth);
+    writer.SetCheckpointInterval(64);
+    writer.Open(filename, buffer_size);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+
+    // One thread per source, all appending to the same file.
+    vector<thread> producers;
+    for(size_t s = 0; s < num_sources; ++s) {
+        producers.emplace_back([&writer, s](){
+            for(size_t n = 0; n < num_packets; ++n) {
+                const string data = ProducerPayload(s, n);
+                writer.WriteSourcePacket(s, data.data(), Time_us(s, n), data.size());
+            }
+        });
+    }
+    for(thread& t : producers) {
+        t.join();
+    }
+    writer.Close();
+}
+
+void CheckLog(const string& filename)
+{
+    PacketStreamReader reader(filename);
+    CHECK(reader.Sources().size() == num_sources);
+
+    // Each source's index is complete and in file order.
+    for(size_t s = 0; s < num_sources; ++s) {
+        CHECK(reader.NumPackets(s) == num_packets);
+        for(size_t n = 1; n < num_packets; ++n) {
+            CHECK(reader.IndexEntry(s, n-1).pos < reader.IndexEntry(s, n).pos);
+            CHECK(reader.IndexEntry(s, n).capture_time == Time_us(s, n));
+        }
+    }
+
+    // Packets of different producers interleave arbitrarily, but each
+    // source's packets are intact and in the order they were written.
+    vector<size_t> next(num_sources, 0);
+    for(size_t i = 0; i < num_sources * num_packets; ++i) {
+        Packet packet = reader.NextFrame();
+        CHECK(packet.src < num_sources);
+        const size_t n = next[packet.src]++;
+        const string expected = ProducerPayload(packet.src, n);
+        CHECK(packet.sequence_num == n);
+        CHECK(packet.time == Time_us(packet.src, n));
+        CHECK(packet.size == expected.size());
+        string data(packet.size, '\0');
+        CHECK(packet.Read(&data[0], data.size()) == data.size());
+        CHECK(data == expected);
+    }
+
+    // Random access through the index.
+    for(size_t s = 0; s < num_sources; ++s) {
+        for(size_t n = 3; n < num_packets; n += 41) {
+            CHECK(reader.Seek(s, n) == n);
+            Packet packet = reader.NextFrame(s);
+            CHECK(packet.sequence_num == n);
+            CHECK(packet.size == ProducerPayload(s, n).size());
+        }
+    }
+}
+
+int main(int, char**)
+{
+    const string filename = "test_multiproducer.pango";
+
+    WriteLog(filename, false, 0);
+    CheckLog(filename);
+
+    WriteLog(filename, true, 0);
+    CheckLog(filename);
+
+    WriteLog(filename, false, 8);
+    CheckLog(filename);
+
+    cout << "All multi-producer tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+
+#include <pangolin/utils/file_utils.h>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+const size_t num_sources = 2;
+const size_t num_packets = 500;
+
+void RemoveSegments(const string& filename)
+{
+    remove(filename.c_str());
+    for(size_t k = 1; FileExists(PacketStreamSegmentFilename(filename, k)); ++k) {
+        remove(PacketStreamSegmentFilename(filename, k).c_str());
+    }
+}
+
+// Writes the log with the given segment limits and returns the number of segments.
+size_t WriteLog(const string& filename, size_t max_bytes, int64_t max_us)
+{
+    RemoveSegments(filename);
+
+    PacketStreamWriter writer;
+    writer.SetSegmentLimits(max_bytes, max_us);
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    WritePackets(writer, num_sources, num_packets);
+    const size_t segments = writer.SegmentIndex() + 1;
+    writer.Close();
+    return segments;
+}
+
+void test_round_trip(size_t max_bytes, int64_t max_us)
+{
+    const string filename = "test_segments.pango";
+    const size_t segments = WriteLog(filename, max_bytes, max_us);
+    CHECK(segments > 1);
+
+    // The next segment is opened ahead of time, but removed again if unused.
+    CHECK(!FileExists(PacketStreamSegmentFilename(filename, segments)));
+
+    PacketStreamReader reader(filename);
+    CHECK(reader.Segments().size() == segments);
+    CHECK(reader.Sources().size() == num_sources);
+    for(size_t s = 0; s < num_sources; ++s) {
+        CHECK(reader.NumPackets(s) == num_packets);
+    }
+    CheckPackets(reader, num_sources, num_packets);
+    reader.Close();
+
+    RemoveSegments(filename);
+}
+
+void test_stale_segments()
+{
+    // A shorter recording over the top of a longer one must not pick up its
+    // remaining segments.
+    const string filename = "test_segments_stale.pango";
+    const size_t long_segments = WriteLog(filename, 8*1024, 0);
+
+    PacketStreamWriter writer;
+    writer.SetSegmentLimits(8*1024, 0);
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    WritePackets(writer, num_sources, 100);
+    const size_t segments = writer.SegmentIndex() + 1;
+    writer.Close();
+    CHECK(segments < long_segments);
+
+    PacketStreamReader reader(filename);
+    CHECK(reader.Segments().size() == segments);
+    for(size_t s = 0; s < num_sources; ++s) {
+        CHECK(reader.NumPackets(s) == 100);
+    }
+    CheckPackets(reader, num_sources, 100);
+    reader.Close();
+
+    RemoveSegments(filename);
+}
+
+int main(int, char**)
+{
+    test_round_trip(16*1024, 0);
+    test_round_trip(0, 200000);
+    test_stale_segments();
+    cout << "All segment tests passed." << endl;
+    return 0;
+}
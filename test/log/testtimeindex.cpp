@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include <pangolin/log/packetstream_scheduler.h>
+
+#include "logtest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace logtest;
+
+// Enough packets for several blocks of the time index per source.
+const size_t num_sources = 3;
+const size_t num_packets = 10000;
+
+// Irregular times, differing in rate per source.
+int64_t IrregularTime_us(size_t src, size_t num)
+{
+    return 1000000 + int64_t(num) * (1000 + 500 * int64_t(src)) + int64_t((num * num) % 400);
+}
+
+vector<PacketStreamSource> WriteLog(const string& filename)
+{
+    PacketStreamWriter writer;
+    writer.Open(filename);
+    for(size_t s = 0; s < num_sources; ++s) {
+        AddSource(writer, "src" + to_string(s));
+    }
+    vector<int64_t> last(num_sources, 0);
+    for(size_t n = 0; n < num_packets; ++n) {
+        for(size_t s = 0; s < num_sources; ++s) {
+            // Every fifth packet repeats the previous time.
+            if(n % 5 || n == 0) last[s] = IrregularTime_us(s, n);
+            const string data = Payload(s, n);
+            writer.WriteSourcePacket(s, data.data(), last[s], data.size());
+        }
+    }
+    vector<PacketStreamSource> sources = writer.Sources();
+    writer.Close();
+    return sources;
+}
+
+SyncTime::TimePoint TimePoint(int64_t time_us)
+{
+    return SyncTime::TimePoint() + chrono::microseconds(time_us);
+}
+
+void test_sparse_index()
+{
+    const string filename = "test_time_index.pango";
+    const vector<PacketStreamSource> written = WriteLog(filename);
+
+    PacketStreamReader reader(filename, true);
+    CHECK(reader.SparseIndex());
+    for(const PacketStreamSource& s : reader.Sources()) {
+        CHECK(s.index.empty());
+    }
+    CheckIndex(reader, written);
+
+    // Seek by time to, between, before and after packets.
+    for(size_t s = 0; s < num_sources; ++s) {
+        const auto& index = written[s].index;
+        const int64_t first = index.front().capture_time;
+        const int64_t last = index.back().capture_time;
+        for(int64_t t = first - 10; t <= last + 10; t += (last - first) / 997) {
+            const size_t expected = lower_bound(index.begin(), index.end(), t,
+                [](const PacketStreamSource::PacketInfo& a, int64_t time){ return a.capture_time < time; }
+            ) - index.begin();
+            CHECK(reader.FindFrame(s, TimePoint(t)) == expected);
+            if(expected < index.size()) {
+                CHECK(reader.Seek(s, TimePoint(t)) == expected);
+                Packet packet = reader.NextFrame(s);
+                CHECK(packet.sequence_num == expected);
+                CHECK(packet.time == index[expected].capture_time);
+            }
+        }
+    }
+}
+
+// The scheduler merges sources by time through NumPackets / IndexEntry, so
+// it must give the same sequence with either index.
+void test_scheduler()
+{
+    const string filename = "test_time_index_scheduler.pango";
+    WriteLog(filename);
+
+    PacketStreamScheduler full, sparse;
+    full.AddStreams(make_shared<PacketStreamReader>(filename, false));
+    shared_ptr<PacketStreamReader> sparse_reader = make_shared<PacketStreamReader>(filename, true);
+    CHECK(sparse_reader->SparseIndex());
+    sparse.AddStreams(sparse_reader);
+
+    const int64_t seek_us = IrregularTime_us(1, num_packets / 2);
+    full.Seek(TimePoint(seek_us));
+    sparse.Seek(TimePoint(seek_us));
+
+    size_t count = 0;
+    for(; full.Good(); ++count) {
+        size_t full_stream, sparse_stream;
+        Packet a = full.NextFrame(full_stream);
+        Packet b = sparse.NextFrame(sparse_stream);
+        CHECK(full_stream == sparse_stream);
+        CHECK(a.sequence_num == b.sequence_num);
+        CHECK(a.time == b.time);
+        CHECK(a.time >= seek_us);
+    }
+    CHECK(count > num_packets);
+    CHECK(!sparse.Good());
+}
+
+int main(int, char**)
+{
+    test_sparse_index();
+    test_scheduler();
+    cout << "All time index tests passed." << endl;
+    return 0;
+}
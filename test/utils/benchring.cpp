@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <pangolin/utils/fix_size_buffer_queue.h>
+#include <pangolin/utils/fix_size_buffer_ring.h>
+#include <pangolin/utils/timer.h>
+
+using namespace std;
+using namespace pangolin;
+
+// Passes num_frames buffers from a producer to a consumer thread through each
+// queue implementation and reports the hand-over rate.
+
+template<typename Queue, typename WaitFree, typename WaitValid>
+double Run(Queue& q, size_t num_buffers, size_t num_frames, WaitFree wait_free, WaitValid wait_valid)
+{
+    vector<size_t> storage(num_buffers);
+    for(auto& s : storage) q.returnOrAddUsedBuffer(&s);
+
+    const basetime start = TimeNow();
+    thread producer([&](){
+        for(size_t i=0; i < num_frames; ++i) {
+            wait_free();
+            size_t* b = q.getFreeBuffer();
+            *b = i;
+            q.addValidBuffer(b);
+        }
+    });
+
+    size_t errors = 0;
+    for(size_t i=0; i < num_frames; ++i) {
+        wait_valid();
+        size_t* b = q.getNext();
+        if(*b != i) ++errors;
+        q.returnOrAddUsedBuffer(b);
+    }
+    producer.join();
+    const double secs = TimeDiff_us(start, TimeNow()) / 1e6;
+
+    if(errors) cerr << errors << " frames out of order!" << endl;
+    return num_frames / secs;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t num_frames = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    const size_t buffer_counts[] = {2, 8, 64};
+
+    cout << "frames: " << num_frames << endl;
+    for(size_t num_buffers : buffer_counts) {
+        FixSizeBuffersQueue<size_t*> locked;
+        const double locked_rate = Run(locked, num_buffers, num_frames,
+            [&](){ while(locked.EmptyBuffers() == 0) this_thread::yield(); },
+            [&](){ while(locked.AvailableFrames() == 0) this_thread::yield(); }
+        );
+
+        // Same polling wait as above, to compare the cost of the queues alone.
+        FixSizeBuffersRing<size_t*> ring_poll(num_buffers);
+        const double ring_poll_rate = Run(ring_poll, num_buffers, num_frames,
+            [&](){ while(ring_poll.EmptyBuffers() == 0) this_thread::yield(); },
+            [&](){ while(ring_poll.AvailableFrames() == 0) this_thread::yield(); }
+        );
+
+        // Blocking wait, as used by ThreadVideo.
+        FixSizeBuffersRing<size_t*> ring_wait(num_buffers);
+        const double ring_wait_rate = Run(ring_wait, num_buffers, num_frames,
+            [&](){ while(!ring_wait.waitForFreeBuffer(chrono::microseconds(100000))) {} },
+            [&](){ while(!ring_wait.waitForValidBuffer(chrono::microseconds(100000))) {} }
+        );
+
+        cout << fixed << setprecision(2)
+             << "buffers: " << setw(3) << num_buffers
+             << "  queue (poll): " << setw(7) << locked_rate / 1e6 << " M/s"
+             << "  ring (poll): " << setw(7) << ring_poll_rate / 1e6 << " M/s"
+             << "  ring (wait): " << setw(7) << ring_wait_rate / 1e6 << " M/s" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <pangolin/utils/mapped_file.h>
+
+#include "../check.h"
+
+#ifndef _WIN_
+#  include <unistd.h>
+#endif
+
+using namespace std;
+using namespace pangolin;
+
+const string filename = "test_mapped_file.bin";
+
+string Bytes(size_t begin, size_t end)
+{
+    string s;
+    for(size_t i = begin; i < end; ++i) s.push_back(char(i * 7 + i / 251));
+    return s;
+}
+
+void Append(size_t begin, size_t end)
+{
+    ofstream f(filename, ios::binary | ios::app);
+    const string s = Bytes(begin, end);
+    f.write(s.data(), s.size());
+}
+
+string Read(istream& is, size_t n)
+{
+    string s(n, '\0');
+    is.read(&s[0], n);
+    s.resize(is.gcount());
+    return s;
+}
+
+struct MappedStream
+{
+    MappedStream(bool map = true)
+        : is(&buf)
+    {
+        file.open(filename, ios::in | ios::binary);
+        buf.reset(map ? MappedFile::Open(filename) : nullptr, &file);
+    }
+
+    filebuf file;
+    mappedstreambuf buf;
+    istream is;
+};
+
+void test_read_seek()
+{
+    remove(filename.c_str());
+    Append(0, 100000);
+
+    MappedStream m;
+    CHECK(m.buf.file() && m.buf.file()->Size() == 100000);
+    CHECK(Read(m.is, 10) == Bytes(0, 10));
+    CHECK(m.is.tellg() == 10);
+
+    m.is.seekg(50000);
+    CHECK(Read(m.is, 20000) == Bytes(50000, 70000));
+
+    const char* p = m.buf.take(100);
+    CHECK(p && string(p, 100) == Bytes(70000, 70100));
+    CHECK(m.is.tellg() == 70100);
+    CHECK(!m.buf.take(100000));
+
+    m.is.seekg(0, ios::end);
+    CHECK(m.is.tellg() == 100000);
+    CHECK(Read(m.is, 1).empty() && m.is.eof());
+}
+
+void test_growth()
+{
+    remove(filename.c_str());
+    Append(0, 5000);
+
+    MappedStream m;
+    CHECK(Read(m.is, 5000) == Bytes(0, 5000));
+    CHECK(m.is.peek() == EOF);
+    m.is.clear();
+
+    // Data appended after the file was mapped can be read, sought and taken.
+    Append(5000, 300000);
+    CHECK(Read(m.is, 1000) == Bytes(5000, 6000));
+    m.is.seekg(0, ios::end);
+    CHECK(m.is.tellg() == 300000);
+    m.is.seekg(250000);
+    const char* p = m.buf.take(10000);
+    CHECK(p && string(p, 10000) == Bytes(250000, 260000));
+    CHECK(Read(m.is, 100000) == Bytes(260000, 300000));
+}
+
+void test_truncation()
+{
+#ifndef _WIN_
+    remove(filename.c_str());
+    Append(0, 1 << 20);
+
+    MappedStream m;
+    m.is.seekg(1000);
+    CHECK(Read(m.is, 1000) == Bytes(1000, 2000));
+
+    // Reads beyond the new end stop there rather than touching unbacked pages.
+    CHECK(truncate(filename.c_str(), 8192) == 0);
+    m.is.seekg(0, ios::end);
+    CHECK(m.is.tellg() == 8192);
+    m.is.seekg(4096);
+    CHECK(Read(m.is, 1 << 20) == Bytes(4096, 8192));
+    m.is.clear();
+    m.is.seekg(8000);
+    CHECK(!m.buf.take(1000));
+    CHECK(m.is.seekg(100000).fail());
+    m.is.clear();
+
+    // Regrowing makes the data readable again.
+    Append(8192, 20000);
+    m.is.seekg(8000);
+    CHECK(Read(m.is, 12000) == Bytes(8000, 20000));
+#endif
+}
+
+// As used once the file can't be remapped.
+void test_fallback()
+{
+    remove(filename.c_str());
+    Append(0, 200000);
+
+    MappedStream m(false);
+    CHECK(!m.buf.file());
+    CHECK(!m.buf.take(10));
+    CHECK(Read(m.is, 10) == Bytes(0, 10));
+    CHECK(m.is.tellg() == 10);
+    m.is.seekg(100000);
+    CHECK(Read(m.is, 100) == Bytes(100000, 100100));
+    CHECK(Read(m.is, 80000) == Bytes(100100, 180100));
+    m.is.seekg(-50, ios::cur);
+    CHECK(Read(m.is, 50) == Bytes(180050, 180100));
+    m.is.seekg(0, ios::end);
+    CHECK(m.is.tellg() == 200000);
+
+    Append(200000, 210000);
+    CHECK(Read(m.is, 20000) == Bytes(200000, 210000));
+}
+
+int main(int, char**)
+{
+    test_read_seek();
+    test_growth();
+    test_truncation();
+    test_fallback();
+    remove(filename.c_str());
+    cout << "All mapped file tests passed." << endl;
+    return 0;
+}
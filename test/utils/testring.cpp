@@ -0,0 +1,163 @@
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <pangolin/utils/fix_size_buffer_ring.h>
+
+#include "../check.h"
+
+using namespace std;
+using namespace pangolin;
+
+void test_full_empty()
+{
+    SpscRing<int> ring(4);
+    int v = -1;
+
+    CHECK(ring.Capacity() == 4);
+    CHECK(ring.Empty() && !ring.Full() && ring.Size() == 0);
+    CHECK(!ring.pop(v) && v == -1);
+
+    for(int i=0; i < 4; ++i) {
+        CHECK(ring.push(int(i)));
+        CHECK(ring.Size() == size_t(i+1));
+    }
+    CHECK(ring.Full() && !ring.Empty());
+    CHECK(!ring.push(99));
+    CHECK(ring.Size() == 4);
+
+    for(int i=0; i < 4; ++i) {
+        CHECK(ring.pop(v) && v == i);
+    }
+    CHECK(ring.Empty() && !ring.pop(v));
+
+    bool threw = false;
+    try { SpscRing<int> bad(0); } catch(const invalid_argument&) { threw = true; }
+    CHECK(threw);
+}
+
+void test_wraparound()
+{
+    // Capacity that does not divide the number of operations so that the
+    // head and tail wrap at every possible slot offset.
+    SpscRing<int> ring(3);
+    int next_push = 0;
+    int next_pop = 0;
+    int v;
+
+    for(int round=0; round < 1000; ++round) {
+        const int n = 1 + round % 3;
+        for(int i=0; i < n; ++i) CHECK(ring.push(int(next_push++)));
+        CHECK(ring.Size() == size_t(n));
+        for(int i=0; i < n; ++i) {
+            CHECK(ring.pop(v) && v == next_pop);
+            ++next_pop;
+        }
+        CHECK(ring.Empty());
+    }
+
+    // Keep the ring partially full while wrapping.
+    CHECK(ring.push(int(next_push++)));
+    for(int i=0; i < 100; ++i) {
+        CHECK(ring.push(int(next_push++)));
+        CHECK(ring.pop(v) && v == next_pop++);
+        CHECK(ring.Size() == 1);
+    }
+}
+
+void test_move_only()
+{
+    SpscRing<unique_ptr<int>> ring(2);
+    CHECK(ring.push(unique_ptr<int>(new int(7))));
+    unique_ptr<int> p;
+    CHECK(ring.pop(p) && p && *p == 7);
+}
+
+void test_buffers_ring()
+{
+    const size_t num_buffers = 4;
+    vector<int> storage(num_buffers);
+    FixSizeBuffersRing<int*> q(num_buffers);
+    for(auto& s : storage) q.returnOrAddUsedBuffer(&s);
+
+    CHECK(q.EmptyBuffers() == num_buffers && q.AvailableFrames() == 0);
+    CHECK(q.getNext() == nullptr);
+    CHECK(q.getNewest() == nullptr);
+
+    // Fill every buffer.
+    for(size_t i=0; i < num_buffers; ++i) {
+        int* b = q.getFreeBuffer();
+        *b = int(i);
+        q.addValidBuffer(b);
+    }
+    CHECK(q.EmptyBuffers() == 0 && q.AvailableFrames() == num_buffers);
+
+    bool threw = false;
+    try { q.getFreeBuffer(); } catch(const runtime_error&) { threw = true; }
+    CHECK(threw);
+    CHECK(!q.waitForFreeBuffer(chrono::microseconds(1000)));
+
+    CHECK(!q.DropNFrames(num_buffers+1));
+    CHECK(q.DropNFrames(1));
+    CHECK(q.AvailableFrames() == num_buffers-1 && q.EmptyBuffers() == 1);
+
+    int* b = q.getNext();
+    CHECK(b && *b == 1);
+    q.returnOrAddUsedBuffer(b);
+
+    b = q.getNewest();
+    CHECK(b && *b == int(num_buffers-1));
+    q.returnOrAddUsedBuffer(b);
+    CHECK(q.AvailableFrames() == 0 && q.EmptyBuffers() == num_buffers);
+    CHECK(q.waitForFreeBuffers(num_buffers, chrono::microseconds(1000)));
+}
+
+void test_threaded()
+{
+    const size_t num_buffers = 3;
+    const int num_frames = 100000;
+    vector<int> storage(num_buffers);
+    FixSizeBuffersRing<int*> q(num_buffers);
+    for(auto& s : storage) q.returnOrAddUsedBuffer(&s);
+
+    thread producer([&](){
+        for(int i=0; i < num_frames; ++i) {
+            while(!q.waitForFreeBuffer(chrono::microseconds(100000))) {}
+            int* b = q.getFreeBuffer();
+            *b = i;
+            q.addValidBuffer(b);
+        }
+    });
+
+    for(int i=0; i < num_frames; ++i) {
+        while(!q.waitForValidBuffer(chrono::microseconds(100000))) {}
+        int* b = q.getNext();
+        CHECK(b && *b == i);
+        q.returnOrAddUsedBuffer(b);
+    }
+    producer.join();
+
+    CHECK(q.AvailableFrames() == 0 && q.EmptyBuffers() == num_buffers);
+
+    // Interrupt releases a waiting consumer without a frame.
+    thread interrupter([&](){
+        this_thread::sleep_for(chrono::milliseconds(10));
+        q.Interrupt();
+    });
+    CHECK(!q.waitForValidBuffer(chrono::seconds(10)));
+    interrupter.join();
+    q.Resume();
+}
+
+int main(int, char**)
+{
+    test_full_empty();
+    test_wraparound();
+    test_move_only();
+    test_buffers_ring();
+    test_threaded();
+    cout << "All ring tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pangolin/video/drivers/debayer.h>
+#include <pangolin/video/drivers/fused.h>
+#include <pangolin/video/drivers/mirror.h>
+#include <pangolin/video/drivers/shift.h>
+#include <pangolin/video/drivers/unpack.h>
+
+#include "videotest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace videotest;
+
+// Runs the same chain of filters with and without FusedVideo and compares
+// the frames. Bands are kept to the minimum height so that most of them read
+// halo rows of their neighbours.
+
+const size_t num_frames = 3;
+
+typedef std::function<unique_ptr<VideoInterface>(size_t num_threads)> ChainFactory;
+
+// Two GRAY16 streams of odd sizes, the first with a padded pitch.
+unique_ptr<VideoInterface> Gray16Source()
+{
+    const PixelFormat fmt = PixelFormatFromString("GRAY16LE");
+    const StreamInfo s0(fmt, 61, 150, 61*2 + 6, 0);
+    const StreamInfo s1(fmt, 40, 37, 40*2, (unsigned char*)0 + s0.SizeBytes());
+    return unique_ptr<VideoInterface>(new PatternVideo({s0, s1}, s0.SizeBytes() + s1.SizeBytes()));
+}
+
+// shift, flips and 8-bit demosaic, all row separable
+unique_ptr<VideoInterface> ShiftMirrorDebayer(size_t num_threads)
+{
+    unique_ptr<VideoInterface> v = Gray16Source();
+    v.reset(new ShiftVideo(v, PixelFormatFromString("GRAY8"), 8));
+    v.reset(new MirrorVideo(v, {MirrorOptionsFlipXY, MirrorOptionsFlipY}, num_threads));
+    v.reset(new DebayerVideo(v, {BAYER_METHOD_HQLINEAR, BAYER_METHOD_BILINEAR}, DC1394_COLOR_FILTER_GRBG, num_threads));
+    v.reset(new MirrorVideo(v, {MirrorOptionsFlipX, MirrorOptionsNone}, num_threads));
+    return v;
+}
+
+// 12-bit packed input, unpacked and demosaiced at 16 bits
+unique_ptr<VideoInterface> UnpackDebayer(size_t num_threads)
+{
+    const StreamInfo s0(PixelFormatFromString("GRAY12"), 64, 101, 64*12/8, 0);
+    unique_ptr<VideoInterface> v(new PatternVideo({s0}, s0.SizeBytes()));
+    v.reset(new UnpackVideo(v, PixelFormatFromString("GRAY16LE")));
+    v.reset(new DebayerVideo(v, {BAYER_METHOD_HQLINEAR}, DC1394_COLOR_FILTER_BGGR, num_threads));
+    v.reset(new MirrorVideo(v, {MirrorOptionsFlipXY}, num_threads));
+    return v;
+}
+
+// rotateCW isn't row separable, so only the debayer above it is fused.
+unique_ptr<VideoInterface> RotateBelow(size_t num_threads)
+{
+    unique_ptr<VideoInterface> v = Gray16Source();
+    v.reset(new ShiftVideo(v, PixelFormatFromString("GRAY8"), 4));
+    v.reset(new MirrorVideo(v, {MirrorOptionsRotateCW, MirrorOptionsRotateCW}, num_threads));
+    v.reset(new DebayerVideo(v, {BAYER_METHOD_HQLINEAR, BAYER_METHOD_HQLINEAR}, DC1394_COLOR_FILTER_RGGB, num_threads));
+    return v;
+}
+
+// With rotateCW at the top nothing is fused and frames are passed through.
+unique_ptr<VideoInterface> RotateAbove(size_t num_threads)
+{
+    unique_ptr<VideoInterface> v = Gray16Source();
+    v.reset(new ShiftVideo(v, PixelFormatFromString("GRAY8"), 4));
+    v.reset(new DebayerVideo(v, {BAYER_METHOD_HQLINEAR, BAYER_METHOD_BILINEAR}, DC1394_COLOR_FILTER_GBRG, num_threads));
+    v.reset(new MirrorVideo(v, {MirrorOptionsRotateCW, MirrorOptionsRotateCW}, num_threads));
+    return v;
+}
+
+void test_fused(const ChainFactory& chain, size_t expected_stages)
+{
+    for(size_t num_threads : {1, 3}) {
+        unique_ptr<VideoInterface> unfused = chain(num_threads);
+        unique_ptr<VideoInterface> inner = chain(1);
+        FusedVideo fused(inner, num_threads, 1);
+        CHECK(fused.NumFusedStages() == expected_stages);
+        CHECK(fused.SizeBytes() == unfused->SizeBytes());
+        CHECK(fused.Streams().size() == unfused->Streams().size());
+
+        vector<unsigned char> expected(unfused->SizeBytes());
+        vector<unsigned char> actual(fused.SizeBytes());
+        for(size_t n = 0; n < num_frames; ++n) {
+            CHECK(unfused->GrabNext(expected.data()));
+            memset(actual.data(), 0, actual.size());
+            CHECK(fused.GrabNext(actual.data()));
+
+            // Compare only the pixels of each stream, not pitch padding.
+            for(const StreamInfo& si : unfused->Streams()) {
+                const size_t row_bytes = si.Width() * si.PixFormat().bpp / 8;
+                for(size_t y = 0; y < si.Height(); ++y) {
+                    const size_t offset = size_t(si.Offset()) + y * si.Pitch();
+                    if(memcmp(expected.data() + offset, actual.data() + offset, row_bytes) != 0) {
+                        throw runtime_error("Fused output differs from unfused: frame " + to_string(n) +
+                                            ", row " + to_string(y) + ", " + to_string(num_threads) + " threads");
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int, char**)
+{
+    test_fused(ShiftMirrorDebayer, 4);
+    test_fused(UnpackDebayer, 3);
+    test_fused(RotateBelow, 1);
+    test_fused(RotateAbove, 0);
+    cout << "All fused video tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pangolin/video/drivers/mirror.h>
+
+#include "videotest.h"
+
+using namespace std;
+using namespace pangolin;
+using namespace videotest;
+
+// Compares MirrorVideo's vectorised and tiled transforms with a pixel at a
+// time reference, for every pixel size it supports, through and beyond the
+// frames on which the transpose tile size is tuned.
+
+const size_t num_frames = 12;
+
+const char* formats[] = {"GRAY8", "GRAY16LE", "RGB24", "GRAY32", "RGB48", "RGBA64", "RGB96F"};
+
+const MirrorOptions options[] = {
+    MirrorOptionsNone, MirrorOptionsFlipX, MirrorOptionsFlipY, MirrorOptionsFlipXY,
+    MirrorOptionsTranspose, MirrorOptionsRotateCW, MirrorOptionsRotateCCW
+};
+
+// Input pixel which the reference places at output (x,y)
+void SourcePixel(MirrorOptions option, size_t w, size_t h, size_t x, size_t y, size_t& sx, size_t& sy)
+{
+    switch(option) {
+    case MirrorOptionsFlipX:      sx = w-1-x; sy = y;     break;
+    case MirrorOptionsFlipY:      sx = x;     sy = h-1-y; break;
+    case MirrorOptionsFlipXY:     sx = w-1-x; sy = h-1-y; break;
+    case MirrorOptionsTranspose:  sx = y;     sy = x;     break;
+    case MirrorOptionsRotateCW:   sx = y;     sy = h-1-x; break;
+    case MirrorOptionsRotateCCW:  sx = w-1-y; sy = x;     break;
+    default:                      sx = x;     sy = y;     break;
+    }
+}
+
+void test_mirror(MirrorOptions option, size_t w, size_t h, size_t pad, size_t num_threads)
+{
+    vector<PixelFormat> fmts;
+    for(const char* f : formats) fmts.push_back(PixelFormatFromString(f));
+
+    unique_ptr<VideoInterface> input = Pattern(fmts, w, h, pad);
+    unique_ptr<VideoInterface> src = Pattern(fmts, w, h, pad);
+    MirrorVideo mirror(src, vector<MirrorOptions>(fmts.size(), option), num_threads);
+
+    const bool transposed = option == MirrorOptionsTranspose || option == MirrorOptionsRotateCW || option == MirrorOptionsRotateCCW;
+    CHECK(mirror.Streams().size() == fmts.size());
+
+    vector<unsigned char> in(input->SizeBytes());
+    vector<unsigned char> out(mirror.SizeBytes());
+    for(size_t n = 0; n < num_frames; ++n) {
+        CHECK(input->GrabNext(in.data()));
+        CHECK(mirror.GrabNext(out.data()));
+
+        for(size_t s = 0; s < fmts.size(); ++s) {
+            const StreamInfo& si = input->Streams()[s];
+            const StreamInfo& so = mirror.Streams()[s];
+            CHECK(so.Width() == (transposed ? h : w));
+            CHECK(so.Height() == (transposed ? w : h));
+
+            const size_t bpp = fmts[s].bpp / 8;
+            for(size_t y = 0; y < so.Height(); ++y) {
+                for(size_t x = 0; x < so.Width(); ++x) {
+                    size_t sx, sy;
+                    SourcePixel(option, w, h, x, y, sx, sy);
+                    if(memcmp(PixelPtr(so, out.data(), x, y), PixelPtr(si, in.data(), sx, sy), bpp) != 0) {
+                        throw runtime_error("Mirror option " + to_string(option) + ", " + formats[s] + " " +
+                                            to_string(w) + "x" + to_string(h) + " pad " + to_string(pad) +
+                                            ", frame " + to_string(n) + ": wrong pixel at (" + to_string(x) + "," + to_string(y) + ")");
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int, char**)
+{
+    const size_t sizes[][2] = { {1,1}, {7,3}, {33,17}, {300,70} };
+    for(MirrorOptions option : options) {
+        for(const auto& sz : sizes) {
+            for(size_t pad : {0, 5}) {
+                for(size_t num_threads : {1, 3}) {
+                    test_mirror(option, sz[0], sz[1], pad, num_threads);
+                }
+            }
+        }
+    }
+    cout << "All mirror tests passed." << endl;
+    return 0;
+}
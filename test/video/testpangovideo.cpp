@@ -0,0 +1,136 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pangolin/video/video.h>
+#include <pangolin/video/video_output.h>
+
+#include "../check.h"
+
+using namespace std;
+using namespace pangolin;
+
+const size_t w = 64;
+const size_t h = 48;
+const size_t num_frames = 20;
+
+vector<unsigned char> Frame(size_t n)
+{
+    vector<unsigned char> frame(w*h);
+    for(size_t i=0; i < frame.size(); ++i) {
+        frame[i] = (unsigned char)(i * 13 + n * 71 + (i / w) * 3);
+    }
+    return frame;
+}
+
+void Record(const string& filename, const string& options = "")
+{
+    VideoOutput out("pango:[" + options + "]//" + filename);
+    out.SetStreams({StreamInfo(PixelFormatFromString("GRAY8"), w, h, w)});
+    for(size_t n=0; n < num_frames; ++n) {
+        CHECK(out.WriteStreams(Frame(n).data()) == 0);
+    }
+}
+
+void test_grab_next(const string& uri)
+{
+    unique_ptr<VideoInterface> video = OpenVideo(uri);
+    CHECK(video->SizeBytes() == w*h);
+    vector<unsigned char> image(w*h);
+    for(size_t n=0; n < num_frames; ++n) {
+        CHECK(video->GrabNext(image.data()));
+        CHECK(image == Frame(n));
+    }
+    CHECK(!video->GrabNext(image.data()));
+}
+
+void test_grab_next_lease(const string& uri)
+{
+    vector<VideoFrameLease> leases;
+    {
+        unique_ptr<VideoInterface> video = OpenVideo(uri);
+        BufferLeaseVideoInterface* lv = dynamic_cast<BufferLeaseVideoInterface*>(video.get());
+        CHECK(lv);
+        for(size_t n=0; n < num_frames; ++n) {
+            VideoFrameLease lease = lv->GrabNextLease();
+            CHECK(lease);
+            CHECK(memcmp(lease.Ptr(), Frame(n).data(), w*h) == 0);
+            leases.push_back(move(lease));
+        }
+        CHECK(!lv->GrabNextLease());
+    }
+
+    // Leases remain valid once the video is closed.
+    for(size_t n=0; n < num_frames; ++n) {
+        CHECK(memcmp(leases[n].Ptr(), Frame(n).data(), w*h) == 0);
+    }
+}
+
+// Overwrite the PNG signature of frame n, so that it fails to decode.
+void CorruptPngFrame(const string& filename, size_t n)
+{
+    ifstream in(filename, ios::binary);
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+
+    const string signature = "\x89PNG";
+    size_t pos = data.find(signature);
+    for(size_t i=0; i < n && pos != string::npos; ++i) {
+        pos = data.find(signature, pos + 1);
+    }
+    CHECK(pos != string::npos);
+    data[pos + 1] = 'X';
+
+    ofstream out(filename, ios::binary | ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+// A frame which fails to decode on the decode threads is skipped, and the
+// frames after it are still returned.
+void test_decode_error(const string& filename)
+{
+    const size_t bad_frame = 5;
+    CorruptPngFrame(filename, bad_frame);
+
+    unique_ptr<VideoInterface> video = OpenVideo("pango:[decode_threads=3]//" + filename);
+    vector<unsigned char> image(w*h);
+    for(size_t n=0; n < num_frames; ++n) {
+        if(n == bad_frame) {
+            CHECK(!video->GrabNext(image.data()));
+        }else{
+            CHECK(video->GrabNext(image.data()));
+            CHECK(image == Frame(n));
+        }
+    }
+    CHECK(!video->GrabNext(image.data()));
+}
+
+int main(int, char**)
+{
+    const string filename = "test_pango_video.pango";
+    Record(filename);
+
+    test_grab_next("pango://" + filename);
+    test_grab_next_lease("pango://" + filename);
+
+    // Read ahead on a background thread.
+    test_grab_next("pango:[prefetch=4]//" + filename);
+    test_grab_next_lease("pango:[prefetch=4]//" + filename);
+
+    // Compressed frames, decoded on the prefetch thread or in parallel.
+    Record(filename, "encoder=png");
+    test_grab_next("pango://" + filename);
+    test_grab_next("pango:[prefetch=4]//" + filename);
+    test_grab_next("pango:[decode_threads=3]//" + filename);
+    test_grab_next_lease("pango:[decode_threads=3]//" + filename);
+    test_decode_error(filename);
+
+    remove(filename.c_str());
+    cout << "All pango video tests passed." << endl;
+    return 0;
+}
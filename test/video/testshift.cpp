@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pangolin/video/drivers/shift.h>
+
+#include "videotest.h"
+
+using namespace std;
+using namespace pangolin;
+
+// Compares DoShift16to8's vector kernel and scalar tail with a per-pixel
+// reference, for every width up to a few vectors, on pitched images.
+
+const size_t height = 3;
+const uint8_t guard = 0xa5;
+
+uint8_t Reference(uint16_t v, int shift, unsigned int mask, unsigned int offset, bool saturate)
+{
+    const unsigned int x = (v > offset ? v - offset : 0u);
+    const unsigned int y = (x >> shift) & mask;
+    return saturate ? uint8_t(std::min(y, 255u)) : uint8_t(y & 0xFF);
+}
+
+void test_shift(size_t w, int shift, unsigned int mask, unsigned int offset, bool saturate)
+{
+    // Pitches padded so that the end of each row is checked too.
+    const size_t in_pitch = 2*w + 6;
+    const size_t out_pitch = w + 5;
+    vector<uint16_t> in_data(in_pitch / 2 * height);
+    vector<unsigned char> out_data(out_pitch * height, guard);
+
+    uint32_t s = uint32_t(w * 7919 + shift * 31 + offset);
+    for(size_t i = 0; i < in_data.size(); ++i) {
+        s = s * 1664525u + 1013904223u;
+        // Include the extremes and values either side of offset.
+        const uint32_t r = s >> 8;
+        in_data[i] = (r % 8 == 0) ? 0 : (r % 8 == 1) ? 0xFFFF : (r % 8 == 2) ? uint16_t(offset + (r >> 4) % 3 - 1) : uint16_t(r >> 4);
+    }
+
+    const Image<unsigned char> in((unsigned char*)in_data.data(), w, height, in_pitch);
+    Image<unsigned char> out(out_data.data(), w, height, out_pitch);
+    DoShift16to8(out, in, shift, mask, offset, saturate);
+
+    for(size_t y = 0; y < height; ++y) {
+        const uint16_t* row_in = (const uint16_t*)in.RowPtr(y);
+        const uint8_t* row_out = out.RowPtr(y);
+        for(size_t x = 0; x < w; ++x) {
+            const uint8_t expected = Reference(row_in[x], shift, mask, offset, saturate);
+            if(row_out[x] != expected) {
+                throw runtime_error("DoShift16to8 w=" + to_string(w) + " shift=" + to_string(shift) + " mask=" + to_string(mask) +
+                                    " offset=" + to_string(offset) + " saturate=" + to_string(saturate) + ": pixel " + to_string(x) +
+                                    " of " + to_string(row_in[x]) + " gave " + to_string(row_out[x]) + ", expected " + to_string(expected));
+            }
+        }
+        for(size_t x = w; x < out_pitch; ++x) {
+            CHECK(row_out[x] == guard);
+        }
+    }
+}
+
+int main(int, char**)
+{
+    for(size_t w = 1; w <= 70; ++w) {
+        for(int shift = 0; shift < 16; ++shift) {
+            for(unsigned int mask : {0xFFFFu, 0x3FFu, 0xFFu, 0x0Fu}) {
+                for(unsigned int offset : {0u, 1u, 1000u, 65535u}) {
+                    test_shift(w, shift, mask, offset, false);
+                    test_shift(w, shift, mask, offset, true);
+                }
+            }
+        }
+    }
+    cout << "All shift tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <pangolin/video/drivers/thread_video_output.h>
+
+#include "../check.h"
+
+using namespace std;
+using namespace pangolin;
+
+const size_t frame_bytes = 16;
+
+// Child output which records the first byte of every frame and can be held
+// shut so that the writer thread stalls inside WriteStreams.
+struct GatedOutput : public VideoOutputInterface
+{
+    const vector<StreamInfo>& Streams() const override {
+        return streams;
+    }
+
+    void SetStreams(const vector<StreamInfo>& s, const string&, const picojson::value&) override {
+        streams = s;
+    }
+
+    int WriteStreams(const unsigned char* data, const picojson::value&) override {
+        unique_lock<mutex> l(m);
+        ++entered;
+        cv.notify_all();
+        cv.wait(l, [this](){ return open; });
+        if(data[0] == fail_value) {
+            throw runtime_error("write failed");
+        }
+        written.push_back(data[0]);
+        return 0;
+    }
+
+    bool IsPipe() const override {
+        return false;
+    }
+
+    void SetOpen(bool o) {
+        lock_guard<mutex> l(m);
+        open = o;
+        cv.notify_all();
+    }
+
+    // Wait until the writer thread has called WriteStreams n times.
+    void WaitEntered(size_t n) {
+        unique_lock<mutex> l(m);
+        cv.wait(l, [&](){ return entered >= n; });
+    }
+
+    vector<StreamInfo> streams;
+    mutex m;
+    condition_variable cv;
+    bool open = false;
+    size_t entered = 0;
+    int fail_value = -1;
+    vector<unsigned char> written;
+};
+
+unique_ptr<ThreadVideoOutput> MakeOutput(GatedOutput*& child, size_t num_buffers, ThreadVideoOutput::FullQueuePolicy policy)
+{
+    child = new GatedOutput();
+    unique_ptr<VideoOutputInterface> out(child);
+    unique_ptr<ThreadVideoOutput> thread_out(new ThreadVideoOutput(out, num_buffers, policy));
+    thread_out->SetStreams({StreamInfo(PixelFormatFromString("GRAY8"), frame_bytes, 1, frame_bytes)}, "", picojson::value());
+    return thread_out;
+}
+
+int Write(ThreadVideoOutput& out, unsigned char v)
+{
+    unsigned char frame[frame_bytes] = {v};
+    return out.WriteStreams(frame, picojson::value());
+}
+
+void test_block()
+{
+    const size_t num_buffers = 3;
+    GatedOutput* child;
+    unique_ptr<ThreadVideoOutput> out = MakeOutput(child, num_buffers, ThreadVideoOutput::FullQueueBlock);
+
+    // One frame is held by the stalled child, the rest fill the queue.
+    CHECK(Write(*out, 0) == 0);
+    child->WaitEntered(1);
+    for(size_t i=1; i <= num_buffers-1; ++i) {
+        CHECK(Write(*out, (unsigned char)i) == 0);
+    }
+    CHECK(out->QueuedFrames() == num_buffers-1);
+
+    // The next write must wait for the writer thread to free a buffer.
+    atomic<bool> returned(false);
+    thread producer([&](){
+        CHECK(Write(*out, (unsigned char)num_buffers) == 0);
+        returned = true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    CHECK(!returned);
+
+    child->SetOpen(true);
+    producer.join();
+    CHECK(returned);
+    out->Flush();
+
+    CHECK(out->DroppedFrames() == 0);
+    CHECK(out->QueuedFrames() == 0);
+    CHECK(child->written.size() == num_buffers+1);
+    for(size_t i=0; i < child->written.size(); ++i) {
+        CHECK(child->written[i] == i);
+    }
+}
+
+void test_drop()
+{
+    const size_t num_buffers = 3;
+    GatedOutput* child;
+    unique_ptr<ThreadVideoOutput> out = MakeOutput(child, num_buffers, ThreadVideoOutput::FullQueueDrop);
+
+    CHECK(Write(*out, 0) == 0);
+    child->WaitEntered(1);
+    for(size_t i=1; i <= num_buffers-1; ++i) {
+        CHECK(Write(*out, (unsigned char)i) == 0);
+    }
+
+    // Queue is full: further frames are discarded immediately.
+    for(size_t i=0; i < 5; ++i) {
+        CHECK(Write(*out, 100) == -1);
+    }
+    CHECK(out->DroppedFrames() == 5);
+    CHECK(out->QueuedFrames() == num_buffers-1);
+
+    child->SetOpen(true);
+    out->Flush();
+
+    // Only the accepted frames arrive, in order.
+    CHECK(child->written.size() == num_buffers);
+    for(size_t i=0; i < child->written.size(); ++i) {
+        CHECK(child->written[i] == i);
+    }
+
+    // Space is available again once the writer catches up.
+    CHECK(Write(*out, 50) == 0);
+    out->Flush();
+    CHECK(child->written.back() == 50);
+    CHECK(out->DroppedFrames() == 5);
+}
+
+void test_write_failure()
+{
+    GatedOutput* child;
+    unique_ptr<ThreadVideoOutput> out = MakeOutput(child, 2, ThreadVideoOutput::FullQueueBlock);
+    child->fail_value = 7;
+    child->SetOpen(true);
+
+    CHECK(Write(*out, 6) == 0);
+    CHECK(Write(*out, 7) == 0);
+    CHECK(Write(*out, 8) == 0);
+    out->Flush();
+
+    // Failed writes are counted as dropped and don't stop the writer.
+    CHECK(out->DroppedFrames() == 1);
+    CHECK(child->written.size() == 2 && child->written[0] == 6 && child->written[1] == 8);
+}
+
+int main(int, char**)
+{
+    test_block();
+    test_drop();
+    test_write_failure();
+    cout << "All thread output tests passed." << endl;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pangolin/video/video.h>
+
+#include "../check.h"
+
+// Helpers shared by the video filter tests.
+
+namespace videotest
+{
+
+// Streams of pseudo-random bytes which change every frame.
+struct PatternVideo : public pangolin::VideoInterface
+{
+    PatternVideo(const std::vector<pangolin::StreamInfo>& streams, size_t size_bytes)
+        : streams(streams), size_bytes(size_bytes), frame(0)
+    {
+    }
+
+    void Start() override {}
+    void Stop() override {}
+
+    size_t SizeBytes() const override {
+        return size_bytes;
+    }
+
+    const std::vector<pangolin::StreamInfo>& Streams() const override {
+        return streams;
+    }
+
+    bool GrabNext(unsigned char* image, bool) override {
+        uint32_t s = uint32_t(++frame) * 2654435761u;
+        for(size_t i = 0; i < size_bytes; ++i) {
+            s = s * 1664525u + 1013904223u;
+            image[i] = (unsigned char)(s >> 24);
+        }
+        return true;
+    }
+
+    bool GrabNewest(unsigned char* image, bool wait) override {
+        return GrabNext(image, wait);
+    }
+
+    std::vector<pangolin::StreamInfo> streams;
+    size_t size_bytes;
+    size_t frame;
+};
+
+// One stream per entry of fmts, each w x h and with pitch padded by pad
+// bytes, laid out one after the other.
+inline std::unique_ptr<pangolin::VideoInterface> Pattern(const std::vector<pangolin::PixelFormat>& fmts, size_t w, size_t h, size_t pad = 0)
+{
+    std::vector<pangolin::StreamInfo> streams;
+    size_t size_bytes = 0;
+    for(const pangolin::PixelFormat& fmt : fmts) {
+        streams.emplace_back(fmt, w, h, w * fmt.bpp / 8 + pad, (unsigned char*)0 + size_bytes);
+        size_bytes += streams.back().SizeBytes();
+    }
+    return std::unique_ptr<pangolin::VideoInterface>(new PatternVideo(streams, size_bytes));
+}
+
+// Pointer to pixel (x,y) of stream si in frame
+inline const unsigned char* PixelPtr(const pangolin::StreamInfo& si, const unsigned char* frame, size_t x, size_t y)
+{
+    return frame + size_t(si.Offset()) + y * si.Pitch() + x * (si.PixFormat().bpp / 8);
+}
+
+}
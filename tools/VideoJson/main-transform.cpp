@@ -45,7 +45,7 @@ int main( int argc, char* argv[] )
             {
                 pangolin::Packet pkt = reader.NextFrame();
                 buffer.resize(pkt.BytesRemaining());
-                pkt.Stream().read(buffer.data(), buffer.size());
+                pkt.Read(buffer.data(), buffer.size());
 
                 const picojson::value& new_frame_json = all_properties[pkt.src]["frame_properties"][pkt.sequence_num];
                 writer.WriteSourcePacket(pkt.src, buffer.data(), pkt.time, buffer.size(), new_frame_json);